@@ -1,5 +1,7 @@
-#version 120
+// Compiled with the profile preamble from ShaderVariants::compose.
+
+VARYING vec4 vColor;
 
 void main() {
-    gl_FragColor = gl_Color;
+    FRAG_COLOR = vColor;
 }
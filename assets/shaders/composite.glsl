@@ -1,15 +1,22 @@
-#version 120
+// Compiled with the profile preamble from ShaderVariants::compose.
 
 uniform sampler2D uAlbedoTex;
 uniform sampler2D uLightTex;
 uniform vec3 uGlobalTint;
+// The targets may be larger than the drawn image: xy scales screen UVs onto
+// it and zw is the last texel centre inside it.
+uniform vec4 uTargetUv;
+
+VARYING vec2 vUv;
 
 void main() {
-    vec2 uv = gl_TexCoord[0].xy;
-    vec3 albedo = texture2D(uAlbedoTex, uv).rgb;
-    vec3 light = texture2D(uLightTex, uv).rgb;
+    vec2 uv = min(vUv * uTargetUv.xy, uTargetUv.zw);
+    vec3 albedo = TEXTURE_2D(uAlbedoTex, uv).rgb;
+    // The light buffer holds linear HDR light; this is its only tone map.
+    vec3 light = TEXTURE_2D(uLightTex, uv).rgb;
+    light = light / (vec3(1.0) + light);
     vec3 color = albedo * light * uGlobalTint;
     color = clamp(color, vec3(0.0), vec3(1.0));
     color = color / (vec3(1.0) + color);
-    gl_FragColor = vec4(color, 1.0);
+    FRAG_COLOR = vec4(color, 1.0);
 }
@@ -1,31 +1,103 @@
-#version 120
+// Compiled with the profile preamble from ShaderVariants::compose, followed by
+// the variant defines:
+//   LIGHT_COUNT   number of lights evaluated (0..8)
+//   FALLOFF_MODE  0 inverse-square, 1 linear, 2 quadratic, 3 power, 4 mixed
+//   OCCLUSION     1 to attenuate lights by the per-tile occlusion texture
+//   FUSED         1 to also run the composite (albedo * light, tint, tone map)
+//                 and write the final colour instead of a light buffer
+//   VOLUME        1 for one light drawn over its screen bounds and blended
+//                 additively; ambient comes from the light buffer clear
+//   BAKED         1 to add the baked static lightmap, scaled by uBakedScale
+//
+// Without FUSED the output is linear HDR light; composite.glsl tone maps it.
+#ifndef LIGHT_COUNT
+#define LIGHT_COUNT 2
+#endif
+#ifndef FALLOFF_MODE
+#define FALLOFF_MODE 4
+#endif
+#ifndef OCCLUSION
+#define OCCLUSION 0
+#endif
+#ifndef FUSED
+#define FUSED 0
+#endif
+#ifndef VOLUME
+#define VOLUME 0
+#endif
+#ifndef BAKED
+#define BAKED 0
+#endif
 
 uniform vec2 uResolution;
 uniform vec2 uIsoTile;
 uniform vec2 uIsoOrigin;
 uniform float uAmbient;
 uniform vec3 uAmbientColor;
-uniform vec4 uPlayerLight;
-uniform vec4 uLampLight;
-uniform vec4 uPlayerLightColor;
-uniform vec4 uLampLightColor;
-
-float lightContribution(vec2 tilePos, vec4 lightData, float falloffExponent) {
-    vec2 delta = tilePos - lightData.xy;
-    float dist = length(delta);
-    float radius = max(0.001, lightData.z);
-    float normalized = dist / radius;
-
-    float attenuation;
+
+#if LIGHT_COUNT > 0
+// xy = tile position, z = radius, w = intensity
+uniform vec4 uLights[LIGHT_COUNT];
+// rgb = colour, w = falloff exponent (<= 0 selects inverse-square)
+uniform vec4 uLightColors[LIGHT_COUNT];
+#endif
+
+#if OCCLUSION
+// One row band of map height per light; 1 = visible from the light, 0 = occluded.
+// uOcclusionSize is (map width, map height, band count).
+uniform sampler2D uOcclusionTex;
+uniform vec3 uOcclusionSize;
+const float kOccludedDirectScale = 0.12;
+#endif
+
+#if FUSED
+// Same inputs as composite.glsl.
+uniform sampler2D uAlbedoTex;
+uniform vec3 uGlobalTint;
+uniform vec4 uTargetUv;
+
+VARYING vec2 vUv;
+#endif
+
+#if BAKED
+// Linear HDR light of the static lights; uBakedSize is the map size in tiles.
+uniform sampler2D uBakedTex;
+uniform vec2 uBakedSize;
+uniform float uBakedScale;
+#endif
+
+#if VOLUME
+// Occlusion band of the light being drawn.
+uniform float uLightIndex;
+#endif
+
+float attenuation(float dist, float radius, float falloffExponent) {
+#if FALLOFF_MODE == 0
+    return 1.0 / (1.0 + dist * dist / (radius * radius));
+#elif FALLOFF_MODE == 1
+    return clamp(1.0 - dist / radius, 0.0, 1.0);
+#elif FALLOFF_MODE == 2
+    float linear = clamp(1.0 - dist / radius, 0.0, 1.0);
+    return linear * linear;
+#elif FALLOFF_MODE == 3
+    return pow(clamp(1.0 - dist / radius, 0.0, 1.0), falloffExponent);
+#else
     if (falloffExponent > 0.0) {
-        attenuation = pow(clamp(1.0 - normalized, 0.0, 1.0), falloffExponent);
-    } else {
-        float k = 1.0 / (radius * radius);
-        attenuation = 1.0 / (1.0 + k * dist * dist);
+        return pow(clamp(1.0 - dist / radius, 0.0, 1.0), falloffExponent);
     }
+    return 1.0 / (1.0 + dist * dist / (radius * radius));
+#endif
+}
 
-    return attenuation * lightData.w;
+#if OCCLUSION
+float visibility(vec2 tilePos, float lightIndex) {
+    vec2 tile = clamp(floor(tilePos), vec2(0.0), uOcclusionSize.xy - vec2(1.0));
+    vec2 uv = vec2(
+        (tile.x + 0.5) / uOcclusionSize.x,
+        (tile.y + 0.5 + lightIndex * uOcclusionSize.y) / (uOcclusionSize.y * uOcclusionSize.z));
+    return mix(kOccludedDirectScale, 1.0, TEXTURE_2D(uOcclusionTex, uv).r);
 }
+#endif
 
 void main() {
     vec2 screenPos = vec2(gl_FragCoord.x, uResolution.y - gl_FragCoord.y);
@@ -34,15 +106,37 @@ void main() {
     float isoY = (screenPos.y - uIsoOrigin.y) / (uIsoTile.y * 0.5);
     vec2 tilePos = vec2((isoX + isoY) * 0.5, (isoY - isoX) * 0.5);
 
-    float playerContribution = lightContribution(tilePos, uPlayerLight, uPlayerLightColor.w);
-    float lampContribution = lightContribution(tilePos, uLampLight, uLampLightColor.w);
-
+#if VOLUME
+    vec3 light = vec3(0.0);
+#else
     vec3 light = uAmbientColor * uAmbient;
-    light += uPlayerLightColor.rgb * playerContribution;
-    light += uLampLightColor.rgb * lampContribution;
+#endif
 
-    light = light / (vec3(1.0) + light);
-    light = clamp(light, vec3(0.0), vec3(1.0));
+#if LIGHT_COUNT > 0
+    for (int i = 0; i < LIGHT_COUNT; ++i) {
+        vec4 lightData = uLights[i];
+        float radius = max(0.001, lightData.z);
+        float contribution = attenuation(length(tilePos - lightData.xy), radius, uLightColors[i].w) * lightData.w;
+#if OCCLUSION && VOLUME
+        contribution *= visibility(tilePos, uLightIndex);
+#elif OCCLUSION
+        contribution *= visibility(tilePos, float(i));
+#endif
+        light += uLightColors[i].rgb * contribution;
+    }
+#endif
+
+#if BAKED
+    light += TEXTURE_2D(uBakedTex, tilePos / uBakedSize).rgb * uBakedScale;
+#endif
 
-    gl_FragColor = vec4(light, 1.0);
+#if FUSED
+    light = light / (vec3(1.0) + light);
+    vec3 albedo = TEXTURE_2D(uAlbedoTex, min(vUv * uTargetUv.xy, uTargetUv.zw)).rgb;
+    vec3 color = clamp(albedo * light * uGlobalTint, vec3(0.0), vec3(1.0));
+    color = color / (vec3(1.0) + color);
+    FRAG_COLOR = vec4(color, 1.0);
+#else
+    FRAG_COLOR = vec4(light, 1.0);
+#endif
 }
@@ -0,0 +1,167 @@
+#include "core/AllocationStats.hpp"
+
+#if defined(ENGINE_TRACK_ALLOCATIONS)
+#include "core/MemoryAccounting.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+#endif
+
+namespace {
+thread_local AllocationCounters t_counters;
+}
+
+bool AllocationStats::enabled() {
+#if defined(ENGINE_TRACK_ALLOCATIONS)
+    return true;
+#else
+    return false;
+#endif
+}
+
+AllocationCounters AllocationStats::thisThread() {
+    return t_counters;
+}
+
+#if defined(ENGINE_TRACK_ALLOCATIONS)
+
+namespace {
+
+// Every counted allocation starts with a header recording its size and tag,
+// so the free can credit the tag it was charged to.
+struct alignas(16) AllocationHeader {
+    std::size_t size;
+    MemoryTag tag;
+};
+static_assert(sizeof(AllocationHeader) == 16);
+
+void* stamp(void* block, std::size_t offset, std::size_t size) {
+    if (block == nullptr) {
+        return nullptr;
+    }
+    auto* memory = static_cast<unsigned char*>(block) + offset;
+    auto* header = reinterpret_cast<AllocationHeader*>(memory) - 1;
+    header->size = size;
+    header->tag = MemoryAccounting::currentTag();
+    ++t_counters.count;
+    t_counters.bytes += size;
+    MemoryAccounting::chargeCpu(header->tag, size);
+    return memory;
+}
+
+// Credits the allocation at `memory` and returns the block to free.
+void* unstamp(void* memory, std::size_t offset) {
+    const AllocationHeader* header = static_cast<AllocationHeader*>(memory) - 1;
+    MemoryAccounting::creditCpu(header->tag, header->size);
+    return static_cast<unsigned char*>(memory) - offset;
+}
+
+void* countedAlloc(std::size_t size) {
+    return stamp(std::malloc(size + sizeof(AllocationHeader)), sizeof(AllocationHeader), size);
+}
+
+// The header takes a whole alignment step in front of the memory.
+std::size_t alignedOffset(std::align_val_t alignment) {
+    return std::max(static_cast<std::size_t>(alignment), sizeof(AllocationHeader));
+}
+
+void* countedAlignedAlloc(std::size_t size, std::align_val_t alignment) {
+    const std::size_t offset = alignedOffset(alignment);
+#if defined(_MSC_VER)
+    return stamp(_aligned_malloc(size + offset, offset), offset, size);
+#else
+    const std::size_t rounded = (size + offset + offset - 1) / offset * offset;
+    return stamp(std::aligned_alloc(offset, rounded), offset, size);
+#endif
+}
+
+void countedFree(void* memory) {
+    if (memory != nullptr) {
+        std::free(unstamp(memory, sizeof(AllocationHeader)));
+    }
+}
+
+void countedAlignedFree(void* memory, std::align_val_t alignment) {
+    if (memory == nullptr) {
+        return;
+    }
+    void* block = unstamp(memory, alignedOffset(alignment));
+#if defined(_MSC_VER)
+    _aligned_free(block);
+#else
+    std::free(block);
+#endif
+}
+
+} // namespace
+
+void* operator new(std::size_t size) {
+    if (void* memory = countedAlloc(size)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    if (void* memory = countedAlloc(size)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return countedAlloc(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return countedAlloc(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    if (void* memory = countedAlignedAlloc(size, alignment)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+    if (void* memory = countedAlignedAlloc(size, alignment)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+    countedFree(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+    countedFree(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    countedFree(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept {
+    countedFree(memory);
+}
+
+void operator delete(void* memory, std::align_val_t alignment) noexcept {
+    countedAlignedFree(memory, alignment);
+}
+
+void operator delete[](void* memory, std::align_val_t alignment) noexcept {
+    countedAlignedFree(memory, alignment);
+}
+
+void operator delete(void* memory, std::size_t, std::align_val_t alignment) noexcept {
+    countedAlignedFree(memory, alignment);
+}
+
+void operator delete[](void* memory, std::size_t, std::align_val_t alignment) noexcept {
+    countedAlignedFree(memory, alignment);
+}
+
+#endif
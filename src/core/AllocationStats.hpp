@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+
+struct AllocationCounters {
+    std::uint64_t count = 0;
+    std::uint64_t bytes = 0;
+};
+
+inline AllocationCounters operator-(const AllocationCounters& a, const AllocationCounters& b) {
+    return {a.count - b.count, a.bytes - b.bytes};
+}
+
+// Global operator new instrumentation, compiled in with ENGINE_TRACK_ALLOCATIONS.
+// Counters are per thread so the main loop can measure its own frame without
+// picking up allocations made by the loader or writer threads; the job system
+// adds up what its jobs allocate on each worker. Each allocation is
+// also charged to the allocating thread's MemoryTag until it is freed.
+class AllocationStats {
+public:
+    static bool enabled();
+    static AllocationCounters thisThread();
+};
@@ -1,22 +1,138 @@
 #include "core/Application.hpp"
 
+#include "core/AllocationStats.hpp"
+#include "core/AssetManager.hpp"
+#include "core/AsyncLoader.hpp"
+#include "core/JobSystem.hpp"
+#include "core/MemoryAccounting.hpp"
+#include "core/SimulationServer.hpp"
+#include "core/Telemetry.hpp"
 #include "core/Timer.hpp"
+#include "core/WorldSnapshot.hpp"
+#include "game/Camera.hpp"
 #include "game/Map.hpp"
+#include "game/ParticleSystem.hpp"
 #include "game/Player.hpp"
+#include "game/SimulationLod.hpp"
+#include "game/Townsfolk.hpp"
+#include "render/Lightmap.hpp"
 #include "render/Renderer.hpp"
 
 #include <SDL2/SDL.h>
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <cmath>
 #include <cstdint>
+#include <cstdlib>
 #include <filesystem>
 #include <iostream>
-
-namespace fs = std::filesystem;
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
 
 namespace {
-constexpr float kTau = 6.28318530718F;
+constexpr double kUploadBudgetSeconds = 0.004;
+// Frames after loading that may still grow caches and scratch arenas before the
+// zero-allocation frame is enforced.
+constexpr int kAllocationWarmupFrames = 120;
+constexpr int kAllocationWarningInterval = 60;
+
+constexpr char kTelemetryFileEnv[] = "TELEMETRY_FILE";
+constexpr char kTelemetryFormatEnv[] = "TELEMETRY_FORMAT";
+constexpr char kTelemetryIntervalEnv[] = "TELEMETRY_INTERVAL";
+constexpr char kJobWorkersEnv[] = "JOB_WORKERS";
+constexpr char kSimLodTiersEnv[] = "SIM_LOD_TIERS";
+constexpr char kMemoryBudgetsEnv[] = "MEMORY_BUDGETS";
+constexpr char kHeadlessWorldsEnv[] = "HEADLESS_WORLDS";
+constexpr char kHeadlessStepsEnv[] = "HEADLESS_STEPS";
+constexpr char kHeadlessInputEnv[] = "HEADLESS_INPUT";
+
+// Memory budgets are checked about once a second.
+constexpr int kMemoryCheckFrames = 60;
+
+// Townsfolk spawned once the map is in; the seed keeps the town the same
+// from run to run.
+constexpr std::size_t kTownsfolk = 8;
+constexpr std::uint32_t kTownsfolkSeed = 1885;
+
+// The saloon lamp never moves, so it is baked into the map's lightmap at its
+// mean radius and intensity; only its flicker is applied per frame.
+constexpr std::array<Light, 1> kStaticLights{
+    Light{11.0F, 7.0F, 3.825F, 0.66F, 1.00F, 0.70F, 0.42F, 1.8F},
+};
+
+// Dust kicked up per second at full walking speed, and one gunshot's smoke.
+constexpr float kDustPerSecond = 40.0F;
+constexpr std::size_t kGunsmokeParticles = 48;
+constexpr std::size_t kMuzzleSparks = 8;
+// Embers rising off the saloon lamp, from about a tile up.
+constexpr float kLampEmbersPerSecond = 12.0F;
+constexpr float kLampHeight = 0.9F;
+
+// Per-user cache of baked lightmaps; empty (no caching) when SDL has no pref path.
+std::filesystem::path lightmapCacheDirectory() {
+    char* prefPath = SDL_GetPrefPath("western_rpg_proto", "cache");
+    if (prefPath == nullptr) {
+        return {};
+    }
+    std::filesystem::path directory = std::filesystem::path(prefPath) / "lightmaps";
+    SDL_free(prefPath);
+    return directory;
+}
+
+// Frame telemetry is written only when TELEMETRY_FILE names an output file.
+void startTelemetry(Telemetry& telemetry) {
+    const char* path = std::getenv(kTelemetryFileEnv);
+    if (path == nullptr || path[0] == '\0') {
+        return;
+    }
+
+    const char* format = std::getenv(kTelemetryFormatEnv);
+    const bool prometheus = format != nullptr && std::string_view(format) == "prometheus";
+    const char* interval = std::getenv(kTelemetryIntervalEnv);
+    telemetry.start(
+        path,
+        prometheus ? TelemetryFormat::Prometheus : TelemetryFormat::Json,
+        interval != nullptr ? std::atof(interval) : 1.0);
+}
+
+// JOB_WORKERS overrides the worker thread count; unset or 0 picks it from the hardware.
+unsigned jobWorkerCount() {
+    const char* workers = std::getenv(kJobWorkersEnv);
+    return workers != nullptr ? static_cast<unsigned>(std::max(0, std::atoi(workers))) : 0U;
+}
+
+// SIM_LOD_TIERS replaces the simulation LOD tiers, e.g. "16:1,40:4,96:16,*:120".
+SimulationLodSettings simulationLodSettings() {
+    SimulationLodSettings settings;
+    const char* tiers = std::getenv(kSimLodTiersEnv);
+    if (tiers != nullptr && tiers[0] != '\0' && !SimulationLodSettings::parse(tiers, settings)) {
+        std::cerr << "Ignoring malformed " << kSimLodTiersEnv << " \"" << tiers << "\"; keeping the default tiers.\n";
+    }
+    return settings;
+}
+
+// MEMORY_BUDGETS sets per-subsystem budgets in MiB, e.g. "map=64,total=512".
+void configureMemoryBudgets() {
+    const char* budgets = std::getenv(kMemoryBudgetsEnv);
+    if (budgets != nullptr && budgets[0] != '\0' && !MemoryAccounting::parseBudgets(budgets)) {
+        std::cerr << "Ignoring malformed " << kMemoryBudgetsEnv << " \"" << budgets << "\".\n";
+    }
+}
+
+// Single quicksave slot beside the other per-user data; empty without a pref path.
+std::filesystem::path quicksavePath() {
+    char* prefPath = SDL_GetPrefPath("western_rpg_proto", "saves");
+    if (prefPath == nullptr) {
+        return {};
+    }
+    std::filesystem::path path = std::filesystem::path(prefPath) / "quicksave.wsnp";
+    SDL_free(prefPath);
+    return path;
+}
 
 float smoothstep(float edge0, float edge1, float x) {
     const float t = std::clamp((x - edge0) / (edge1 - edge0), 0.0F, 1.0F);
@@ -27,51 +143,153 @@ float mix(float a, float b, float t) {
     return a + (b - a) * t;
 }
 
-fs::path resolveAssetPath(const fs::path& relativePath) {
-    auto findFromRoot = [&](const fs::path& root) -> fs::path {
-        std::error_code ec;
-        fs::path cursor = root;
+// Ambient, tint and the lamp flicker follow the time of day.
+void animateDayCycle(float worldTime, Renderer& renderer) {
+    constexpr float kDayLengthSeconds = 72.0F;
+    const float dayPhase = std::fmod(worldTime / kDayLengthSeconds, 1.0F);
+
+    const float dawn = smoothstep(0.20F, 0.32F, dayPhase);
+    const float dusk = smoothstep(0.68F, 0.82F, dayPhase);
+    const float daylight = std::clamp(dawn - dusk, 0.0F, 1.0F);
+    const float twilight = std::clamp((dawn * (1.0F - daylight)) + (dusk * (1.0F - daylight)), 0.0F, 1.0F);
+
+    const float ambient = mix(0.11F, 0.38F, daylight) + 0.06F * twilight;
+    renderer.setAmbient(ambient);
+
+    const float nightTintR = 0.72F;
+    const float nightTintG = 0.82F;
+    const float nightTintB = 1.05F;
+    const float duskTintR = 1.12F;
+    const float duskTintG = 0.95F;
+    const float duskTintB = 0.82F;
+
+    const float baseTintR = mix(nightTintR, 1.0F, daylight);
+    const float baseTintG = mix(nightTintG, 1.0F, daylight);
+    const float baseTintB = mix(nightTintB, 1.0F, daylight);
+
+    const float tintR = mix(baseTintR, duskTintR, twilight);
+    const float tintG = mix(baseTintG, duskTintG, twilight);
+    const float tintB = mix(baseTintB, duskTintB, twilight);
+    renderer.setGlobalTint(tintR, tintG, tintB);
+
+    const float lampFlicker = 0.9F + 0.1F * std::sin(worldTime * 9.0F + 0.3F) * std::sin(worldTime * 5.0F + 0.8F);
+    renderer.setStaticLightScale(lampFlicker);
+}
 
-        while (!cursor.empty()) {
-            const fs::path candidate = cursor / relativePath;
-            if (fs::exists(candidate, ec) && !ec) {
-                return candidate;
-            }
+// The player's lantern follows them and flickers.
+void animatePlayerLight(float worldTime, const Player& player, Light& light) {
+    light.x = player.x();
+    light.y = player.y();
+    const float playerFlicker = 0.93F + 0.07F * std::sin(worldTime * 14.0F + 1.1F);
+    light.intensity = 0.82F * playerFlicker;
+    light.radius = 3.9F + 0.25F * std::sin(worldTime * 3.5F);
+}
 
-            const fs::path parent = cursor.parent_path();
-            if (parent == cursor) {
-                break;
-            }
-            cursor = parent;
+// Fills an unused light slot: it sits on the player's tile and lights nothing.
+Light darkLight(const Light& playerLight) {
+    return Light{std::round(playerLight.x), std::round(playerLight.y), 0.5F, 0.0F, 0.0F, 0.0F, 0.0F, ParticleSystem::kLightFalloff};
+}
+
+void enqueueShaderLoad(AsyncLoader& loader, const AssetManager& assets, Renderer& renderer) {
+    loader.enqueue("shaders", [&assets, &renderer](const std::atomic<bool>&, AsyncLoader::UploadTask& outUpload) {
+        auto sources = std::make_shared<ShaderSources>();
+        if (!Renderer::loadShaderSources(assets, *sources)) {
+            return false;
         }
+        outUpload = [&renderer, sources] { return renderer.uploadShaders(*sources); };
+        return true;
+    });
+}
 
-        return {};
-    };
+// Loads the map and its static lightmap on the loader thread; both are swapped
+// in together on the GL thread.
+void enqueueMapLoad(
+    AsyncLoader& loader,
+    const AssetManager& assets,
+    const std::string& path,
+    std::span<const Light> staticLights,
+    Map& target,
+    Renderer& renderer) {
+    loader.enqueue(path, [&assets, &target, &renderer, path, staticLights](const std::atomic<bool>& cancelled, AsyncLoader::UploadTask& outUpload) {
+        const MemoryTagScope memoryTag(MemoryTag::Map);
+        std::string text;
+        if (!assets.readText(path, text)) {
+            return false;
+        }
+        if (cancelled.load()) {
+            return false;
+        }
+
+        auto staged = std::make_shared<Map>();
+        if (!staged->loadFromAscii(text)) {
+            return false;
+        }
+        const MemoryTagScope lightingTag(MemoryTag::Lighting);
+        auto lightmap = std::make_shared<Lightmap>();
+        if (!LightmapBaker::loadOrBake(*staged, staticLights, lightmapCacheDirectory(), cancelled, *lightmap)) {
+            return false;
+        }
+        outUpload = [&target, &renderer, staged, lightmap] {
+            target = std::move(*staged);
+            renderer.setStaticLighting(std::move(*lightmap));
+            return true;
+        };
+        return true;
+    });
+}
+
+// HEADLESS_WORLDS > 0 runs that many worlds without a window or GL instead of
+// the game, HEADLESS_STEPS steps each, replaying HEADLESS_INPUT if set.
+std::size_t headlessWorldCount() {
+    const char* worlds = std::getenv(kHeadlessWorldsEnv);
+    return worlds != nullptr ? static_cast<std::size_t>(std::max(0L, std::atol(worlds))) : 0U;
+}
 
-    if (const fs::path fromCwd = findFromRoot(fs::current_path()); !fromCwd.empty()) {
-        return fromCwd;
+bool runHeadless(std::size_t worlds) {
+    configureMemoryBudgets();
+    AssetManager assets;
+    bool assetsReady = false;
+    {
+        const MemoryTagScope memoryTag(MemoryTag::Assets);
+        assetsReady = assets.initialize();
+    }
+    if (!assetsReady) {
+        std::cerr << "Asset initialization failed.\n";
+        return false;
     }
 
-    if (const char* basePath = SDL_GetBasePath(); basePath != nullptr) {
-        const fs::path fromBasePath = findFromRoot(fs::path(basePath));
-        SDL_free(const_cast<char*>(basePath));
-        if (!fromBasePath.empty()) {
-            return fromBasePath;
-        }
+    SimulationServerSettings settings;
+    settings.worlds = worlds;
+    if (const char* steps = std::getenv(kHeadlessStepsEnv); steps != nullptr && steps[0] != '\0') {
+        settings.steps = static_cast<std::uint64_t>(std::max(0LL, std::atoll(steps)));
+    }
+    if (const char* input = std::getenv(kHeadlessInputEnv); input != nullptr) {
+        settings.inputPath = input;
     }
+    settings.townsfolk = kTownsfolk;
+    settings.seed = kTownsfolkSeed;
+    settings.lod = simulationLodSettings();
 
-    return relativePath;
+    JobSystem jobs(jobWorkerCount());
+    SimulationServer server;
+    if (!server.load(assets, settings)) {
+        return false;
+    }
+    SimulationServer::writeReport(std::cout, server.run(jobs));
+    return true;
 }
 }
 
 bool Application::run() {
+    if (const std::size_t worlds = headlessWorldCount(); worlds > 0) {
+        return runHeadless(worlds);
+    }
+
     if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER) != 0) {
         std::cerr << "SDL_Init failed: " << SDL_GetError() << '\n';
         return false;
     }
 
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 2);
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 1);
     SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
 
     SDL_Window* window = SDL_CreateWindow(
@@ -88,51 +306,212 @@ bool Application::run() {
         return false;
     }
 
-    Renderer renderer;
-    if (!renderer.initialize(window)) {
-        std::cerr << "Renderer initialization failed.\n";
+    configureMemoryBudgets();
+    AssetManager assets;
+    bool assetsReady = false;
+    {
+        const MemoryTagScope memoryTag(MemoryTag::Assets);
+        assetsReady = assets.initialize();
+    }
+    if (!assetsReady) {
+        std::cerr << "Asset initialization failed.\n";
         SDL_DestroyWindow(window);
         SDL_Quit();
         return false;
     }
 
-    Map map;
-    const fs::path mapPath = resolveAssetPath("data/maps/frontier_town.map");
-    if (!map.loadFromAsciiFile(mapPath.string())) {
-        std::cerr << "Failed to load map: " << mapPath << '\n';
-        renderer.shutdown();
+    JobSystem jobs(jobWorkerCount());
+    Renderer renderer;
+    renderer.setJobSystem(&jobs);
+    if (!renderer.initialize(window)) {
+        std::cerr << "Renderer initialization failed.\n";
         SDL_DestroyWindow(window);
         SDL_Quit();
         return false;
     }
 
+    Map map;
+    AsyncLoader loader;
+    loader.start();
+    enqueueShaderLoad(loader, assets, renderer);
+    enqueueMapLoad(loader, assets, "data/maps/frontier_town.map", kStaticLights, map, renderer);
+    bool loading = true;
+    bool loadFailed = false;
+
     Player player;
     player.setPosition(2.5F, 2.5F);
+    Camera camera;
+    camera.snapTo(player.x(), player.y());
+
+    Telemetry telemetry;
+    startTelemetry(telemetry);
 
     Timer timer;
     bool running = true;
     std::uint64_t previous = SDL_GetPerformanceCounter();
 
     Light playerLight{player.x(), player.y(), 4.2F, 0.88F, 1.00F, 0.78F, 0.52F, 2.3F};
-    Light lampLight{11.0F, 7.0F, 4.0F, 0.72F, 1.00F, 0.70F, 0.42F, 1.8F};
 
     float worldTime = 0.0F;
+    SnapshotStore snapshots;
+    const std::filesystem::path quicksave = quicksavePath();
+    int steadyFrames = 0;
+    int framesSinceMemoryCheck = 0;
+    int framesSinceAllocationWarning = kAllocationWarningInterval;
+
+    Townsfolk townsfolk;
+    townsfolk.configure(simulationLodSettings());
+
+    // The particle pools are allocated up front.
+    ParticleSystem particles = [] {
+        const MemoryTagScope memoryTag(MemoryTag::Particles);
+        return ParticleSystem();
+    }();
+    ParticleEmitter dustEmitter{ParticleKind::Dust, player.x(), player.y(), 0.0F, 0.0F};
+    ParticleEmitter lampEmbers{ParticleKind::Ember, kStaticLights[0].x, kStaticLights[0].y, kLampHeight, kLampEmbersPerSecond};
+
+    // The frame as a task graph, built once. Simulation runs on any thread;
+    // the particle and day cycle tasks only read its results and run side by
+    // side; rendering needs the GL context, so it stays on this thread and
+    // spreads its CPU lighting work over the pool itself.
+    InputState input{};
+    int simulationSteps = 0;
+    double renderSeconds = 0.0;
+    // The player's light, then the brightest ember clusters. The count stays
+    // fixed so the light shader variant does not change, and a recompile
+    // does not land mid-game, when embers come and go; unused slots hold
+    // dark lights.
+    std::array<Light, 1 + ParticleSystem::kMaxParticleLights> frameLights{};
+    std::array<WorkerStats, JobSystem::kMaxWorkers + 1> workerStats{};
+    TaskGraph frame;
+    const TaskGraph::TaskId simulate =
+        frame.add("simulate", [&simulationSteps, &timer, &worldTime, &player, &townsfolk, &input, &map, &camera] {
+            const MemoryTagScope memoryTag(MemoryTag::Simulation);
+            simulationSteps = 0;
+            while (timer.canStep()) {
+                ++simulationSteps;
+                const float dt = static_cast<float>(timer.delta());
+                worldTime += dt;
+                player.update(input, map, dt);
+                camera.follow(player.x(), player.y(), dt);
+                // Townsfolk near the camera update every step, the rest less often.
+                townsfolk.update(map, camera.x(), camera.y(), dt);
+                timer.consumeStep();
+            }
+        });
+    // Particles take the same fixed steps, after the player has moved.
+    const TaskGraph::TaskId effects = frame.add(
+        "particles", [&simulationSteps, &timer, &particles, &dustEmitter, &lampEmbers, &player, &map] {
+            const MemoryTagScope memoryTag(MemoryTag::Particles);
+            const float dt = static_cast<float>(timer.delta());
+            for (int step = 0; step < simulationSteps; ++step) {
+                dustEmitter.x = player.x();
+                dustEmitter.y = player.y();
+                dustEmitter.perSecond = kDustPerSecond * player.moveBlend();
+                particles.runEmitter(dustEmitter, dt);
+                particles.runEmitter(lampEmbers, dt);
+                particles.update(map, dt);
+            }
+        });
+    const TaskGraph::TaskId dayCycle = frame.add("day cycle", [&worldTime, &renderer] { animateDayCycle(worldTime, renderer); });
+    const TaskGraph::TaskId lightAnimation =
+        frame.add("light animation", [&worldTime, &player, &playerLight, &particles, &frameLights] {
+            animatePlayerLight(worldTime, player, playerLight);
+            frameLights[0] = playerLight;
+            const std::size_t lit = 1 + particles.collectLights(std::span<Light>(frameLights).subspan(1));
+            std::fill(frameLights.begin() + static_cast<std::ptrdiff_t>(lit), frameLights.end(), darkLight(playerLight));
+        });
+    const TaskGraph::TaskId render = frame.add(
+        "render",
+        [&renderer, &map, &player, &townsfolk, &camera, &particles, &frameLights, &renderSeconds] {
+            const std::uint64_t renderStart = SDL_GetPerformanceCounter();
+            renderer.render(map, player, townsfolk, camera, particles, frameLights);
+            renderSeconds = static_cast<double>(SDL_GetPerformanceCounter() - renderStart) /
+                static_cast<double>(SDL_GetPerformanceFrequency());
+        },
+        TaskAffinity::Caller);
+    frame.precede(simulate, effects);
+    frame.precede(simulate, dayCycle);
+    frame.precede(effects, lightAnimation);
+    frame.precede(dayCycle, render);
+    frame.precede(lightAnimation, render);
 
     while (running) {
         const std::uint64_t current = SDL_GetPerformanceCounter();
         const std::uint64_t freq = SDL_GetPerformanceFrequency();
         const double frameSeconds = static_cast<double>(current - previous) / static_cast<double>(freq);
         previous = current;
+        const AllocationCounters frameAllocationsStart = AllocationStats::thisThread();
+        const std::uint64_t mapRevisionAtStart = map.revision();
+        bool snapshotFrame = false;
+        bool resizeFrame = false;
+        snapshots.poll();
 
-        InputState input{};
+        input = InputState{};
         SDL_Event event;
         while (SDL_PollEvent(&event) == 1) {
             if (event.type == SDL_QUIT) {
                 running = false;
             }
+            // Fires for every size change (drag, fullscreen, API); the
+            // renderer keeps the size instead of querying it per frame.
+            if (event.type == SDL_WINDOWEVENT && event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED) {
+                renderer.resize(event.window.data1, event.window.data2);
+                resizeFrame = true;
+            }
             if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_ESCAPE) {
                 running = false;
             }
+            if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_e && event.key.repeat == 0 && !loading) {
+                const MemoryTagScope memoryTag(MemoryTag::Map);
+                player.toggleNearbyDoor(map);
+            }
+            if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F3 && event.key.repeat == 0) {
+                MemoryAccounting::writeReport(std::cerr);
+            }
+            if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_g && event.key.repeat == 0 && !loading) {
+                particles.emit(ParticleKind::Smoke, player.x(), player.y(), 0.6F, kGunsmokeParticles);
+                particles.emit(ParticleKind::Ember, player.x(), player.y(), 0.6F, kMuzzleSparks);
+            }
+            if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F5 && event.key.repeat == 0 && !loading &&
+                !quicksave.empty()) {
+                const WorldState state{player.state(), camera.x(), camera.y(), worldTime, playerLight};
+                if (!snapshots.save(quicksave, state, map, townsfolk)) {
+                    std::cerr << "Previous quicksave is still being written.\n";
+                }
+                snapshotFrame = true;
+            }
+            if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F9 && event.key.repeat == 0 && !loading &&
+                !quicksave.empty()) {
+                WorldState state{};
+                if (snapshots.load(quicksave, state, map, townsfolk)) {
+                    player.restoreState(state.player);
+                    camera.snapTo(state.cameraX, state.cameraY);
+                    worldTime = state.worldTime;
+                    playerLight = state.playerLight;
+                    particles.clear();
+                }
+                snapshotFrame = true;
+            }
+        }
+
+        if (loading) {
+            if (!running) {
+                loader.cancel();
+                break;
+            }
+            if (!loader.pumpUploads(kUploadBudgetSeconds)) {
+                std::cerr << "Failed to load: " << loader.lastError() << '\n';
+                loadFailed = true;
+                break;
+            }
+            if (loader.idle()) {
+                loading = false;
+                const MemoryTagScope memoryTag(MemoryTag::Simulation);
+                townsfolk.spawn(map, kTownsfolk, kTownsfolkSeed);
+            }
+            renderer.renderLoadingScreen(loader.progress().fraction());
+            continue;
         }
 
         const Uint8* keys = SDL_GetKeyboardState(nullptr);
@@ -142,57 +521,42 @@ bool Application::run() {
         input.right = keys[SDL_SCANCODE_D] != 0 || keys[SDL_SCANCODE_RIGHT] != 0;
 
         timer.tick(std::min(frameSeconds, 0.1));
-        while (timer.canStep()) {
-            const float dt = static_cast<float>(timer.delta());
-            worldTime += dt;
-
-            player.update(input, map, dt);
-            playerLight.x = player.x();
-            playerLight.y = player.y();
-
-            constexpr float kDayLengthSeconds = 72.0F;
-            const float dayPhase = std::fmod(worldTime / kDayLengthSeconds, 1.0F);
-
-            const float dawn = smoothstep(0.20F, 0.32F, dayPhase);
-            const float dusk = smoothstep(0.68F, 0.82F, dayPhase);
-            const float daylight = std::clamp(dawn - dusk, 0.0F, 1.0F);
-            const float twilight = std::clamp((dawn * (1.0F - daylight)) + (dusk * (1.0F - daylight)), 0.0F, 1.0F);
-
-            const float ambient = mix(0.11F, 0.38F, daylight) + 0.06F * twilight;
-            renderer.setAmbient(ambient);
-
-            const float nightTintR = 0.72F;
-            const float nightTintG = 0.82F;
-            const float nightTintB = 1.05F;
-            const float duskTintR = 1.12F;
-            const float duskTintG = 0.95F;
-            const float duskTintB = 0.82F;
-
-            const float baseTintR = mix(nightTintR, 1.0F, daylight);
-            const float baseTintG = mix(nightTintG, 1.0F, daylight);
-            const float baseTintB = mix(nightTintB, 1.0F, daylight);
-
-            const float tintR = mix(baseTintR, duskTintR, twilight);
-            const float tintG = mix(baseTintG, duskTintG, twilight);
-            const float tintB = mix(baseTintB, duskTintB, twilight);
-            renderer.setGlobalTint(tintR, tintG, tintB);
-
-            const float playerFlicker = 0.93F + 0.07F * std::sin(worldTime * 14.0F + 1.1F);
-            const float lampFlicker = 0.9F + 0.1F * std::sin(worldTime * 9.0F + 0.3F) * std::sin(worldTime * 5.0F + 0.8F);
-            playerLight.intensity = 0.82F * playerFlicker;
-            lampLight.intensity = 0.66F * lampFlicker;
-
-            playerLight.radius = 3.9F + 0.25F * std::sin(worldTime * 3.5F);
-            lampLight.radius = 3.6F + 0.45F * (0.5F + 0.5F * std::sin(worldTime * 2.1F + kTau * 0.25F));
-
-            timer.consumeStep();
+        jobs.run(frame);
+        telemetry.recordFrame(frameSeconds, simulationSteps, renderSeconds);
+        const std::size_t workerSlots = jobs.collectStats(workerStats);
+        telemetry.recordWorkers(std::span<const WorkerStats>(workerStats).first(workerSlots));
+        if (++framesSinceMemoryCheck >= kMemoryCheckFrames) {
+            framesSinceMemoryCheck = 0;
+            MemoryAccounting::checkBudgets();
         }
 
-        renderer.render(map, player, playerLight, lampLight);
+        if (AllocationStats::enabled()) {
+            AllocationCounters frameAllocations = AllocationStats::thisThread() - frameAllocationsStart;
+            // Tasks on the workers allocate on their own threads; entry 0 is
+            // this thread, already counted above.
+            for (std::size_t i = 1; i < workerSlots; ++i) {
+                frameAllocations.count += workerStats[i].allocations.count;
+                frameAllocations.bytes += workerStats[i].allocations.bytes;
+            }
+            // Frames with a map edit are exempt: rebaking the edited lightmap
+            // area uses scratch buffers. So are frames that start a save or
+            // restore one, and resizes, which may need new render targets.
+            const bool exemptFrame = map.revision() != mapRevisionAtStart || snapshotFrame || resizeFrame;
+            ++framesSinceAllocationWarning;
+            if (steadyFrames < kAllocationWarmupFrames) {
+                ++steadyFrames;
+            } else if (frameAllocations.count > 0 && !exemptFrame && framesSinceAllocationWarning >= kAllocationWarningInterval) {
+                std::cerr << "Frame allocated " << frameAllocations.count << " times (" << frameAllocations.bytes
+                          << " bytes) after warm-up.\n";
+                framesSinceAllocationWarning = 0;
+            }
+        }
     }
 
+    telemetry.stop();
+    loader.stop();
     renderer.shutdown();
     SDL_DestroyWindow(window);
     SDL_Quit();
-    return true;
+    return !loadFailed;
 }
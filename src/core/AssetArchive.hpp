@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+// On-disk layout of the packed asset archive written by tools/asset_packer.cpp.
+//
+//   AssetArchiveHeader
+//   AssetArchiveEntry[entryCount]
+//   std::uint32_t buckets[bucketCount]   (entry index or kAssetArchiveEmptyBucket)
+//   name blob                            (relative paths, '/' separated, not terminated)
+//   data blob                            (each entry aligned to kAssetArchiveDataAlignment)
+//
+// All integers are little-endian. bucketCount is a power of two so lookups are
+// a hash, a mask and a short chain walk directly over the mapped file.
+
+constexpr char kAssetArchiveMagic[4] = {'W', 'R', 'P', 'K'};
+constexpr std::uint32_t kAssetArchiveVersion = 1;
+constexpr std::uint32_t kAssetArchiveEmptyBucket = 0xFFFFFFFFU;
+constexpr std::uint64_t kAssetArchiveDataAlignment = 16;
+
+struct AssetArchiveHeader {
+    char magic[4];
+    std::uint32_t version;
+    std::uint32_t entryCount;
+    std::uint32_t bucketCount;
+    std::uint64_t entriesOffset;
+    std::uint64_t bucketsOffset;
+    std::uint64_t namesOffset;
+    std::uint64_t dataOffset;
+};
+
+struct AssetArchiveEntry {
+    std::uint64_t nameHash;
+    std::uint32_t nameOffset;
+    std::uint32_t nameLength;
+    std::uint64_t dataOffset;
+    std::uint64_t dataSize;
+    std::uint32_t nextInBucket;
+    std::uint32_t reserved;
+};
+
+static_assert(sizeof(AssetArchiveHeader) == 48, "AssetArchiveHeader layout changed");
+static_assert(sizeof(AssetArchiveEntry) == 40, "AssetArchiveEntry layout changed");
+
+// FNV-1a over the relative path; shared by the packer and the runtime lookup.
+constexpr std::uint64_t assetPathHash(std::string_view path) {
+    std::uint64_t hash = 0xCBF29CE484222325ULL;
+    for (const char c : path) {
+        hash ^= static_cast<std::uint8_t>(c);
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
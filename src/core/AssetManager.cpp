@@ -0,0 +1,272 @@
+#include "core/AssetManager.hpp"
+
+#include <SDL2/SDL.h>
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// A directory is an asset root when it holds both top-level asset folders.
+bool isAssetRoot(const fs::path& directory) {
+    std::error_code ec;
+    return fs::is_directory(directory / "assets", ec) && fs::is_directory(directory / "data", ec);
+}
+
+fs::path findRootFrom(const fs::path& start) {
+    fs::path cursor = start;
+    while (!cursor.empty()) {
+        if (isAssetRoot(cursor)) {
+            return cursor;
+        }
+
+        const fs::path parent = cursor.parent_path();
+        if (parent == cursor) {
+            break;
+        }
+        cursor = parent;
+    }
+    return {};
+}
+
+fs::path sdlBasePath() {
+    char* basePath = SDL_GetBasePath();
+    if (basePath == nullptr) {
+        return {};
+    }
+    fs::path result(basePath);
+    SDL_free(basePath);
+    return result;
+}
+
+} // namespace
+
+AssetManager::~AssetManager() {
+    shutdown();
+}
+
+bool AssetManager::initialize(const char* archiveName) {
+    shutdown();
+
+    std::error_code ec;
+    const fs::path cwd = fs::current_path(ec);
+    const fs::path basePath = sdlBasePath();
+
+    m_root = findRootFrom(cwd);
+    if (m_root.empty() && !basePath.empty()) {
+        m_root = findRootFrom(basePath);
+    }
+
+    // The build writes the archive next to the executable; a shipped layout may
+    // also keep it at the asset root.
+    bool archiveOpened = false;
+    if (!basePath.empty() && fs::is_regular_file(basePath / archiveName, ec)) {
+        archiveOpened = openArchive(basePath / archiveName);
+    }
+    if (!archiveOpened && !m_root.empty() && fs::is_regular_file(m_root / archiveName, ec)) {
+        archiveOpened = openArchive(m_root / archiveName);
+    }
+
+    if (!archiveOpened && m_root.empty()) {
+        std::cerr << "No asset archive (" << archiveName << ") or asset root found.\n";
+        return false;
+    }
+
+    if (!archiveOpened) {
+        std::cerr << "Asset archive " << archiveName << " not found; reading loose files from " << m_root << '\n';
+    }
+    return true;
+}
+
+void AssetManager::shutdown() {
+    closeArchive();
+    m_root.clear();
+}
+
+std::string_view AssetManager::view(std::string_view relativePath) const {
+    const AssetArchiveEntry* entry = findEntry(relativePath);
+    if (entry == nullptr) {
+        return {};
+    }
+    return {reinterpret_cast<const char*>(m_archiveData + entry->dataOffset), static_cast<std::size_t>(entry->dataSize)};
+}
+
+bool AssetManager::readText(std::string_view relativePath, std::string& outText) const {
+    if (const AssetArchiveEntry* entry = findEntry(relativePath); entry != nullptr) {
+        outText.assign(reinterpret_cast<const char*>(m_archiveData + entry->dataOffset), static_cast<std::size_t>(entry->dataSize));
+        return true;
+    }
+
+    if (m_root.empty()) {
+        return false;
+    }
+
+    std::ifstream file(m_root / fs::path(relativePath));
+    if (!file.is_open()) {
+        return false;
+    }
+
+    std::stringstream stream;
+    stream << file.rdbuf();
+    outText = stream.str();
+    return true;
+}
+
+bool AssetManager::hasArchive() const {
+    return m_archiveData != nullptr;
+}
+
+const fs::path& AssetManager::root() const {
+    return m_root;
+}
+
+bool AssetManager::openArchive(const fs::path& path) {
+#if defined(_WIN32)
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize{};
+    if (GetFileSizeEx(file, &fileSize) == 0 || fileSize.QuadPart <= 0) {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr) {
+        CloseHandle(file);
+        return false;
+    }
+
+    const void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (data == nullptr) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    m_fileHandle = file;
+    m_mappingHandle = mapping;
+    m_archiveData = static_cast<const std::uint8_t*>(data);
+    m_archiveSize = static_cast<std::size_t>(fileSize.QuadPart);
+#else
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat info {};
+    if (::fstat(fd, &info) != 0 || info.st_size <= 0) {
+        ::close(fd);
+        return false;
+    }
+
+    void* data = ::mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+
+    m_archiveData = static_cast<const std::uint8_t*>(data);
+    m_archiveSize = static_cast<std::size_t>(info.st_size);
+#endif
+
+    if (m_archiveSize < sizeof(AssetArchiveHeader)) {
+        std::cerr << "Asset archive is truncated: " << path << '\n';
+        closeArchive();
+        return false;
+    }
+
+    const auto* header = reinterpret_cast<const AssetArchiveHeader*>(m_archiveData);
+    const std::uint64_t entriesEnd = header->entriesOffset + std::uint64_t{header->entryCount} * sizeof(AssetArchiveEntry);
+    const std::uint64_t bucketsEnd = header->bucketsOffset + std::uint64_t{header->bucketCount} * sizeof(std::uint32_t);
+    const bool valid = std::memcmp(header->magic, kAssetArchiveMagic, sizeof(kAssetArchiveMagic)) == 0 &&
+        header->version == kAssetArchiveVersion &&
+        header->bucketCount != 0 &&
+        (header->bucketCount & (header->bucketCount - 1)) == 0 &&
+        entriesEnd <= m_archiveSize &&
+        bucketsEnd <= m_archiveSize &&
+        header->namesOffset <= m_archiveSize &&
+        header->dataOffset <= m_archiveSize;
+    if (!valid) {
+        std::cerr << "Asset archive has an unsupported or corrupt header: " << path << '\n';
+        closeArchive();
+        return false;
+    }
+
+    m_header = header;
+    m_entries = reinterpret_cast<const AssetArchiveEntry*>(m_archiveData + header->entriesOffset);
+    m_buckets = reinterpret_cast<const std::uint32_t*>(m_archiveData + header->bucketsOffset);
+    m_names = reinterpret_cast<const char*>(m_archiveData + header->namesOffset);
+
+    for (std::uint32_t i = 0; i < header->entryCount; ++i) {
+        const AssetArchiveEntry& entry = m_entries[i];
+        if (header->namesOffset + entry.nameOffset + entry.nameLength > m_archiveSize ||
+            entry.dataOffset + entry.dataSize > m_archiveSize) {
+            std::cerr << "Asset archive entry " << i << " is out of bounds: " << path << '\n';
+            closeArchive();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void AssetManager::closeArchive() {
+    if (m_archiveData != nullptr) {
+#if defined(_WIN32)
+        UnmapViewOfFile(m_archiveData);
+        CloseHandle(static_cast<HANDLE>(m_mappingHandle));
+        CloseHandle(static_cast<HANDLE>(m_fileHandle));
+        m_mappingHandle = nullptr;
+        m_fileHandle = nullptr;
+#else
+        ::munmap(const_cast<std::uint8_t*>(m_archiveData), m_archiveSize);
+#endif
+    }
+
+    m_archiveData = nullptr;
+    m_archiveSize = 0;
+    m_header = nullptr;
+    m_entries = nullptr;
+    m_buckets = nullptr;
+    m_names = nullptr;
+}
+
+const AssetArchiveEntry* AssetManager::findEntry(std::string_view relativePath) const {
+    if (m_header == nullptr) {
+        return nullptr;
+    }
+
+    const std::uint64_t hash = assetPathHash(relativePath);
+    std::uint32_t index = m_buckets[hash & (m_header->bucketCount - 1)];
+    for (std::uint32_t steps = 0; index < m_header->entryCount && steps < m_header->entryCount; ++steps) {
+        const AssetArchiveEntry& entry = m_entries[index];
+        if (entry.nameHash == hash &&
+            std::string_view(m_names + entry.nameOffset, entry.nameLength) == relativePath) {
+            return &entry;
+        }
+        index = entry.nextInBucket;
+    }
+    return nullptr;
+}
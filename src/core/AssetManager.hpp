@@ -0,0 +1,50 @@
+#pragma once
+
+#include "core/AssetArchive.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+// Resolves the asset root once and serves assets from the packed, memory-mapped
+// archive produced by the build. Only files missing from the archive (or every
+// file, when no archive is present) are read loose from the resolved root; a
+// packed file is always served from the archive, so editing it takes effect
+// once game_assets repacks. Reads are safe from any thread.
+class AssetManager {
+public:
+    AssetManager() = default;
+    ~AssetManager();
+
+    AssetManager(const AssetManager&) = delete;
+    AssetManager& operator=(const AssetManager&) = delete;
+
+    bool initialize(const char* archiveName = "assets.pak");
+    void shutdown();
+
+    // Returns a view into the mapped archive, or an empty view when the asset is not packed.
+    std::string_view view(std::string_view relativePath) const;
+    bool readText(std::string_view relativePath, std::string& outText) const;
+
+    bool hasArchive() const;
+    const std::filesystem::path& root() const;
+
+private:
+    bool openArchive(const std::filesystem::path& path);
+    void closeArchive();
+    const AssetArchiveEntry* findEntry(std::string_view relativePath) const;
+
+    std::filesystem::path m_root;
+    const std::uint8_t* m_archiveData = nullptr;
+    std::size_t m_archiveSize = 0;
+    const AssetArchiveHeader* m_header = nullptr;
+    const AssetArchiveEntry* m_entries = nullptr;
+    const std::uint32_t* m_buckets = nullptr;
+    const char* m_names = nullptr;
+#if defined(_WIN32)
+    void* m_fileHandle = nullptr;
+    void* m_mappingHandle = nullptr;
+#endif
+};
@@ -0,0 +1,165 @@
+#include "core/AsyncLoader.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <utility>
+
+AsyncLoader::AsyncLoader(std::size_t uploadQueueCapacity)
+    : m_uploadCapacity(uploadQueueCapacity > 0 ? uploadQueueCapacity : 1) {}
+
+AsyncLoader::~AsyncLoader() {
+    stop();
+}
+
+void AsyncLoader::start() {
+    if (m_worker.joinable()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = false;
+    }
+    m_worker = std::thread(&AsyncLoader::workerLoop, this);
+}
+
+void AsyncLoader::stop() {
+    cancel();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_loadReady.notify_all();
+    m_uploadSpace.notify_all();
+
+    if (m_worker.joinable()) {
+        m_worker.join();
+    }
+}
+
+void AsyncLoader::enqueue(std::string label, LoadTask task) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_cancelled.load()) {
+            // A new batch after a cancel starts from a clean slate.
+            m_cancelled.store(false);
+            m_progress = LoadProgress{};
+            m_lastError.clear();
+        }
+        m_loads.push_back({std::move(label), std::move(task)});
+        ++m_progress.total;
+    }
+    m_loadReady.notify_one();
+}
+
+void AsyncLoader::cancel() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_cancelled.store(true);
+        m_progress.cancelled = true;
+        m_loads.clear();
+        m_uploads.clear();
+    }
+    m_uploadSpace.notify_all();
+}
+
+bool AsyncLoader::pumpUploads(double budgetSeconds) {
+    using Clock = std::chrono::steady_clock;
+    const Clock::time_point start = Clock::now();
+
+    do {
+        PendingUpload upload;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_uploads.empty()) {
+                break;
+            }
+            upload = std::move(m_uploads.front());
+            m_uploads.pop_front();
+        }
+        m_uploadSpace.notify_one();
+
+        const bool ok = !upload.task || upload.task();
+        if (!ok) {
+            recordFailure(upload.label, "upload");
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_progress.completed;
+    } while (std::chrono::duration<double>(Clock::now() - start).count() < budgetSeconds);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_progress.failed == 0;
+}
+
+LoadProgress AsyncLoader::progress() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_progress;
+}
+
+bool AsyncLoader::idle() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_loads.empty() && m_uploads.empty() && !m_loadInFlight;
+}
+
+std::string AsyncLoader::lastError() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_lastError;
+}
+
+void AsyncLoader::workerLoop() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_loadReady.wait(lock, [this] { return m_stopping || !m_loads.empty(); });
+        if (m_stopping) {
+            return;
+        }
+
+        PendingLoad load = std::move(m_loads.front());
+        m_loads.pop_front();
+        m_loadInFlight = true;
+        lock.unlock();
+
+        UploadTask upload;
+        const bool ok = load.task(m_cancelled, upload);
+
+        lock.lock();
+        if (m_cancelled.load()) {
+            m_loadInFlight = false;
+            continue;
+        }
+        if (!ok) {
+            lock.unlock();
+            recordFailure(load.label, "load");
+            lock.lock();
+            ++m_progress.loaded;
+            ++m_progress.completed;
+            m_loadInFlight = false;
+            continue;
+        }
+
+        // The load stays in flight while it waits for upload space, so idle()
+        // cannot report true between the load finishing and its upload being
+        // queued.
+        ++m_progress.loaded;
+        m_uploadSpace.wait(lock, [this] {
+            return m_stopping || m_cancelled.load() || m_uploads.size() < m_uploadCapacity;
+        });
+        m_loadInFlight = false;
+        if (m_stopping) {
+            return;
+        }
+        if (m_cancelled.load()) {
+            continue;
+        }
+        m_uploads.push_back({std::move(load.label), std::move(upload)});
+    }
+}
+
+void AsyncLoader::recordFailure(const std::string& label, const char* stage) {
+    std::cerr << "Asset " << stage << " failed: " << label << '\n';
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ++m_progress.failed;
+    m_lastError = label;
+}
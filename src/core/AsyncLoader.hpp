@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+struct LoadProgress {
+    std::size_t total = 0;
+    std::size_t loaded = 0;
+    std::size_t completed = 0;
+    std::size_t failed = 0;
+    bool cancelled = false;
+
+    float fraction() const {
+        if (total == 0) {
+            return 1.0F;
+        }
+        // Loading and uploading each count for half of a job.
+        return static_cast<float>(loaded + completed) / static_cast<float>(total * 2);
+    }
+};
+
+// Runs load tasks (file reads, parsing, decoding) on a background I/O thread and
+// hands their results to a bounded queue of upload tasks that the GL thread
+// drains under a per-frame time budget. The I/O thread blocks while the upload
+// queue is full, which caps the amount of decoded data held in memory.
+class AsyncLoader {
+public:
+    using UploadTask = std::function<bool()>;
+    using LoadTask = std::function<bool(const std::atomic<bool>& cancelled, UploadTask& outUpload)>;
+
+    explicit AsyncLoader(std::size_t uploadQueueCapacity = 8);
+    ~AsyncLoader();
+
+    AsyncLoader(const AsyncLoader&) = delete;
+    AsyncLoader& operator=(const AsyncLoader&) = delete;
+
+    void start();
+    void stop();
+
+    void enqueue(std::string label, LoadTask task);
+    void cancel();
+
+    // GL thread only. Runs queued uploads until the budget is spent (at least one
+    // per call so progress is guaranteed). Returns false once any job has failed.
+    bool pumpUploads(double budgetSeconds);
+
+    LoadProgress progress() const;
+    // True once every job has loaded and its upload has been handed to
+    // pumpUploads; a finished load still waiting for queue space keeps it false.
+    bool idle() const;
+    std::string lastError() const;
+
+private:
+    struct PendingLoad {
+        std::string label;
+        LoadTask task;
+    };
+
+    struct PendingUpload {
+        std::string label;
+        UploadTask task;
+    };
+
+    void workerLoop();
+    void recordFailure(const std::string& label, const char* stage);
+
+    const std::size_t m_uploadCapacity;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_loadReady;
+    std::condition_variable m_uploadSpace;
+    std::deque<PendingLoad> m_loads;
+    std::deque<PendingUpload> m_uploads;
+    LoadProgress m_progress;
+    std::string m_lastError;
+    bool m_loadInFlight = false;
+    bool m_stopping = false;
+
+    std::atomic<bool> m_cancelled{false};
+    std::thread m_worker;
+};
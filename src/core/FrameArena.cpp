@@ -0,0 +1,59 @@
+#include "core/FrameArena.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace {
+std::size_t alignUp(std::size_t value, std::size_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+}
+
+FrameArena::FrameArena(std::size_t initialCapacity)
+    : m_buffer(std::make_unique<std::byte[]>(initialCapacity)), m_capacity(initialCapacity) {}
+
+void* FrameArena::allocate(std::size_t bytes, std::size_t alignment) {
+    if (bytes == 0) {
+        bytes = 1;
+    }
+
+    const auto base = reinterpret_cast<std::uintptr_t>(m_buffer.get());
+    const std::size_t start = alignUp(base + m_offset, alignment) - base;
+    if (start + bytes <= m_capacity) {
+        m_offset = start + bytes;
+        m_highWater = std::max(m_highWater, m_offset + m_overflowBytes);
+        return m_buffer.get() + start;
+    }
+
+    // Over budget for this frame: fall back to the heap and remember how much
+    // was missing so the next reset can size the arena to fit.
+    m_overflow.push_back(std::make_unique<std::byte[]>(bytes + alignment));
+    m_overflowBytes += bytes + alignment;
+    m_highWater = std::max(m_highWater, m_offset + m_overflowBytes);
+
+    const auto block = reinterpret_cast<std::uintptr_t>(m_overflow.back().get());
+    return reinterpret_cast<void*>(alignUp(block, alignment));
+}
+
+void FrameArena::reset() {
+    if (!m_overflow.empty()) {
+        m_overflow.clear();
+        m_capacity = std::max(m_capacity * 2, alignUp(m_highWater, 4096));
+        m_buffer = std::make_unique<std::byte[]>(m_capacity);
+    }
+
+    m_offset = 0;
+    m_overflowBytes = 0;
+}
+
+std::size_t FrameArena::capacity() const {
+    return m_capacity;
+}
+
+std::size_t FrameArena::used() const {
+    return m_offset + m_overflowBytes;
+}
+
+std::size_t FrameArena::highWater() const {
+    return m_highWater;
+}
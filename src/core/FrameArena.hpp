@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+// Linear allocator for data that lives for a single frame. Allocation is a
+// pointer bump; reset() releases everything at once. If a frame needs more than
+// the current capacity, the excess is served from temporary heap blocks and the
+// arena grows to the observed high-water mark on the next reset, so steady-state
+// frames touch the heap zero times.
+class FrameArena {
+public:
+    explicit FrameArena(std::size_t initialCapacity = 256 * 1024);
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    void* allocate(std::size_t bytes, std::size_t alignment = alignof(std::max_align_t));
+
+    // Returns uninitialized storage; FrameArena never runs destructors.
+    template <typename T>
+    std::span<T> allocateArray(std::size_t count) {
+        static_assert(std::is_trivially_destructible_v<T>, "FrameArena cannot hold types with destructors");
+        return {static_cast<T*>(allocate(sizeof(T) * count, alignof(T))), count};
+    }
+
+    void reset();
+
+    std::size_t capacity() const;
+    std::size_t used() const;
+    std::size_t highWater() const;
+
+private:
+    std::unique_ptr<std::byte[]> m_buffer;
+    std::size_t m_capacity = 0;
+    std::size_t m_offset = 0;
+    std::size_t m_overflowBytes = 0;
+    std::size_t m_highWater = 0;
+    std::vector<std::unique_ptr<std::byte[]>> m_overflow;
+};
@@ -0,0 +1,360 @@
+#include "core/JobSystem.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+namespace {
+
+// Owner of the calling thread's slot, so nested calls find their own deque.
+thread_local const JobSystem* t_pool = nullptr;
+thread_local std::size_t t_slot = 0;
+// Jobs run while waiting inside another job nest; only the outermost one is
+// timed, so busy time is not counted twice.
+thread_local int t_jobDepth = 0;
+
+// Failed job searches before an idle worker goes to sleep.
+constexpr int kIdleSpins = 64;
+
+std::uint64_t nowNanoseconds() {
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+} // namespace
+
+TaskGraph::Node* TaskGraph::addNode(const char* name, TaskAffinity affinity) {
+    if (m_count >= kMaxTasks) {
+        std::cerr << "TaskGraph is full; task " << name << " was not added.\n";
+        return nullptr;
+    }
+    Node& node = m_nodes[m_count++];
+    node.name = name;
+    node.affinity = affinity;
+    node.successorCount = 0;
+    node.predecessorCount = 0;
+    return &node;
+}
+
+bool TaskGraph::precede(TaskId before, TaskId after) {
+    if (before >= m_count || after >= m_count || before == after) {
+        return false;
+    }
+    Node& node = m_nodes[before];
+    if (node.successorCount >= kMaxSuccessors) {
+        std::cerr << "Task " << node.name << " has too many successors.\n";
+        return false;
+    }
+    node.successors[node.successorCount++] = after;
+    ++m_nodes[after].predecessorCount;
+    return true;
+}
+
+std::size_t TaskGraph::size() const {
+    return m_count;
+}
+
+bool TaskGraph::acyclic() const {
+    std::array<std::uint32_t, kMaxTasks> waiting{};
+    std::array<TaskId, kMaxTasks> ready{};
+    std::size_t readyCount = 0;
+    for (TaskId task = 0; task < m_count; ++task) {
+        waiting[task] = m_nodes[task].predecessorCount;
+        if (waiting[task] == 0) {
+            ready[readyCount++] = task;
+        }
+    }
+    std::size_t visited = 0;
+    while (readyCount > 0) {
+        const Node& node = m_nodes[ready[--readyCount]];
+        ++visited;
+        for (std::uint32_t i = 0; i < node.successorCount; ++i) {
+            if (--waiting[node.successors[i]] == 0) {
+                ready[readyCount++] = node.successors[i];
+            }
+        }
+    }
+    return visited == m_count;
+}
+
+bool JobSystem::Queue::pushBack(const Job& job) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (count == jobs.size()) {
+        return false;
+    }
+    jobs[(head + count) % jobs.size()] = job;
+    ++count;
+    return true;
+}
+
+bool JobSystem::Queue::popBack(Job& outJob) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (count == 0) {
+        return false;
+    }
+    --count;
+    outJob = jobs[(head + count) % jobs.size()];
+    return true;
+}
+
+bool JobSystem::Queue::popFront(Job& outJob) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (count == 0) {
+        return false;
+    }
+    outJob = jobs[head];
+    head = (head + 1) % jobs.size();
+    --count;
+    return true;
+}
+
+JobSystem::JobSystem(unsigned workerCount) {
+    if (workerCount == 0) {
+        const unsigned hardware = std::thread::hardware_concurrency();
+        workerCount = hardware > 1 ? hardware - 1 : 0;
+    }
+    m_workerCount = std::min<std::size_t>(workerCount, kMaxWorkers);
+    m_queues = std::make_unique<Queue[]>(m_workerCount + 1);
+    m_counters = std::make_unique<Counters[]>(m_workerCount + 1);
+    m_lastCollect = nowNanoseconds();
+
+    m_threads.reserve(m_workerCount);
+    for (std::size_t slot = 0; slot < m_workerCount; ++slot) {
+        m_threads.emplace_back(&JobSystem::workerLoop, this, slot);
+    }
+}
+
+JobSystem::~JobSystem() {
+    m_stopping.store(true);
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+    }
+    m_wake.notify_all();
+    for (std::thread& thread : m_threads) {
+        thread.join();
+    }
+}
+
+unsigned JobSystem::workerCount() const {
+    return static_cast<unsigned>(m_workerCount);
+}
+
+std::size_t JobSystem::currentSlot() const {
+    return t_pool == this ? t_slot : m_workerCount;
+}
+
+void JobSystem::push(const Job& job) {
+    if (m_workerCount == 0 || !m_queues[currentSlot()].pushBack(job)) {
+        execute(job, currentSlot());
+        return;
+    }
+
+    // Sleepers re-check m_queued under m_sleepMutex, so taking it here
+    // before notifying cannot lose the wake-up.
+    m_queued.fetch_add(1);
+    if (m_sleepers.load() > 0) {
+        {
+            std::lock_guard<std::mutex> lock(m_sleepMutex);
+        }
+        m_wake.notify_one();
+    }
+}
+
+bool JobSystem::runOneJob() {
+    const std::size_t slot = currentSlot();
+    Job job{};
+    bool found = m_queues[slot].popBack(job);
+    bool stolen = false;
+    // Steal oldest-first, starting after our own slot so thieves spread out.
+    for (std::size_t i = 1; !found && i <= m_workerCount; ++i) {
+        found = m_queues[(slot + i) % (m_workerCount + 1)].popFront(job);
+        stolen = found;
+    }
+    if (!found) {
+        return false;
+    }
+
+    m_queued.fetch_sub(1);
+    if (stolen) {
+        m_counters[slot].steals.fetch_add(1, std::memory_order_relaxed);
+    }
+    execute(job, slot);
+    return true;
+}
+
+void JobSystem::execute(const Job& job, std::size_t slot) {
+    Counters& counters = m_counters[slot];
+    counters.jobs.fetch_add(1, std::memory_order_relaxed);
+    if (t_jobDepth > 0) {
+        job.execute(job.data, job.argument);
+        return;
+    }
+
+    ++t_jobDepth;
+    const std::uint64_t start = nowNanoseconds();
+    const AllocationCounters allocationsStart = AllocationStats::thisThread();
+    job.execute(job.data, job.argument);
+    const AllocationCounters allocations = AllocationStats::thisThread() - allocationsStart;
+    counters.busyNanoseconds.fetch_add(nowNanoseconds() - start, std::memory_order_relaxed);
+    counters.allocations.fetch_add(allocations.count, std::memory_order_relaxed);
+    counters.allocationBytes.fetch_add(allocations.bytes, std::memory_order_relaxed);
+    --t_jobDepth;
+}
+
+void JobSystem::workerLoop(std::size_t slot) {
+    t_pool = this;
+    t_slot = slot;
+    int idle = 0;
+    while (!m_stopping.load()) {
+        if (runOneJob()) {
+            idle = 0;
+            continue;
+        }
+        if (++idle < kIdleSpins) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_sleepers.fetch_add(1);
+        m_wake.wait(lock, [this] { return m_stopping.load() || m_queued.load() > 0; });
+        m_sleepers.fetch_sub(1);
+        idle = 0;
+    }
+}
+
+bool JobSystem::run(TaskGraph& graph) {
+    if (!graph.acyclic()) {
+        std::cerr << "Task graph has a cycle; not running it.\n";
+        return false;
+    }
+    if (graph.m_count == 0) {
+        return true;
+    }
+
+    graph.m_jobs = this;
+    graph.m_callerReadyCount = 0;
+    graph.m_remaining.store(graph.m_count);
+    for (TaskGraph::TaskId task = 0; task < graph.m_count; ++task) {
+        graph.m_nodes[task].pending.store(graph.m_nodes[task].predecessorCount, std::memory_order_relaxed);
+    }
+    for (TaskGraph::TaskId task = 0; task < graph.m_count; ++task) {
+        if (graph.m_nodes[task].predecessorCount == 0) {
+            schedule(graph, task);
+        }
+    }
+
+    while (graph.m_remaining.load(std::memory_order_acquire) > 0) {
+        if (!runCallerTask(graph) && !runOneJob()) {
+            std::this_thread::yield();
+        }
+    }
+    graph.m_jobs = nullptr;
+    return true;
+}
+
+void JobSystem::schedule(TaskGraph& graph, TaskGraph::TaskId task) {
+    if (graph.m_nodes[task].affinity == TaskAffinity::Caller) {
+        std::lock_guard<std::mutex> lock(graph.m_callerMutex);
+        graph.m_callerReady[graph.m_callerReadyCount++] = task;
+        return;
+    }
+    push(Job{&JobSystem::runGraphTask, &graph, task});
+}
+
+bool JobSystem::runCallerTask(TaskGraph& graph) {
+    TaskGraph::TaskId task = 0;
+    {
+        std::lock_guard<std::mutex> lock(graph.m_callerMutex);
+        if (graph.m_callerReadyCount == 0) {
+            return false;
+        }
+        task = graph.m_callerReady[--graph.m_callerReadyCount];
+    }
+    execute(Job{&JobSystem::runGraphTask, &graph, task}, currentSlot());
+    return true;
+}
+
+void JobSystem::runGraphTask(void* graphPointer, std::uint32_t task) {
+    TaskGraph& graph = *static_cast<TaskGraph*>(graphPointer);
+    const TaskGraph::Node& node = graph.m_nodes[task];
+    node.invoke(node.storage.data());
+    graph.m_jobs->finishGraphTask(graph, task);
+}
+
+void JobSystem::finishGraphTask(TaskGraph& graph, TaskGraph::TaskId task) {
+    const TaskGraph::Node& node = graph.m_nodes[task];
+    for (std::uint32_t i = 0; i < node.successorCount; ++i) {
+        const TaskGraph::TaskId successor = node.successors[i];
+        if (graph.m_nodes[successor].pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            schedule(graph, successor);
+        }
+    }
+    graph.m_remaining.fetch_sub(1, std::memory_order_release);
+}
+
+void JobSystem::runParallelFor(ParallelFor& state) {
+    const std::size_t chunks = (state.count + state.grain - 1) / state.grain;
+    const auto helpers = static_cast<std::uint32_t>(std::min(m_workerCount, chunks > 0 ? chunks - 1 : 0));
+    state.helpersRunning.store(helpers);
+    for (std::uint32_t i = 0; i < helpers; ++i) {
+        push(Job{&JobSystem::runParallelForHelper, &state, 0});
+    }
+    runChunks(state);
+
+    // `state` lives on this stack frame, so wait until every helper job has
+    // run, even the ones that found no chunk left.
+    while (state.helpersRunning.load(std::memory_order_acquire) > 0) {
+        if (!runOneJob()) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void JobSystem::runChunks(ParallelFor& state) {
+    const MemoryTagScope memoryTag(state.tag);
+    for (;;) {
+        const std::size_t begin = state.next.fetch_add(state.grain);
+        if (begin >= state.count) {
+            return;
+        }
+        state.body(state.function, begin, std::min(begin + state.grain, state.count));
+    }
+}
+
+void JobSystem::runParallelForHelper(void* statePointer, std::uint32_t) {
+    ParallelFor& state = *static_cast<ParallelFor*>(statePointer);
+    runChunks(state);
+    state.helpersRunning.fetch_sub(1, std::memory_order_release);
+}
+
+std::size_t JobSystem::collectStats(std::span<WorkerStats> outStats) {
+    const std::uint64_t now = nowNanoseconds();
+    const double window = static_cast<double>(now - m_lastCollect) * 1.0e-9;
+    m_lastCollect = now;
+
+    const std::size_t count = std::min(outStats.size(), m_workerCount + 1);
+    for (std::size_t i = 0; i < count; ++i) {
+        // Reported order puts the shared slot (the main thread) first.
+        const std::size_t slot = i == 0 ? m_workerCount : i - 1;
+        const Counters& counters = m_counters[slot];
+        const std::uint64_t busy = counters.busyNanoseconds.load(std::memory_order_relaxed);
+        const std::uint64_t jobs = counters.jobs.load(std::memory_order_relaxed);
+        const std::uint64_t steals = counters.steals.load(std::memory_order_relaxed);
+        const AllocationCounters allocations{
+            counters.allocations.load(std::memory_order_relaxed),
+            counters.allocationBytes.load(std::memory_order_relaxed)};
+
+        WorkerStats& stats = outStats[i];
+        stats.jobs = jobs - m_lastJobs[slot];
+        stats.steals = steals - m_lastSteals[slot];
+        stats.busySeconds = static_cast<double>(busy - m_lastBusy[slot]) * 1.0e-9;
+        stats.windowSeconds = window;
+        stats.allocations = allocations - m_lastAllocations[slot];
+        m_lastBusy[slot] = busy;
+        m_lastJobs[slot] = jobs;
+        m_lastSteals[slot] = steals;
+        m_lastAllocations[slot] = allocations;
+    }
+    return count;
+}
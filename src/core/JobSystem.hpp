@@ -0,0 +1,223 @@
+#pragma once
+
+#include "core/AllocationStats.hpp"
+#include "core/MemoryAccounting.hpp"
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <span>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+class JobSystem;
+
+// Caller tasks run only on the thread that calls JobSystem::run; that is where
+// the GL context is current.
+enum class TaskAffinity : std::uint8_t {
+    Any,
+    Caller,
+};
+
+// A fixed-capacity graph of tasks and the order between them. It is built
+// once and can be run every frame; running it neither allocates nor copies
+// the tasks. Tasks are small callables, normally lambdas capturing by
+// reference.
+class TaskGraph {
+public:
+    using TaskId = std::uint32_t;
+    static constexpr std::size_t kMaxTasks = 32;
+    static constexpr std::size_t kMaxSuccessors = 8;
+    static constexpr std::size_t kTaskStorage = 64;
+    static constexpr TaskId kInvalidTask = ~TaskId{0};
+
+    TaskGraph() = default;
+    TaskGraph(const TaskGraph&) = delete;
+    TaskGraph& operator=(const TaskGraph&) = delete;
+
+    // Returns kInvalidTask when the graph is full.
+    template <typename F>
+    TaskId add(const char* name, const F& task, TaskAffinity affinity = TaskAffinity::Any) {
+        static_assert(sizeof(F) <= kTaskStorage && alignof(F) <= alignof(std::max_align_t), "task captures too much");
+        static_assert(std::is_trivially_copyable_v<F> && std::is_trivially_destructible_v<F>, "capture by reference");
+        Node* node = addNode(name, affinity);
+        if (node == nullptr) {
+            return kInvalidTask;
+        }
+        ::new (static_cast<void*>(node->storage.data())) F(task);
+        node->invoke = [](const void* storage) { (*static_cast<const F*>(storage))(); };
+        return m_count - 1;
+    }
+
+    // `after` starts only once `before` has finished.
+    bool precede(TaskId before, TaskId after);
+    std::size_t size() const;
+
+private:
+    friend class JobSystem;
+
+    struct Node {
+        const char* name = nullptr;
+        void (*invoke)(const void* storage) = nullptr;
+        alignas(std::max_align_t) std::array<std::byte, kTaskStorage> storage{};
+        TaskAffinity affinity = TaskAffinity::Any;
+        std::array<TaskId, kMaxSuccessors> successors{};
+        std::uint32_t successorCount = 0;
+        std::uint32_t predecessorCount = 0;
+        std::atomic<std::uint32_t> pending{0};
+    };
+
+    Node* addNode(const char* name, TaskAffinity affinity);
+    // Kahn's algorithm over the edges; a cycle would never finish running.
+    bool acyclic() const;
+
+    std::array<Node, kMaxTasks> m_nodes;
+    std::uint32_t m_count = 0;
+
+    // State of the run in progress.
+    JobSystem* m_jobs = nullptr;
+    std::atomic<std::uint32_t> m_remaining{0};
+    std::mutex m_callerMutex;
+    std::array<TaskId, kMaxTasks> m_callerReady{};
+    std::uint32_t m_callerReadyCount = 0;
+};
+
+// Per-thread activity over the window since the previous collectStats call.
+struct WorkerStats {
+    std::uint64_t jobs = 0;
+    std::uint64_t steals = 0;
+    double busySeconds = 0.0;
+    double windowSeconds = 0.0;
+    // Allocations made by the jobs the thread ran; always zero without
+    // ENGINE_TRACK_ALLOCATIONS.
+    AllocationCounters allocations;
+
+    double utilization() const {
+        return windowSeconds > 0.0 ? busySeconds / windowSeconds : 0.0;
+    }
+};
+
+// Work-stealing thread pool. Each worker owns a deque: it pushes and pops
+// jobs at the back, and idle workers steal from the front of the others.
+// Threads outside the pool share one extra deque, and while they wait on a
+// graph or a parallelFor they run jobs too. The deques are fixed rings, so
+// scheduling never allocates; a push onto a full ring runs the job inline.
+class JobSystem {
+public:
+    static constexpr std::size_t kMaxWorkers = 15;
+    static constexpr std::size_t kQueueCapacity = 256;
+
+    // 0 workers picks one fewer than the hardware threads, leaving a core to
+    // the thread that drives the frame.
+    explicit JobSystem(unsigned workerCount = 0);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    unsigned workerCount() const;
+
+    // Runs every task once in dependency order and returns when all are done.
+    // Returns false, running nothing, if the graph has a cycle.
+    bool run(TaskGraph& graph);
+
+    // Calls body(begin, end) over [0, count) in chunks of `grain`, spread over
+    // the workers and the calling thread. Returns when every chunk is done.
+    template <typename F>
+    void parallelFor(std::size_t count, std::size_t grain, const F& body) {
+        ParallelFor state;
+        state.body = [](const void* function, std::size_t begin, std::size_t end) {
+            (*static_cast<const F*>(function))(begin, end);
+        };
+        state.function = &body;
+        state.count = count;
+        state.grain = grain == 0 ? 1 : grain;
+        state.tag = MemoryAccounting::currentTag();
+        runParallelFor(state);
+    }
+
+    // One entry per thread: index 0 covers the threads outside the pool (the
+    // main thread), then one per worker. Busy time and allocations only count
+    // running jobs.
+    // Returns the number of entries written.
+    std::size_t collectStats(std::span<WorkerStats> outStats);
+
+private:
+    struct Job {
+        void (*execute)(void* data, std::uint32_t argument);
+        void* data;
+        std::uint32_t argument;
+    };
+
+    struct alignas(64) Queue {
+        std::mutex mutex;
+        std::array<Job, kQueueCapacity> jobs{};
+        std::size_t head = 0;
+        std::size_t count = 0;
+
+        bool pushBack(const Job& job);
+        bool popBack(Job& outJob);
+        bool popFront(Job& outJob);
+    };
+
+    struct alignas(64) Counters {
+        std::atomic<std::uint64_t> jobs{0};
+        std::atomic<std::uint64_t> steals{0};
+        std::atomic<std::uint64_t> busyNanoseconds{0};
+        std::atomic<std::uint64_t> allocations{0};
+        std::atomic<std::uint64_t> allocationBytes{0};
+    };
+
+    struct ParallelFor {
+        void (*body)(const void* function, std::size_t begin, std::size_t end) = nullptr;
+        const void* function = nullptr;
+        std::size_t count = 0;
+        std::size_t grain = 1;
+        // The caller's memory tag, so helpers charge its subsystem too.
+        MemoryTag tag = MemoryTag::Other;
+        std::atomic<std::size_t> next{0};
+        std::atomic<std::uint32_t> helpersRunning{0};
+    };
+
+    // Slot of the calling thread: a worker's own index, or the shared slot
+    // for threads outside the pool.
+    std::size_t currentSlot() const;
+    void push(const Job& job);
+    bool runOneJob();
+    void execute(const Job& job, std::size_t slot);
+    void workerLoop(std::size_t slot);
+
+    void schedule(TaskGraph& graph, TaskGraph::TaskId task);
+    bool runCallerTask(TaskGraph& graph);
+    static void runGraphTask(void* graph, std::uint32_t task);
+    void finishGraphTask(TaskGraph& graph, TaskGraph::TaskId task);
+
+    void runParallelFor(ParallelFor& state);
+    static void runChunks(ParallelFor& state);
+    static void runParallelForHelper(void* state, std::uint32_t argument);
+
+    // Slots [0, workers) belong to the workers; the last one is shared by
+    // every other thread.
+    std::size_t m_workerCount = 0;
+    std::unique_ptr<Queue[]> m_queues;
+    std::unique_ptr<Counters[]> m_counters;
+    std::vector<std::thread> m_threads;
+
+    std::atomic<std::int64_t> m_queued{0};
+    std::atomic<int> m_sleepers{0};
+    std::atomic<bool> m_stopping{false};
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wake;
+
+    std::array<std::uint64_t, kMaxWorkers + 1> m_lastBusy{};
+    std::array<std::uint64_t, kMaxWorkers + 1> m_lastJobs{};
+    std::array<std::uint64_t, kMaxWorkers + 1> m_lastSteals{};
+    std::array<AllocationCounters, kMaxWorkers + 1> m_lastAllocations{};
+    std::uint64_t m_lastCollect = 0;
+};
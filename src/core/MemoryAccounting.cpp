@@ -0,0 +1,228 @@
+#include "core/MemoryAccounting.hpp"
+
+#include "core/AllocationStats.hpp"
+
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <ostream>
+
+namespace {
+
+constexpr std::array<std::string_view, kMemoryTagCount> kTagNames{
+    "other",
+    "assets",
+    "shaders",
+    "map",
+    "lighting",
+    "render",
+    "render-targets",
+    "geometry",
+    "capture",
+    "particles",
+    "simulation",
+    "saves",
+};
+constexpr std::string_view kTotalName = "total";
+constexpr double kMiB = 1024.0 * 1024.0;
+
+struct TagCounters {
+    std::atomic<std::uint64_t> cpuBytes{0};
+    std::atomic<std::uint64_t> cpuAllocations{0};
+    std::atomic<std::uint64_t> gpuBytes{0};
+    std::atomic<std::uint64_t> budgetBytes{0};
+};
+
+// Constant-initialised, so the allocation hooks can use them before main.
+std::array<TagCounters, kMemoryTagCount> g_tags;
+std::atomic<std::uint64_t> g_totalBudget{0};
+// Budgets over their limit at the last check; the last entry is the total.
+std::array<bool, kMemoryTagCount + 1> g_overBudget{};
+
+thread_local MemoryTag t_tag = MemoryTag::Other;
+
+TagCounters& counters(MemoryTag tag) {
+    return g_tags[static_cast<std::size_t>(tag)];
+}
+
+bool tagFromName(std::string_view name, std::size_t& outIndex) {
+    for (std::size_t i = 0; i < kTagNames.size(); ++i) {
+        if (kTagNames[i] == name) {
+            outIndex = i;
+            return true;
+        }
+    }
+    if (name == kTotalName) {
+        outIndex = kMemoryTagCount;
+        return true;
+    }
+    return false;
+}
+
+void warnOverBudget(std::size_t index, std::string_view name, const MemoryUsage& usage) {
+    const bool over = usage.budgetBytes > 0 && usage.cpuBytes + usage.gpuBytes > usage.budgetBytes;
+    if (over && !g_overBudget[index]) {
+        const std::ios::fmtflags flags = std::cerr.flags();
+        const std::streamsize precision = std::cerr.precision();
+        std::cerr << "Memory budget exceeded: " << name << " uses " << std::fixed << std::setprecision(1)
+                  << static_cast<double>(usage.cpuBytes + usage.gpuBytes) / kMiB << " MiB of "
+                  << static_cast<double>(usage.budgetBytes) / kMiB << " MiB.\n";
+        std::cerr.flags(flags);
+        std::cerr.precision(precision);
+    }
+    g_overBudget[index] = over;
+}
+
+} // namespace
+
+MemoryTagScope::MemoryTagScope(MemoryTag tag)
+    : m_previous(t_tag) {
+    t_tag = tag;
+}
+
+MemoryTagScope::~MemoryTagScope() {
+    t_tag = m_previous;
+}
+
+GpuAllocation::GpuAllocation(MemoryTag tag)
+    : m_tag(tag) {
+}
+
+GpuAllocation::~GpuAllocation() {
+    release();
+}
+
+void GpuAllocation::set(std::uint64_t bytes) {
+    std::atomic<std::uint64_t>& total = counters(m_tag).gpuBytes;
+    if (bytes >= m_bytes) {
+        total.fetch_add(bytes - m_bytes, std::memory_order_relaxed);
+    } else {
+        total.fetch_sub(m_bytes - bytes, std::memory_order_relaxed);
+    }
+    m_bytes = bytes;
+}
+
+void GpuAllocation::release() {
+    set(0);
+}
+
+std::uint64_t GpuAllocation::bytes() const {
+    return m_bytes;
+}
+
+std::string_view MemoryAccounting::tagName(MemoryTag tag) {
+    return kTagNames[static_cast<std::size_t>(tag)];
+}
+
+MemoryTag MemoryAccounting::currentTag() {
+    return t_tag;
+}
+
+bool MemoryAccounting::tracksCpu() {
+    return AllocationStats::enabled();
+}
+
+MemoryUsage MemoryAccounting::usage(MemoryTag tag) {
+    const TagCounters& tagCounters = counters(tag);
+    MemoryUsage result;
+    result.cpuBytes = tagCounters.cpuBytes.load(std::memory_order_relaxed);
+    result.cpuAllocations = tagCounters.cpuAllocations.load(std::memory_order_relaxed);
+    result.gpuBytes = tagCounters.gpuBytes.load(std::memory_order_relaxed);
+    result.budgetBytes = tagCounters.budgetBytes.load(std::memory_order_relaxed);
+    return result;
+}
+
+MemoryUsage MemoryAccounting::total() {
+    MemoryUsage result;
+    for (std::size_t i = 0; i < kMemoryTagCount; ++i) {
+        const MemoryUsage tag = usage(static_cast<MemoryTag>(i));
+        result.cpuBytes += tag.cpuBytes;
+        result.cpuAllocations += tag.cpuAllocations;
+        result.gpuBytes += tag.gpuBytes;
+    }
+    result.budgetBytes = g_totalBudget.load(std::memory_order_relaxed);
+    return result;
+}
+
+bool MemoryAccounting::parseBudgets(std::string_view text) {
+    std::array<std::uint64_t, kMemoryTagCount + 1> budgets{};
+    std::array<bool, kMemoryTagCount + 1> set{};
+    while (!text.empty()) {
+        const std::size_t comma = text.find(',');
+        const std::string_view entry = text.substr(0, comma);
+        text = comma == std::string_view::npos ? std::string_view{} : text.substr(comma + 1);
+
+        const std::size_t equals = entry.find('=');
+        std::size_t index = 0;
+        if (equals == std::string_view::npos || !tagFromName(entry.substr(0, equals), index)) {
+            return false;
+        }
+        const std::string_view value = entry.substr(equals + 1);
+        double mebibytes = 0.0;
+        const auto result = std::from_chars(value.data(), value.data() + value.size(), mebibytes);
+        if (result.ec != std::errc{} || result.ptr != value.data() + value.size() || !(mebibytes > 0.0)) {
+            return false;
+        }
+        budgets[index] = static_cast<std::uint64_t>(std::llround(mebibytes * kMiB));
+        set[index] = true;
+    }
+
+    for (std::size_t i = 0; i < kMemoryTagCount; ++i) {
+        if (set[i]) {
+            g_tags[i].budgetBytes.store(budgets[i], std::memory_order_relaxed);
+        }
+    }
+    if (set[kMemoryTagCount]) {
+        g_totalBudget.store(budgets[kMemoryTagCount], std::memory_order_relaxed);
+    }
+    return true;
+}
+
+void MemoryAccounting::checkBudgets() {
+    for (std::size_t i = 0; i < kMemoryTagCount; ++i) {
+        warnOverBudget(i, kTagNames[i], usage(static_cast<MemoryTag>(i)));
+    }
+    warnOverBudget(kMemoryTagCount, kTotalName, total());
+}
+
+void MemoryAccounting::writeReport(std::ostream& out) {
+    const auto writeRow = [&out](std::string_view name, const MemoryUsage& usage) {
+        out << std::setw(16) << name << std::setw(10) << static_cast<double>(usage.cpuBytes) / kMiB << std::setw(10)
+            << static_cast<double>(usage.gpuBytes) / kMiB;
+        if (usage.budgetBytes > 0) {
+            out << std::setw(10) << static_cast<double>(usage.budgetBytes) / kMiB;
+        }
+        out << '\n';
+    };
+
+    const std::ios::fmtflags flags = out.flags();
+    const std::streamsize precision = out.precision();
+    out << std::fixed << std::setprecision(2);
+    out << "Memory (MiB" << (tracksCpu() ? "" : "; CPU not tracked in this build") << ")\n";
+    out << std::setw(16) << "tag" << std::setw(10) << "cpu" << std::setw(10) << "gpu" << std::setw(10) << "budget"
+        << '\n';
+    for (std::size_t i = 0; i < kMemoryTagCount; ++i) {
+        const MemoryUsage tag = usage(static_cast<MemoryTag>(i));
+        if (tag.cpuBytes > 0 || tag.gpuBytes > 0 || tag.budgetBytes > 0) {
+            writeRow(kTagNames[i], tag);
+        }
+    }
+    writeRow(kTotalName, total());
+    out.flags(flags);
+    out.precision(precision);
+}
+
+void MemoryAccounting::chargeCpu(MemoryTag tag, std::size_t bytes) {
+    TagCounters& tagCounters = counters(tag);
+    tagCounters.cpuBytes.fetch_add(bytes, std::memory_order_relaxed);
+    tagCounters.cpuAllocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+void MemoryAccounting::creditCpu(MemoryTag tag, std::size_t bytes) {
+    TagCounters& tagCounters = counters(tag);
+    tagCounters.cpuBytes.fetch_sub(bytes, std::memory_order_relaxed);
+    tagCounters.cpuAllocations.fetch_sub(1, std::memory_order_relaxed);
+}
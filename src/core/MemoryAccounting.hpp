@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string_view>
+
+// Subsystems memory is charged to. CPU allocations go to the tag current on
+// the allocating thread (see MemoryTagScope) and are credited back to it when
+// freed, whichever thread frees them. GPU bytes are estimates recorded when a
+// texture or buffer is created.
+enum class MemoryTag : std::uint8_t {
+    Other,
+    Assets,
+    Shaders,
+    Map,
+    Lighting,
+    Render,
+    RenderTargets,
+    Geometry,
+    Capture,
+    Particles,
+    Simulation,
+    Saves,
+};
+
+inline constexpr std::size_t kMemoryTagCount = 12;
+
+struct MemoryUsage {
+    std::uint64_t cpuBytes = 0;
+    std::uint64_t cpuAllocations = 0;
+    std::uint64_t gpuBytes = 0;
+    // 0 when the tag has no budget.
+    std::uint64_t budgetBytes = 0;
+};
+
+// Charges CPU allocations made on this thread to `tag` until it goes out of
+// scope, then restores the previous tag. Scopes nest.
+class MemoryTagScope {
+public:
+    explicit MemoryTagScope(MemoryTag tag);
+    ~MemoryTagScope();
+
+    MemoryTagScope(const MemoryTagScope&) = delete;
+    MemoryTagScope& operator=(const MemoryTagScope&) = delete;
+
+private:
+    MemoryTag m_previous;
+};
+
+// Estimated size of one GPU resource: set() when it is created or resized,
+// release() when it is deleted. The tag's GPU total follows.
+class GpuAllocation {
+public:
+    explicit GpuAllocation(MemoryTag tag);
+    ~GpuAllocation();
+
+    GpuAllocation(const GpuAllocation&) = delete;
+    GpuAllocation& operator=(const GpuAllocation&) = delete;
+
+    void set(std::uint64_t bytes);
+    void release();
+    std::uint64_t bytes() const;
+
+private:
+    MemoryTag m_tag;
+    std::uint64_t m_bytes = 0;
+};
+
+// Live memory per tag with optional budgets. The counters are atomics, so any
+// thread may charge memory or read usage.
+class MemoryAccounting {
+public:
+    static std::string_view tagName(MemoryTag tag);
+    static MemoryTag currentTag();
+    // CPU bytes are only counted in builds with ENGINE_TRACK_ALLOCATIONS.
+    static bool tracksCpu();
+    static MemoryUsage usage(MemoryTag tag);
+    // Sum over every tag; budgetBytes is the "total" budget.
+    static MemoryUsage total();
+
+    // Comma-separated "tag=MiB" entries, e.g. "map=64,render-targets=256";
+    // the tag "total" budgets the sum. Budgets count CPU and GPU bytes
+    // together. Returns false, changing nothing, when the text is malformed.
+    static bool parseBudgets(std::string_view text);
+
+    // Warns on std::cerr about every budget exceeded since the last check. A
+    // budget warns again only after usage has dropped back under it. Call
+    // from one thread; does not allocate.
+    static void checkBudgets();
+    // One line per tag in use: CPU and GPU bytes and the budget.
+    static void writeReport(std::ostream& out);
+
+    // Allocation hooks (AllocationStats.cpp).
+    static void chargeCpu(MemoryTag tag, std::size_t bytes);
+    static void creditCpu(MemoryTag tag, std::size_t bytes);
+};
@@ -0,0 +1,122 @@
+#include "core/SimulationServer.hpp"
+
+#include "core/AssetManager.hpp"
+#include "core/JobSystem.hpp"
+#include "core/MemoryAccounting.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+constexpr std::uint64_t kFnvOffset = 0xCBF29CE484222325ULL;
+constexpr double kProgressSeconds = 1.0;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+} // namespace
+
+double SimulationReport::stepsPerSecond() const {
+    return seconds > 0.0 ? static_cast<double>(worlds) * static_cast<double>(steps) / seconds : 0.0;
+}
+
+bool SimulationServer::load(const AssetManager& assets, const SimulationServerSettings& settings) {
+    const MemoryTagScope memoryTag(MemoryTag::Simulation);
+    m_settings = settings;
+    m_worlds.clear();
+    m_recording.clear();
+
+    std::string text;
+    {
+        const MemoryTagScope mapTag(MemoryTag::Map);
+        if (!assets.readText(settings.mapPath, text) || !m_map.loadFromAscii(text)) {
+            std::cerr << "Headless: cannot load map " << settings.mapPath << '\n';
+            return false;
+        }
+    }
+
+    if (!settings.inputPath.empty()) {
+        std::ifstream file(settings.inputPath);
+        std::stringstream stream;
+        stream << file.rdbuf();
+        if (!file.is_open() || !InputScript::parseRecording(stream.str(), m_recording)) {
+            std::cerr << "Headless: cannot read input recording " << settings.inputPath.string() << '\n';
+            return false;
+        }
+    }
+
+    m_worlds.resize(settings.worlds);
+    for (std::size_t i = 0; i < m_worlds.size(); ++i) {
+        SimulationWorld& world = m_worlds[i];
+        const std::uint32_t seed = settings.seed + static_cast<std::uint32_t>(i);
+        world.spawn(m_map, settings.playerX, settings.playerY, settings.townsfolk, seed, settings.lod);
+        if (m_recording.empty()) {
+            world.input().wander(seed);
+        } else {
+            world.input().replay(m_recording, i * kReplayStagger);
+        }
+    }
+    return true;
+}
+
+SimulationReport SimulationServer::run(JobSystem& jobs) {
+    const MemoryTagScope memoryTag(MemoryTag::Simulation);
+    const auto dt = static_cast<float>(kStepSeconds);
+    const Clock::time_point start = Clock::now();
+    double nextProgress = kProgressSeconds;
+
+    std::uint64_t done = 0;
+    while (done < m_settings.steps) {
+        const std::uint64_t batch = std::min(kBatchSteps, m_settings.steps - done);
+        jobs.parallelFor(m_worlds.size(), kWorldsPerJob, [this, batch, dt](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; ++i) {
+                for (std::uint64_t step = 0; step < batch; ++step) {
+                    m_worlds[i].step(m_map, dt);
+                }
+            }
+        });
+        done += batch;
+
+        const double elapsed = secondsSince(start);
+        if (elapsed >= nextProgress && done < m_settings.steps) {
+            nextProgress = elapsed + kProgressSeconds;
+            std::cerr << "Headless: step " << done << " of " << m_settings.steps << ", "
+                      << static_cast<std::uint64_t>(static_cast<double>(m_worlds.size() * done) / elapsed)
+                      << " world steps/s\n";
+        }
+    }
+
+    SimulationReport report;
+    report.seconds = secondsSince(start);
+    report.worlds = m_worlds.size();
+    report.steps = m_settings.steps;
+    report.threads = jobs.workerCount() + 1;
+    report.stateHash = kFnvOffset;
+    for (const SimulationWorld& world : m_worlds) {
+        report.stateHash = world.hashState(report.stateHash);
+    }
+    return report;
+}
+
+void SimulationServer::writeReport(std::ostream& out, const SimulationReport& report) {
+    const std::ios::fmtflags flags = out.flags();
+    const std::streamsize precision = out.precision();
+    const double stepsPerSecond = report.stepsPerSecond();
+    const double worldSteps = static_cast<double>(report.worlds) * static_cast<double>(report.steps);
+    out << std::fixed << std::setprecision(3);
+    out << "Headless: " << report.worlds << " worlds x " << report.steps << " steps on " << report.threads
+        << " threads in " << report.seconds << " s\n";
+    out << "  " << std::setprecision(0) << stepsPerSecond << " world steps/s, " << std::setprecision(3)
+        << (worldSteps > 0.0 ? report.seconds * 1.0e9 / worldSteps : 0.0) << " ns per world step, "
+        << std::setprecision(0) << stepsPerSecond * SimulationServer::kStepSeconds << "x real time\n";
+    out << "  state hash " << std::hex << std::setw(16) << std::setfill('0') << report.stateHash << std::setfill(' ')
+        << '\n';
+    out.flags(flags);
+    out.precision(precision);
+}
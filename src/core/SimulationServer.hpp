@@ -0,0 +1,73 @@
+#pragma once
+
+#include "game/InputScript.hpp"
+#include "game/Map.hpp"
+#include "game/SimulationLod.hpp"
+#include "game/SimulationWorld.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+class AssetManager;
+class JobSystem;
+
+struct SimulationServerSettings {
+    std::size_t worlds = 1000;
+    // Fixed steps every world takes; 3600 is a minute of game time.
+    std::uint64_t steps = 3600;
+    std::size_t townsfolk = 8;
+    // World i spawns its townsfolk and wanders from seed + i.
+    std::uint32_t seed = 1;
+    float playerX = 2.5F;
+    float playerY = 2.5F;
+    std::string mapPath = "data/maps/frontier_town.map";
+    // Input recording replayed by every world (see InputScript); empty lets
+    // every world wander.
+    std::filesystem::path inputPath;
+    SimulationLodSettings lod;
+};
+
+struct SimulationReport {
+    std::size_t worlds = 0;
+    std::uint64_t steps = 0;
+    unsigned threads = 0;
+    double seconds = 0.0;
+    // Hash of every world's final state, in world order.
+    std::uint64_t stateHash = 0;
+
+    // World steps per wall-clock second, summed over all worlds.
+    double stepsPerSecond() const;
+};
+
+// Runs many independent worlds without a window or GL, for balance testing
+// and training. All worlds read one shared map. They are stepped in batches
+// spread over the job system, each world taking a batch of steps in a row
+// while its state is in cache, as fast as the cores allow rather than in real
+// time. Every world's outcome depends only on its seed or recording, so the
+// same settings give the same state hash on any number of threads.
+class SimulationServer {
+public:
+    static constexpr double kStepSeconds = 1.0 / 60.0;
+    static constexpr std::uint64_t kBatchSteps = 60;
+    static constexpr std::size_t kWorldsPerJob = 4;
+    // Replaying worlds start this many steps apart in the recording.
+    static constexpr std::uint64_t kReplayStagger = 37;
+
+    // Loads the map and the recording and spawns the worlds.
+    bool load(const AssetManager& assets, const SimulationServerSettings& settings);
+    // Steps every world settings.steps times, printing progress to std::cerr
+    // about once a second.
+    SimulationReport run(JobSystem& jobs);
+
+    static void writeReport(std::ostream& out, const SimulationReport& report);
+
+private:
+    SimulationServerSettings m_settings;
+    Map m_map;
+    std::vector<InputSpan> m_recording;
+    std::vector<SimulationWorld> m_worlds;
+};
@@ -0,0 +1,364 @@
+#include "core/Telemetry.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <system_error>
+
+namespace {
+
+// Frame and render times: 10% wide buckets from 0.25 ms up to about 2 s.
+constexpr float kTimeFirstUpperMs = 0.25F;
+constexpr float kTimeGrowth = 1.1F;
+
+void appendf(std::string& out, const char* format, double value) {
+    std::array<char, 64> buffer{};
+    std::snprintf(buffer.data(), buffer.size(), format, value);
+    out += buffer.data();
+}
+
+void appendJsonMetric(std::string& out, const char* name, const MetricSummary& metric, bool last) {
+    out += "    \"";
+    out += name;
+    out += "\": {";
+    appendf(out, "\"p50\": %.3f, ", metric.p50);
+    appendf(out, "\"p95\": %.3f, ", metric.p95);
+    appendf(out, "\"p99\": %.3f, ", metric.p99);
+    appendf(out, "\"mean\": %.3f, ", metric.mean);
+    appendf(out, "\"max\": %.3f, ", metric.max);
+    appendf(out, "\"count\": %.0f, ", static_cast<double>(metric.count));
+    appendf(out, "\"sum\": %.3f}", metric.sum);
+    out += last ? "\n" : ",\n";
+}
+
+void appendPrometheusMetric(std::string& out, const char* name, const char* help, const MetricSummary& metric) {
+    out += "# HELP ";
+    out += name;
+    out += ' ';
+    out += help;
+    out += "\n# TYPE ";
+    out += name;
+    out += " summary\n";
+    const std::array<std::pair<const char*, float>, 3> quantiles{{{"0.5", metric.p50}, {"0.95", metric.p95}, {"0.99", metric.p99}}};
+    for (const auto& [label, value] : quantiles) {
+        out += name;
+        out += "{quantile=\"";
+        out += label;
+        appendf(out, "\"} %.3f\n", value);
+    }
+    out += name;
+    appendf(out, "_sum %.3f\n", metric.sum);
+    out += name;
+    appendf(out, "_count %.0f\n", static_cast<double>(metric.count));
+}
+
+} // namespace
+
+RollingHistogram::RollingHistogram(float firstUpper, float step, bool geometric)
+    : m_step(step),
+      m_geometric(geometric) {
+    float upper = firstUpper;
+    for (float& bound : m_upperBounds) {
+        bound = upper;
+        upper = geometric ? upper * step : upper + step;
+    }
+}
+
+std::size_t RollingHistogram::bucketFor(float value) const {
+    const auto it = std::upper_bound(m_upperBounds.begin(), m_upperBounds.end(), value);
+    return std::min(static_cast<std::size_t>(it - m_upperBounds.begin()), kBucketCount - 1);
+}
+
+void RollingHistogram::add(float value) {
+    if (m_windowCount == kWindow) {
+        const float evicted = m_samples[m_next];
+        --m_counts[bucketFor(evicted)];
+        m_windowSum -= evicted;
+    } else {
+        ++m_windowCount;
+    }
+    m_samples[m_next] = value;
+    m_next = (m_next + 1) % kWindow;
+    ++m_counts[bucketFor(value)];
+    m_windowSum += value;
+    ++m_totalCount;
+    m_totalSum += value;
+}
+
+float RollingHistogram::percentile(float fraction) const {
+    if (m_windowCount == 0) {
+        return 0.0F;
+    }
+
+    // The rank'th smallest sample is reported as the middle of its bucket.
+    const auto rank = static_cast<std::size_t>(std::ceil(std::clamp(fraction, 0.0F, 1.0F) * static_cast<float>(m_windowCount)));
+    std::size_t seen = 0;
+    for (std::size_t bucket = 0; bucket < kBucketCount; ++bucket) {
+        seen += m_counts[bucket];
+        if (seen >= std::max<std::size_t>(rank, 1)) {
+            if (bucket == kBucketCount - 1) {
+                return windowMax();
+            }
+            const float upper = m_upperBounds[bucket];
+            return m_geometric ? upper / std::sqrt(m_step) : upper - m_step * 0.5F;
+        }
+    }
+    return windowMax();
+}
+
+float RollingHistogram::windowMean() const {
+    return m_windowCount == 0 ? 0.0F : static_cast<float>(m_windowSum / static_cast<double>(m_windowCount));
+}
+
+float RollingHistogram::windowMax() const {
+    if (m_windowCount == 0) {
+        return 0.0F;
+    }
+    return *std::max_element(m_samples.begin(), m_samples.begin() + static_cast<std::ptrdiff_t>(m_windowCount));
+}
+
+std::size_t RollingHistogram::windowCount() const {
+    return m_windowCount;
+}
+
+std::uint64_t RollingHistogram::totalCount() const {
+    return m_totalCount;
+}
+
+double RollingHistogram::totalSum() const {
+    return m_totalSum;
+}
+
+Telemetry::Telemetry()
+    : m_frameMs(kTimeFirstUpperMs, kTimeGrowth, true),
+      m_renderMs(kTimeFirstUpperMs, kTimeGrowth, true),
+      m_simSteps(0.5F, 1.0F, false) {
+}
+
+Telemetry::~Telemetry() {
+    stop();
+}
+
+bool Telemetry::start(const std::filesystem::path& outputPath, TelemetryFormat format, double intervalSeconds) {
+    stop();
+    std::error_code error;
+    if (outputPath.has_parent_path()) {
+        std::filesystem::create_directories(outputPath.parent_path(), error);
+        if (error) {
+            std::cerr << "Telemetry: cannot create " << outputPath.parent_path().string() << ": " << error.message() << '\n';
+            return false;
+        }
+    }
+
+    m_outputPath = outputPath;
+    m_format = format;
+    m_intervalSeconds = std::max(0.1, intervalSeconds);
+    m_sinceLastPublish = 0.0;
+    m_stopping = false;
+    m_hasPending = false;
+    m_writeFailures = 0;
+    m_active = true;
+    m_writer = std::thread(&Telemetry::writerLoop, this);
+    return true;
+}
+
+void Telemetry::stop() {
+    if (!m_active) {
+        return;
+    }
+
+    publish();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_published.notify_one();
+    m_writer.join();
+    m_active = false;
+
+    const TelemetrySnapshot summary = snapshot();
+    std::cerr << "Telemetry: " << summary.frameMs.count << " frames, frame time p50/p95/p99 " << summary.frameMs.p50
+              << '/' << summary.frameMs.p95 << '/' << summary.frameMs.p99 << " ms, " << summary.hitches << " hitches";
+    if (m_writeFailures > 0) {
+        std::cerr << ", " << m_writeFailures << " failed writes to " << m_outputPath.string();
+    }
+    std::cerr << ".\n";
+}
+
+bool Telemetry::active() const {
+    return m_active;
+}
+
+void Telemetry::recordFrame(double frameSeconds, int simulationSteps, double renderSeconds) {
+    const float frameMs = static_cast<float>(frameSeconds * 1000.0);
+    m_frameMs.add(frameMs);
+    m_renderMs.add(static_cast<float>(renderSeconds * 1000.0));
+    m_simSteps.add(static_cast<float>(simulationSteps));
+
+    const bool hitch = m_hitchThresholdMs > 0.0F && frameMs > m_hitchThresholdMs;
+    m_windowHitches -= m_hitchFlags[m_hitchNext];
+    m_hitchFlags[m_hitchNext] = hitch ? 1 : 0;
+    m_windowHitches += m_hitchFlags[m_hitchNext];
+    m_hitchNext = (m_hitchNext + 1) % m_hitchFlags.size();
+    m_hitches += hitch ? 1 : 0;
+    if (m_frameMs.totalCount() % kThresholdRefreshFrames == 0) {
+        m_hitchThresholdMs = kHitchFactor * m_frameMs.percentile(0.5F);
+    }
+
+    m_uptimeSeconds += frameSeconds;
+    m_sinceLastPublish += frameSeconds;
+    if (m_active && m_sinceLastPublish >= m_intervalSeconds) {
+        m_sinceLastPublish = 0.0;
+        publish();
+    }
+}
+
+void Telemetry::recordWorkers(std::span<const WorkerStats> workers) {
+    m_workerCount = std::min(workers.size(), m_workerBusySeconds.size());
+    for (std::size_t i = 0; i < m_workerCount; ++i) {
+        m_workerBusySeconds[i] += workers[i].busySeconds;
+        m_workerWindowSeconds[i] += workers[i].windowSeconds;
+    }
+}
+
+TelemetrySnapshot Telemetry::snapshot() const {
+    const auto summarize = [](const RollingHistogram& histogram) {
+        MetricSummary summary;
+        summary.p50 = histogram.percentile(0.50F);
+        summary.p95 = histogram.percentile(0.95F);
+        summary.p99 = histogram.percentile(0.99F);
+        summary.mean = histogram.windowMean();
+        summary.max = histogram.windowMax();
+        summary.count = histogram.totalCount();
+        summary.sum = histogram.totalSum();
+        return summary;
+    };
+
+    TelemetrySnapshot result;
+    result.uptimeSeconds = m_uptimeSeconds;
+    result.windowFrames = m_frameMs.windowCount();
+    result.frameMs = summarize(m_frameMs);
+    result.renderMs = summarize(m_renderMs);
+    result.simSteps = summarize(m_simSteps);
+    result.hitches = m_hitches;
+    result.windowHitches = m_windowHitches;
+    result.hitchThresholdMs = m_hitchThresholdMs;
+    result.workerCount = m_workerCount;
+    for (std::size_t i = 0; i < m_workerCount; ++i) {
+        const double window = m_workerWindowSeconds[i];
+        result.workerUtilization[i] = window > 0.0 ? static_cast<float>(m_workerBusySeconds[i] / window) : 0.0F;
+    }
+    for (std::size_t i = 0; i < kMemoryTagCount; ++i) {
+        result.memory[i] = MemoryAccounting::usage(static_cast<MemoryTag>(i));
+    }
+    return result;
+}
+
+void Telemetry::publish() {
+    const TelemetrySnapshot current = snapshot();
+    m_workerBusySeconds.fill(0.0);
+    m_workerWindowSeconds.fill(0.0);
+    {
+        // A snapshot the writer has not picked up yet is simply replaced.
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending = current;
+        m_hasPending = true;
+    }
+    m_published.notify_one();
+}
+
+void Telemetry::writerLoop() {
+    for (;;) {
+        TelemetrySnapshot current;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_published.wait(lock, [this] { return m_hasPending || m_stopping; });
+            if (!m_hasPending) {
+                return;
+            }
+            current = m_pending;
+            m_hasPending = false;
+        }
+
+        const bool written = writeSnapshot(current);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_writeFailures += written ? 0 : 1;
+    }
+}
+
+bool Telemetry::writeSnapshot(const TelemetrySnapshot& snapshot) const {
+    std::string text;
+    if (m_format == TelemetryFormat::Json) {
+        text += "{\n";
+        appendf(text, "  \"uptime_seconds\": %.3f,\n", snapshot.uptimeSeconds);
+        appendf(text, "  \"window_frames\": %.0f,\n", static_cast<double>(snapshot.windowFrames));
+        appendf(text, "  \"hitches\": %.0f,\n", static_cast<double>(snapshot.hitches));
+        appendf(text, "  \"window_hitches\": %.0f,\n", static_cast<double>(snapshot.windowHitches));
+        appendf(text, "  \"hitch_threshold_ms\": %.3f,\n", snapshot.hitchThresholdMs);
+        text += "  \"worker_utilization\": [";
+        for (std::size_t i = 0; i < snapshot.workerCount; ++i) {
+            appendf(text, i == 0 ? "%.3f" : ", %.3f", snapshot.workerUtilization[i]);
+        }
+        text += "],\n";
+        text += "  \"memory\": {\n";
+        for (std::size_t i = 0; i < kMemoryTagCount; ++i) {
+            const MemoryUsage& usage = snapshot.memory[i];
+            text += "    \"";
+            text += MemoryAccounting::tagName(static_cast<MemoryTag>(i));
+            appendf(text, "\": {\"cpu_bytes\": %.0f, ", static_cast<double>(usage.cpuBytes));
+            appendf(text, "\"gpu_bytes\": %.0f, ", static_cast<double>(usage.gpuBytes));
+            appendf(text, "\"budget_bytes\": %.0f}", static_cast<double>(usage.budgetBytes));
+            text += i + 1 < kMemoryTagCount ? ",\n" : "\n";
+        }
+        text += "  },\n";
+        text += "  \"metrics\": {\n";
+        appendJsonMetric(text, "frame_ms", snapshot.frameMs, false);
+        appendJsonMetric(text, "render_ms", snapshot.renderMs, false);
+        appendJsonMetric(text, "sim_steps", snapshot.simSteps, true);
+        text += "  }\n}\n";
+    } else {
+        appendPrometheusMetric(text, "engine_frame_time_ms", "Frame time over the rolling window.", snapshot.frameMs);
+        appendPrometheusMetric(text, "engine_render_time_ms", "CPU time spent in Renderer::render.", snapshot.renderMs);
+        appendPrometheusMetric(text, "engine_sim_steps", "Fixed simulation steps run per frame.", snapshot.simSteps);
+        text += "# HELP engine_hitches_total Frames longer than twice the rolling median.\n";
+        text += "# TYPE engine_hitches_total counter\n";
+        appendf(text, "engine_hitches_total %.0f\n", static_cast<double>(snapshot.hitches));
+        text += "# HELP engine_memory_bytes Live memory per subsystem; GPU bytes are estimates.\n";
+        text += "# TYPE engine_memory_bytes gauge\n";
+        for (std::size_t i = 0; i < kMemoryTagCount; ++i) {
+            const std::string tag(MemoryAccounting::tagName(static_cast<MemoryTag>(i)));
+            text += "engine_memory_bytes{tag=\"" + tag + "\",kind=\"cpu\"}";
+            appendf(text, " %.0f\n", static_cast<double>(snapshot.memory[i].cpuBytes));
+            text += "engine_memory_bytes{tag=\"" + tag + "\",kind=\"gpu\"}";
+            appendf(text, " %.0f\n", static_cast<double>(snapshot.memory[i].gpuBytes));
+        }
+        text += "# TYPE engine_uptime_seconds gauge\n";
+        appendf(text, "engine_uptime_seconds %.3f\n", snapshot.uptimeSeconds);
+        if (snapshot.workerCount > 0) {
+            text += "# HELP engine_worker_utilization Share of the interval a thread spent running jobs.\n";
+            text += "# TYPE engine_worker_utilization gauge\n";
+            appendf(text, "engine_worker_utilization{worker=\"main\"} %.3f\n", snapshot.workerUtilization[0]);
+            for (std::size_t i = 1; i < snapshot.workerCount; ++i) {
+                text += "engine_worker_utilization{worker=\"" + std::to_string(i - 1) + "\"}";
+                appendf(text, " %.3f\n", snapshot.workerUtilization[i]);
+            }
+        }
+    }
+
+    // Replaced atomically so a scraper never reads a half-written file.
+    std::filesystem::path temporary = m_outputPath;
+    temporary += ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        file << text;
+        if (!file) {
+            return false;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, m_outputPath, error);
+    return !error;
+}
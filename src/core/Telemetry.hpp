@@ -0,0 +1,145 @@
+#pragma once
+
+#include "core/JobSystem.hpp"
+#include "core/MemoryAccounting.hpp"
+
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <span>
+#include <thread>
+
+// Histogram over the last kWindow samples. Buckets are fixed at construction,
+// so adding a sample is a bucket search plus two counter updates.
+class RollingHistogram {
+public:
+    static constexpr std::size_t kWindow = 600;
+    static constexpr std::size_t kBucketCount = 96;
+
+    // Bucket upper bounds start at firstUpper and then grow by `step`: added
+    // for linear buckets, multiplied for geometric ones. The last bucket also
+    // takes everything above its bound.
+    RollingHistogram(float firstUpper, float step, bool geometric);
+
+    void add(float value);
+    // Value below which `fraction` of the window lies, reported as the middle
+    // of its bucket (the window maximum for the overflow bucket). 0 with an
+    // empty window.
+    float percentile(float fraction) const;
+    float windowMean() const;
+    float windowMax() const;
+    std::size_t windowCount() const;
+    // Since construction, not just the window.
+    std::uint64_t totalCount() const;
+    double totalSum() const;
+
+private:
+    std::size_t bucketFor(float value) const;
+
+    float m_step;
+    bool m_geometric;
+    std::array<float, kBucketCount> m_upperBounds{};
+    std::array<std::uint32_t, kBucketCount> m_counts{};
+    std::array<float, kWindow> m_samples{};
+    std::size_t m_next = 0;
+    std::size_t m_windowCount = 0;
+    double m_windowSum = 0.0;
+    std::uint64_t m_totalCount = 0;
+    double m_totalSum = 0.0;
+};
+
+enum class TelemetryFormat {
+    Json,
+    Prometheus,
+};
+
+struct MetricSummary {
+    float p50 = 0.0F;
+    float p95 = 0.0F;
+    float p99 = 0.0F;
+    float mean = 0.0F;
+    float max = 0.0F;
+    std::uint64_t count = 0;
+    double sum = 0.0;
+};
+
+struct TelemetrySnapshot {
+    double uptimeSeconds = 0.0;
+    // Frames the window percentiles cover; below kWindow until it fills.
+    std::size_t windowFrames = 0;
+    MetricSummary frameMs;
+    MetricSummary renderMs;
+    MetricSummary simSteps;
+    std::uint64_t hitches = 0;
+    std::uint64_t windowHitches = 0;
+    float hitchThresholdMs = 0.0F;
+    // Share of the publish interval each thread spent running jobs; entry 0
+    // is the main thread, then the job workers.
+    std::array<float, JobSystem::kMaxWorkers + 1> workerUtilization{};
+    std::size_t workerCount = 0;
+    // Live memory per MemoryTag when the snapshot was taken.
+    std::array<MemoryUsage, kMemoryTagCount> memory{};
+};
+
+// Rolling frame time, render time and simulation step histograms with hitch
+// counting. recordFrame() never allocates or blocks: once per interval it
+// summarises the window into a snapshot and hands it to a writer thread,
+// which formats it and replaces the output file.
+class Telemetry {
+public:
+    Telemetry();
+    ~Telemetry();
+
+    Telemetry(const Telemetry&) = delete;
+    Telemetry& operator=(const Telemetry&) = delete;
+
+    bool start(const std::filesystem::path& outputPath, TelemetryFormat format, double intervalSeconds);
+    // Writes a final snapshot and joins the writer.
+    void stop();
+    bool active() const;
+
+    void recordFrame(double frameSeconds, int simulationSteps, double renderSeconds);
+    // Takes JobSystem::collectStats output; summed until the next publish.
+    void recordWorkers(std::span<const WorkerStats> workers);
+    TelemetrySnapshot snapshot() const;
+
+private:
+    // A frame is a hitch when it takes this many times the rolling median.
+    static constexpr float kHitchFactor = 2.0F;
+    // The median behind the hitch threshold is refreshed this often.
+    static constexpr std::uint64_t kThresholdRefreshFrames = 60;
+
+    void publish();
+    void writerLoop();
+    bool writeSnapshot(const TelemetrySnapshot& snapshot) const;
+
+    RollingHistogram m_frameMs;
+    RollingHistogram m_renderMs;
+    RollingHistogram m_simSteps;
+    std::array<std::uint8_t, RollingHistogram::kWindow> m_hitchFlags{};
+    std::size_t m_hitchNext = 0;
+    std::uint64_t m_hitches = 0;
+    std::uint64_t m_windowHitches = 0;
+    float m_hitchThresholdMs = 0.0F;
+    double m_uptimeSeconds = 0.0;
+    double m_sinceLastPublish = 0.0;
+    std::array<double, JobSystem::kMaxWorkers + 1> m_workerBusySeconds{};
+    std::array<double, JobSystem::kMaxWorkers + 1> m_workerWindowSeconds{};
+    std::size_t m_workerCount = 0;
+
+    std::filesystem::path m_outputPath;
+    TelemetryFormat m_format = TelemetryFormat::Json;
+    double m_intervalSeconds = 1.0;
+    bool m_active = false;
+
+    std::mutex m_mutex;
+    std::condition_variable m_published;
+    TelemetrySnapshot m_pending;
+    bool m_hasPending = false;
+    bool m_stopping = false;
+    std::uint64_t m_writeFailures = 0;
+    std::thread m_writer;
+};
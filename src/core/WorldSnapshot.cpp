@@ -0,0 +1,206 @@
+#include "core/WorldSnapshot.hpp"
+
+#include "core/MemoryAccounting.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <system_error>
+#include <vector>
+
+namespace {
+
+constexpr std::uint32_t kSnapshotMagic = 0x504E5357U; // "WSNP"
+// Bump when the meaning of the saved data changes; a WorldState layout
+// change is caught by the stored size.
+constexpr std::uint32_t kSnapshotVersion = 2;
+
+struct SnapshotHeader {
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint32_t stateSize;
+    std::int32_t mapWidth;
+    std::int32_t mapHeight;
+    std::uint32_t townsfolkCount;
+    std::uint32_t walkerSize;
+    // Either 0 or townsfolkCount.
+    std::uint32_t lodTierCount;
+    std::uint64_t townsfolkStep;
+};
+
+std::uintmax_t townsfolkBytes(std::uintmax_t count, std::uintmax_t lodTierCount) {
+    return count * (sizeof(float) * 2 + sizeof(TownsfolkWalker)) + lodTierCount;
+}
+
+template <typename T>
+void writeArray(std::ofstream& file, const std::vector<T>& values) {
+    file.write(reinterpret_cast<const char*>(values.data()), static_cast<std::streamsize>(values.size() * sizeof(T)));
+}
+
+template <typename T>
+void readArray(std::ifstream& file, std::vector<T>& values, std::size_t count) {
+    values.resize(count);
+    file.read(reinterpret_cast<char*>(values.data()), static_cast<std::streamsize>(count * sizeof(T)));
+}
+
+} // namespace
+
+SnapshotStore::~SnapshotStore() {
+    if (m_writer.joinable()) {
+        m_writer.join();
+        finishSave();
+    }
+}
+
+bool SnapshotStore::save(const std::filesystem::path& path, const WorldState& state, const Map& map, const Townsfolk& townsfolk) {
+    poll();
+    if (m_writer.joinable()) {
+        return false;
+    }
+
+    const MemoryTagScope memoryTag(MemoryTag::Saves);
+    m_savePath = path;
+    m_saveState = state;
+    m_saveTiles = map.shareTiles();
+    townsfolk.copyState(m_saveTownsfolk);
+    m_written.store(false);
+    m_writer = std::thread([this] {
+        const MemoryTagScope writerTag(MemoryTag::Saves);
+        m_writeSucceeded = writeFile(m_savePath, m_saveState, m_saveTiles, m_saveTownsfolk);
+        m_written.store(true, std::memory_order_release);
+    });
+    return true;
+}
+
+void SnapshotStore::poll() {
+    if (m_writer.joinable() && m_written.load(std::memory_order_acquire)) {
+        m_writer.join();
+        finishSave();
+    }
+}
+
+bool SnapshotStore::saving() const {
+    return m_writer.joinable();
+}
+
+void SnapshotStore::finishSave() {
+    // Dropped here rather than on the writer so the map sees the bands'
+    // reference counts fall on its own thread.
+    m_saveTiles = MapTiles{};
+    if (!m_writeSucceeded) {
+        std::cerr << "Failed to write snapshot " << m_savePath.string() << '\n';
+    }
+}
+
+bool SnapshotStore::load(const std::filesystem::path& path, WorldState& outState, Map& map, Townsfolk& townsfolk) {
+    if (m_writer.joinable()) {
+        m_writer.join();
+        finishSave();
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "No snapshot at " << path.string() << '\n';
+        return false;
+    }
+
+    SnapshotHeader header{};
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!file || header.magic != kSnapshotMagic || header.version != kSnapshotVersion ||
+        header.stateSize != sizeof(WorldState) || header.mapWidth <= 0 || header.mapHeight <= 0 ||
+        header.walkerSize != sizeof(TownsfolkWalker) ||
+        (header.lodTierCount != 0 && header.lodTierCount != header.townsfolkCount)) {
+        std::cerr << "Snapshot " << path.string() << " is not a compatible snapshot.\n";
+        return false;
+    }
+
+    const std::uintmax_t tileCount = static_cast<std::uintmax_t>(header.mapWidth) * static_cast<std::uintmax_t>(header.mapHeight);
+    std::error_code error;
+    const std::uintmax_t expectedSize = sizeof(SnapshotHeader) + sizeof(WorldState) + tileCount +
+        townsfolkBytes(header.townsfolkCount, header.lodTierCount);
+    if (std::filesystem::file_size(path, error) != expectedSize || error) {
+        std::cerr << "Snapshot " << path.string() << " is truncated.\n";
+        return false;
+    }
+
+    const MemoryTagScope memoryTag(MemoryTag::Saves);
+    WorldState state{};
+    std::vector<char> tiles(static_cast<std::size_t>(tileCount));
+    file.read(reinterpret_cast<char*>(&state), sizeof(state));
+    file.read(tiles.data(), static_cast<std::streamsize>(tiles.size()));
+    TownsfolkState townsfolkState;
+    townsfolkState.step = header.townsfolkStep;
+    readArray(file, townsfolkState.x, header.townsfolkCount);
+    readArray(file, townsfolkState.y, header.townsfolkCount);
+    readArray(file, townsfolkState.walkers, header.townsfolkCount);
+    readArray(file, townsfolkState.lodTiers, header.lodTierCount);
+    if (!file) {
+        std::cerr << "Failed to read snapshot " << path.string() << '\n';
+        return false;
+    }
+    // The restored tiles belong to the map from here on.
+    {
+        const MemoryTagScope mapTag(MemoryTag::Map);
+        if (!map.assignTiles(header.mapWidth, header.mapHeight, tiles)) {
+            std::cerr << "Failed to read snapshot " << path.string() << '\n';
+            return false;
+        }
+    }
+    {
+        const MemoryTagScope simulationTag(MemoryTag::Simulation);
+        townsfolk.restoreState(townsfolkState);
+    }
+    outState = state;
+    return true;
+}
+
+bool SnapshotStore::writeFile(
+    const std::filesystem::path& path,
+    const WorldState& state,
+    const MapTiles& tiles,
+    const TownsfolkState& townsfolk) {
+    std::error_code error;
+    if (path.has_parent_path()) {
+        std::filesystem::create_directories(path.parent_path(), error);
+    }
+
+    // Written beside the target and renamed over it, so a crash mid-save
+    // leaves the previous snapshot intact.
+    std::filesystem::path temporary = path;
+    temporary += ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            return false;
+        }
+
+        const SnapshotHeader header{
+            kSnapshotMagic,
+            kSnapshotVersion,
+            sizeof(WorldState),
+            tiles.width,
+            tiles.height,
+            static_cast<std::uint32_t>(townsfolk.walkers.size()),
+            sizeof(TownsfolkWalker),
+            static_cast<std::uint32_t>(townsfolk.lodTiers.size()),
+            townsfolk.step};
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(&state), sizeof(state));
+        // A band is its rows back to back, so each goes out in one write.
+        for (int y = 0; y < tiles.height; y += MapTiles::kBandRows) {
+            const int rows = std::min(MapTiles::kBandRows, tiles.height - y);
+            file.write(tiles.row(y), static_cast<std::streamsize>(rows) * tiles.width);
+        }
+        writeArray(file, townsfolk.x);
+        writeArray(file, townsfolk.y);
+        writeArray(file, townsfolk.walkers);
+        writeArray(file, townsfolk.lodTiers);
+        if (!file) {
+            return false;
+        }
+    }
+
+    std::filesystem::rename(temporary, path, error);
+    return !error;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "game/Map.hpp"
+#include "game/Player.hpp"
+#include "game/Townsfolk.hpp"
+#include "render/Light.hpp"
+
+#include <atomic>
+#include <filesystem>
+#include <thread>
+
+// The world state Application::run keeps outside the map. Plain data, so a
+// snapshot stores and restores it with one copy.
+struct WorldState {
+    PlayerState player;
+    float cameraX;
+    float cameraY;
+    float worldTime;
+    Light playerLight;
+};
+
+// Versioned binary world snapshots: a header, the WorldState bytes, the map
+// tiles row by row, then the townsfolk as bulk arrays (x, y, walkers and LOD
+// tiers). Saving shares the map's tiles copy-on-write and writes
+// them on a background thread, so the frame that saves only copies pointers.
+// Loading reads the file in a few bulk reads and hands the tiles to
+// Map::assignTiles, which re-derives only what changed.
+class SnapshotStore {
+public:
+    SnapshotStore() = default;
+    ~SnapshotStore();
+
+    SnapshotStore(const SnapshotStore&) = delete;
+    SnapshotStore& operator=(const SnapshotStore&) = delete;
+
+    // Starts writing a snapshot to `path`. Returns false, queueing nothing,
+    // while the previous save is still being written.
+    bool save(const std::filesystem::path& path, const WorldState& state, const Map& map, const Townsfolk& townsfolk);
+    // Call once per frame on the thread that edits the map: finishes a
+    // completed save, releasing its tiles and reporting failures.
+    void poll();
+    bool saving() const;
+    // Blocks until any pending save is written, then restores from `path`.
+    // Leaves the state, the map and the townsfolk untouched on failure.
+    bool load(const std::filesystem::path& path, WorldState& outState, Map& map, Townsfolk& townsfolk);
+
+private:
+    static bool writeFile(
+        const std::filesystem::path& path,
+        const WorldState& state,
+        const MapTiles& tiles,
+        const TownsfolkState& townsfolk);
+    void finishSave();
+
+    std::thread m_writer;
+    std::atomic<bool> m_written{false};
+    bool m_writeSucceeded = false;
+    std::filesystem::path m_savePath;
+    WorldState m_saveState{};
+    MapTiles m_saveTiles;
+    // Copied on the saving frame; keeps its buffers between saves.
+    TownsfolkState m_saveTownsfolk;
+};
@@ -0,0 +1,23 @@
+#include "game/Camera.hpp"
+
+#include <cmath>
+
+void Camera::snapTo(float x, float y) {
+    m_x = x;
+    m_y = y;
+}
+
+void Camera::follow(float targetX, float targetY, float dtSeconds) {
+    // Frame-rate independent exponential approach.
+    const float blend = 1.0F - std::exp(-m_followRate * dtSeconds);
+    m_x += (targetX - m_x) * blend;
+    m_y += (targetY - m_y) * blend;
+}
+
+float Camera::x() const {
+    return m_x;
+}
+
+float Camera::y() const {
+    return m_y;
+}
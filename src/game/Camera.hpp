@@ -0,0 +1,17 @@
+#pragma once
+
+// Tile-space point the view is centred on. follow() eases toward the target
+// so the view trails the player slightly instead of locking to every step.
+class Camera {
+public:
+    void snapTo(float x, float y);
+    void follow(float targetX, float targetY, float dtSeconds);
+
+    float x() const;
+    float y() const;
+
+private:
+    float m_x = 0.0F;
+    float m_y = 0.0F;
+    float m_followRate = 8.0F;
+};
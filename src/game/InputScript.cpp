@@ -0,0 +1,153 @@
+#include "game/InputScript.hpp"
+
+#include <array>
+#include <charconv>
+#include <utility>
+
+namespace {
+// Wandering holds each choice for a quarter second to two seconds of steps.
+constexpr std::uint32_t kMinWanderSteps = 15;
+constexpr std::uint32_t kMaxWanderSteps = 120;
+// One choice in this many is to stand still.
+constexpr std::uint32_t kIdleOdds = 5;
+
+// The eight directions, as up, down, left, right.
+constexpr std::array<InputState, 8> kDirections{{
+    {true, false, false, false},
+    {true, false, false, true},
+    {false, false, false, true},
+    {false, true, false, true},
+    {false, true, false, false},
+    {false, true, true, false},
+    {false, false, true, false},
+    {true, false, true, false},
+}};
+
+std::uint32_t nextRandom(std::uint32_t& state) {
+    state ^= state << 13U;
+    state ^= state >> 17U;
+    state ^= state << 5U;
+    return state;
+}
+
+std::string_view trim(std::string_view text) {
+    const std::size_t first = text.find_first_not_of(" \t\r");
+    if (first == std::string_view::npos) {
+        return {};
+    }
+    return text.substr(first, text.find_last_not_of(" \t\r") - first + 1);
+}
+
+bool parseKeys(std::string_view keys, InputState& outInput) {
+    outInput = InputState{};
+    if (keys == "-") {
+        return true;
+    }
+    for (const char key : keys) {
+        bool* held = nullptr;
+        switch (key) {
+        case 'u':
+            held = &outInput.up;
+            break;
+        case 'd':
+            held = &outInput.down;
+            break;
+        case 'l':
+            held = &outInput.left;
+            break;
+        case 'r':
+            held = &outInput.right;
+            break;
+        default:
+            return false;
+        }
+        if (*held) {
+            return false;
+        }
+        *held = true;
+    }
+    return !keys.empty();
+}
+} // namespace
+
+bool InputScript::parseRecording(std::string_view text, std::vector<InputSpan>& outSpans) {
+    std::vector<InputSpan> spans;
+    while (!text.empty()) {
+        const std::size_t newline = text.find('\n');
+        const std::string_view line = trim(text.substr(0, newline));
+        text = newline == std::string_view::npos ? std::string_view{} : text.substr(newline + 1);
+        if (line.empty() || line.front() == '#') {
+            continue;
+        }
+
+        const std::size_t space = line.find_first_of(" \t");
+        if (space == std::string_view::npos) {
+            return false;
+        }
+        InputSpan span{};
+        const std::string_view count = line.substr(0, space);
+        const auto result = std::from_chars(count.data(), count.data() + count.size(), span.steps);
+        if (result.ec != std::errc{} || result.ptr != count.data() + count.size() || span.steps == 0 ||
+            !parseKeys(trim(line.substr(space)), span.input)) {
+            return false;
+        }
+        spans.push_back(span);
+    }
+    if (spans.empty()) {
+        return false;
+    }
+    outSpans = std::move(spans);
+    return true;
+}
+
+void InputScript::wander(std::uint32_t seed) {
+    m_recording = {};
+    // Spread the seed so neighbouring seeds do not start out alike; xorshift
+    // needs a non-zero state.
+    m_rng = seed * 0x9E3779B9U;
+    m_rng ^= m_rng >> 16U;
+    if (m_rng == 0) {
+        m_rng = 0x6D2B79F5U;
+    }
+    m_stepsLeft = 0;
+}
+
+void InputScript::replay(std::span<const InputSpan> recording, std::uint64_t offsetSteps) {
+    m_recording = recording;
+    m_span = 0;
+    m_stepsLeft = 0;
+    std::uint64_t length = 0;
+    for (const InputSpan& span : recording) {
+        length += span.steps;
+    }
+    if (length == 0) {
+        return;
+    }
+    offsetSteps %= length;
+    while (offsetSteps >= recording[m_span].steps) {
+        offsetSteps -= recording[m_span].steps;
+        ++m_span;
+    }
+    m_input = recording[m_span].input;
+    m_stepsLeft = recording[m_span].steps - static_cast<std::uint32_t>(offsetSteps);
+}
+
+InputState InputScript::next() {
+    if (m_stepsLeft == 0) {
+        if (m_recording.empty()) {
+            pickWander();
+        } else {
+            m_span = (m_span + 1) % m_recording.size();
+            m_input = m_recording[m_span].input;
+            m_stepsLeft = m_recording[m_span].steps;
+        }
+    }
+    --m_stepsLeft;
+    return m_input;
+}
+
+void InputScript::pickWander() {
+    const std::uint32_t choice = nextRandom(m_rng);
+    m_input = choice % kIdleOdds == 0 ? InputState{} : kDirections[(choice >> 8U) % kDirections.size()];
+    m_stepsLeft = kMinWanderSteps + nextRandom(m_rng) % (kMaxWanderSteps - kMinWanderSteps + 1);
+}
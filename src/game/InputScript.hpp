@@ -0,0 +1,44 @@
+#pragma once
+
+#include "game/Player.hpp"
+
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+// One input held for a number of fixed steps.
+struct InputSpan {
+    InputState input;
+    std::uint32_t steps;
+};
+
+// Input for a world without a keyboard, one InputState per fixed step.
+// Wandering scripts hold a random direction (or stand still) for a random
+// stretch, from their own random stream. Replays loop over a recording; the
+// recording is not copied and must outlive the script.
+class InputScript {
+public:
+    // A recording is one span per line, "<steps> <keys>", where keys is any
+    // of u, d, l and r held together, or "-" for none. Blank lines and lines
+    // starting with '#' are skipped. Returns false, leaving outSpans alone,
+    // when a line is malformed or the recording is empty.
+    static bool parseRecording(std::string_view text, std::vector<InputSpan>& outSpans);
+
+    void wander(std::uint32_t seed);
+    // Starts `offsetSteps` into the recording, so worlds replaying the same
+    // recording need not move in lockstep.
+    void replay(std::span<const InputSpan> recording, std::uint64_t offsetSteps);
+
+    // The input for the next step.
+    InputState next();
+
+private:
+    void pickWander();
+
+    std::span<const InputSpan> m_recording;
+    std::size_t m_span = 0;
+    InputState m_input{};
+    std::uint32_t m_stepsLeft = 0;
+    std::uint32_t m_rng = 1;
+};
@@ -1,6 +1,13 @@
 #include "game/Map.hpp"
 
+#include <atomic>
+#include <cstring>
 #include <fstream>
+#include <sstream>
+
+namespace {
+std::atomic<std::uint64_t> g_nextRevision{1};
+}
 
 bool Map::loadFromAsciiFile(const std::string& path) {
     std::ifstream file(path);
@@ -8,33 +15,227 @@ bool Map::loadFromAsciiFile(const std::string& path) {
         return false;
     }
 
-    m_rows.clear();
-    std::string line;
-    while (std::getline(file, line)) {
+    std::stringstream stream;
+    stream << file.rdbuf();
+    return loadFromAscii(stream.str());
+}
+
+bool Map::loadFromAscii(std::string_view text) {
+    std::vector<std::string_view> lines;
+    std::size_t longest = 0;
+    while (!text.empty()) {
+        const std::size_t end = text.find('\n');
+        std::string_view line = text.substr(0, end);
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
         if (!line.empty()) {
-            m_rows.push_back(line);
+            lines.push_back(line);
+            longest = std::max(longest, line.size());
+        }
+        if (end == std::string_view::npos) {
+            break;
         }
+        text.remove_prefix(end + 1);
+    }
+
+    // Short rows are padded with wall, which is what reads past them return.
+    allocateBands(static_cast<int>(longest), static_cast<int>(lines.size()));
+    for (int y = 0; y < m_height; ++y) {
+        const std::string_view line = lines[static_cast<std::size_t>(y)];
+        char* row = writableRow(y);
+        std::copy(line.begin(), line.end(), row);
+        std::fill(row + line.size(), row + m_width, kWallTile);
     }
-    return !m_rows.empty();
+    m_revision = g_nextRevision.fetch_add(1);
+    m_changeCount = 0;
+    m_changeLogBase = m_revision;
+    buildOccupancy();
+    return m_height > 0;
+}
+
+void Map::allocateBands(int width, int height) {
+    m_width = width;
+    m_height = height;
+    m_bands.clear();
+    for (int y = 0; y < height; y += MapTiles::kBandRows) {
+        const int rows = std::min(MapTiles::kBandRows, height - y);
+        m_bands.push_back(std::make_shared<char[]>(static_cast<std::size_t>(rows) * static_cast<std::size_t>(width)));
+    }
+}
+
+char* Map::writableRow(int y) {
+    std::shared_ptr<char[]>& band = m_bands[static_cast<std::size_t>(y / MapTiles::kBandRows)];
+    if (band.use_count() > 1) {
+        const int first = y - y % MapTiles::kBandRows;
+        const std::size_t size = static_cast<std::size_t>(std::min(MapTiles::kBandRows, m_height - first)) * static_cast<std::size_t>(m_width);
+        std::shared_ptr<char[]> copy = std::make_shared<char[]>(size);
+        std::memcpy(copy.get(), band.get(), size);
+        band = std::move(copy);
+    }
+    return band.get() + static_cast<std::ptrdiff_t>(y % MapTiles::kBandRows) * m_width;
 }
 
 bool Map::isBlocked(int x, int y) const {
-    if (y < 0 || x < 0 || y >= static_cast<int>(m_rows.size())) {
+    const char tile = tileAt(x, y);
+    return tile == kWallTile || tile == kClosedDoorTile;
+}
+
+char Map::tileAt(int x, int y) const {
+    if (x < 0 || y < 0 || x >= m_width || y >= m_height) {
+        return kWallTile;
+    }
+    return m_bands[static_cast<std::size_t>(y / MapTiles::kBandRows)][static_cast<std::ptrdiff_t>(y % MapTiles::kBandRows) * m_width + x];
+}
+
+bool Map::setTile(int x, int y, char tile) {
+    if (x < 0 || y < 0 || x >= m_width || y >= m_height) {
+        return false;
+    }
+    if (tileAt(x, y) == tile) {
+        return true;
+    }
+
+    writableRow(y)[x] = tile;
+    updateOccupancy(x, y);
+    logChange(TileRect{x, y, 1, 1});
+    return true;
+}
+
+bool Map::toggleDoor(int x, int y) {
+    const char tile = tileAt(x, y);
+    if (tile == kClosedDoorTile) {
+        return setTile(x, y, kOpenDoorTile);
+    }
+    if (tile == kOpenDoorTile) {
+        return setTile(x, y, kClosedDoorTile);
+    }
+    return false;
+}
+
+MapTiles Map::shareTiles() const {
+    MapTiles tiles;
+    tiles.width = m_width;
+    tiles.height = m_height;
+    tiles.bands.assign(m_bands.begin(), m_bands.end());
+    return tiles;
+}
+
+bool Map::assignTiles(int width, int height, std::span<const char> tiles) {
+    if (width <= 0 || height <= 0 || tiles.size() != static_cast<std::size_t>(width) * static_cast<std::size_t>(height)) {
+        return false;
+    }
+
+    if (width != m_width || height != m_height) {
+        allocateBands(width, height);
+        for (int y = 0; y < height; ++y) {
+            std::memcpy(writableRow(y), tiles.data() + static_cast<std::ptrdiff_t>(y) * width, static_cast<std::size_t>(width));
+        }
+        m_revision = g_nextRevision.fetch_add(1);
+        m_changeCount = 0;
+        m_changeLogBase = m_revision;
+        buildOccupancy();
         return true;
     }
-    if (x >= static_cast<int>(m_rows[y].size())) {
+
+    // Whole rows are compared and copied; columns are only scanned on rows
+    // that differ, to bound the logged region.
+    TileRect changed;
+    for (int y = 0; y < height; ++y) {
+        const char* source = tiles.data() + static_cast<std::ptrdiff_t>(y) * width;
+        const char* current = m_bands[static_cast<std::size_t>(y / MapTiles::kBandRows)].get() +
+            static_cast<std::ptrdiff_t>(y % MapTiles::kBandRows) * width;
+        if (std::memcmp(source, current, static_cast<std::size_t>(width)) == 0) {
+            continue;
+        }
+        int first = 0;
+        while (source[first] == current[first]) {
+            ++first;
+        }
+        int last = width - 1;
+        while (source[last] == current[last]) {
+            --last;
+        }
+        changed = changed.united(TileRect{first, y, last - first + 1, 1});
+        std::memcpy(writableRow(y), source, static_cast<std::size_t>(width));
+    }
+    if (changed.empty()) {
         return true;
     }
-    return m_rows[y][x] == '#';
+
+    // Per-tile pyramid updates cost O(levels) each; past a quarter of the
+    // map a full rebuild is cheaper.
+    if (static_cast<std::int64_t>(changed.width) * changed.height * 4 > static_cast<std::int64_t>(width) * height) {
+        buildOccupancy();
+    } else {
+        for (int y = changed.y; y < changed.y + changed.height; ++y) {
+            for (int x = changed.x; x < changed.x + changed.width; ++x) {
+                updateOccupancy(x, y);
+            }
+        }
+    }
+    logChange(changed);
+    return true;
 }
 
-int Map::width() const {
-    if (m_rows.empty()) {
-        return 0;
+void Map::logChange(const TileRect& region) {
+    m_revision = g_nextRevision.fetch_add(1);
+    if (m_changeCount >= kChangeLogSize) {
+        m_changeLogBase = m_changeLog[m_changeCount % kChangeLogSize].revision;
     }
-    return static_cast<int>(m_rows.front().size());
+    m_changeLog[m_changeCount % kChangeLogSize] = Change{m_revision, region};
+    ++m_changeCount;
+}
+
+int Map::width() const {
+    return m_width;
 }
 
 int Map::height() const {
-    return static_cast<int>(m_rows.size());
+    return m_height;
+}
+
+std::uint64_t Map::revision() const {
+    return m_revision;
+}
+
+bool Map::dirtyRegionSince(std::uint64_t revision, TileRect& outRegion) const {
+    outRegion = TileRect{};
+    if (revision == m_revision) {
+        return true;
+    }
+
+    // Revisions come from a global counter, so matching an exact logged value
+    // also rejects revisions of other maps.
+    const std::size_t logged = std::min(m_changeCount, kChangeLogSize);
+    bool known = revision == m_changeLogBase;
+    for (std::size_t i = 0; i < logged; ++i) {
+        const Change& change = m_changeLog[(m_changeCount - 1 - i) % kChangeLogSize];
+        if (change.revision == revision) {
+            known = true;
+            break;
+        }
+        outRegion = outRegion.united(change.region);
+    }
+    if (!known) {
+        outRegion = TileRect{};
+    }
+    return known;
+}
+
+std::uint64_t Map::contentHash() const {
+    // 64-bit FNV-1a.
+    std::uint64_t hash = 14695981039346656037ULL;
+    const auto mix = [&hash](std::uint64_t value) {
+        hash ^= value;
+        hash *= 1099511628211ULL;
+    };
+    mix(static_cast<std::uint64_t>(width()));
+    mix(static_cast<std::uint64_t>(height()));
+    for (int y = 0; y < height(); ++y) {
+        for (int x = 0; x < width(); ++x) {
+            mix(isBlocked(x, y) ? 1U : 0U);
+        }
+    }
+    return hash;
 }
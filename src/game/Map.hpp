@@ -1,15 +1,175 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 
+// A segment in tile coordinates; tile (x, y) covers [x, x + 1) x [y, y + 1).
+struct Ray {
+    float fromX;
+    float fromY;
+    float toX;
+    float toY;
+};
+
+struct RayHit {
+    bool hit;
+    // First blocked cell the segment enters, not counting the one it starts in.
+    int cellX;
+    int cellY;
+    // Fraction of the segment travelled before entering that cell.
+    float t;
+    // Outward normal of the face that was crossed (diagonal on exact corners).
+    float normalX;
+    float normalY;
+};
+
+// Tiles [x, x + width) x [y, y + height).
+struct TileRect {
+    int x = 0;
+    int y = 0;
+    int width = 0;
+    int height = 0;
+
+    bool empty() const {
+        return width <= 0 || height <= 0;
+    }
+
+    bool intersects(const TileRect& other) const {
+        return !empty() && !other.empty() && x < other.x + other.width && other.x < x + width &&
+            y < other.y + other.height && other.y < y + height;
+    }
+
+    TileRect united(const TileRect& other) const {
+        if (empty()) {
+            return other;
+        }
+        if (other.empty()) {
+            return *this;
+        }
+        const int left = std::min(x, other.x);
+        const int top = std::min(y, other.y);
+        const int right = std::max(x + width, other.x + other.width);
+        const int bottom = std::max(y + height, other.y + other.height);
+        return {left, top, right - left, bottom - top};
+    }
+
+    TileRect expanded(int margin) const {
+        return {x - margin, y - margin, width + margin * 2, height + margin * 2};
+    }
+};
+
+// Read-only tiles shared with the Map they came from. The map copies a band
+// before editing it while a view still holds it, so a view never changes and
+// can be read from another thread. Release views on the thread that edits
+// the map: the map decides whether to copy from the band's reference count.
+struct MapTiles {
+    static constexpr int kBandRows = 64;
+
+    int width = 0;
+    int height = 0;
+    std::vector<std::shared_ptr<const char[]>> bands;
+
+    const char* row(int y) const {
+        return bands[static_cast<std::size_t>(y / kBandRows)].get() + static_cast<std::ptrdiff_t>(y % kBandRows) * width;
+    }
+};
+
+struct SweepResult {
+    float x;
+    float y;
+    bool collided;
+};
+
 class Map {
 public:
+    static constexpr char kFloorTile = '.';
+    static constexpr char kWallTile = '#';
+    static constexpr char kClosedDoorTile = '+';
+    static constexpr char kOpenDoorTile = '/';
+
     bool loadFromAsciiFile(const std::string& path);
+    bool loadFromAscii(std::string_view text);
     bool isBlocked(int x, int y) const;
+    // Tile character; cells outside the map read as wall.
+    char tileAt(int x, int y) const;
     int width() const;
     int height() const;
 
+    // Replaces one tile. Returns false outside the map; setting the tile it
+    // already holds is a no-op that keeps the revision.
+    bool setTile(int x, int y, char tile);
+    // Opens a closed door or closes an open one.
+    bool toggleDoor(int x, int y);
+
+    // Shares the current tiles without copying them.
+    MapTiles shareTiles() const;
+    // Replaces every tile from `tiles` (row-major, width * height). At the
+    // current size the tiles that differ are logged as one edit, so derived
+    // data updates just that area; a new size starts over like a fresh load.
+    bool assignTiles(int width, int height, std::span<const char> tiles);
+
+    // Changes whenever the tile contents change; derived caches compare it to
+    // decide when to rebuild. Unique across Map instances.
+    std::uint64_t revision() const;
+    // Every edit is logged with the revision it produced. Sets outRegion to
+    // the tiles changed after `revision` (empty if none) so derived data can
+    // update just that area. Returns false when `revision` is not one of this
+    // map's recent revisions; the caller must then rebuild everything.
+    bool dirtyRegionSince(std::uint64_t revision, TileRect& outRegion) const;
+    // Hash of the size and blocked tiles; equal for equal maps across runs,
+    // so it can key data cached on disk.
+    std::uint64_t contentHash() const;
+
+    // Queries (MapQuery.cpp). Cells outside the map count as blocked.
+    RayHit raycast(float fromX, float fromY, float toX, float toY) const;
+    void raycastBatch(std::span<const Ray> rays, std::span<RayHit> outHits) const;
+    // Whether the centre of (toX, toY) is visible from the centre of
+    // (fromX, fromY). Neither end cell can occlude.
+    bool hasLineOfSight(int fromX, int fromY, int toX, int toY) const;
+    // Moves a circle by (moveX, moveY), stopping at blocked tiles and sliding
+    // the rest of the move along the surface that was hit.
+    SweepResult sweepCircle(float x, float y, float radius, float moveX, float moveY) const;
+    // The same for an axis-aligned box reaching halfWidth and halfHeight from
+    // (x, y); its corners are square, so it slides along walls without
+    // rounding off tile corners.
+    SweepResult sweepBox(float x, float y, float halfWidth, float halfHeight, float moveX, float moveY) const;
+
 private:
-    std::vector<std::string> m_rows;
+    struct Change {
+        std::uint64_t revision;
+        TileRect region;
+    };
+    static constexpr std::size_t kChangeLogSize = 32;
+
+    void allocateBands(int width, int height);
+    // Band holding row y, copied first if a MapTiles view still shares it.
+    char* writableRow(int y);
+    void logChange(const TileRect& region);
+    void buildOccupancy();
+    void updateOccupancy(int x, int y);
+    bool blockOccupied(int level, int blockX, int blockY) const;
+
+    // Rows of kBandRows rows each, m_width bytes per row.
+    int m_width = 0;
+    int m_height = 0;
+    std::vector<std::shared_ptr<char[]>> m_bands;
+    std::uint64_t m_revision = 0;
+
+    // Ring of the last kChangeLogSize edits. m_changeLogBase is the revision
+    // just before the oldest logged edit.
+    std::array<Change, kChangeLogSize> m_changeLog{};
+    std::size_t m_changeCount = 0;
+    std::uint64_t m_changeLogBase = 0;
+
+    // m_occupancy[level] holds one byte per 2^level x 2^level block of tiles,
+    // non-zero when any tile in the block is blocked. Level 0 is the tiles.
+    std::vector<std::vector<std::uint8_t>> m_occupancy;
+    std::vector<int> m_occupancyWidths;
+    std::vector<int> m_occupancyHeights;
 };
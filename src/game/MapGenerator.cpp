@@ -0,0 +1,304 @@
+#include "game/MapGenerator.hpp"
+
+#include "game/Map.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+namespace {
+
+// Town layout: square blocks split into 2 x 2 lots, separated by streets.
+constexpr int kStreetWidth = 3;
+constexpr int kBlockSize = 18;
+constexpr int kBlockPitch = kBlockSize + kStreetWidth;
+constexpr int kMinBuildingSize = 5;
+constexpr int kMaxFenceLength = 5;
+
+// Canyon noise: two octaves of value noise on these lattice spacings.
+constexpr int kCoarseCell = 24;
+constexpr int kFineCell = 6;
+constexpr float kFineWeight = 0.35F;
+constexpr int kNoiseLevels = 256;
+
+// splitmix64; a fixed generator keeps the maps identical across standard
+// libraries, which std::uniform_*_distribution does not.
+class Rng {
+public:
+    explicit Rng(std::uint64_t seed)
+        : m_state(seed) {
+    }
+
+    std::uint64_t next() {
+        m_state += 0x9E3779B97F4A7C15ULL;
+        std::uint64_t z = m_state;
+        z = (z ^ (z >> 30U)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27U)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31U);
+    }
+
+    // Uniform in [0, bound).
+    int below(int bound) {
+        return static_cast<int>((next() >> 33U) % static_cast<std::uint64_t>(bound));
+    }
+
+    int between(int low, int high) {
+        return low + below(high - low + 1);
+    }
+
+    bool chance(float probability) {
+        return static_cast<float>(next() >> 40U) * (1.0F / 16777216.0F) < probability;
+    }
+
+private:
+    std::uint64_t m_state;
+};
+
+// Row-major tiles plus the newline after each row, so the grid is the text.
+class Grid {
+public:
+    Grid(int width, int height, std::string& text)
+        : m_width(width),
+          m_height(height),
+          m_text(text) {
+        const std::size_t stride = static_cast<std::size_t>(width) + 1;
+        m_text.assign(stride * static_cast<std::size_t>(height), Map::kFloorTile);
+        for (int y = 0; y < height; ++y) {
+            m_text[stride * static_cast<std::size_t>(y) + static_cast<std::size_t>(width)] = '\n';
+        }
+    }
+
+    int width() const {
+        return m_width;
+    }
+
+    int height() const {
+        return m_height;
+    }
+
+    char& at(int x, int y) {
+        return m_text[(static_cast<std::size_t>(m_width) + 1) * static_cast<std::size_t>(y) + static_cast<std::size_t>(x)];
+    }
+
+    bool inside(int x, int y) const {
+        return x > 0 && y > 0 && x < m_width - 1 && y < m_height - 1;
+    }
+
+    void drawBorder() {
+        for (int x = 0; x < m_width; ++x) {
+            at(x, 0) = Map::kWallTile;
+            at(x, m_height - 1) = Map::kWallTile;
+        }
+        for (int y = 0; y < m_height; ++y) {
+            at(0, y) = Map::kWallTile;
+            at(m_width - 1, y) = Map::kWallTile;
+        }
+    }
+
+    std::size_t countBlocked() {
+        std::size_t count = 0;
+        for (int y = 0; y < m_height; ++y) {
+            for (int x = 0; x < m_width; ++x) {
+                const char tile = at(x, y);
+                count += tile == Map::kWallTile || tile == Map::kClosedDoorTile ? 1 : 0;
+            }
+        }
+        return count;
+    }
+
+private:
+    int m_width;
+    int m_height;
+    std::string& m_text;
+};
+
+bool isStreet(int x, int y) {
+    return x % kBlockPitch < kStreetWidth || y % kBlockPitch < kStreetWidth;
+}
+
+// Walls around [x0, x1] x [y0, y1] with a door on one of the two sides in
+// `doorSides` (bit 0 west, 1 east, 2 north, 3 south), and sometimes an inner
+// partition with an open doorway.
+void placeBuilding(Grid& grid, Rng& rng, int x0, int y0, int x1, int y1, unsigned doorSides) {
+    for (int x = x0; x <= x1; ++x) {
+        grid.at(x, y0) = Map::kWallTile;
+        grid.at(x, y1) = Map::kWallTile;
+    }
+    for (int y = y0; y <= y1; ++y) {
+        grid.at(x0, y) = Map::kWallTile;
+        grid.at(x1, y) = Map::kWallTile;
+    }
+
+    std::array<int, 4> sides{};
+    int sideCount = 0;
+    for (int side = 0; side < 4; ++side) {
+        if ((doorSides & (1U << static_cast<unsigned>(side))) != 0) {
+            sides[sideCount++] = side;
+        }
+    }
+    const int side = sides[rng.below(sideCount)];
+    const char door = rng.chance(0.5F) ? Map::kClosedDoorTile : Map::kOpenDoorTile;
+    if (side < 2) {
+        grid.at(side == 0 ? x0 : x1, rng.between(y0 + 1, y1 - 1)) = door;
+    } else {
+        grid.at(rng.between(x0 + 1, x1 - 1), side == 2 ? y0 : y1) = door;
+    }
+
+    if (x1 - x0 >= 6 && rng.chance(0.5F)) {
+        const int wallX = rng.between(x0 + 3, x1 - 3);
+        for (int y = y0 + 1; y < y1; ++y) {
+            grid.at(wallX, y) = Map::kWallTile;
+        }
+        grid.at(wallX, rng.between(y0 + 1, y1 - 1)) = Map::kOpenDoorTile;
+    }
+}
+
+bool nextToDoor(Grid& grid, int x, int y) {
+    constexpr std::array<std::array<int, 2>, 4> kNeighbours{{{1, 0}, {-1, 0}, {0, 1}, {0, -1}}};
+    for (const auto& [dx, dy] : kNeighbours) {
+        const char tile = grid.at(x + dx, y + dy);
+        if (tile == Map::kClosedDoorTile || tile == Map::kOpenDoorTile) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void generateTown(Grid& grid, Rng& rng, float wallDensity) {
+    grid.drawBorder();
+    // Full lots cover roughly a fifth of the map with walls; lower densities
+    // leave lots empty and higher ones are topped up with fences.
+    const float buildingChance = std::min(1.0F, wallDensity * 4.0F);
+    constexpr int kLotSize = kBlockSize / 2;
+
+    for (int blockY = kStreetWidth; blockY < grid.height() - 1; blockY += kBlockPitch) {
+        for (int blockX = kStreetWidth; blockX < grid.width() - 1; blockX += kBlockPitch) {
+            for (int lot = 0; lot < 4; ++lot) {
+                const int lotX = blockX + (lot % 2) * kLotSize;
+                const int lotY = blockY + (lot / 2) * kLotSize;
+                const int lotRight = std::min(lotX + kLotSize, grid.width() - 1) - 1;
+                const int lotBottom = std::min(lotY + kLotSize, grid.height() - 1) - 1;
+                if (lotRight - lotX + 1 < kMinBuildingSize || lotBottom - lotY + 1 < kMinBuildingSize ||
+                    !rng.chance(buildingChance)) {
+                    continue;
+                }
+
+                const int width = rng.between(kMinBuildingSize, lotRight - lotX + 1);
+                const int height = rng.between(kMinBuildingSize, lotBottom - lotY + 1);
+                const int x0 = lotX + rng.below(lotRight - lotX + 2 - width);
+                const int y0 = lotY + rng.below(lotBottom - lotY + 2 - height);
+                // Doors face the streets on the lot's outer sides.
+                const unsigned doorSides = (lot % 2 == 0 ? 1U : 2U) | (lot / 2 == 0 ? 4U : 8U);
+                placeBuilding(grid, rng, x0, y0, x0 + width - 1, y0 + height - 1, doorSides);
+            }
+        }
+    }
+
+    const std::size_t area = static_cast<std::size_t>(grid.width()) * static_cast<std::size_t>(grid.height());
+    const auto target = static_cast<std::size_t>(wallDensity * static_cast<float>(area));
+    std::size_t blocked = grid.countBlocked();
+    for (std::size_t attempts = 0; blocked < target && attempts < target * 4; ++attempts) {
+        int x = rng.between(1, grid.width() - 2);
+        int y = rng.between(1, grid.height() - 2);
+        const bool horizontal = rng.chance(0.5F);
+        const int length = rng.between(2, kMaxFenceLength);
+        for (int i = 0; i < length && grid.inside(x, y) && blocked < target; ++i) {
+            if (isStreet(x, y) || grid.at(x, y) != Map::kFloorTile || nextToDoor(grid, x, y)) {
+                break;
+            }
+            grid.at(x, y) = Map::kWallTile;
+            ++blocked;
+            x += horizontal ? 1 : 0;
+            y += horizontal ? 0 : 1;
+        }
+    }
+}
+
+float latticeValue(std::uint64_t seed, int x, int y) {
+    Rng hash(seed ^ (static_cast<std::uint64_t>(static_cast<std::uint32_t>(x)) << 32U) ^ static_cast<std::uint32_t>(y));
+    return static_cast<float>(hash.next() >> 40U) * (1.0F / 16777216.0F);
+}
+
+float valueNoise(std::uint64_t seed, int x, int y, int cell) {
+    const int cellX = x / cell;
+    const int cellY = y / cell;
+    const auto fade = [](float t) { return t * t * (3.0F - 2.0F * t); };
+    const float tx = fade(static_cast<float>(x % cell) / static_cast<float>(cell));
+    const float ty = fade(static_cast<float>(y % cell) / static_cast<float>(cell));
+    const float top = std::lerp(latticeValue(seed, cellX, cellY), latticeValue(seed, cellX + 1, cellY), tx);
+    const float bottom = std::lerp(latticeValue(seed, cellX, cellY + 1), latticeValue(seed, cellX + 1, cellY + 1), tx);
+    return std::lerp(top, bottom, ty);
+}
+
+void generateCanyon(Grid& grid, Rng& rng, std::uint64_t seed, float wallDensity) {
+    const int width = grid.width();
+    const int height = grid.height();
+
+    // Quantised noise, then the level that walls off `wallDensity` of the map.
+    std::vector<std::uint8_t> levels(static_cast<std::size_t>(width) * static_cast<std::size_t>(height));
+    std::array<std::size_t, kNoiseLevels> histogram{};
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            const float noise = (valueNoise(seed, x, y, kCoarseCell) + kFineWeight * valueNoise(seed + 1, x, y, kFineCell)) /
+                (1.0F + kFineWeight);
+            const auto level = static_cast<std::uint8_t>(std::min(noise * kNoiseLevels, kNoiseLevels - 1.0F));
+            levels[static_cast<std::size_t>(y) * static_cast<std::size_t>(width) + static_cast<std::size_t>(x)] = level;
+            ++histogram[level];
+        }
+    }
+    const auto target = static_cast<std::size_t>(wallDensity * static_cast<float>(levels.size()));
+    int threshold = kNoiseLevels;
+    for (std::size_t walls = 0; threshold > 0 && walls + histogram[threshold - 1] <= target;) {
+        --threshold;
+        walls += histogram[threshold];
+    }
+
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            if (levels[static_cast<std::size_t>(y) * static_cast<std::size_t>(width) + static_cast<std::size_t>(x)] >= threshold) {
+                grid.at(x, y) = Map::kWallTile;
+            }
+        }
+    }
+
+    // A channel from west to east keeps the map crossable.
+    int y = rng.between(height / 4, height - 1 - height / 4);
+    int drift = 0;
+    for (int x = 1; x < width - 1; ++x) {
+        if (rng.chance(0.15F)) {
+            drift = rng.between(-1, 1);
+        }
+        y = std::clamp(y + drift, 2, height - 3);
+        const int radius = rng.chance(0.2F) ? 2 : 1;
+        for (int dy = -radius; dy <= radius; ++dy) {
+            if (grid.inside(x, y + dy)) {
+                grid.at(x, y + dy) = Map::kFloorTile;
+            }
+        }
+    }
+    grid.drawBorder();
+}
+
+} // namespace
+
+float MapGenerator::defaultDensity(MapStyle style) {
+    return style == MapStyle::Town ? 0.2F : 0.45F;
+}
+
+bool MapGenerator::generate(const MapGenSettings& settings, std::string& outText) {
+    if (settings.width < kMinSize || settings.height < kMinSize || settings.width > kMaxSize ||
+        settings.height > kMaxSize || !(settings.wallDensity >= 0.0F && settings.wallDensity <= 0.9F)) {
+        return false;
+    }
+
+    Grid grid(settings.width, settings.height, outText);
+    Rng rng(settings.seed);
+    if (settings.style == MapStyle::Town) {
+        generateTown(grid, rng, settings.wallDensity);
+    } else {
+        generateCanyon(grid, rng, settings.seed, settings.wallDensity);
+    }
+    return true;
+}
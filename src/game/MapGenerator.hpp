@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Town: a street grid with walled buildings (doors onto the street) and
+// fences in the yards. Canyon: smoothed cave noise with a winding channel
+// carved from the west edge to the east edge.
+enum class MapStyle : std::uint8_t {
+    Town,
+    Canyon,
+};
+
+struct MapGenSettings {
+    MapStyle style = MapStyle::Town;
+    int width = 64;
+    int height = 64;
+    std::uint64_t seed = 1;
+    // Target fraction of blocked tiles; the result lands near it, not on it.
+    float wallDensity = 0.2F;
+};
+
+// Seeded stress maps in the ASCII format Map::loadFromAscii reads. The same
+// settings produce the same map on every platform.
+class MapGenerator {
+public:
+    static constexpr int kMinSize = 16;
+    static constexpr int kMaxSize = 8192;
+
+    // Densities that look like a real town or canyon.
+    static float defaultDensity(MapStyle style);
+
+    // Fails when a side is outside [kMinSize, kMaxSize] or the density is
+    // outside [0, 0.9].
+    static bool generate(const MapGenSettings& settings, std::string& outText);
+};
@@ -0,0 +1,395 @@
+#include "game/Map.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+namespace {
+
+constexpr float kInfinity = std::numeric_limits<float>::infinity();
+// Gap left between a swept circle and the surface it stopped against, so the
+// next sweep starts cleanly outside it.
+constexpr float kContactSkin = 1.0e-3F;
+constexpr int kMaxSlides = 3;
+
+// Parameter along the segment where it next crosses a cell boundary on one axis.
+float nextBoundaryT(float origin, float delta, int step, int cell) {
+    if (step == 0) {
+        return kInfinity;
+    }
+    const int boundary = step > 0 ? cell + 1 : cell;
+    return (static_cast<float>(boundary) - origin) / delta;
+}
+
+// Cell on one axis at parameter t. The estimate from the position is settled
+// with the same boundary comparisons the cell-by-cell walk makes, so a jump
+// through an exact corner lands where the walk would.
+int cellAtT(float origin, float delta, int step, float t) {
+    int cell = static_cast<int>(std::floor(origin + delta * t));
+    if (step == 0) {
+        return cell;
+    }
+    while (nextBoundaryT(origin, delta, step, cell) <= t) {
+        cell += step;
+    }
+    while (nextBoundaryT(origin, delta, step, cell - step) > t) {
+        cell -= step;
+    }
+    return cell;
+}
+
+struct Contact {
+    float t;
+    float normalX;
+    float normalY;
+};
+
+// Segment (x, y) + (dx, dy) * t, t in [0, 1], against an axis-aligned box.
+// A segment that starts inside reports nothing, so overlaps can be escaped.
+bool segmentEntersBox(float x, float y, float dx, float dy, float minX, float minY, float maxX, float maxY, Contact& outContact) {
+    float enter = -kInfinity;
+    float exit = kInfinity;
+    float normalX = 0.0F;
+    float normalY = 0.0F;
+
+    const auto clipAxis = [&](float origin, float delta, float low, float high, bool xAxis) {
+        if (delta == 0.0F) {
+            return origin > low && origin < high;
+        }
+        float nearT = (low - origin) / delta;
+        float farT = (high - origin) / delta;
+        if (nearT > farT) {
+            std::swap(nearT, farT);
+        }
+        if (nearT > enter) {
+            enter = nearT;
+            normalX = xAxis ? (delta > 0.0F ? -1.0F : 1.0F) : 0.0F;
+            normalY = xAxis ? 0.0F : (delta > 0.0F ? -1.0F : 1.0F);
+        }
+        exit = std::min(exit, farT);
+        return true;
+    };
+
+    if (!clipAxis(x, dx, minX, maxX, true) || !clipAxis(y, dy, minY, maxY, false)) {
+        return false;
+    }
+    if (enter >= exit || enter < 0.0F || enter > 1.0F) {
+        return false;
+    }
+    outContact = Contact{enter, normalX, normalY};
+    return true;
+}
+
+bool segmentEntersCircle(float x, float y, float dx, float dy, float centerX, float centerY, float radius, Contact& outContact) {
+    const float ox = x - centerX;
+    const float oy = y - centerY;
+    const float a = dx * dx + dy * dy;
+    const float b = 2.0F * (ox * dx + oy * dy);
+    const float c = ox * ox + oy * oy - radius * radius;
+    if (c <= 0.0F || a == 0.0F) {
+        return false;
+    }
+    const float discriminant = b * b - 4.0F * a * c;
+    if (discriminant < 0.0F) {
+        return false;
+    }
+    const float t = (-b - std::sqrt(discriminant)) / (2.0F * a);
+    if (t < 0.0F || t > 1.0F) {
+        return false;
+    }
+    outContact = Contact{t, (ox + dx * t) / radius, (oy + dy * t) / radius};
+    return true;
+}
+
+// A circle swept against a unit tile is the centre's segment against the tile
+// grown by the radius with rounded corners: two grown boxes plus four circles.
+bool sweepCircleAgainstTile(float x, float y, float radius, float dx, float dy, int tileX, int tileY, Contact& outContact) {
+    const float minX = static_cast<float>(tileX);
+    const float minY = static_cast<float>(tileY);
+    const float maxX = minX + 1.0F;
+    const float maxY = minY + 1.0F;
+
+    bool found = false;
+    Contact contact{};
+    const auto consider = [&](bool hit) {
+        if (hit && (!found || contact.t < outContact.t)) {
+            outContact = contact;
+            found = true;
+        }
+    };
+    consider(segmentEntersBox(x, y, dx, dy, minX - radius, minY, maxX + radius, maxY, contact));
+    consider(segmentEntersBox(x, y, dx, dy, minX, minY - radius, maxX, maxY + radius, contact));
+    consider(segmentEntersCircle(x, y, dx, dy, minX, minY, radius, contact));
+    consider(segmentEntersCircle(x, y, dx, dy, maxX, minY, radius, contact));
+    consider(segmentEntersCircle(x, y, dx, dy, minX, maxY, radius, contact));
+    consider(segmentEntersCircle(x, y, dx, dy, maxX, maxY, radius, contact));
+    return found;
+}
+
+// An axis-aligned box swept against a unit tile is the centre's segment
+// against the tile grown by the half extents, square corners and all.
+bool sweepBoxAgainstTile(float x, float y, float halfWidth, float halfHeight, float dx, float dy, int tileX, int tileY, Contact& outContact) {
+    const float minX = static_cast<float>(tileX);
+    const float minY = static_cast<float>(tileY);
+    return segmentEntersBox(
+        x, y, dx, dy, minX - halfWidth, minY - halfHeight, minX + 1.0F + halfWidth, minY + 1.0F + halfHeight, outContact);
+}
+
+// Moves a shape whose bounds reach halfWidth and halfHeight from its centre,
+// up to kMaxSlides times: stop at the nearest contact `againstTile` reports
+// for a blocked tile, then slide the rest of the move along its surface.
+template <typename AgainstTile>
+SweepResult sweepShape(const Map& map, float x, float y, float halfWidth, float halfHeight, float moveX, float moveY, const AgainstTile& againstTile) {
+    SweepResult result{x, y, false};
+    for (int slide = 0; slide < kMaxSlides && (moveX != 0.0F || moveY != 0.0F); ++slide) {
+        // Every tile the swept bounds touch; the whole move is tested, so a
+        // fast mover cannot step over a wall.
+        const int minX = static_cast<int>(std::floor(std::min(result.x, result.x + moveX) - halfWidth));
+        const int maxX = static_cast<int>(std::floor(std::max(result.x, result.x + moveX) + halfWidth));
+        const int minY = static_cast<int>(std::floor(std::min(result.y, result.y + moveY) - halfHeight));
+        const int maxY = static_cast<int>(std::floor(std::max(result.y, result.y + moveY) + halfHeight));
+
+        bool found = false;
+        Contact nearest{1.0F, 0.0F, 0.0F};
+        for (int tileY = minY; tileY <= maxY; ++tileY) {
+            for (int tileX = minX; tileX <= maxX; ++tileX) {
+                if (!map.isBlocked(tileX, tileY)) {
+                    continue;
+                }
+                Contact contact{};
+                if (againstTile(result.x, result.y, moveX, moveY, tileX, tileY, contact) &&
+                    (!found || contact.t < nearest.t)) {
+                    nearest = contact;
+                    found = true;
+                }
+            }
+        }
+
+        if (!found) {
+            result.x += moveX;
+            result.y += moveY;
+            break;
+        }
+
+        // Stop at the contact, backed off along the normal, then keep the part
+        // of the remaining move that runs along the surface.
+        result.collided = true;
+        result.x += moveX * nearest.t + nearest.normalX * kContactSkin;
+        result.y += moveY * nearest.t + nearest.normalY * kContactSkin;
+        const float remainingX = moveX * (1.0F - nearest.t);
+        const float remainingY = moveY * (1.0F - nearest.t);
+        const float into = remainingX * nearest.normalX + remainingY * nearest.normalY;
+        moveX = remainingX - into * nearest.normalX;
+        moveY = remainingY - into * nearest.normalY;
+    }
+    return result;
+}
+
+} // namespace
+
+void Map::buildOccupancy() {
+    m_occupancy.clear();
+    m_occupancyWidths.clear();
+    m_occupancyHeights.clear();
+
+    int levelWidth = width();
+    int levelHeight = height();
+    if (levelWidth <= 0 || levelHeight <= 0) {
+        return;
+    }
+
+    std::vector<std::uint8_t> tiles(static_cast<std::size_t>(levelWidth) * static_cast<std::size_t>(levelHeight));
+    for (int y = 0; y < levelHeight; ++y) {
+        for (int x = 0; x < levelWidth; ++x) {
+            tiles[static_cast<std::size_t>(y * levelWidth + x)] = isBlocked(x, y) ? 1 : 0;
+        }
+    }
+    m_occupancy.push_back(std::move(tiles));
+    m_occupancyWidths.push_back(levelWidth);
+    m_occupancyHeights.push_back(levelHeight);
+
+    // Halve until one block covers the map. Blocks hanging off the right or
+    // bottom edge count as occupied, since the cells out there are blocked.
+    while (levelWidth > 1 || levelHeight > 1) {
+        const std::vector<std::uint8_t>& finer = m_occupancy.back();
+        const int finerWidth = levelWidth;
+        const int finerHeight = levelHeight;
+        levelWidth = (levelWidth + 1) / 2;
+        levelHeight = (levelHeight + 1) / 2;
+
+        std::vector<std::uint8_t> coarse(static_cast<std::size_t>(levelWidth) * static_cast<std::size_t>(levelHeight));
+        for (int y = 0; y < levelHeight; ++y) {
+            for (int x = 0; x < levelWidth; ++x) {
+                std::uint8_t occupied = 0;
+                for (int child = 0; child < 4; ++child) {
+                    const int cx = x * 2 + (child & 1);
+                    const int cy = y * 2 + (child >> 1);
+                    occupied |= cx < finerWidth && cy < finerHeight ? finer[static_cast<std::size_t>(cy * finerWidth + cx)] : 1;
+                }
+                coarse[static_cast<std::size_t>(y * levelWidth + x)] = occupied;
+            }
+        }
+        m_occupancy.push_back(std::move(coarse));
+        m_occupancyWidths.push_back(levelWidth);
+        m_occupancyHeights.push_back(levelHeight);
+    }
+}
+
+void Map::updateOccupancy(int x, int y) {
+    if (m_occupancy.empty()) {
+        return;
+    }
+
+    // Only the blocks containing (x, y) change, one per level.
+    m_occupancy[0][static_cast<std::size_t>(y * m_occupancyWidths[0] + x)] = isBlocked(x, y) ? 1 : 0;
+    for (std::size_t level = 1; level < m_occupancy.size(); ++level) {
+        x >>= 1;
+        y >>= 1;
+        const std::vector<std::uint8_t>& finer = m_occupancy[level - 1];
+        const int finerWidth = m_occupancyWidths[level - 1];
+        const int finerHeight = m_occupancyHeights[level - 1];
+        std::uint8_t occupied = 0;
+        for (int child = 0; child < 4; ++child) {
+            const int cx = x * 2 + (child & 1);
+            const int cy = y * 2 + (child >> 1);
+            occupied |= cx < finerWidth && cy < finerHeight ? finer[static_cast<std::size_t>(cy * finerWidth + cx)] : 1;
+        }
+        m_occupancy[level][static_cast<std::size_t>(y * m_occupancyWidths[level] + x)] = occupied;
+    }
+}
+
+bool Map::blockOccupied(int level, int blockX, int blockY) const {
+    const std::size_t index = static_cast<std::size_t>(level);
+    const int levelWidth = m_occupancyWidths[index];
+    if (blockX < 0 || blockY < 0 || blockX >= levelWidth || blockY >= m_occupancyHeights[index]) {
+        return true;
+    }
+    return m_occupancy[index][static_cast<std::size_t>(blockY * levelWidth + blockX)] != 0;
+}
+
+RayHit Map::raycast(float fromX, float fromY, float toX, float toY) const {
+    RayHit result{false, 0, 0, 1.0F, 0.0F, 0.0F};
+    if (m_occupancy.empty()) {
+        return result;
+    }
+
+    // Grid DDA (Amanatides & Woo). Before each step, the largest empty
+    // pyramid block around the current cell is skipped in one jump; its
+    // cells hold nothing to hit, so the first blocked cell stays exact.
+    const float dx = toX - fromX;
+    const float dy = toY - fromY;
+    const int stepX = dx > 0.0F ? 1 : (dx < 0.0F ? -1 : 0);
+    const int stepY = dy > 0.0F ? 1 : (dy < 0.0F ? -1 : 0);
+    int cellX = static_cast<int>(std::floor(fromX));
+    int cellY = static_cast<int>(std::floor(fromY));
+    const int levelCount = static_cast<int>(m_occupancy.size());
+
+    for (;;) {
+        int level = 0;
+        while (level + 1 < levelCount && !blockOccupied(level + 1, cellX >> (level + 1), cellY >> (level + 1))) {
+            ++level;
+        }
+
+        float t = 0.0F;
+        bool crossedX = false;
+        bool crossedY = false;
+        if (level > 0) {
+            const int size = 1 << level;
+            const int blockX = (cellX >> level) << level;
+            const int blockY = (cellY >> level) << level;
+            const float exitX = nextBoundaryT(fromX, dx, stepX, stepX > 0 ? blockX + size - 1 : blockX);
+            const float exitY = nextBoundaryT(fromY, dy, stepY, stepY > 0 ? blockY + size - 1 : blockY);
+            t = std::min(exitX, exitY);
+            if (t > 1.0F) {
+                return result;
+            }
+            crossedX = exitX <= exitY;
+            crossedY = exitY <= exitX;
+            // Land in the cell just past the block; the other axis comes from
+            // the crossing point, kept inside the block against rounding. When
+            // that point is exactly on a cell corner inside the block, the
+            // other axis crossed a boundary at t too, as the cell-by-cell walk
+            // would report.
+            if (crossedX) {
+                cellX = stepX > 0 ? blockX + size : blockX - 1;
+            } else {
+                cellX = std::clamp(cellAtT(fromX, dx, stepX, t), blockX, blockX + size - 1);
+                crossedX = nextBoundaryT(fromX, dx, stepX, cellX - stepX) == t;
+            }
+            if (crossedY) {
+                cellY = stepY > 0 ? blockY + size : blockY - 1;
+            } else {
+                cellY = std::clamp(cellAtT(fromY, dy, stepY, t), blockY, blockY + size - 1);
+                crossedY = nextBoundaryT(fromY, dy, stepY, cellY - stepY) == t;
+            }
+        } else {
+            const float nextX = nextBoundaryT(fromX, dx, stepX, cellX);
+            const float nextY = nextBoundaryT(fromY, dy, stepY, cellY);
+            t = std::min(nextX, nextY);
+            if (t > 1.0F) {
+                return result;
+            }
+            // An exact corner steps both axes, so a diagonal does not pick a side.
+            crossedX = nextX <= nextY;
+            crossedY = nextY <= nextX;
+            cellX += crossedX ? stepX : 0;
+            cellY += crossedY ? stepY : 0;
+        }
+
+        if (blockOccupied(0, cellX, cellY)) {
+            result.hit = true;
+            result.cellX = cellX;
+            result.cellY = cellY;
+            result.t = t;
+            result.normalX = crossedX ? static_cast<float>(-stepX) : 0.0F;
+            result.normalY = crossedY ? static_cast<float>(-stepY) : 0.0F;
+            return result;
+        }
+    }
+}
+
+void Map::raycastBatch(std::span<const Ray> rays, std::span<RayHit> outHits) const {
+    const std::size_t count = std::min(rays.size(), outHits.size());
+    for (std::size_t i = 0; i < count; ++i) {
+        const Ray& ray = rays[i];
+        outHits[i] = raycast(ray.fromX, ray.fromY, ray.toX, ray.toY);
+    }
+}
+
+bool Map::hasLineOfSight(int fromX, int fromY, int toX, int toY) const {
+    const RayHit hit = raycast(
+        static_cast<float>(fromX) + 0.5F,
+        static_cast<float>(fromY) + 0.5F,
+        static_cast<float>(toX) + 0.5F,
+        static_cast<float>(toY) + 0.5F);
+    return !hit.hit || (hit.cellX == toX && hit.cellY == toY);
+}
+
+SweepResult Map::sweepCircle(float x, float y, float radius, float moveX, float moveY) const {
+    return sweepShape(
+        *this,
+        x,
+        y,
+        radius,
+        radius,
+        moveX,
+        moveY,
+        [radius](float fromX, float fromY, float dx, float dy, int tileX, int tileY, Contact& outContact) {
+            return sweepCircleAgainstTile(fromX, fromY, radius, dx, dy, tileX, tileY, outContact);
+        });
+}
+
+SweepResult Map::sweepBox(float x, float y, float halfWidth, float halfHeight, float moveX, float moveY) const {
+    return sweepShape(
+        *this,
+        x,
+        y,
+        halfWidth,
+        halfHeight,
+        moveX,
+        moveY,
+        [halfWidth, halfHeight](float fromX, float fromY, float dx, float dy, int tileX, int tileY, Contact& outContact) {
+            return sweepBoxAgainstTile(fromX, fromY, halfWidth, halfHeight, dx, dy, tileX, tileY, outContact);
+        });
+}
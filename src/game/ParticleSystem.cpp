@@ -0,0 +1,351 @@
+#include "game/ParticleSystem.hpp"
+
+#include "game/Map.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// Motion of one kind. Speeds are tiles per second; lift is the vertical
+// acceleration (negative falls, positive rises), drag the exponential decay
+// rate of velocity.
+struct KindPhysics {
+    float speedMin;
+    float speedMax;
+    float riseMin;
+    float riseMax;
+    float lift;
+    float drag;
+    float lifeMin;
+    float lifeMax;
+    float spawnRadius;
+    // Speed kept when bouncing off a wall or the ground.
+    float bounce;
+    // Horizontal speed kept by a ground bounce.
+    float groundFriction;
+};
+
+constexpr std::array<KindPhysics, kParticleKindCount> kPhysics{{
+    // Dust kicks up low, falls back and skids.
+    {0.3F, 1.0F, 0.3F, 0.8F, -3.0F, 2.0F, 0.5F, 1.1F, 0.15F, 0.3F, 0.5F},
+    // Embers float up and drift.
+    {0.1F, 0.4F, 0.6F, 1.4F, 0.4F, 0.8F, 1.2F, 2.4F, 0.1F, 0.5F, 0.8F},
+    // Smoke billows out slowly and rises.
+    {0.2F, 0.8F, 0.2F, 0.5F, 0.3F, 1.5F, 2.0F, 3.5F, 0.15F, 0.2F, 0.9F},
+}};
+
+constexpr std::array<ParticleLook, kParticleKindCount> kLooks{{
+    {{0.72F, 0.62F, 0.42F, 0.60F}, {0.78F, 0.70F, 0.52F, 0.0F}, 3.0F, 7.0F, false},
+    {{1.00F, 0.72F, 0.30F, 1.00F}, {0.70F, 0.20F, 0.08F, 0.0F}, 3.0F, 1.0F, true},
+    {{0.55F, 0.55F, 0.57F, 0.45F}, {0.70F, 0.70F, 0.72F, 0.0F}, 6.0F, 22.0F, false},
+}};
+
+// Ember clusters are gathered on a grid of this many tiles, in a small
+// open-addressed table; embers past a full table are ignored.
+constexpr int kLightCellTiles = 4;
+constexpr std::size_t kLightCells = 64;
+// Summed remaining life below which a cluster does not light anything.
+constexpr float kMinLightWeight = 2.0F;
+
+std::size_t roundUpToFour(std::size_t value) {
+    return (value + 3) & ~static_cast<std::size_t>(3);
+}
+
+int tileOf(float coordinate) {
+    return static_cast<int>(std::floor(coordinate));
+}
+
+// Velocity decay, motion and the ground bounce for particles [0, count).
+void integrate(
+    float* x,
+    float* y,
+    float* z,
+    float* velocityX,
+    float* velocityY,
+    float* velocityZ,
+    float* age,
+    const float* ageRate,
+    std::size_t count,
+    const KindPhysics& physics,
+    float dt) {
+    const float damping = std::exp(-physics.drag * dt);
+    const float lift = physics.lift * dt;
+    std::size_t i = 0;
+#if defined(__SSE2__)
+    const __m128 dampingV = _mm_set1_ps(damping);
+    const __m128 liftV = _mm_set1_ps(lift);
+    const __m128 dtV = _mm_set1_ps(dt);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 groundBounce = _mm_set1_ps(-physics.bounce);
+    const __m128 friction = _mm_set1_ps(physics.groundFriction);
+    const __m128 one = _mm_set1_ps(1.0F);
+    for (; i + 4 <= count; i += 4) {
+        const __m128 vx = _mm_mul_ps(_mm_load_ps(velocityX + i), dampingV);
+        const __m128 vy = _mm_mul_ps(_mm_load_ps(velocityY + i), dampingV);
+        const __m128 vz = _mm_add_ps(_mm_mul_ps(_mm_load_ps(velocityZ + i), dampingV), liftV);
+        const __m128 newZ = _mm_add_ps(_mm_load_ps(z + i), _mm_mul_ps(vz, dtV));
+
+        // Below ground: clamp to it, reflect vz, and lose some skid.
+        const __m128 landed = _mm_cmplt_ps(newZ, zero);
+        const __m128 scale = _mm_or_ps(_mm_and_ps(landed, friction), _mm_andnot_ps(landed, one));
+        const __m128 bouncedVz = _mm_or_ps(_mm_and_ps(landed, _mm_mul_ps(vz, groundBounce)), _mm_andnot_ps(landed, vz));
+        const __m128 finalVx = _mm_mul_ps(vx, scale);
+        const __m128 finalVy = _mm_mul_ps(vy, scale);
+
+        _mm_store_ps(velocityX + i, finalVx);
+        _mm_store_ps(velocityY + i, finalVy);
+        _mm_store_ps(velocityZ + i, bouncedVz);
+        _mm_store_ps(x + i, _mm_add_ps(_mm_load_ps(x + i), _mm_mul_ps(finalVx, dtV)));
+        _mm_store_ps(y + i, _mm_add_ps(_mm_load_ps(y + i), _mm_mul_ps(finalVy, dtV)));
+        _mm_store_ps(z + i, _mm_max_ps(newZ, zero));
+        _mm_store_ps(age + i, _mm_add_ps(_mm_load_ps(age + i), _mm_mul_ps(_mm_load_ps(ageRate + i), dtV)));
+    }
+#endif
+    for (; i < count; ++i) {
+        float vx = velocityX[i] * damping;
+        float vy = velocityY[i] * damping;
+        float vz = velocityZ[i] * damping + lift;
+        const float newZ = z[i] + vz * dt;
+        if (newZ < 0.0F) {
+            vx *= physics.groundFriction;
+            vy *= physics.groundFriction;
+            vz *= -physics.bounce;
+        }
+        velocityX[i] = vx;
+        velocityY[i] = vy;
+        velocityZ[i] = vz;
+        x[i] += vx * dt;
+        y[i] += vy * dt;
+        z[i] = std::max(newZ, 0.0F);
+        age[i] += ageRate[i] * dt;
+    }
+}
+
+} // namespace
+
+ParticlePool::ParticlePool(std::size_t capacity)
+    : m_storage(std::make_unique<float[]>(roundUpToFour(capacity) * kFieldCount)),
+      m_capacity(roundUpToFour(capacity)) {
+}
+
+std::size_t ParticlePool::size() const {
+    return m_count;
+}
+
+std::size_t ParticlePool::capacity() const {
+    return m_capacity;
+}
+
+const float* ParticlePool::x() const {
+    return field(kX);
+}
+
+const float* ParticlePool::y() const {
+    return field(kY);
+}
+
+const float* ParticlePool::z() const {
+    return field(kZ);
+}
+
+const float* ParticlePool::age() const {
+    return field(kAge);
+}
+
+float* ParticlePool::field(Field name) {
+    return m_storage.get() + static_cast<std::size_t>(name) * m_capacity;
+}
+
+const float* ParticlePool::field(Field name) const {
+    return m_storage.get() + static_cast<std::size_t>(name) * m_capacity;
+}
+
+ParticleSystem::ParticleSystem()
+    : m_pools{ParticlePool(kPoolCapacity), ParticlePool(kPoolCapacity), ParticlePool(kPoolCapacity)} {
+}
+
+float ParticleSystem::random() {
+    m_rngState ^= m_rngState << 13U;
+    m_rngState ^= m_rngState >> 7U;
+    m_rngState ^= m_rngState << 17U;
+    return static_cast<float>(m_rngState >> 40U) * (1.0F / 16777216.0F);
+}
+
+std::size_t ParticleSystem::emit(ParticleKind kind, float x, float y, float z, std::size_t count) {
+    ParticlePool& pool = m_pools[static_cast<std::size_t>(kind)];
+    const KindPhysics& physics = kPhysics[static_cast<std::size_t>(kind)];
+    count = std::min(count, pool.m_capacity - pool.m_count);
+
+    float* px = pool.field(ParticlePool::kX);
+    float* py = pool.field(ParticlePool::kY);
+    float* pz = pool.field(ParticlePool::kZ);
+    float* vx = pool.field(ParticlePool::kVelocityX);
+    float* vy = pool.field(ParticlePool::kVelocityY);
+    float* vz = pool.field(ParticlePool::kVelocityZ);
+    float* age = pool.field(ParticlePool::kAge);
+    float* ageRate = pool.field(ParticlePool::kAgeRate);
+    for (std::size_t n = 0; n < count; ++n) {
+        const std::size_t i = pool.m_count++;
+        const float angle = random() * 2.0F * std::numbers::pi_v<float>;
+        const float offset = random() * physics.spawnRadius;
+        const float speed = physics.speedMin + random() * (physics.speedMax - physics.speedMin);
+        px[i] = x + std::cos(angle) * offset;
+        py[i] = y + std::sin(angle) * offset;
+        pz[i] = z;
+        vx[i] = std::cos(angle) * speed;
+        vy[i] = std::sin(angle) * speed;
+        vz[i] = physics.riseMin + random() * (physics.riseMax - physics.riseMin);
+        age[i] = 0.0F;
+        ageRate[i] = 1.0F / (physics.lifeMin + random() * (physics.lifeMax - physics.lifeMin));
+    }
+    return count;
+}
+
+void ParticleSystem::runEmitter(ParticleEmitter& emitter, float dtSeconds) {
+    emitter.pending += emitter.perSecond * dtSeconds;
+    if (emitter.pending < 1.0F) {
+        return;
+    }
+    const float whole = std::floor(emitter.pending);
+    emitter.pending -= whole;
+    emit(emitter.kind, emitter.x, emitter.y, emitter.z, static_cast<std::size_t>(whole));
+}
+
+void ParticleSystem::update(const Map& map, float dtSeconds) {
+    for (std::size_t kind = 0; kind < kParticleKindCount; ++kind) {
+        ParticlePool& pool = m_pools[kind];
+        const KindPhysics& physics = kPhysics[kind];
+        float* x = pool.field(ParticlePool::kX);
+        float* y = pool.field(ParticlePool::kY);
+        float* z = pool.field(ParticlePool::kZ);
+        float* vx = pool.field(ParticlePool::kVelocityX);
+        float* vy = pool.field(ParticlePool::kVelocityY);
+        float* vz = pool.field(ParticlePool::kVelocityZ);
+        float* age = pool.field(ParticlePool::kAge);
+        float* ageRate = pool.field(ParticlePool::kAgeRate);
+
+        integrate(x, y, z, vx, vy, vz, age, ageRate, pool.m_count, physics, dtSeconds);
+
+        // A particle that stays in its tile cannot have hit a wall, so most
+        // of them skip the map entirely. Each axis is undone separately, so
+        // particles slide along walls and bounce off them.
+        for (std::size_t i = 0; i < pool.m_count; ++i) {
+            const float previousX = x[i] - vx[i] * dtSeconds;
+            const float previousY = y[i] - vy[i] * dtSeconds;
+            const int tileX = tileOf(x[i]);
+            const int tileY = tileOf(y[i]);
+            const int previousTileY = tileOf(previousY);
+            if (tileX == tileOf(previousX) && tileY == previousTileY) {
+                continue;
+            }
+            if (map.isBlocked(tileX, previousTileY)) {
+                x[i] = previousX;
+                vx[i] *= -physics.bounce;
+            }
+            if (map.isBlocked(tileOf(x[i]), tileY)) {
+                y[i] = previousY;
+                vy[i] *= -physics.bounce;
+            }
+        }
+
+        // Order does not matter, so the dead are replaced by the last live
+        // particle and the pool stays packed.
+        std::size_t i = 0;
+        while (i < pool.m_count) {
+            if (age[i] < 1.0F) {
+                ++i;
+                continue;
+            }
+            const std::size_t last = --pool.m_count;
+            for (std::size_t field = 0; field < ParticlePool::kFieldCount; ++field) {
+                float* values = pool.field(static_cast<ParticlePool::Field>(field));
+                values[i] = values[last];
+            }
+        }
+    }
+}
+
+void ParticleSystem::clear() {
+    for (ParticlePool& pool : m_pools) {
+        pool.m_count = 0;
+    }
+}
+
+const ParticlePool& ParticleSystem::pool(ParticleKind kind) const {
+    return m_pools[static_cast<std::size_t>(kind)];
+}
+
+std::size_t ParticleSystem::size() const {
+    std::size_t total = 0;
+    for (const ParticlePool& pool : m_pools) {
+        total += pool.size();
+    }
+    return total;
+}
+
+const ParticleLook& ParticleSystem::look(ParticleKind kind) {
+    return kLooks[static_cast<std::size_t>(kind)];
+}
+
+std::size_t ParticleSystem::collectLights(std::span<Light> outLights) const {
+    struct Cluster {
+        int cellX;
+        int cellY;
+        float weight;
+        float sumX;
+        float sumY;
+    };
+    std::array<Cluster, kLightCells> clusters{};
+    std::size_t used = 0;
+
+    const ParticlePool& embers = pool(ParticleKind::Ember);
+    const float* x = embers.x();
+    const float* y = embers.y();
+    const float* age = embers.age();
+    for (std::size_t i = 0; i < embers.size(); ++i) {
+        const int cellX = tileOf(x[i] / kLightCellTiles);
+        const int cellY = tileOf(y[i] / kLightCellTiles);
+        std::size_t slot = (static_cast<std::size_t>(cellX) * 73856093U ^ static_cast<std::size_t>(cellY) * 19349663U) % kLightCells;
+        for (std::size_t probe = 0; probe < kLightCells; ++probe) {
+            Cluster& cluster = clusters[slot];
+            if (cluster.weight == 0.0F && used < kLightCells) {
+                cluster = Cluster{cellX, cellY, 0.0F, 0.0F, 0.0F};
+                ++used;
+            }
+            if (cluster.cellX == cellX && cluster.cellY == cellY) {
+                // Young embers burn brighter.
+                const float weight = 1.0F - age[i];
+                cluster.weight += weight;
+                cluster.sumX += x[i] * weight;
+                cluster.sumY += y[i] * weight;
+                break;
+            }
+            slot = (slot + 1) % kLightCells;
+        }
+    }
+
+    std::size_t written = 0;
+    while (written < outLights.size()) {
+        const auto brightest = std::max_element(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) {
+            return a.weight < b.weight;
+        });
+        if (brightest->weight < kMinLightWeight) {
+            break;
+        }
+        // Snapped to the tile, so the light's occlusion is recast only when
+        // the cluster drifts into another tile.
+        const float lightX = std::round(brightest->sumX / brightest->weight);
+        const float lightY = std::round(brightest->sumY / brightest->weight);
+        const float radius = std::min(4.0F, 1.2F + 0.25F * std::sqrt(brightest->weight));
+        const float intensity = std::min(0.9F, 0.04F * brightest->weight);
+        outLights[written++] = Light{lightX, lightY, radius, intensity, 1.00F, 0.55F, 0.22F, kLightFalloff};
+        brightest->weight = 0.0F;
+    }
+    return written;
+}
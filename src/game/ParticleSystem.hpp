@@ -0,0 +1,118 @@
+#pragma once
+
+#include "render/Light.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+
+class Map;
+
+enum class ParticleKind : std::uint8_t {
+    Dust,
+    Ember,
+    Smoke,
+};
+
+constexpr std::size_t kParticleKindCount = 3;
+
+// How a kind is drawn over its life: colour (with alpha) and size in pixels
+// blend linearly from start to end. Emissive particles glow rather than
+// reflect, so a path that cannot light them draws them at full colour.
+struct ParticleLook {
+    std::array<float, 4> startColor;
+    std::array<float, 4> endColor;
+    float startSize;
+    float endSize;
+    bool emissive;
+};
+
+// Particles of one kind, stored as one array per field. Positions are in
+// tiles; z is the height above the ground, in tile heights. Age runs from 0 at
+// birth to 1 at death.
+class ParticlePool {
+public:
+    explicit ParticlePool(std::size_t capacity);
+
+    std::size_t size() const;
+    std::size_t capacity() const;
+    const float* x() const;
+    const float* y() const;
+    const float* z() const;
+    const float* age() const;
+
+private:
+    friend class ParticleSystem;
+
+    enum Field : std::size_t {
+        kX,
+        kY,
+        kZ,
+        kVelocityX,
+        kVelocityY,
+        kVelocityZ,
+        kAge,
+        kAgeRate,
+        kFieldCount,
+    };
+
+    float* field(Field name);
+    const float* field(Field name) const;
+
+    // Fields back to back, m_capacity floats each. The capacity is a multiple
+    // of four, so every field starts on a 16-byte boundary.
+    std::unique_ptr<float[]> m_storage;
+    std::size_t m_capacity = 0;
+    std::size_t m_count = 0;
+};
+
+// Continuous emission at a point, e.g. dust behind the player or embers over a
+// lamp. Fractional particles carry over between steps in `pending`.
+struct ParticleEmitter {
+    ParticleKind kind;
+    float x;
+    float y;
+    float z;
+    float perSecond;
+    float pending = 0.0F;
+};
+
+// Dust, embers and smoke in fixed pools, so emitting and updating never
+// allocate. update() runs in the fixed simulation step: integration and the
+// ground bounce go four particles at a time with SSE, wall collision is a
+// tile lookup only for particles that cross into another tile, and dead
+// particles are swapped out with the last live one.
+class ParticleSystem {
+public:
+    static constexpr std::size_t kPoolCapacity = 65536;
+    // Particle lights handed to the lighting pass at most.
+    static constexpr std::size_t kMaxParticleLights = 3;
+    // Falloff exponent of every particle light.
+    static constexpr float kLightFalloff = 2.0F;
+
+    ParticleSystem();
+
+    // Spawns up to `count` particles of `kind` around (x, y) at height z with
+    // the kind's random spread; returns how many fit in the pool.
+    std::size_t emit(ParticleKind kind, float x, float y, float z, std::size_t count);
+    void runEmitter(ParticleEmitter& emitter, float dtSeconds);
+    void update(const Map& map, float dtSeconds);
+    void clear();
+
+    const ParticlePool& pool(ParticleKind kind) const;
+    std::size_t size() const;
+    static const ParticleLook& look(ParticleKind kind);
+
+    // Groups glowing particles (embers) into clusters a few tiles wide and
+    // writes a light for each of the brightest clusters, up to
+    // outLights.size(). Returns the number written.
+    std::size_t collectLights(std::span<Light> outLights) const;
+
+private:
+    float random();
+
+    std::array<ParticlePool, kParticleKindCount> m_pools;
+    std::uint64_t m_rngState = 0x9E3779B97F4A7C15ULL;
+};
@@ -7,6 +7,9 @@
 
 namespace {
 constexpr float kTau = 6.28318530718F;
+constexpr float kCollisionRadius = 0.25F;
+// Furthest a door tile's edge may be from the player's centre to be used.
+constexpr float kUseReach = 0.75F;
 }
 
 void Player::setPosition(float x, float y) {
@@ -37,15 +40,11 @@ void Player::update(const InputState& input, const Map& map, float dtSeconds) {
         dy /= length;
     }
 
-    const float candidateX = m_x + dx * m_speed * dtSeconds;
-    const float candidateY = m_y + dy * m_speed * dtSeconds;
-
-    if (!map.isBlocked(static_cast<int>(candidateX), static_cast<int>(m_y))) {
-        m_x = candidateX;
-    }
-    if (!map.isBlocked(static_cast<int>(m_x), static_cast<int>(candidateY))) {
-        m_y = candidateY;
-    }
+    // Swept against the walls, so a long step cannot pass through one.
+    const SweepResult moved =
+        map.sweepCircle(m_x, m_y, kCollisionRadius, dx * m_speed * dtSeconds, dy * m_speed * dtSeconds);
+    m_x = moved.x;
+    m_y = moved.y;
 
     const float targetBlend = length > 0.0F ? 1.0F : 0.0F;
     const float blendRate = 8.0F;
@@ -60,7 +59,50 @@ void Player::update(const InputState& input, const Map& map, float dtSeconds) {
     }
 }
 
+bool Player::toggleNearbyDoor(Map& map) const {
+    const int centerX = static_cast<int>(std::floor(m_x));
+    const int centerY = static_cast<int>(std::floor(m_y));
+    int doorX = 0;
+    int doorY = 0;
+    float nearest = kUseReach;
+    bool found = false;
+    for (int y = centerY - 1; y <= centerY + 1; ++y) {
+        for (int x = centerX - 1; x <= centerX + 1; ++x) {
+            const char tile = map.tileAt(x, y);
+            if (tile != Map::kClosedDoorTile && tile != Map::kOpenDoorTile) {
+                continue;
+            }
+            // Distance from the player's centre to the closest point of the tile.
+            const float dx = m_x - std::clamp(m_x, static_cast<float>(x), static_cast<float>(x + 1));
+            const float dy = m_y - std::clamp(m_y, static_cast<float>(y), static_cast<float>(y + 1));
+            const float distance = std::sqrt(dx * dx + dy * dy);
+            if (distance > nearest) {
+                continue;
+            }
+            if (tile == Map::kOpenDoorTile && distance < kCollisionRadius) {
+                continue;
+            }
+            nearest = distance;
+            doorX = x;
+            doorY = y;
+            found = true;
+        }
+    }
+    return found && map.toggleDoor(doorX, doorY);
+}
+
 float Player::x() const { return m_x; }
 float Player::y() const { return m_y; }
 float Player::walkPhase() const { return m_walkPhase; }
 float Player::moveBlend() const { return m_moveBlend; }
+
+PlayerState Player::state() const {
+    return PlayerState{m_x, m_y, m_walkPhase, m_moveBlend};
+}
+
+void Player::restoreState(const PlayerState& state) {
+    m_x = state.x;
+    m_y = state.y;
+    m_walkPhase = state.walkPhase;
+    m_moveBlend = state.moveBlend;
+}
@@ -9,16 +9,30 @@ struct InputState {
 
 class Map;
 
+// Everything update() advances; enough to resume the player from a save.
+struct PlayerState {
+    float x;
+    float y;
+    float walkPhase;
+    float moveBlend;
+};
+
 class Player {
 public:
     void setPosition(float x, float y);
     void update(const InputState& input, const Map& map, float dtSeconds);
+    // Opens or closes the nearest door within reach. A door is not closed on
+    // top of the player. Returns whether a door changed.
+    bool toggleNearbyDoor(Map& map) const;
 
     float x() const;
     float y() const;
     float walkPhase() const;
     float moveBlend() const;
 
+    PlayerState state() const;
+    void restoreState(const PlayerState& state);
+
 private:
     float m_x = 2.0F;
     float m_y = 2.0F;
@@ -0,0 +1,156 @@
+#include "game/SimulationLod.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+bool parseNumber(std::string_view text, float& outValue) {
+    const char* end = text.data() + text.size();
+    const auto result = std::from_chars(text.data(), end, outValue);
+    return result.ec == std::errc{} && result.ptr == end;
+}
+
+bool parseNumber(std::string_view text, std::uint32_t& outValue) {
+    const char* end = text.data() + text.size();
+    const auto result = std::from_chars(text.data(), end, outValue);
+    return result.ec == std::errc{} && result.ptr == end;
+}
+
+} // namespace
+
+bool SimulationLodSettings::parse(std::string_view text, SimulationLodSettings& outSettings) {
+    SimulationLodSettings settings = outSettings;
+    settings.tierCount = 0;
+    while (!text.empty()) {
+        const std::size_t comma = text.find(',');
+        const std::string_view entry = text.substr(0, comma);
+        text = comma == std::string_view::npos ? std::string_view{} : text.substr(comma + 1);
+
+        const std::size_t colon = entry.find(':');
+        if (colon == std::string_view::npos) {
+            return false;
+        }
+        std::uint32_t period = 0;
+        if (!parseNumber(entry.substr(colon + 1), period) || period == 0) {
+            return false;
+        }
+        // The coarse rate ends the list.
+        if (entry.substr(0, colon) == "*") {
+            if (!text.empty()) {
+                return false;
+            }
+            settings.coarsePeriod = period;
+            break;
+        }
+
+        float radius = 0.0F;
+        if (settings.tierCount == kMaxTiers || !parseNumber(entry.substr(0, colon), radius) || !(radius > 0.0F) ||
+            (settings.tierCount > 0 && radius <= settings.tiers[settings.tierCount - 1].radius)) {
+            return false;
+        }
+        settings.tiers[settings.tierCount++] = LodTier{radius, period};
+    }
+    if (settings.tierCount == 0) {
+        return false;
+    }
+    outSettings = settings;
+    return true;
+}
+
+SimulationLodSettings SimulationLodSettings::fullRate() {
+    SimulationLodSettings settings;
+    settings.tiers[0] = LodTier{std::numeric_limits<float>::infinity(), 1};
+    settings.tierCount = 1;
+    settings.coarsePeriod = 1;
+    return settings;
+}
+
+void SimulationLod::configure(const SimulationLodSettings& settings) {
+    m_settings = settings;
+    // Forces a reclassification on the next step.
+    m_order.clear();
+}
+
+const SimulationLodSettings& SimulationLod::settings() const {
+    return m_settings;
+}
+
+std::size_t SimulationLod::classify(float x, float y, float focusX, float focusY) const {
+    // Unloaded: the nearest point of the actor's region is out of reach.
+    const float outerRadius = m_settings.tiers[m_settings.tierCount - 1].radius;
+    const auto region = static_cast<float>(m_settings.regionTiles);
+    const float left = std::floor(x / region) * region;
+    const float top = std::floor(y / region) * region;
+    const float regionDx = focusX - std::clamp(focusX, left, left + region);
+    const float regionDy = focusY - std::clamp(focusY, top, top + region);
+    if (regionDx * regionDx + regionDy * regionDy > outerRadius * outerRadius) {
+        return m_settings.tierCount;
+    }
+
+    const float dx = x - focusX;
+    const float dy = y - focusY;
+    const float distanceSquared = dx * dx + dy * dy;
+    for (std::size_t tier = 0; tier + 1 < m_settings.tierCount; ++tier) {
+        if (distanceSquared <= m_settings.tiers[tier].radius * m_settings.tiers[tier].radius) {
+            return tier;
+        }
+    }
+    // A loaded region reaches a little past the last radius; its actors stay
+    // in the last tier.
+    return m_settings.tierCount - 1;
+}
+
+std::size_t SimulationLod::tierCount() const {
+    return m_settings.tierCount;
+}
+
+std::size_t SimulationLod::bucketSize(std::size_t tier) const {
+    return tier <= m_settings.tierCount ? m_bucketStart[tier + 1] - m_bucketStart[tier] : 0;
+}
+
+std::span<const std::uint8_t> SimulationLod::tiers() const {
+    return m_tiers;
+}
+
+bool SimulationLod::restoreTiers(std::span<const std::uint8_t> tiers) {
+    const bool valid = std::all_of(tiers.begin(), tiers.end(), [this](std::uint8_t tier) {
+        return tier <= m_settings.tierCount;
+    });
+    if (!valid) {
+        m_order.clear();
+        return false;
+    }
+    m_tiers.assign(tiers.begin(), tiers.end());
+    buildBuckets();
+    return true;
+}
+
+void SimulationLod::reclassify(float focusX, float focusY, std::span<const float> xs, std::span<const float> ys) {
+    m_tiers.resize(xs.size());
+    for (std::size_t i = 0; i < xs.size(); ++i) {
+        m_tiers[i] = static_cast<std::uint8_t>(classify(xs[i], ys[i], focusX, focusY));
+    }
+    buildBuckets();
+}
+
+void SimulationLod::buildBuckets() {
+    // Counting sort by tier, stable in actor order; the buffers keep their
+    // capacity, so only a population change allocates.
+    m_order.resize(m_tiers.size());
+    std::array<std::size_t, SimulationLodSettings::kMaxTiers + 2> counts{};
+    for (const std::uint8_t tier : m_tiers) {
+        ++counts[tier];
+    }
+
+    m_bucketStart[0] = 0;
+    for (std::size_t tier = 0; tier + 1 < m_bucketStart.size(); ++tier) {
+        m_bucketStart[tier + 1] = m_bucketStart[tier] + counts[tier];
+    }
+    std::array<std::size_t, SimulationLodSettings::kMaxTiers + 2> next = m_bucketStart;
+    for (std::size_t i = 0; i < m_tiers.size(); ++i) {
+        m_order[next[m_tiers[i]]++] = static_cast<std::uint32_t>(i);
+    }
+}
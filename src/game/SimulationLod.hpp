@@ -0,0 +1,103 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+// Actors within `radius` tiles of the focus, and outside every nearer tier,
+// update once every `period` fixed steps.
+struct LodTier {
+    float radius;
+    std::uint32_t period;
+};
+
+// Distance tiers, nearest first, and the rate of the coarse updates given to
+// actors in unloaded regions. The map is cut into regionTiles-square regions;
+// a region is unloaded when none of it lies within the last tier's radius.
+struct SimulationLodSettings {
+    static constexpr std::size_t kMaxTiers = 4;
+
+    std::array<LodTier, kMaxTiers> tiers{{{16.0F, 1}, {40.0F, 4}, {96.0F, 16}, {0.0F, 0}}};
+    std::size_t tierCount = 3;
+    std::uint32_t coarsePeriod = 120;
+    int regionTiles = 32;
+
+    // Comma-separated "radius:period" tiers, nearest first, optionally ending
+    // in "*:period" for the coarse rate, e.g. "16:1,40:4,96:16,*:120".
+    // Returns false, leaving outSettings alone, when the text is malformed.
+    static bool parse(std::string_view text, SimulationLodSettings& outSettings);
+    // Every actor on every step: the reference the tiers are measured against.
+    static SimulationLodSettings fullRate();
+};
+
+// Decides which actors update on each fixed step. Actors are bucketed by tier
+// from their positions every kReclassifySteps steps; bucket `coarse` holds the
+// ones in unloaded regions. In a tier with period p, actor i is due when
+// (i + step) % p == 0. The phase belongs to the actor, not to its place in the
+// bucket, so reclassifying never delays anyone: an actor that stays in a tier
+// is updated exactly once every period, and the actors of a tier spread over
+// the period by index. The plan depends only on the step, the focus and the
+// positions, so a replay of the same steps updates the same actors.
+class SimulationLod {
+public:
+    static constexpr std::uint32_t kReclassifySteps = 10;
+
+    void configure(const SimulationLodSettings& settings);
+    const SimulationLodSettings& settings() const;
+
+    // Tier of an actor at (x, y); tierCount() means coarse.
+    std::size_t classify(float x, float y, float focusX, float focusY) const;
+    std::size_t tierCount() const;
+    // Actors per bucket at the last reclassification, coarse last.
+    std::size_t bucketSize(std::size_t tier) const;
+    // Every actor's tier at the last reclassification, in actor order.
+    std::span<const std::uint8_t> tiers() const;
+    // Puts back tiers saved from tiers(), so a restored population follows the
+    // same plan as the one saved. Returns false, leaving a reclassification
+    // due on the next step, when a tier is out of range for the settings.
+    bool restoreTiers(std::span<const std::uint8_t> tiers);
+
+    // Calls visit(actor, tier) for every actor due on `step`.
+    template <typename F>
+    void forEachDue(
+        std::uint64_t step,
+        float focusX,
+        float focusY,
+        std::span<const float> xs,
+        std::span<const float> ys,
+        const F& visit) {
+        if (xs.size() != m_order.size() || step % kReclassifySteps == 0) {
+            reclassify(focusX, focusY, xs, ys);
+        }
+        for (std::size_t tier = 0; tier <= m_settings.tierCount; ++tier) {
+            const std::uint64_t period = tier < m_settings.tierCount ? m_settings.tiers[tier].period : m_settings.coarsePeriod;
+            if (period == 1) {
+                for (std::size_t i = m_bucketStart[tier]; i < m_bucketStart[tier + 1]; ++i) {
+                    visit(m_order[i], tier);
+                }
+                continue;
+            }
+            // Only actors whose phase matches this step can be due; check
+            // those against the tier rather than walking the whole bucket.
+            const std::size_t first = static_cast<std::size_t>((period - step % period) % period);
+            for (std::size_t actor = first; actor < m_tiers.size(); actor += static_cast<std::size_t>(period)) {
+                if (m_tiers[actor] == tier) {
+                    visit(static_cast<std::uint32_t>(actor), tier);
+                }
+            }
+        }
+    }
+
+private:
+    void reclassify(float focusX, float focusY, std::span<const float> xs, std::span<const float> ys);
+    void buildBuckets();
+
+    SimulationLodSettings m_settings;
+    // Actor indices grouped by bucket, in actor order within each bucket.
+    std::vector<std::uint32_t> m_order;
+    std::vector<std::uint8_t> m_tiers;
+    std::array<std::size_t, SimulationLodSettings::kMaxTiers + 2> m_bucketStart{};
+};
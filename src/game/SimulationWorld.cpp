@@ -0,0 +1,61 @@
+#include "game/SimulationWorld.hpp"
+
+#include <bit>
+
+namespace {
+constexpr std::uint64_t kFnvPrime = 0x100000001B3ULL;
+
+std::uint64_t hashFloat(std::uint64_t hash, float value) {
+    std::uint32_t bits = std::bit_cast<std::uint32_t>(value);
+    for (int i = 0; i < 4; ++i) {
+        hash = (hash ^ (bits & 0xFFU)) * kFnvPrime;
+        bits >>= 8U;
+    }
+    return hash;
+}
+} // namespace
+
+void SimulationWorld::spawn(
+    const Map& map,
+    float playerX,
+    float playerY,
+    std::size_t townsfolk,
+    std::uint32_t seed,
+    const SimulationLodSettings& lod) {
+    m_player.setPosition(playerX, playerY);
+    m_camera.snapTo(playerX, playerY);
+    m_townsfolk.configure(lod);
+    m_townsfolk.spawn(map, townsfolk, seed);
+}
+
+InputScript& SimulationWorld::input() {
+    return m_input;
+}
+
+void SimulationWorld::step(const Map& map, float dtSeconds) {
+    m_player.update(m_input.next(), map, dtSeconds);
+    m_camera.follow(m_player.x(), m_player.y(), dtSeconds);
+    m_townsfolk.update(map, m_camera.x(), m_camera.y(), dtSeconds);
+}
+
+const Player& SimulationWorld::player() const {
+    return m_player;
+}
+
+const Townsfolk& SimulationWorld::townsfolk() const {
+    return m_townsfolk;
+}
+
+std::uint64_t SimulationWorld::hashState(std::uint64_t hash) const {
+    const PlayerState player = m_player.state();
+    for (const float value : {player.x, player.y, player.walkPhase, player.moveBlend, m_camera.x(), m_camera.y()}) {
+        hash = hashFloat(hash, value);
+    }
+    for (std::size_t i = 0; i < m_townsfolk.size(); ++i) {
+        const TownsfolkPose pose = m_townsfolk.pose(i);
+        for (const float value : {pose.x, pose.y, pose.walkPhase, pose.moveBlend}) {
+            hash = hashFloat(hash, value);
+        }
+    }
+    return hash;
+}
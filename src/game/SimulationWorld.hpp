@@ -0,0 +1,43 @@
+#pragma once
+
+#include "game/Camera.hpp"
+#include "game/InputScript.hpp"
+#include "game/Player.hpp"
+#include "game/Townsfolk.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+class Map;
+
+// One independent world without a window: a player driven by an InputScript,
+// the camera that is the townsfolk's LOD focus, and the townsfolk. step() is
+// the game's fixed simulation step. The map is shared and only read, so
+// different worlds can step on different threads at once.
+class SimulationWorld {
+public:
+    // Places the player at (playerX, playerY) and `townsfolk` townsfolk from
+    // `seed`; the input keeps whatever script it was given.
+    void spawn(
+        const Map& map,
+        float playerX,
+        float playerY,
+        std::size_t townsfolk,
+        std::uint32_t seed,
+        const SimulationLodSettings& lod);
+
+    InputScript& input();
+    void step(const Map& map, float dtSeconds);
+
+    const Player& player() const;
+    const Townsfolk& townsfolk() const;
+    // Folds everything step() advances into `hash` (FNV-1a), so two runs can
+    // be checked for the same outcome.
+    std::uint64_t hashState(std::uint64_t hash) const;
+
+private:
+    Player m_player;
+    Camera m_camera;
+    Townsfolk m_townsfolk;
+    InputScript m_input;
+};
@@ -0,0 +1,244 @@
+#include "game/Townsfolk.hpp"
+
+#include "game/Map.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+constexpr float kTau = 6.28318530718F;
+constexpr float kCollisionRadius = 0.25F;
+constexpr float kWalkSpeed = 1.6F;
+constexpr float kWalkCyclesPerSecond = 1.2F;
+constexpr float kBlendRate = 6.0F;
+constexpr float kMinWait = 1.0F;
+constexpr float kMaxWait = 4.0F;
+// Targets are open tiles at most this many tiles away on each axis.
+constexpr int kWanderReach = 6;
+constexpr int kTargetAttempts = 8;
+constexpr int kSpawnAttempts = 64;
+// Coarse updates assume walking takes this much longer than the straight line.
+constexpr float kDetour = 1.3F;
+// A walk step that covers less than this share of its move is stuck on a wall.
+constexpr float kStuckFraction = 0.1F;
+constexpr float kArriveDistance = 0.05F;
+
+std::uint32_t nextRandom(std::uint32_t& state) {
+    state ^= state << 13U;
+    state ^= state >> 17U;
+    state ^= state << 5U;
+    return state;
+}
+
+// Spreads a seed and an index over a non-zero xorshift state.
+std::uint32_t streamSeed(std::uint32_t seed, std::size_t index) {
+    std::uint32_t state = seed ^ (static_cast<std::uint32_t>(index) * 0x9E3779B9U);
+    state ^= state >> 16U;
+    state *= 0x85EBCA6BU;
+    state ^= state >> 13U;
+    return state != 0 ? state : 0x6D2B79F5U;
+}
+} // namespace
+
+void Townsfolk::configure(const SimulationLodSettings& settings) {
+    m_lod.configure(settings);
+}
+
+void Townsfolk::spawn(const Map& map, std::size_t count, std::uint32_t seed) {
+    clear();
+    std::uint32_t placement = streamSeed(seed, count);
+    for (std::size_t i = 0; i < count; ++i) {
+        for (int attempt = 0; attempt < kSpawnAttempts; ++attempt) {
+            const int x = static_cast<int>(nextRandom(placement) % static_cast<std::uint32_t>(std::max(map.width(), 1)));
+            const int y = static_cast<int>(nextRandom(placement) % static_cast<std::uint32_t>(std::max(map.height(), 1)));
+            if (map.isBlocked(x, y)) {
+                continue;
+            }
+            Walker walker{};
+            walker.targetX = static_cast<float>(x) + 0.5F;
+            walker.targetY = static_cast<float>(y) + 0.5F;
+            walker.rng = streamSeed(seed, i);
+            walker.outfit = static_cast<std::uint8_t>(i % kOutfitCount);
+            rest(walker);
+            m_x.push_back(walker.targetX);
+            m_y.push_back(walker.targetY);
+            m_walkers.push_back(walker);
+            break;
+        }
+    }
+}
+
+void Townsfolk::clear() {
+    m_x.clear();
+    m_y.clear();
+    m_walkers.clear();
+    m_step = 0;
+    m_updatesLastStep = 0;
+}
+
+void Townsfolk::copyState(TownsfolkState& outState) const {
+    outState.step = m_step;
+    outState.x.assign(m_x.begin(), m_x.end());
+    outState.y.assign(m_y.begin(), m_y.end());
+    outState.walkers.assign(m_walkers.begin(), m_walkers.end());
+    // Tiers left over from an earlier population are not this one's.
+    const std::span<const std::uint8_t> tiers = m_lod.tiers();
+    if (tiers.size() == m_x.size()) {
+        outState.lodTiers.assign(tiers.begin(), tiers.end());
+    } else {
+        outState.lodTiers.clear();
+    }
+}
+
+bool Townsfolk::restoreState(const TownsfolkState& state) {
+    const std::size_t count = state.walkers.size();
+    if (state.x.size() != count || state.y.size() != count ||
+        (!state.lodTiers.empty() && state.lodTiers.size() != count)) {
+        return false;
+    }
+    m_x = state.x;
+    m_y = state.y;
+    m_walkers = state.walkers;
+    m_step = state.step;
+    m_updatesLastStep = 0;
+    // No saved tiers (nothing stepped yet) or tiers from other settings fall
+    // back to classifying afresh on the next step.
+    if (state.lodTiers.empty() || !m_lod.restoreTiers(state.lodTiers)) {
+        m_lod.configure(m_lod.settings());
+    }
+    return true;
+}
+
+void Townsfolk::update(const Map& map, float focusX, float focusY, float dtSeconds) {
+    ++m_step;
+    std::size_t updates = 0;
+    m_lod.forEachDue(m_step, focusX, focusY, m_x, m_y, [&](std::uint32_t index, std::size_t tier) {
+        Walker& walker = m_walkers[index];
+        const float seconds = static_cast<float>(m_step - walker.lastStep) * dtSeconds;
+        walker.lastStep = m_step;
+        if (tier < m_lod.tierCount()) {
+            walk(index, map, seconds);
+        } else {
+            skim(index, map, seconds);
+        }
+        ++updates;
+    });
+    m_updatesLastStep = updates;
+}
+
+void Townsfolk::walk(std::size_t index, const Map& map, float seconds) {
+    Walker& walker = m_walkers[index];
+    if (walker.wait > 0.0F) {
+        walker.wait -= seconds;
+        walker.moveBlend -= walker.moveBlend * std::min(1.0F, kBlendRate * seconds);
+        if (walker.wait > 0.0F) {
+            return;
+        }
+        // Whatever is left of the step goes into walking to the next target.
+        seconds = -walker.wait;
+        walker.wait = 0.0F;
+        pickTarget(index, map);
+        if (walker.wait > 0.0F) {
+            return;
+        }
+    }
+
+    const float dx = walker.targetX - m_x[index];
+    const float dy = walker.targetY - m_y[index];
+    const float distance = std::sqrt(dx * dx + dy * dy);
+    const float reach = kWalkSpeed * seconds;
+    if (distance > kArriveDistance && reach > 0.0F) {
+        const float scale = std::min(reach, distance) / distance;
+        const SweepResult moved = map.sweepCircle(m_x[index], m_y[index], kCollisionRadius, dx * scale, dy * scale);
+        const float progressX = moved.x - m_x[index];
+        const float progressY = moved.y - m_y[index];
+        m_x[index] = moved.x;
+        m_y[index] = moved.y;
+        walker.walkPhase = std::fmod(walker.walkPhase + kTau * kWalkCyclesPerSecond * seconds, kTau);
+        walker.moveBlend += (1.0F - walker.moveBlend) * std::min(1.0F, kBlendRate * seconds);
+
+        const float progress = std::sqrt(progressX * progressX + progressY * progressY);
+        if (moved.collided && progress < kStuckFraction * std::min(reach, distance)) {
+            pickTarget(index, map);
+            return;
+        }
+        if (reach < distance) {
+            return;
+        }
+    }
+    rest(walker);
+}
+
+void Townsfolk::skim(std::size_t index, const Map& map, float seconds) {
+    Walker& walker = m_walkers[index];
+    walker.moveBlend = 0.0F;
+    if (walker.wait > 0.0F) {
+        walker.wait -= seconds;
+        if (walker.wait > 0.0F) {
+            return;
+        }
+        seconds = -walker.wait;
+        walker.wait = 0.0F;
+        pickTarget(index, map);
+        if (walker.wait > 0.0F) {
+            return;
+        }
+    }
+
+    // Nobody is watching: the walk is skipped and the townsperson appears at
+    // the target once it would have got there.
+    walker.travel -= seconds;
+    if (walker.travel <= 0.0F) {
+        m_x[index] = walker.targetX;
+        m_y[index] = walker.targetY;
+        rest(walker);
+    }
+}
+
+void Townsfolk::rest(Walker& walker) {
+    walker.wait = kMinWait + random(walker) * (kMaxWait - kMinWait);
+    walker.travel = 0.0F;
+}
+
+void Townsfolk::pickTarget(std::size_t index, const Map& map) {
+    Walker& walker = m_walkers[index];
+    const int originX = static_cast<int>(std::floor(m_x[index]));
+    const int originY = static_cast<int>(std::floor(m_y[index]));
+    constexpr auto kSpan = static_cast<std::uint32_t>(kWanderReach * 2 + 1);
+    for (int attempt = 0; attempt < kTargetAttempts; ++attempt) {
+        const int x = originX + static_cast<int>(nextRandom(walker.rng) % kSpan) - kWanderReach;
+        const int y = originY + static_cast<int>(nextRandom(walker.rng) % kSpan) - kWanderReach;
+        if ((x == originX && y == originY) || map.isBlocked(x, y)) {
+            continue;
+        }
+        walker.targetX = static_cast<float>(x) + 0.5F;
+        walker.targetY = static_cast<float>(y) + 0.5F;
+        const float dx = walker.targetX - m_x[index];
+        const float dy = walker.targetY - m_y[index];
+        walker.travel = std::sqrt(dx * dx + dy * dy) / kWalkSpeed * kDetour;
+        return;
+    }
+    // Boxed in: stand a while and try again.
+    rest(walker);
+}
+
+float Townsfolk::random(Walker& walker) {
+    return static_cast<float>(nextRandom(walker.rng) >> 8U) * (1.0F / 16777216.0F);
+}
+
+std::size_t Townsfolk::size() const {
+    return m_walkers.size();
+}
+
+TownsfolkPose Townsfolk::pose(std::size_t index) const {
+    const Walker& walker = m_walkers[index];
+    return TownsfolkPose{m_x[index], m_y[index], walker.walkPhase, walker.moveBlend, walker.outfit};
+}
+
+const SimulationLod& Townsfolk::lod() const {
+    return m_lod;
+}
+
+std::size_t Townsfolk::updatesLastStep() const {
+    return m_updatesLastStep;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "game/SimulationLod.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class Map;
+
+// What the renderer needs of one townsperson.
+struct TownsfolkPose {
+    float x;
+    float y;
+    float walkPhase;
+    float moveBlend;
+    std::uint8_t outfit;
+};
+
+// What a townsperson carries besides its position. Plain data, so snapshots
+// store arrays of it as they are.
+struct TownsfolkWalker {
+    float targetX;
+    float targetY;
+    float walkPhase;
+    float moveBlend;
+    // Seconds left standing still; walking when not positive.
+    float wait;
+    // Expected seconds left to reach the target, for coarse updates.
+    float travel;
+    std::uint64_t lastStep;
+    std::uint32_t rng;
+    std::uint8_t outfit;
+};
+
+// Everything a population advances, as bulk arrays in townsperson order,
+// plus the LOD tiers in force so a restored town follows the same plan.
+struct TownsfolkState {
+    std::uint64_t step = 0;
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<TownsfolkWalker> walkers;
+    std::vector<std::uint8_t> lodTiers;
+};
+
+// Townsfolk wandering the map: each walks to a random open tile nearby, waits
+// a moment, and picks another. Updates are scheduled by SimulationLod around
+// the focus (the camera). Loaded actors walk with wall collision over the
+// time since their last update; actors in unloaded regions are updated
+// coarsely, jumping to their target once the expected walking time has
+// passed. Every townsperson has its own random stream, so what one does never
+// depends on when the others were updated.
+class Townsfolk {
+public:
+    static constexpr std::size_t kOutfitCount = 4;
+
+    void configure(const SimulationLodSettings& settings);
+    // Replaces the population with `count` townsfolk on random open tiles.
+    // The same map, count and seed give the same town.
+    void spawn(const Map& map, std::size_t count, std::uint32_t seed);
+    void clear();
+    // Copies the population into `outState`, reusing its buffers.
+    void copyState(TownsfolkState& outState) const;
+    // Replaces the population with a copied one. Returns false, leaving the
+    // population alone, when the arrays differ in length.
+    bool restoreState(const TownsfolkState& state);
+
+    // Advances one fixed step of dtSeconds with the focus at (focusX, focusY).
+    void update(const Map& map, float focusX, float focusY, float dtSeconds);
+
+    std::size_t size() const;
+    TownsfolkPose pose(std::size_t index) const;
+    const SimulationLod& lod() const;
+    // Townsfolk updated by the last step.
+    std::size_t updatesLastStep() const;
+
+private:
+    using Walker = TownsfolkWalker;
+
+    void walk(std::size_t index, const Map& map, float seconds);
+    void skim(std::size_t index, const Map& map, float seconds);
+    void rest(Walker& walker);
+    void pickTarget(std::size_t index, const Map& map);
+    static float random(Walker& walker);
+
+    // Positions apart from the rest so classification streams through them.
+    std::vector<float> m_x;
+    std::vector<float> m_y;
+    std::vector<Walker> m_walkers;
+    SimulationLod m_lod;
+    std::uint64_t m_step = 0;
+    std::size_t m_updatesLastStep = 0;
+};
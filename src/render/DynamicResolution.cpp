@@ -0,0 +1,86 @@
+#include "render/DynamicResolution.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace {
+// Scales snap to this grid so render targets are only rebuilt on real changes.
+constexpr float kScaleStep = 0.05F;
+// Frames slower than budget * kOverBudget count as missing the target; the
+// slack keeps vsync jitter from triggering a drop.
+constexpr double kOverBudget = 1.10;
+// Passes must fit in budget * kHeadroom before the scale climbs; one step up
+// costs up to ~20% more pixels at the bottom of the range.
+constexpr double kHeadroom = 0.60;
+
+float snapScale(float scale) {
+    return std::round(scale / kScaleStep) * kScaleStep;
+}
+}
+
+DynamicResolution::DynamicResolution(double targetFrameSeconds)
+    : m_targetFrameSeconds(targetFrameSeconds) {
+}
+
+void DynamicResolution::setEnabled(bool enabled) {
+    m_enabled = enabled;
+    m_sampleCount = 0;
+    if (!enabled) {
+        m_scale = m_maxScale;
+    }
+}
+
+void DynamicResolution::setTargetFrameSeconds(double seconds) {
+    m_targetFrameSeconds = std::max(seconds, 1e-4);
+    m_sampleCount = 0;
+}
+
+void DynamicResolution::setScaleRange(float minScale, float maxScale) {
+    m_maxScale = std::clamp(snapScale(maxScale), kScaleStep, 1.0F);
+    m_minScale = std::clamp(snapScale(minScale), kScaleStep, m_maxScale);
+    setScale(m_scale);
+}
+
+bool DynamicResolution::addSample(double frameSeconds, double passSeconds) {
+    if (!m_enabled) {
+        return false;
+    }
+
+    // One long stall (window drag, breakpoint) should not dominate the window.
+    const double ceiling = m_targetFrameSeconds * 4.0;
+    m_frameSamples[m_sampleCount] = std::min(frameSeconds, ceiling);
+    m_passSamples[m_sampleCount] = std::min(passSeconds, ceiling);
+    ++m_sampleCount;
+    if (m_sampleCount < kWindowFrames) {
+        return false;
+    }
+    m_sampleCount = 0;
+
+    const double frameMean = std::accumulate(m_frameSamples.begin(), m_frameSamples.end(), 0.0) / kWindowFrames;
+    const double passMean = std::accumulate(m_passSamples.begin(), m_passSamples.end(), 0.0) / kWindowFrames;
+    const float previous = m_scale;
+
+    if (frameMean > m_targetFrameSeconds * kOverBudget) {
+        // Cost is roughly proportional to pixel count, so jump straight to the
+        // scale that should fit, but always by at least one step.
+        const double fit = static_cast<double>(m_scale) * std::sqrt(m_targetFrameSeconds / frameMean);
+        setScale(std::min(static_cast<float>(fit), m_scale - kScaleStep));
+    } else if (passMean < m_targetFrameSeconds * kHeadroom) {
+        setScale(m_scale + kScaleStep);
+    }
+
+    return m_scale != previous;
+}
+
+bool DynamicResolution::enabled() const {
+    return m_enabled;
+}
+
+float DynamicResolution::scale() const {
+    return m_scale;
+}
+
+void DynamicResolution::setScale(float scale) {
+    m_scale = std::clamp(snapScale(scale), m_minScale, m_maxScale);
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <array>
+
+// Chooses the internal render scale from measured frame and pass times. Drops
+// quickly when frames miss the budget, climbs back one step at a time only
+// when passes leave clear headroom, and waits a full sample window after every
+// change so the two thresholds cannot oscillate.
+class DynamicResolution {
+public:
+    explicit DynamicResolution(double targetFrameSeconds = 1.0 / 60.0);
+
+    void setEnabled(bool enabled);
+    void setTargetFrameSeconds(double seconds);
+    void setScaleRange(float minScale, float maxScale);
+
+    // frameSeconds is the interval between presented frames; passSeconds is
+    // the cost of the render passes alone, without the swap and any vsync
+    // wait in it. Returns true when scale() changed.
+    bool addSample(double frameSeconds, double passSeconds);
+
+    bool enabled() const;
+    float scale() const;
+
+private:
+    static constexpr int kWindowFrames = 30;
+
+    void setScale(float scale);
+
+    std::array<double, kWindowFrames> m_frameSamples{};
+    std::array<double, kWindowFrames> m_passSamples{};
+    int m_sampleCount = 0;
+    double m_targetFrameSeconds;
+    float m_minScale = 0.5F;
+    float m_maxScale = 1.0F;
+    float m_scale = 1.0F;
+    bool m_enabled = true;
+};
@@ -0,0 +1,373 @@
+#include "render/FrameCapture.hpp"
+
+#include "render/GlFunctions.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <system_error>
+
+namespace {
+
+constexpr std::size_t kBytesPerPixel = 4;
+constexpr std::size_t kMaxStoredBlock = 65535;
+
+std::uint32_t crc32(const std::uint8_t* data, std::size_t size, std::uint32_t crc = 0) {
+    static const std::array<std::uint32_t, 256> table = [] {
+        std::array<std::uint32_t, 256> entries{};
+        for (std::uint32_t n = 0; n < 256; ++n) {
+            std::uint32_t c = n;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1U) != 0 ? 0xEDB88320U ^ (c >> 1) : c >> 1;
+            }
+            entries[n] = c;
+        }
+        return entries;
+    }();
+
+    crc = ~crc;
+    for (std::size_t i = 0; i < size; ++i) {
+        crc = table[(crc ^ data[i]) & 0xFFU] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+std::uint32_t adler32(const std::uint8_t* data, std::size_t size) {
+    // 5552 is the longest run whose sums cannot overflow 32 bits before the
+    // modulo has to be taken.
+    constexpr std::uint32_t kModulus = 65521;
+    constexpr std::size_t kMaxRun = 5552;
+    std::uint32_t a = 1;
+    std::uint32_t b = 0;
+    while (size > 0) {
+        const std::size_t run = std::min(size, kMaxRun);
+        for (std::size_t i = 0; i < run; ++i) {
+            a += data[i];
+            b += a;
+        }
+        a %= kModulus;
+        b %= kModulus;
+        data += run;
+        size -= run;
+    }
+    return (b << 16) | a;
+}
+
+void appendBigEndian(std::vector<std::uint8_t>& out, std::uint32_t value) {
+    out.push_back(static_cast<std::uint8_t>(value >> 24));
+    out.push_back(static_cast<std::uint8_t>(value >> 16));
+    out.push_back(static_cast<std::uint8_t>(value >> 8));
+    out.push_back(static_cast<std::uint8_t>(value));
+}
+
+void appendChunk(std::vector<std::uint8_t>& out, const char* type, const std::uint8_t* data, std::size_t size) {
+    appendBigEndian(out, static_cast<std::uint32_t>(size));
+    const std::size_t typeOffset = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data, data + size);
+    appendBigEndian(out, crc32(out.data() + typeOffset, size + 4));
+}
+
+// Rows arrive bottom-up as RGBA from glReadPixels; both formats want top-down RGB.
+void appendFlippedRgb(std::vector<std::uint8_t>& out, const std::uint8_t* pixels, int width, int height, bool pngFilterByte) {
+    const std::size_t rowBytes = static_cast<std::size_t>(width) * 3 + (pngFilterByte ? 1 : 0);
+    std::size_t offset = out.size();
+    out.resize(offset + rowBytes * static_cast<std::size_t>(height));
+    for (int y = height - 1; y >= 0; --y) {
+        std::uint8_t* target = out.data() + offset;
+        if (pngFilterByte) {
+            *target++ = 0;
+        }
+        const std::uint8_t* source =
+            pixels + static_cast<std::size_t>(y) * static_cast<std::size_t>(width) * kBytesPerPixel;
+        for (int x = 0; x < width; ++x) {
+            target[0] = source[0];
+            target[1] = source[1];
+            target[2] = source[2];
+            target += 3;
+            source += kBytesPerPixel;
+        }
+        offset += rowBytes;
+    }
+}
+
+// Stored (uncompressed) deflate blocks keep the encoder trivial and fast; the
+// captures are for diffing, not distribution.
+void encodePng(std::vector<std::uint8_t>& out, const std::uint8_t* pixels, int width, int height) {
+    std::vector<std::uint8_t> scanlines;
+    appendFlippedRgb(scanlines, pixels, width, height, true);
+
+    std::vector<std::uint8_t> zlib;
+    zlib.reserve(scanlines.size() + scanlines.size() / kMaxStoredBlock * 5 + 16);
+    zlib.push_back(0x78);
+    zlib.push_back(0x01);
+    std::size_t offset = 0;
+    do {
+        const std::size_t length = std::min(kMaxStoredBlock, scanlines.size() - offset);
+        const bool last = offset + length == scanlines.size();
+        zlib.push_back(last ? 1 : 0);
+        zlib.push_back(static_cast<std::uint8_t>(length));
+        zlib.push_back(static_cast<std::uint8_t>(length >> 8));
+        zlib.push_back(static_cast<std::uint8_t>(~length));
+        zlib.push_back(static_cast<std::uint8_t>(~length >> 8));
+        zlib.insert(zlib.end(), scanlines.begin() + static_cast<std::ptrdiff_t>(offset),
+                    scanlines.begin() + static_cast<std::ptrdiff_t>(offset + length));
+        offset += length;
+    } while (offset < scanlines.size());
+    appendBigEndian(zlib, adler32(scanlines.data(), scanlines.size()));
+
+    constexpr std::array<std::uint8_t, 8> kSignature{0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    out.insert(out.end(), kSignature.begin(), kSignature.end());
+
+    std::vector<std::uint8_t> header;
+    appendBigEndian(header, static_cast<std::uint32_t>(width));
+    appendBigEndian(header, static_cast<std::uint32_t>(height));
+    // 8-bit truecolour, deflate, adaptive filtering, no interlace.
+    header.insert(header.end(), {8, 2, 0, 0, 0});
+    appendChunk(out, "IHDR", header.data(), header.size());
+    appendChunk(out, "IDAT", zlib.data(), zlib.size());
+    appendChunk(out, "IEND", nullptr, 0);
+}
+
+void encodePpm(std::vector<std::uint8_t>& out, const std::uint8_t* pixels, int width, int height) {
+    const std::string header = "P6\n" + std::to_string(width) + ' ' + std::to_string(height) + "\n255\n";
+    out.insert(out.end(), header.begin(), header.end());
+    appendFlippedRgb(out, pixels, width, height, false);
+}
+
+} // namespace
+
+FrameCapture::~FrameCapture() {
+    stop();
+}
+
+bool FrameCapture::start(const std::filesystem::path& directory, CaptureFormat format, int interval) {
+    stop();
+
+    if (glMapBuffer == nullptr || glUnmapBuffer == nullptr) {
+        std::cerr << "Frame capture needs pixel buffer objects; capture disabled.\n";
+        return false;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error) {
+        std::cerr << "Failed to create capture directory " << directory.string() << ": " << error.message() << '\n';
+        return false;
+    }
+
+    m_directory = directory;
+    m_format = format;
+    m_interval = std::max(interval, 1);
+    m_droppedFrames = 0;
+    m_framesWritten = 0;
+    m_writeFailures = 0;
+    m_readbackHead = 0;
+    m_readbackTail = 0;
+    m_slotHead = 0;
+    m_slotTail = 0;
+    for (Readback& readback : m_readbacks) {
+        glGenBuffers(1, &readback.pbo);
+    }
+
+    m_stopping = false;
+    m_worker = std::thread(&FrameCapture::workerLoop, this);
+    m_active = true;
+    return true;
+}
+
+void FrameCapture::stop() {
+    if (!m_active) {
+        return;
+    }
+
+    collectReadbacks(true);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_slotFilled.notify_all();
+    if (m_worker.joinable()) {
+        m_worker.join();
+    }
+
+    for (Readback& readback : m_readbacks) {
+        glDeleteBuffers(1, &readback.pbo);
+        readback = Readback{};
+    }
+    m_readbackMemory.release();
+    m_active = false;
+
+    std::cerr << "Frame capture: wrote " << m_framesWritten << " frame(s) to " << m_directory.string();
+    if (m_droppedFrames > 0 || m_writeFailures > 0) {
+        std::cerr << " (" << m_droppedFrames << " dropped, " << m_writeFailures << " failed)";
+    }
+    std::cerr << '\n';
+}
+
+bool FrameCapture::active() const {
+    return m_active;
+}
+
+void FrameCapture::captureFrame(int width, int height) {
+    if (!m_active) {
+        return;
+    }
+
+    const MemoryTagScope memoryTag(MemoryTag::Capture);
+    collectReadbacks(false);
+
+    const std::uint64_t frame = m_frameIndex++;
+    if (frame % static_cast<std::uint64_t>(m_interval) != 0 || width <= 0 || height <= 0) {
+        return;
+    }
+
+    Readback& readback = m_readbacks[m_readbackHead];
+    if (readback.pending) {
+        // The GPU or the encoder is a whole ring behind; waiting here is
+        // exactly the stall this path exists to avoid.
+        ++m_droppedFrames;
+        return;
+    }
+
+    const std::size_t bytes = static_cast<std::size_t>(width) * static_cast<std::size_t>(height) * kBytesPerPixel;
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pbo);
+    if (readback.capacity < bytes) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, static_cast<GLsizeiptr>(bytes), nullptr, GL_STREAM_READ);
+        m_readbackMemory.set(m_readbackMemory.bytes() + bytes - readback.capacity);
+        readback.capacity = bytes;
+    }
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    readback.fence = g_gl.syncSupported ? glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) : nullptr;
+    readback.width = width;
+    readback.height = height;
+    readback.frame = frame;
+    readback.pending = true;
+    m_readbackHead = (m_readbackHead + 1) % kReadbackCount;
+}
+
+bool FrameCapture::readbackReady(const Readback& readback) const {
+    if (readback.fence != nullptr) {
+        const GLenum status = glClientWaitSync(readback.fence, 0, 0);
+        return status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED;
+    }
+    // Without sync objects, assume a ring's worth of frames is enough latency.
+    return m_frameIndex - readback.frame >= kReadbackCount;
+}
+
+void FrameCapture::collectReadbacks(bool wait) {
+    while (m_readbacks[m_readbackTail].pending) {
+        Readback& readback = m_readbacks[m_readbackTail];
+        if (!wait && !readbackReady(readback)) {
+            return;
+        }
+
+        EncodeSlot& slot = m_slots[m_slotHead];
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (slot.full) {
+                if (!wait) {
+                    return;
+                }
+                m_slotFreed.wait(lock, [&slot] { return !slot.full; });
+            }
+        }
+
+        // Grows only on the first capture and on window resizes.
+        const std::size_t bytes =
+            static_cast<std::size_t>(readback.width) * static_cast<std::size_t>(readback.height) * kBytesPerPixel;
+        slot.pixels.resize(bytes);
+
+        // Mapping is where an unfinished readback would block; with wait set
+        // that is the intent.
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pbo);
+        const void* mapped = glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+        const bool copied = mapped != nullptr;
+        if (copied) {
+            std::memcpy(slot.pixels.data(), mapped, bytes);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        if (readback.fence != nullptr) {
+            glDeleteSync(readback.fence);
+            readback.fence = nullptr;
+        }
+        readback.pending = false;
+        m_readbackTail = (m_readbackTail + 1) % kReadbackCount;
+
+        if (!copied) {
+            ++m_droppedFrames;
+            continue;
+        }
+
+        slot.width = readback.width;
+        slot.height = readback.height;
+        slot.frame = readback.frame;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            slot.full = true;
+        }
+        m_slotHead = (m_slotHead + 1) % kEncodeSlotCount;
+        m_slotFilled.notify_one();
+    }
+}
+
+void FrameCapture::workerLoop() {
+    const MemoryTagScope memoryTag(MemoryTag::Capture);
+    std::vector<std::uint8_t> scratch;
+    for (;;) {
+        EncodeSlot* slot = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_slotFilled.wait(lock, [this] { return m_slots[m_slotTail].full || m_stopping; });
+            if (!m_slots[m_slotTail].full) {
+                return;
+            }
+            slot = &m_slots[m_slotTail];
+        }
+
+        const bool written = writeImage(*slot, scratch);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (written) {
+                ++m_framesWritten;
+            } else {
+                ++m_writeFailures;
+            }
+            slot->full = false;
+            m_slotTail = (m_slotTail + 1) % kEncodeSlotCount;
+        }
+        m_slotFreed.notify_one();
+    }
+}
+
+bool FrameCapture::writeImage(const EncodeSlot& slot, std::vector<std::uint8_t>& scratch) const {
+    scratch.clear();
+    const char* extension = "png";
+    if (m_format == CaptureFormat::Ppm) {
+        encodePpm(scratch, slot.pixels.data(), slot.width, slot.height);
+        extension = "ppm";
+    } else {
+        encodePng(scratch, slot.pixels.data(), slot.width, slot.height);
+    }
+
+    std::array<char, 32> name{};
+    std::snprintf(name.data(), name.size(), "frame_%06llu.%s", static_cast<unsigned long long>(slot.frame), extension);
+    const std::filesystem::path path = m_directory / name.data();
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(scratch.data()), static_cast<std::streamsize>(scratch.size()));
+    if (!file) {
+        std::cerr << "Failed to write capture " << path.string() << '\n';
+        return false;
+    }
+    return true;
+}
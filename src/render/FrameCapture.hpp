@@ -0,0 +1,98 @@
+#pragma once
+
+#include <SDL2/SDL_opengl.h>
+#include <SDL2/SDL_opengl_glext.h>
+
+#include "core/MemoryAccounting.hpp"
+
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+enum class CaptureFormat {
+    Png,
+    Ppm,
+};
+
+// Writes presented frames to disk without stalling the GL thread. Each capture
+// is read into one of a ring of pixel-pack buffers and only mapped a few frames
+// later, once its fence has signalled. The mapped pixels are copied into a
+// fixed set of encode slots, and a worker thread writes them out as PNG or PPM.
+// When the ring or the encoder falls behind, frames are dropped rather than
+// waited for, and the drop count is reported on stop().
+class FrameCapture {
+public:
+    FrameCapture() = default;
+    ~FrameCapture();
+
+    FrameCapture(const FrameCapture&) = delete;
+    FrameCapture& operator=(const FrameCapture&) = delete;
+
+    // GL thread, with the context current. Captures every interval-th frame.
+    bool start(const std::filesystem::path& directory, CaptureFormat format, int interval);
+    // Waits for in-flight readbacks and encodes, then releases the buffers.
+    // Must run before the context that start() saw is destroyed.
+    void stop();
+    bool active() const;
+
+    // Call with the finished frame in the default back buffer, before the swap.
+    void captureFrame(int width, int height);
+
+private:
+    struct Readback {
+        GLuint pbo = 0;
+        GLsync fence = nullptr;
+        std::size_t capacity = 0;
+        int width = 0;
+        int height = 0;
+        std::uint64_t frame = 0;
+        bool pending = false;
+    };
+
+    // Owned by the GL thread while empty and by the worker while full.
+    struct EncodeSlot {
+        std::vector<std::uint8_t> pixels;
+        int width = 0;
+        int height = 0;
+        std::uint64_t frame = 0;
+        bool full = false;
+    };
+
+    static constexpr std::size_t kReadbackCount = 3;
+    static constexpr std::size_t kEncodeSlotCount = 4;
+
+    void collectReadbacks(bool wait);
+    bool readbackReady(const Readback& readback) const;
+    void workerLoop();
+    bool writeImage(const EncodeSlot& slot, std::vector<std::uint8_t>& scratch) const;
+
+    std::filesystem::path m_directory;
+    CaptureFormat m_format = CaptureFormat::Png;
+    int m_interval = 1;
+    bool m_active = false;
+    std::uint64_t m_frameIndex = 0;
+    std::uint64_t m_droppedFrames = 0;
+
+    std::array<Readback, kReadbackCount> m_readbacks{};
+    // Sum of the readback buffer capacities.
+    GpuAllocation m_readbackMemory{MemoryTag::Capture};
+    std::size_t m_readbackHead = 0;
+    std::size_t m_readbackTail = 0;
+
+    std::array<EncodeSlot, kEncodeSlotCount> m_slots{};
+    std::size_t m_slotHead = 0;
+    std::size_t m_slotTail = 0;
+    std::uint64_t m_framesWritten = 0;
+    std::uint64_t m_writeFailures = 0;
+
+    std::mutex m_mutex;
+    std::condition_variable m_slotFilled;
+    std::condition_variable m_slotFreed;
+    bool m_stopping = false;
+    std::thread m_worker;
+};
@@ -0,0 +1,97 @@
+#include "render/GlFunctions.hpp"
+
+#include <SDL2/SDL.h>
+
+#include <type_traits>
+
+GlFunctions g_gl;
+
+bool loadGlFunctions(bool coreProfile) {
+    auto loadProc = [](auto& proc, const char* name) {
+        proc = reinterpret_cast<std::remove_reference_t<decltype(proc)>>(SDL_GL_GetProcAddress(name));
+        return proc != nullptr;
+    };
+
+    const bool shared = loadProc(g_gl.activeTexture, "glActiveTexture") &&
+        loadProc(g_gl.attachShader, "glAttachShader") &&
+        loadProc(g_gl.compileShader, "glCompileShader") &&
+        loadProc(g_gl.createProgram, "glCreateProgram") &&
+        loadProc(g_gl.createShader, "glCreateShader") &&
+        loadProc(g_gl.deleteProgram, "glDeleteProgram") &&
+        loadProc(g_gl.deleteShader, "glDeleteShader") &&
+        loadProc(g_gl.getProgramiv, "glGetProgramiv") &&
+        loadProc(g_gl.getProgramInfoLog, "glGetProgramInfoLog") &&
+        loadProc(g_gl.getShaderiv, "glGetShaderiv") &&
+        loadProc(g_gl.getShaderInfoLog, "glGetShaderInfoLog") &&
+        loadProc(g_gl.getUniformLocation, "glGetUniformLocation") &&
+        loadProc(g_gl.linkProgram, "glLinkProgram") &&
+        loadProc(g_gl.shaderSource, "glShaderSource") &&
+        loadProc(g_gl.useProgram, "glUseProgram") &&
+        loadProc(g_gl.uniform1f, "glUniform1f") &&
+        loadProc(g_gl.uniform2f, "glUniform2f") &&
+        loadProc(g_gl.uniform3f, "glUniform3f") &&
+        loadProc(g_gl.uniform3fv, "glUniform3fv") &&
+        loadProc(g_gl.uniform4f, "glUniform4f") &&
+        loadProc(g_gl.uniform4fv, "glUniform4fv") &&
+        loadProc(g_gl.uniform1i, "glUniform1i") &&
+        loadProc(g_gl.bindFramebuffer, "glBindFramebuffer") &&
+        loadProc(g_gl.deleteFramebuffers, "glDeleteFramebuffers") &&
+        loadProc(g_gl.genFramebuffers, "glGenFramebuffers") &&
+        loadProc(g_gl.checkFramebufferStatus, "glCheckFramebufferStatus") &&
+        loadProc(g_gl.framebufferTexture2D, "glFramebufferTexture2D") &&
+        loadProc(g_gl.blitFramebuffer, "glBlitFramebuffer") &&
+        loadProc(g_gl.genBuffers, "glGenBuffers") &&
+        loadProc(g_gl.bindBuffer, "glBindBuffer") &&
+        loadProc(g_gl.bufferData, "glBufferData") &&
+        loadProc(g_gl.bufferSubData, "glBufferSubData") &&
+        loadProc(g_gl.deleteBuffers, "glDeleteBuffers") &&
+        loadProc(g_gl.mapBuffer, "glMapBuffer") &&
+        loadProc(g_gl.unmapBuffer, "glUnmapBuffer");
+
+    // A non-null address proves nothing on GLX, which resolves any name, so
+    // the optional groups also need the context to offer them: the 3.3 core
+    // profile has both, the legacy context needs the extension.
+    g_gl.syncSupported = coreProfile || SDL_GL_ExtensionSupported("GL_ARB_sync");
+    g_gl.timerQuerySupported = coreProfile || SDL_GL_ExtensionSupported("GL_ARB_timer_query");
+
+    // Fences are all-or-nothing so callers only need to test one of them.
+    if (!(g_gl.syncSupported &&
+          loadProc(g_gl.fenceSync, "glFenceSync") &&
+          loadProc(g_gl.clientWaitSync, "glClientWaitSync") &&
+          loadProc(g_gl.deleteSync, "glDeleteSync"))) {
+        g_gl.fenceSync = nullptr;
+        g_gl.clientWaitSync = nullptr;
+        g_gl.deleteSync = nullptr;
+        g_gl.syncSupported = false;
+    }
+
+    // Timer queries likewise; a driver without them leaves all of them null.
+    if (!(g_gl.timerQuerySupported &&
+          loadProc(g_gl.genQueries, "glGenQueries") &&
+          loadProc(g_gl.deleteQueries, "glDeleteQueries") &&
+          loadProc(g_gl.beginQuery, "glBeginQuery") &&
+          loadProc(g_gl.endQuery, "glEndQuery") &&
+          loadProc(g_gl.getQueryObjectiv, "glGetQueryObjectiv") &&
+          loadProc(g_gl.getQueryObjectui64v, "glGetQueryObjectui64v"))) {
+        g_gl.genQueries = nullptr;
+        g_gl.deleteQueries = nullptr;
+        g_gl.beginQuery = nullptr;
+        g_gl.endQuery = nullptr;
+        g_gl.getQueryObjectiv = nullptr;
+        g_gl.getQueryObjectui64v = nullptr;
+        g_gl.timerQuerySupported = false;
+    }
+
+    if (!shared || !coreProfile) {
+        return shared;
+    }
+
+    return loadProc(g_gl.genVertexArrays, "glGenVertexArrays") &&
+        loadProc(g_gl.bindVertexArray, "glBindVertexArray") &&
+        loadProc(g_gl.deleteVertexArrays, "glDeleteVertexArrays") &&
+        loadProc(g_gl.vertexAttribPointer, "glVertexAttribPointer") &&
+        loadProc(g_gl.vertexAttribIPointer, "glVertexAttribIPointer") &&
+        loadProc(g_gl.enableVertexAttribArray, "glEnableVertexAttribArray") &&
+        loadProc(g_gl.vertexAttribDivisor, "glVertexAttribDivisor") &&
+        loadProc(g_gl.drawArraysInstanced, "glDrawArraysInstanced");
+}
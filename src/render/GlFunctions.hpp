@@ -0,0 +1,130 @@
+#pragma once
+
+#include <SDL2/SDL_opengl.h>
+#include <SDL2/SDL_opengl_glext.h>
+
+// Entry points resolved through SDL_GL_GetProcAddress. Render translation units
+// call them through the gl* macros below, so call sites read like plain GL.
+struct GlFunctions {
+    PFNGLACTIVETEXTUREPROC activeTexture = nullptr;
+    PFNGLATTACHSHADERPROC attachShader = nullptr;
+    PFNGLCOMPILESHADERPROC compileShader = nullptr;
+    PFNGLCREATEPROGRAMPROC createProgram = nullptr;
+    PFNGLCREATESHADERPROC createShader = nullptr;
+    PFNGLDELETEPROGRAMPROC deleteProgram = nullptr;
+    PFNGLDELETESHADERPROC deleteShader = nullptr;
+    PFNGLGETPROGRAMIVPROC getProgramiv = nullptr;
+    PFNGLGETPROGRAMINFOLOGPROC getProgramInfoLog = nullptr;
+    PFNGLGETSHADERIVPROC getShaderiv = nullptr;
+    PFNGLGETSHADERINFOLOGPROC getShaderInfoLog = nullptr;
+    PFNGLGETUNIFORMLOCATIONPROC getUniformLocation = nullptr;
+    PFNGLLINKPROGRAMPROC linkProgram = nullptr;
+    PFNGLSHADERSOURCEPROC shaderSource = nullptr;
+    PFNGLUSEPROGRAMPROC useProgram = nullptr;
+    PFNGLUNIFORM1FPROC uniform1f = nullptr;
+    PFNGLUNIFORM2FPROC uniform2f = nullptr;
+    PFNGLUNIFORM3FPROC uniform3f = nullptr;
+    PFNGLUNIFORM3FVPROC uniform3fv = nullptr;
+    PFNGLUNIFORM4FPROC uniform4f = nullptr;
+    PFNGLUNIFORM4FVPROC uniform4fv = nullptr;
+    PFNGLUNIFORM1IPROC uniform1i = nullptr;
+    PFNGLBINDFRAMEBUFFERPROC bindFramebuffer = nullptr;
+    PFNGLDELETEFRAMEBUFFERSPROC deleteFramebuffers = nullptr;
+    PFNGLGENFRAMEBUFFERSPROC genFramebuffers = nullptr;
+    PFNGLCHECKFRAMEBUFFERSTATUSPROC checkFramebufferStatus = nullptr;
+    PFNGLFRAMEBUFFERTEXTURE2DPROC framebufferTexture2D = nullptr;
+    PFNGLBLITFRAMEBUFFERPROC blitFramebuffer = nullptr;
+    PFNGLGENBUFFERSPROC genBuffers = nullptr;
+    PFNGLBINDBUFFERPROC bindBuffer = nullptr;
+    PFNGLBUFFERDATAPROC bufferData = nullptr;
+    PFNGLBUFFERSUBDATAPROC bufferSubData = nullptr;
+    PFNGLDELETEBUFFERSPROC deleteBuffers = nullptr;
+    PFNGLMAPBUFFERPROC mapBuffer = nullptr;
+    PFNGLUNMAPBUFFERPROC unmapBuffer = nullptr;
+
+    // Optional in either profile (GL 3.2 or ARB_sync); null when unsupported.
+    bool syncSupported = false;
+    PFNGLFENCESYNCPROC fenceSync = nullptr;
+    PFNGLCLIENTWAITSYNCPROC clientWaitSync = nullptr;
+    PFNGLDELETESYNCPROC deleteSync = nullptr;
+
+    // Optional in either profile (GL 3.3 or ARB_timer_query); null when unsupported.
+    bool timerQuerySupported = false;
+    PFNGLGENQUERIESPROC genQueries = nullptr;
+    PFNGLDELETEQUERIESPROC deleteQueries = nullptr;
+    PFNGLBEGINQUERYPROC beginQuery = nullptr;
+    PFNGLENDQUERYPROC endQuery = nullptr;
+    PFNGLGETQUERYOBJECTIVPROC getQueryObjectiv = nullptr;
+    PFNGLGETQUERYOBJECTUI64VPROC getQueryObjectui64v = nullptr;
+
+    // GL 3.3 core only.
+    PFNGLGENVERTEXARRAYSPROC genVertexArrays = nullptr;
+    PFNGLBINDVERTEXARRAYPROC bindVertexArray = nullptr;
+    PFNGLDELETEVERTEXARRAYSPROC deleteVertexArrays = nullptr;
+    PFNGLVERTEXATTRIBPOINTERPROC vertexAttribPointer = nullptr;
+    PFNGLVERTEXATTRIBIPOINTERPROC vertexAttribIPointer = nullptr;
+    PFNGLENABLEVERTEXATTRIBARRAYPROC enableVertexAttribArray = nullptr;
+    PFNGLVERTEXATTRIBDIVISORPROC vertexAttribDivisor = nullptr;
+    PFNGLDRAWARRAYSINSTANCEDPROC drawArraysInstanced = nullptr;
+};
+
+extern GlFunctions g_gl;
+
+// Resolves the shared entry points, plus the VAO and instancing entry points
+// when coreProfile is set. Returns false if any required entry point is missing;
+// the optional sync and timer query entry points are left null, and their
+// supported flags false, when the context does not offer them.
+bool loadGlFunctions(bool coreProfile);
+
+#define glActiveTexture g_gl.activeTexture
+#define glAttachShader g_gl.attachShader
+#define glCompileShader g_gl.compileShader
+#define glCreateProgram g_gl.createProgram
+#define glCreateShader g_gl.createShader
+#define glDeleteProgram g_gl.deleteProgram
+#define glDeleteShader g_gl.deleteShader
+#define glGetProgramiv g_gl.getProgramiv
+#define glGetProgramInfoLog g_gl.getProgramInfoLog
+#define glGetShaderiv g_gl.getShaderiv
+#define glGetShaderInfoLog g_gl.getShaderInfoLog
+#define glGetUniformLocation g_gl.getUniformLocation
+#define glLinkProgram g_gl.linkProgram
+#define glShaderSource g_gl.shaderSource
+#define glUseProgram g_gl.useProgram
+#define glUniform1f g_gl.uniform1f
+#define glUniform2f g_gl.uniform2f
+#define glUniform3f g_gl.uniform3f
+#define glUniform3fv g_gl.uniform3fv
+#define glUniform4f g_gl.uniform4f
+#define glUniform4fv g_gl.uniform4fv
+#define glUniform1i g_gl.uniform1i
+#define glBindFramebuffer g_gl.bindFramebuffer
+#define glDeleteFramebuffers g_gl.deleteFramebuffers
+#define glGenFramebuffers g_gl.genFramebuffers
+#define glCheckFramebufferStatus g_gl.checkFramebufferStatus
+#define glFramebufferTexture2D g_gl.framebufferTexture2D
+#define glBlitFramebuffer g_gl.blitFramebuffer
+#define glGenBuffers g_gl.genBuffers
+#define glBindBuffer g_gl.bindBuffer
+#define glBufferData g_gl.bufferData
+#define glBufferSubData g_gl.bufferSubData
+#define glDeleteBuffers g_gl.deleteBuffers
+#define glMapBuffer g_gl.mapBuffer
+#define glUnmapBuffer g_gl.unmapBuffer
+#define glFenceSync g_gl.fenceSync
+#define glClientWaitSync g_gl.clientWaitSync
+#define glDeleteSync g_gl.deleteSync
+#define glGenQueries g_gl.genQueries
+#define glDeleteQueries g_gl.deleteQueries
+#define glBeginQuery g_gl.beginQuery
+#define glEndQuery g_gl.endQuery
+#define glGetQueryObjectiv g_gl.getQueryObjectiv
+#define glGetQueryObjectui64v g_gl.getQueryObjectui64v
+#define glGenVertexArrays g_gl.genVertexArrays
+#define glBindVertexArray g_gl.bindVertexArray
+#define glDeleteVertexArrays g_gl.deleteVertexArrays
+#define glVertexAttribPointer g_gl.vertexAttribPointer
+#define glVertexAttribIPointer g_gl.vertexAttribIPointer
+#define glEnableVertexAttribArray g_gl.enableVertexAttribArray
+#define glVertexAttribDivisor g_gl.vertexAttribDivisor
+#define glDrawArraysInstanced g_gl.drawArraysInstanced
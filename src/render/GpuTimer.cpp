@@ -0,0 +1,69 @@
+#include "render/GpuTimer.hpp"
+
+#include "render/GlFunctions.hpp"
+
+void GpuTimer::create() {
+    if (m_created || !g_gl.timerQuerySupported) {
+        return;
+    }
+    glGenQueries(static_cast<GLsizei>(m_queries.size()), m_queries.data());
+    m_oldest = 0;
+    m_pending = 0;
+    m_running = false;
+    m_created = true;
+}
+
+void GpuTimer::destroy() {
+    if (!m_created) {
+        return;
+    }
+    if (m_running) {
+        glEndQuery(GL_TIME_ELAPSED);
+    }
+    glDeleteQueries(static_cast<GLsizei>(m_queries.size()), m_queries.data());
+    m_queries = {};
+    m_pending = 0;
+    m_running = false;
+    m_created = false;
+}
+
+bool GpuTimer::available() const {
+    return m_created;
+}
+
+void GpuTimer::begin() {
+    if (!m_created || m_running || m_pending == m_queries.size()) {
+        return;
+    }
+    glBeginQuery(GL_TIME_ELAPSED, m_queries[(m_oldest + m_pending) % m_queries.size()]);
+    m_running = true;
+}
+
+void GpuTimer::end() {
+    if (!m_running) {
+        return;
+    }
+    glEndQuery(GL_TIME_ELAPSED);
+    m_running = false;
+    ++m_pending;
+}
+
+bool GpuTimer::poll(double& outSeconds) {
+    bool found = false;
+    // Queries finish in order, so stop at the first one still in flight.
+    while (m_pending > 0) {
+        const GLuint query = m_queries[m_oldest];
+        GLint ready = GL_FALSE;
+        glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &ready);
+        if (ready == GL_FALSE) {
+            break;
+        }
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+        outSeconds = static_cast<double>(nanoseconds) * 1e-9;
+        found = true;
+        m_oldest = (m_oldest + 1) % m_queries.size();
+        --m_pending;
+    }
+    return found;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <SDL2/SDL_opengl.h>
+
+#include <array>
+#include <cstddef>
+
+// Measures how long the GPU spends on a span of commands with GL_TIME_ELAPSED
+// queries. Results are read a few frames later, once the driver has them, so
+// timing never stalls the pipeline. available() is false without timer
+// queries (GL 3.3 or ARB_timer_query). GL thread only.
+class GpuTimer {
+public:
+    static constexpr std::size_t kQueries = 4;
+
+    // Creates the queries in the current context; a no-op when it lacks
+    // timer queries.
+    void create();
+    void destroy();
+    bool available() const;
+
+    // Brackets the commands to time. A begin() while every query still waits
+    // for its result is skipped, along with its end().
+    void begin();
+    void end();
+    // Seconds of the newest span whose result has arrived since the last
+    // call; false when none has.
+    bool poll(double& outSeconds);
+
+private:
+    std::array<GLuint, kQueries> m_queries{};
+    // Spans issued and not yet read, oldest at m_oldest.
+    std::size_t m_oldest = 0;
+    std::size_t m_pending = 0;
+    bool m_running = false;
+    bool m_created = false;
+};
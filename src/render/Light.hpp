@@ -0,0 +1,32 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+// Maximum number of lights evaluated by a single lighting pass.
+constexpr std::size_t kMaxLights = 8;
+
+// Direct light kept on tiles a light cannot see; matches light.glsl.
+constexpr float kOccludedDirectScale = 0.12F;
+
+struct Light {
+    float x;
+    float y;
+    float radius;
+    float intensity;
+    float r;
+    float g;
+    float b;
+    float falloffExponent;
+};
+
+// CPU copy of the mixed falloff in light.glsl: a power curve that reaches zero
+// at the radius, or inverse-square when the exponent is not positive.
+inline float lightFalloff(float distance, float radius, float falloffExponent) {
+    radius = std::max(0.001F, radius);
+    if (falloffExponent > 0.0F) {
+        return std::pow(std::clamp(1.0F - distance / radius, 0.0F, 1.0F), falloffExponent);
+    }
+    return 1.0F / (1.0F + distance * distance / (radius * radius));
+}
@@ -0,0 +1,464 @@
+#include "render/Lightmap.hpp"
+
+#include "core/JobSystem.hpp"
+#include "game/Map.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <system_error>
+#include <thread>
+
+namespace {
+
+constexpr std::uint32_t kCacheMagic = 0x50414D4CU; // "LMAP"
+// Bump when the bake or the file layout changes; it is part of the key.
+constexpr std::uint32_t kBakeVersion = 1;
+constexpr unsigned kMaxBakeWorkers = 8;
+
+// Fixed at two: bakeRegion gathers a first and a second bounce.
+constexpr int kBounceCount = 2;
+// Walls further than this (in tiles) from a receiver are not gathered.
+constexpr int kBounceRadius = 4;
+constexpr float kBounceStrength = 0.45F;
+// Wall reflectance; the wall entry of the tile palette.
+constexpr std::array<float, 3> kWallAlbedo{0.42F, 0.30F, 0.20F};
+
+struct CacheHeader {
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint64_t key;
+    std::int32_t width;
+    std::int32_t height;
+};
+
+struct Rgb {
+    float r;
+    float g;
+    float b;
+};
+
+// Runs rowFn(row) for every row. With a job system the rows go to its
+// workers; otherwise (the loader thread's bake) worker threads are started
+// for the call and rows handed out as they finish the previous one.
+template <typename RowFn>
+void forEachRowParallel(JobSystem* jobs, int rows, const std::atomic<bool>& cancelled, const RowFn& rowFn) {
+    if (jobs != nullptr) {
+        jobs->parallelFor(static_cast<std::size_t>(rows), 1, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t row = begin; row < end && !cancelled.load(); ++row) {
+                rowFn(static_cast<int>(row));
+            }
+        });
+        return;
+    }
+
+    const unsigned workerCount = std::clamp(std::thread::hardware_concurrency(), 1U, kMaxBakeWorkers);
+    std::atomic<int> nextRow{0};
+    const auto work = [&] {
+        for (int row = nextRow.fetch_add(1); row < rows && !cancelled.load(); row = nextRow.fetch_add(1)) {
+            rowFn(row);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(workerCount - 1);
+    for (unsigned i = 1; i < workerCount; ++i) {
+        workers.emplace_back(work);
+    }
+    work();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+// Per-tile values over a window of the map.
+struct TileGrid {
+    TileRect rect;
+    std::vector<Rgb> values;
+
+    void reset(const TileRect& window) {
+        rect = window;
+        values.assign(static_cast<std::size_t>(window.width) * static_cast<std::size_t>(window.height), Rgb{0.0F, 0.0F, 0.0F});
+    }
+
+    Rgb& at(int x, int y) {
+        return values[static_cast<std::size_t>((y - rect.y) * rect.width + (x - rect.x))];
+    }
+
+    const Rgb& at(int x, int y) const {
+        return values[static_cast<std::size_t>((y - rect.y) * rect.width + (x - rect.x))];
+    }
+};
+
+TileRect clipToMap(const TileRect& rect, const Map& map) {
+    const int left = std::max(rect.x, 0);
+    const int top = std::max(rect.y, 0);
+    const int right = std::min(rect.x + rect.width, map.width());
+    const int bottom = std::min(rect.y + rect.height, map.height());
+    return {left, top, std::max(0, right - left), std::max(0, bottom - top)};
+}
+
+// Tiles a light reaches; inverse-square lights never reach zero.
+TileRect lightReach(const Map& map, const Light& light) {
+    if (light.falloffExponent <= 0.0F) {
+        return {0, 0, map.width(), map.height()};
+    }
+    const int left = static_cast<int>(std::floor(light.x - light.radius));
+    const int top = static_cast<int>(std::floor(light.y - light.radius));
+    const int right = static_cast<int>(std::ceil(light.x + light.radius));
+    const int bottom = static_cast<int>(std::ceil(light.y + light.radius));
+    return clipToMap(TileRect{left, top, right - left + 1, bottom - top + 1}, map);
+}
+
+// One gather: every tile of outGathered.rect collects the light leaving nearby
+// visible walls. Walls outside emitted.rect are not read.
+void gatherBounce(
+    JobSystem* jobs,
+    const Map& map,
+    const TileGrid& emitted,
+    TileGrid& outGathered,
+    const std::atomic<bool>& cancelled) {
+    const TileRect& source = emitted.rect;
+    const TileRect& target = outGathered.rect;
+    forEachRowParallel(jobs, target.height, cancelled, [&](int row) {
+        const int y = target.y + row;
+        for (int x = target.x; x < target.x + target.width; ++x) {
+            Rgb sum{0.0F, 0.0F, 0.0F};
+            const int wallTop = std::max(source.y, y - kBounceRadius);
+            const int wallBottom = std::min(source.y + source.height - 1, y + kBounceRadius);
+            const int wallLeft = std::max(source.x, x - kBounceRadius);
+            const int wallRight = std::min(source.x + source.width - 1, x + kBounceRadius);
+            for (int wallY = wallTop; wallY <= wallBottom; ++wallY) {
+                for (int wallX = wallLeft; wallX <= wallRight; ++wallX) {
+                    if ((wallX == x && wallY == y) || !map.isBlocked(wallX, wallY)) {
+                        continue;
+                    }
+                    const Rgb& light = emitted.at(wallX, wallY);
+                    if (light.r + light.g + light.b <= 0.0F) {
+                        continue;
+                    }
+                    const float dx = static_cast<float>(wallX - x);
+                    const float dy = static_cast<float>(wallY - y);
+                    const float distanceSquared = dx * dx + dy * dy;
+                    if (distanceSquared > static_cast<float>(kBounceRadius * kBounceRadius) ||
+                        !map.hasLineOfSight(x, y, wallX, wallY)) {
+                        continue;
+                    }
+                    const float weight = kBounceStrength / (1.0F + distanceSquared);
+                    sum.r += light.r * weight;
+                    sum.g += light.g * weight;
+                    sum.b += light.b * weight;
+                }
+            }
+            outGathered.at(x, y) = sum;
+        }
+    });
+}
+
+} // namespace
+
+bool Lightmap::empty() const {
+    return texels.empty();
+}
+
+void Lightmap::sample(float tileX, float tileY, float& outR, float& outG, float& outB) const {
+    outR = 0.0F;
+    outG = 0.0F;
+    outB = 0.0F;
+    if (texels.empty()) {
+        return;
+    }
+
+    const float u = std::clamp(tileX * kTexelsPerTile - 0.5F, 0.0F, static_cast<float>(width - 1));
+    const float v = std::clamp(tileY * kTexelsPerTile - 0.5F, 0.0F, static_cast<float>(height - 1));
+    const int x0 = static_cast<int>(u);
+    const int y0 = static_cast<int>(v);
+    const int x1 = std::min(x0 + 1, width - 1);
+    const int y1 = std::min(y0 + 1, height - 1);
+    const float fx = u - static_cast<float>(x0);
+    const float fy = v - static_cast<float>(y0);
+
+    const auto texel = [this](int x, int y) {
+        return &texels[(static_cast<std::size_t>(y) * static_cast<std::size_t>(width) + static_cast<std::size_t>(x)) * 3];
+    };
+    const float* a = texel(x0, y0);
+    const float* b = texel(x1, y0);
+    const float* c = texel(x0, y1);
+    const float* d = texel(x1, y1);
+    const auto blend = [fx, fy](float p, float q, float r, float s) {
+        return (p + (q - p) * fx) * (1.0F - fy) + (r + (s - r) * fx) * fy;
+    };
+    outR = blend(a[0], b[0], c[0], d[0]);
+    outG = blend(a[1], b[1], c[1], d[1]);
+    outB = blend(a[2], b[2], c[2], d[2]);
+}
+
+std::uint64_t LightmapBaker::cacheKey(const Map& map, std::span<const Light> lights) {
+    std::uint64_t hash = map.contentHash();
+    const auto mix = [&hash](const void* data, std::size_t size) {
+        const auto* bytes = static_cast<const std::uint8_t*>(data);
+        for (std::size_t i = 0; i < size; ++i) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ULL;
+        }
+    };
+    mix(&kBakeVersion, sizeof(kBakeVersion));
+    const int texelsPerTile = Lightmap::kTexelsPerTile;
+    mix(&texelsPerTile, sizeof(texelsPerTile));
+    for (const Light& light : lights) {
+        const std::array<float, 8> fields{
+            light.x, light.y, light.radius, light.intensity, light.r, light.g, light.b, light.falloffExponent};
+        mix(fields.data(), sizeof(fields));
+    }
+    return hash;
+}
+
+bool LightmapBaker::loadOrBake(
+    const Map& map,
+    std::span<const Light> lights,
+    const std::filesystem::path& cacheDirectory,
+    const std::atomic<bool>& cancelled,
+    Lightmap& outLightmap) {
+    const std::uint64_t key = cacheKey(map, lights);
+    std::filesystem::path cachePath;
+    if (!cacheDirectory.empty()) {
+        std::array<char, 32> name{};
+        std::snprintf(name.data(), name.size(), "%016llx.lmap", static_cast<unsigned long long>(key));
+        cachePath = cacheDirectory / name.data();
+        if (readCache(cachePath, key, outLightmap)) {
+            outLightmap.mapRevision = map.revision();
+            outLightmap.lights.assign(lights.begin(), lights.end());
+            return true;
+        }
+    }
+
+    if (!bake(map, lights, cancelled, outLightmap)) {
+        return false;
+    }
+    outLightmap.key = key;
+    if (!cachePath.empty() && !writeCache(cachePath, outLightmap)) {
+        std::cerr << "Failed to write lightmap cache " << cachePath.string() << '\n';
+    }
+    return true;
+}
+
+bool LightmapBaker::bake(const Map& map, std::span<const Light> lights, const std::atomic<bool>& cancelled, Lightmap& outLightmap) {
+    if (map.width() <= 0 || map.height() <= 0) {
+        return false;
+    }
+
+    Lightmap lightmap;
+    lightmap.width = map.width() * Lightmap::kTexelsPerTile;
+    lightmap.height = map.height() * Lightmap::kTexelsPerTile;
+    lightmap.mapRevision = map.revision();
+    lightmap.lights.assign(lights.begin(), lights.end());
+    lightmap.texels.resize(static_cast<std::size_t>(lightmap.width) * static_cast<std::size_t>(lightmap.height) * 3);
+    if (!bakeRegion(nullptr, map, TileRect{0, 0, map.width(), map.height()}, cancelled, lightmap)) {
+        return false;
+    }
+    outLightmap = std::move(lightmap);
+    return true;
+}
+
+void LightmapBaker::rebake(JobSystem* jobs, const Map& map, const TileRect& changed, Lightmap& lightmap, TileRect& outUpdated) {
+    outUpdated = TileRect{};
+    if (changed.empty() || lightmap.width != map.width() * Lightmap::kTexelsPerTile ||
+        lightmap.height != map.height() * Lightmap::kTexelsPerTile) {
+        return;
+    }
+
+    // Direct light changes wherever a light whose reach covers the edit can
+    // now see more or less; a changed wall also emits differently itself.
+    // Each bounce spreads that by the gather radius, and indirect light is
+    // interpolated from neighbouring tile centres.
+    TileRect direct = changed;
+    for (const Light& light : lightmap.lights) {
+        const TileRect reach = lightReach(map, light);
+        if (reach.intersects(changed)) {
+            direct = direct.united(reach);
+        }
+    }
+    const TileRect region = clipToMap(direct.expanded(kBounceRadius * kBounceCount + 1), map);
+    const std::atomic<bool> notCancelled{false};
+    if (bakeRegion(jobs, map, region, notCancelled, lightmap)) {
+        lightmap.mapRevision = map.revision();
+        outUpdated = region;
+    }
+}
+
+bool LightmapBaker::bakeRegion(
+    JobSystem* jobs,
+    const Map& map,
+    const TileRect& region,
+    const std::atomic<bool>& cancelled,
+    Lightmap& lightmap) {
+    const std::span<const Light> lights = lightmap.lights;
+
+    // Texels of `region` interpolate indirect light from one tile further out;
+    // the second bounce there reads first-bounce light one gather radius
+    // further, which reads direct light another radius beyond that.
+    const TileRect indirectRect = clipToMap(region.expanded(1), map);
+    const TileRect firstBounceRect = clipToMap(indirectRect.expanded(kBounceRadius), map);
+    const TileRect directRect = clipToMap(firstBounceRect.expanded(kBounceRadius), map);
+    const std::size_t directTiles = static_cast<std::size_t>(directRect.width) * static_cast<std::size_t>(directRect.height);
+
+    // Whether each light sees each tile, shared by every texel of the tile.
+    std::vector<std::uint8_t> visible(directTiles * lights.size());
+    const auto visibleIndex = [&directRect, directTiles](std::size_t light, int x, int y) {
+        return light * directTiles + static_cast<std::size_t>((y - directRect.y) * directRect.width + (x - directRect.x));
+    };
+    forEachRowParallel(jobs, directRect.height, cancelled, [&](int row) {
+        const int y = directRect.y + row;
+        for (std::size_t i = 0; i < lights.size(); ++i) {
+            const int lightX = static_cast<int>(std::round(lights[i].x));
+            const int lightY = static_cast<int>(std::round(lights[i].y));
+            for (int x = directRect.x; x < directRect.x + directRect.width; ++x) {
+                visible[visibleIndex(i, x, y)] = map.hasLineOfSight(lightX, lightY, x, y) ? 1 : 0;
+            }
+        }
+    });
+
+    const auto directAt = [&](float px, float py, int tileX, int tileY) {
+        Rgb sum{0.0F, 0.0F, 0.0F};
+        for (std::size_t i = 0; i < lights.size(); ++i) {
+            const Light& light = lights[i];
+            const float dx = px - light.x;
+            const float dy = py - light.y;
+            float contribution = lightFalloff(std::sqrt(dx * dx + dy * dy), light.radius, light.falloffExponent) * light.intensity;
+            contribution *= visible[visibleIndex(i, tileX, tileY)] != 0 ? 1.0F : kOccludedDirectScale;
+            sum.r += light.r * contribution;
+            sum.g += light.g * contribution;
+            sum.b += light.b * contribution;
+        }
+        return sum;
+    };
+
+    // Bounces are gathered per tile; only walls re-emit, tinted by their albedo.
+    TileGrid emitted;
+    emitted.reset(directRect);
+    forEachRowParallel(jobs, directRect.height, cancelled, [&](int row) {
+        const int y = directRect.y + row;
+        for (int x = directRect.x; x < directRect.x + directRect.width; ++x) {
+            const Rgb light = directAt(static_cast<float>(x) + 0.5F, static_cast<float>(y) + 0.5F, x, y);
+            emitted.at(x, y) = Rgb{light.r * kWallAlbedo[0], light.g * kWallAlbedo[1], light.b * kWallAlbedo[2]};
+        }
+    });
+
+    TileGrid firstBounce;
+    firstBounce.reset(firstBounceRect);
+    gatherBounce(jobs, map, emitted, firstBounce, cancelled);
+
+    emitted.reset(firstBounceRect);
+    for (std::size_t tile = 0; tile < emitted.values.size(); ++tile) {
+        const Rgb& light = firstBounce.values[tile];
+        emitted.values[tile] = Rgb{light.r * kWallAlbedo[0], light.g * kWallAlbedo[1], light.b * kWallAlbedo[2]};
+    }
+    TileGrid indirect;
+    indirect.reset(indirectRect);
+    gatherBounce(jobs, map, emitted, indirect, cancelled);
+    for (int y = indirectRect.y; y < indirectRect.y + indirectRect.height; ++y) {
+        for (int x = indirectRect.x; x < indirectRect.x + indirectRect.width; ++x) {
+            const Rgb& first = firstBounce.at(x, y);
+            Rgb& total = indirect.at(x, y);
+            total.r += first.r;
+            total.g += first.g;
+            total.b += first.b;
+        }
+    }
+
+    // Texels: direct light at the texel centre, indirect interpolated between
+    // tile centres so the coarser bounce grid does not show.
+    const int mapWidth = map.width();
+    const int mapHeight = map.height();
+    const auto indirectAt = [&](float px, float py) {
+        const float u = std::clamp(px - 0.5F, 0.0F, static_cast<float>(mapWidth - 1));
+        const float v = std::clamp(py - 0.5F, 0.0F, static_cast<float>(mapHeight - 1));
+        const int x0 = static_cast<int>(u);
+        const int y0 = static_cast<int>(v);
+        const int x1 = std::min(x0 + 1, mapWidth - 1);
+        const int y1 = std::min(y0 + 1, mapHeight - 1);
+        const float fx = u - static_cast<float>(x0);
+        const float fy = v - static_cast<float>(y0);
+        const Rgb& a = indirect.at(x0, y0);
+        const Rgb& b = indirect.at(x1, y0);
+        const Rgb& c = indirect.at(x0, y1);
+        const Rgb& d = indirect.at(x1, y1);
+        const auto blend = [fx, fy](float p, float q, float r, float s) {
+            return (p + (q - p) * fx) * (1.0F - fy) + (r + (s - r) * fx) * fy;
+        };
+        return Rgb{blend(a.r, b.r, c.r, d.r), blend(a.g, b.g, c.g, d.g), blend(a.b, b.b, c.b, d.b)};
+    };
+    const int firstColumn = region.x * Lightmap::kTexelsPerTile;
+    const int columnCount = region.width * Lightmap::kTexelsPerTile;
+    forEachRowParallel(jobs, region.height * Lightmap::kTexelsPerTile, cancelled, [&](int regionRow) {
+        const int row = region.y * Lightmap::kTexelsPerTile + regionRow;
+        const float py = (static_cast<float>(row) + 0.5F) / Lightmap::kTexelsPerTile;
+        const int tileY = row / Lightmap::kTexelsPerTile;
+        float* out = &lightmap.texels[static_cast<std::size_t>(row) * static_cast<std::size_t>(lightmap.width) * 3];
+        for (int column = firstColumn; column < firstColumn + columnCount; ++column) {
+            const float px = (static_cast<float>(column) + 0.5F) / Lightmap::kTexelsPerTile;
+            const Rgb direct = directAt(px, py, column / Lightmap::kTexelsPerTile, tileY);
+            const Rgb bounced = indirectAt(px, py);
+            out[column * 3 + 0] = direct.r + bounced.r;
+            out[column * 3 + 1] = direct.g + bounced.g;
+            out[column * 3 + 2] = direct.b + bounced.b;
+        }
+    });
+
+    return !cancelled.load();
+}
+
+bool LightmapBaker::readCache(const std::filesystem::path& path, std::uint64_t key, Lightmap& outLightmap) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    CacheHeader header{};
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!file || header.magic != kCacheMagic || header.version != kBakeVersion || header.key != key ||
+        header.width <= 0 || header.height <= 0) {
+        return false;
+    }
+
+    Lightmap lightmap;
+    lightmap.width = header.width;
+    lightmap.height = header.height;
+    lightmap.key = key;
+    lightmap.texels.resize(static_cast<std::size_t>(header.width) * static_cast<std::size_t>(header.height) * 3);
+    file.read(reinterpret_cast<char*>(lightmap.texels.data()), static_cast<std::streamsize>(lightmap.texels.size() * sizeof(float)));
+    if (!file) {
+        return false;
+    }
+    outLightmap = std::move(lightmap);
+    return true;
+}
+
+bool LightmapBaker::writeCache(const std::filesystem::path& path, const Lightmap& lightmap) {
+    std::error_code error;
+    std::filesystem::create_directories(path.parent_path(), error);
+    if (error) {
+        return false;
+    }
+
+    // Written beside the final name and renamed, so a reader never sees half a file.
+    std::filesystem::path temporary = path;
+    temporary += ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        const CacheHeader header{kCacheMagic, kBakeVersion, lightmap.key, lightmap.width, lightmap.height};
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(
+            reinterpret_cast<const char*>(lightmap.texels.data()),
+            static_cast<std::streamsize>(lightmap.texels.size() * sizeof(float)));
+        if (!file) {
+            return false;
+        }
+    }
+    std::filesystem::rename(temporary, path, error);
+    return !error;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "render/Light.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+class JobSystem;
+class Map;
+struct TileRect;
+
+// Lighting from lights that never move, baked over the map grid: their direct
+// light plus light bounced off walls. Texels hold linear HDR RGB for a light
+// scale of 1. Tile (x, y) covers kTexelsPerTile x kTexelsPerTile texels
+// starting at (x, y) * kTexelsPerTile.
+struct Lightmap {
+    static constexpr int kTexelsPerTile = 4;
+
+    int width = 0;
+    int height = 0;
+    std::uint64_t key = 0;
+    // Map revision the texels match, and the static lights they hold.
+    std::uint64_t mapRevision = 0;
+    std::vector<Light> lights;
+    std::vector<float> texels;
+
+    bool empty() const;
+    // Bilinear sample at a tile-space position, clamped to the map.
+    void sample(float tileX, float tileY, float& outR, float& outG, float& outB) const;
+};
+
+class LightmapBaker {
+public:
+    // Identifies a bake by map contents, static lights and baker settings.
+    static std::uint64_t cacheKey(const Map& map, std::span<const Light> lights);
+
+    // Reads the bake for this map and these lights from cacheDirectory, or bakes
+    // it and writes it there. An empty directory skips the cache. Returns false
+    // when cancelled or when the map is empty.
+    static bool loadOrBake(
+        const Map& map,
+        std::span<const Light> lights,
+        const std::filesystem::path& cacheDirectory,
+        const std::atomic<bool>& cancelled,
+        Lightmap& outLightmap);
+
+    // Direct light and two wall bounces, split by rows across worker threads
+    // started for the bake. Meant for the loader thread, off the frame.
+    static bool bake(const Map& map, std::span<const Light> lights, const std::atomic<bool>& cancelled, Lightmap& outLightmap);
+    // Updates the lightmap after the tiles in `changed` were edited,
+    // recomputing only the tiles the edit can reach through the lights and
+    // bounces. outUpdated receives the rebaked tiles (empty if none). Rows
+    // are spread over `jobs`; without one, over threads started for the call.
+    static void rebake(JobSystem* jobs, const Map& map, const TileRect& changed, Lightmap& lightmap, TileRect& outUpdated);
+
+private:
+    // Recomputes the texels of the tiles in `region` from lightmap.lights,
+    // over `jobs`, or over threads of its own when that is null.
+    static bool bakeRegion(
+        JobSystem* jobs,
+        const Map& map,
+        const TileRect& region,
+        const std::atomic<bool>& cancelled,
+        Lightmap& lightmap);
+    static bool readCache(const std::filesystem::path& path, std::uint64_t key, Lightmap& outLightmap);
+    static bool writeCache(const std::filesystem::path& path, const Lightmap& lightmap);
+};
@@ -0,0 +1,218 @@
+#include "render/RenderCommands.hpp"
+
+#include "core/FrameArena.hpp"
+#include "render/GlFunctions.hpp"
+
+#include <algorithm>
+
+void GlStateCache::invalidate() {
+    m_program = kUnknown;
+    m_textures.fill(kUnknown);
+    m_activeUnit = kTextureUnits;
+    m_vertexArray = kUnknown;
+    m_readFramebuffer = kUnknown;
+    m_drawFramebuffer = kUnknown;
+    m_blend = 2;
+    m_blendSource = 0;
+    m_blendDestination = 0;
+}
+
+bool GlStateCache::skip(bool current) {
+    ++m_stats.requested;
+    if (current) {
+        ++m_stats.skipped;
+    }
+    return current;
+}
+
+void GlStateCache::useProgram(GLuint program) {
+    if (skip(m_program == program)) {
+        return;
+    }
+    glUseProgram(program);
+    m_program = program;
+}
+
+void GlStateCache::activeTexture(std::size_t unit) {
+    if (skip(m_activeUnit == unit)) {
+        return;
+    }
+    glActiveTexture(static_cast<GLenum>(GL_TEXTURE0 + unit));
+    m_activeUnit = unit;
+}
+
+void GlStateCache::bindTexture(std::size_t unit, GLuint texture) {
+    activeTexture(unit);
+    if (skip(m_textures[unit] == texture)) {
+        return;
+    }
+    glBindTexture(GL_TEXTURE_2D, texture);
+    m_textures[unit] = texture;
+}
+
+void GlStateCache::bindVertexArray(GLuint vertexArray) {
+    if (skip(m_vertexArray == vertexArray)) {
+        return;
+    }
+    glBindVertexArray(vertexArray);
+    m_vertexArray = vertexArray;
+}
+
+void GlStateCache::bindFramebuffer(GLenum target, GLuint framebuffer) {
+    const bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+    const bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+    if (skip((!read || m_readFramebuffer == framebuffer) && (!draw || m_drawFramebuffer == framebuffer))) {
+        return;
+    }
+    glBindFramebuffer(target, framebuffer);
+    if (read) {
+        m_readFramebuffer = framebuffer;
+    }
+    if (draw) {
+        m_drawFramebuffer = framebuffer;
+    }
+}
+
+void GlStateCache::setBlend(bool enabled) {
+    if (skip(m_blend == (enabled ? 1 : 0))) {
+        return;
+    }
+    if (enabled) {
+        glEnable(GL_BLEND);
+    } else {
+        glDisable(GL_BLEND);
+    }
+    m_blend = enabled ? 1 : 0;
+}
+
+void GlStateCache::blendFunc(GLenum source, GLenum destination) {
+    if (skip(m_blendSource == source && m_blendDestination == destination)) {
+        return;
+    }
+    glBlendFunc(source, destination);
+    m_blendSource = source;
+    m_blendDestination = destination;
+}
+
+GlStateStats GlStateCache::stats() const {
+    return m_stats;
+}
+
+CommandUniform CommandUniform::int1(GLint location, int value) {
+    return CommandUniform{location, UniformType::Int1, {static_cast<float>(value), 0.0F, 0.0F, 0.0F}};
+}
+
+CommandUniform CommandUniform::float1(GLint location, float x) {
+    return CommandUniform{location, UniformType::Float1, {x, 0.0F, 0.0F, 0.0F}};
+}
+
+CommandUniform CommandUniform::float2(GLint location, float x, float y) {
+    return CommandUniform{location, UniformType::Float2, {x, y, 0.0F, 0.0F}};
+}
+
+CommandUniform CommandUniform::float3(GLint location, float x, float y, float z) {
+    return CommandUniform{location, UniformType::Float3, {x, y, z, 0.0F}};
+}
+
+CommandUniform CommandUniform::float4(GLint location, float x, float y, float z, float w) {
+    return CommandUniform{location, UniformType::Float4, {x, y, z, w}};
+}
+
+void RenderCommandBuffer::begin(FrameArena& arena, std::size_t commandCapacity, std::size_t uniformCapacity) {
+    m_commands = arena.allocateArray<RenderCommand>(commandCapacity);
+    m_uniforms = arena.allocateArray<CommandUniform>(uniformCapacity);
+    m_commandCount.store(0, std::memory_order_relaxed);
+    m_uniformCount.store(0, std::memory_order_relaxed);
+}
+
+bool RenderCommandBuffer::record(std::uint32_t order, const RenderCommand& command, std::span<const CommandUniform> uniforms) {
+    // Uniforms are claimed first: a command slot is only taken once its
+    // uniforms fit, so every slot below the count holds a whole command.
+    // Slots claimed by a failed call are simply never read.
+    const std::size_t firstUniform = m_uniformCount.fetch_add(uniforms.size(), std::memory_order_relaxed);
+    if (firstUniform + uniforms.size() > m_uniforms.size()) {
+        return false;
+    }
+    const std::size_t slot = m_commandCount.fetch_add(1, std::memory_order_relaxed);
+    if (slot >= m_commands.size()) {
+        return false;
+    }
+
+    std::copy(uniforms.begin(), uniforms.end(), m_uniforms.begin() + static_cast<std::ptrdiff_t>(firstUniform));
+    RenderCommand& recorded = m_commands[slot];
+    recorded = command;
+    recorded.sortKey = (static_cast<std::uint64_t>(command.program) << 32U) | order;
+    recorded.firstUniform = static_cast<std::uint32_t>(firstUniform);
+    recorded.uniformCount = static_cast<std::uint32_t>(uniforms.size());
+    return true;
+}
+
+std::size_t RenderCommandBuffer::size() const {
+    return std::min(m_commandCount.load(std::memory_order_relaxed), m_commands.size());
+}
+
+void RenderCommandBuffer::execute(GlStateCache& state) {
+    const std::span<RenderCommand> commands = m_commands.first(size());
+    std::sort(commands.begin(), commands.end(), [](const RenderCommand& a, const RenderCommand& b) {
+        return a.sortKey < b.sortKey;
+    });
+
+    for (const RenderCommand& command : commands) {
+        state.useProgram(command.program);
+        for (std::size_t unit = 0; unit < command.textures.size(); ++unit) {
+            if (command.textures[unit] != 0) {
+                state.bindTexture(unit, command.textures[unit]);
+            }
+        }
+        for (const CommandUniform& uniform : m_uniforms.subspan(command.firstUniform, command.uniformCount)) {
+            setUniform(uniform);
+        }
+        draw(command, state);
+    }
+
+    m_commands = {};
+    m_uniforms = {};
+    m_commandCount.store(0, std::memory_order_relaxed);
+    m_uniformCount.store(0, std::memory_order_relaxed);
+}
+
+void RenderCommandBuffer::setUniform(const CommandUniform& uniform) {
+    if (uniform.location < 0) {
+        return;
+    }
+    const std::array<float, 4>& v = uniform.values;
+    switch (uniform.type) {
+    case UniformType::Int1:
+        glUniform1i(uniform.location, static_cast<GLint>(v[0]));
+        break;
+    case UniformType::Float1:
+        glUniform1f(uniform.location, v[0]);
+        break;
+    case UniformType::Float2:
+        glUniform2f(uniform.location, v[0], v[1]);
+        break;
+    case UniformType::Float3:
+        glUniform3f(uniform.location, v[0], v[1], v[2]);
+        break;
+    case UniformType::Float4:
+        glUniform4f(uniform.location, v[0], v[1], v[2], v[3]);
+        break;
+    }
+}
+
+void RenderCommandBuffer::draw(const RenderCommand& command, GlStateCache& state) {
+    if (command.draw == CommandDraw::Arrays) {
+        state.bindVertexArray(command.vertexArray);
+        glDrawArrays(command.mode, command.first, command.count);
+        return;
+    }
+
+    const std::array<float, 4>& rect = command.rect;
+    glColor3f(1.0F, 1.0F, 1.0F);
+    glBegin(GL_QUADS);
+    glVertex2f(rect[0], rect[1]);
+    glVertex2f(rect[2], rect[1]);
+    glVertex2f(rect[2], rect[3]);
+    glVertex2f(rect[0], rect[3]);
+    glEnd();
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <SDL2/SDL_opengl.h>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+class FrameArena;
+
+// Totals since the renderer started: binds asked of the cache, and how many
+// of them matched the current state and never reached GL.
+struct GlStateStats {
+    std::uint64_t requested = 0;
+    std::uint64_t skipped = 0;
+};
+
+// Mirror of the GL binding state the renderer changes most: program, texture
+// per unit, active unit, vertex array, framebuffers and blending. A call that
+// matches the mirror is dropped. Anything that changes this state behind the
+// cache's back (another module, a new context) must call invalidate(), after
+// which the next call of each kind reaches GL.
+class GlStateCache {
+public:
+    static constexpr std::size_t kTextureUnits = 4;
+
+    void invalidate();
+
+    void useProgram(GLuint program);
+    // Binds a 2D texture to `unit` and leaves that unit active, so texture
+    // uploads and parameters right after it land on `texture`.
+    void bindTexture(std::size_t unit, GLuint texture);
+    // GL 3.3 core only.
+    void bindVertexArray(GLuint vertexArray);
+    // GL_FRAMEBUFFER sets both the read and the draw binding.
+    void bindFramebuffer(GLenum target, GLuint framebuffer);
+    void setBlend(bool enabled);
+    void blendFunc(GLenum source, GLenum destination);
+
+    GlStateStats stats() const;
+
+private:
+    static constexpr GLuint kUnknown = ~GLuint{0};
+
+    void activeTexture(std::size_t unit);
+    bool skip(bool current);
+
+    GLuint m_program = kUnknown;
+    std::array<GLuint, kTextureUnits> m_textures{kUnknown, kUnknown, kUnknown, kUnknown};
+    std::size_t m_activeUnit = kTextureUnits;
+    GLuint m_vertexArray = kUnknown;
+    GLuint m_readFramebuffer = kUnknown;
+    GLuint m_drawFramebuffer = kUnknown;
+    // 0 off, 1 on, 2 unknown.
+    int m_blend = 2;
+    GLenum m_blendSource = 0;
+    GLenum m_blendDestination = 0;
+    GlStateStats m_stats;
+};
+
+enum class UniformType : std::uint8_t {
+    Int1,
+    Float1,
+    Float2,
+    Float3,
+    Float4,
+};
+
+// One uniform value to set before a draw. Int1 keeps its value in values[0];
+// it is only used for sampler units.
+struct CommandUniform {
+    GLint location = -1;
+    UniformType type = UniformType::Float1;
+    std::array<float, 4> values{};
+
+    static CommandUniform int1(GLint location, int value);
+    static CommandUniform float1(GLint location, float x);
+    static CommandUniform float2(GLint location, float x, float y);
+    static CommandUniform float3(GLint location, float x, float y, float z);
+    static CommandUniform float4(GLint location, float x, float y, float z, float w);
+};
+
+// Arrays draws a vertex array (GL 3.3 core); ScreenQuad draws `rect` in
+// immediate mode under the 2.1 path's y-down pixel projection.
+enum class CommandDraw : std::uint8_t {
+    Arrays,
+    ScreenQuad,
+};
+
+// One draw and the state it needs. Uniforms live in the buffer's shared pool.
+struct RenderCommand {
+    static constexpr std::size_t kTextureUnits = 3;
+
+    // Program in the high half and the recorder's order in the low half, so
+    // sorting groups draws by program and stays deterministic within one.
+    std::uint64_t sortKey = 0;
+    GLuint program = 0;
+    // Texture per unit; 0 leaves the unit as it is.
+    std::array<GLuint, kTextureUnits> textures{};
+    CommandDraw draw = CommandDraw::Arrays;
+    GLenum mode = GL_TRIANGLES;
+    GLuint vertexArray = 0;
+    GLint first = 0;
+    GLsizei count = 0;
+    std::array<float, 4> rect{};
+    std::uint32_t firstUniform = 0;
+    std::uint32_t uniformCount = 0;
+};
+
+// Draws recorded from any thread and replayed on the GL thread. begin() sizes
+// the buffer from the frame arena on the GL thread; record() only claims
+// slots with atomic counters, so workers can record side by side. execute()
+// sorts the commands by state and issues them through a GlStateCache, which
+// drops the binds consecutive commands share.
+class RenderCommandBuffer {
+public:
+    void begin(FrameArena& arena, std::size_t commandCapacity, std::size_t uniformCapacity);
+
+    // Thread-safe. Returns false, recording nothing, when the buffer is full.
+    bool record(std::uint32_t order, const RenderCommand& command, std::span<const CommandUniform> uniforms);
+
+    std::size_t size() const;
+
+    // Sorts and replays every recorded command, then empties the buffer.
+    // Call only once recording has finished.
+    void execute(GlStateCache& state);
+
+private:
+    static void setUniform(const CommandUniform& uniform);
+    static void draw(const RenderCommand& command, GlStateCache& state);
+
+    std::span<RenderCommand> m_commands;
+    std::span<CommandUniform> m_uniforms;
+    std::atomic<std::size_t> m_commandCount{0};
+    std::atomic<std::size_t> m_uniformCount{0};
+};
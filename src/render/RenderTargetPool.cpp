@@ -0,0 +1,149 @@
+#include "render/RenderTargetPool.hpp"
+
+#include "render/GlFunctions.hpp"
+#include "render/RenderCommands.hpp"
+
+#include <algorithm>
+
+namespace {
+
+// An eighth of headroom before rounding, so a window dragged just past a
+// bucket edge does not land on a target it immediately outgrows.
+int bucketed(int size) {
+    const int padded = size + size / 8;
+    return (padded + RenderTargetPool::kBucketPixels - 1) / RenderTargetPool::kBucketPixels *
+           RenderTargetPool::kBucketPixels;
+}
+
+std::uint64_t area(int width, int height) {
+    return static_cast<std::uint64_t>(width) * static_cast<std::uint64_t>(height);
+}
+
+std::uint64_t targetBytes(const RenderTarget& target) {
+    const std::uint64_t bytesPerPixel = target.format == GL_RGBA16F ? 8 : 4;
+    return area(target.width, target.height) * bytesPerPixel;
+}
+
+} // namespace
+
+RenderTargetPool::RenderTargetPool(GlStateCache& glState)
+    : m_glState(glState) {
+}
+
+RenderTargetPool::~RenderTargetPool() {
+    // The context may already be gone; clear() runs while it is current.
+    m_memory.release();
+}
+
+bool RenderTargetPool::suits(const RenderTarget& target, int width, int height, GLint format) {
+    // Twice the bucketed area is the most a target may waste before a smaller
+    // one is worth the allocation.
+    return target.texture != 0 && target.format == format && target.width >= width && target.height >= height &&
+           area(target.width, target.height) <= 2 * area(bucketed(width), bucketed(height));
+}
+
+bool RenderTargetPool::ensure(RenderTarget& target, int width, int height, GLint format, GLint filter) {
+    if (!suits(target, width, height, format)) {
+        release(target);
+
+        // The smallest pooled target that suits, else a new one.
+        std::size_t best = m_pooledCount;
+        for (std::size_t i = 0; i < m_pooledCount; ++i) {
+            const RenderTarget& pooled = m_pooled[i].target;
+            if (suits(pooled, width, height, format) &&
+                (best == m_pooledCount ||
+                 area(pooled.width, pooled.height) < area(m_pooled[best].target.width, m_pooled[best].target.height))) {
+                best = i;
+            }
+        }
+        if (best < m_pooledCount) {
+            target = m_pooled[best].target;
+            m_pooled[best] = m_pooled[--m_pooledCount];
+        } else if (!create(bucketed(width), bucketed(height), format, target)) {
+            return false;
+        }
+    }
+
+    if (target.filter != filter) {
+        m_glState.bindTexture(0, target.texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+        target.filter = filter;
+    }
+    return true;
+}
+
+void RenderTargetPool::release(RenderTarget& target) {
+    if (target.texture == 0) {
+        return;
+    }
+    if (m_pooledCount == kMaxPooled) {
+        // Full: the target released longest ago goes.
+        const auto oldest = std::min_element(
+            m_pooled.begin(), m_pooled.end(), [](const Pooled& a, const Pooled& b) {
+                return a.releasedFrame < b.releasedFrame;
+            });
+        destroy(oldest->target);
+        *oldest = m_pooled[--m_pooledCount];
+    }
+    m_pooled[m_pooledCount++] = Pooled{target, m_frame};
+    target = RenderTarget{};
+}
+
+void RenderTargetPool::trim() {
+    ++m_frame;
+    for (std::size_t i = 0; i < m_pooledCount;) {
+        if (m_frame - m_pooled[i].releasedFrame >= kIdleFrames) {
+            destroy(m_pooled[i].target);
+            m_pooled[i] = m_pooled[--m_pooledCount];
+        } else {
+            ++i;
+        }
+    }
+}
+
+void RenderTargetPool::clear() {
+    for (std::size_t i = 0; i < m_pooledCount; ++i) {
+        destroy(m_pooled[i].target);
+    }
+    m_pooledCount = 0;
+}
+
+bool RenderTargetPool::create(int width, int height, GLint format, RenderTarget& outTarget) {
+    RenderTarget target;
+    target.width = width;
+    target.height = height;
+    target.format = format;
+    target.filter = GL_LINEAR;
+
+    glGenTextures(1, &target.texture);
+    m_glState.bindTexture(0, target.texture);
+    const GLenum type = format == GL_RGBA16F ? GL_FLOAT : GL_UNSIGNED_BYTE;
+    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, GL_RGBA, type, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    glGenFramebuffers(1, &target.framebuffer);
+    m_glState.bindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.texture, 0);
+    const bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    m_liveBytes += targetBytes(target);
+    if (!complete) {
+        destroy(target);
+        m_memory.set(m_liveBytes);
+        return false;
+    }
+    m_memory.set(m_liveBytes);
+    outTarget = target;
+    return true;
+}
+
+void RenderTargetPool::destroy(RenderTarget& target) {
+    glDeleteFramebuffers(1, &target.framebuffer);
+    glDeleteTextures(1, &target.texture);
+    m_liveBytes -= targetBytes(target);
+    m_memory.set(m_liveBytes);
+    target = RenderTarget{};
+    // Deleted names may be handed out again by the next glGen* call.
+    m_glState.invalidate();
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <SDL2/SDL_opengl.h>
+
+#include "core/MemoryAccounting.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+class GlStateCache;
+
+// A colour texture and the framebuffer that draws into it. width and height
+// are the allocated size; passes draw into a sub-rectangle of it anchored at
+// the bottom-left corner.
+struct RenderTarget {
+    GLuint texture = 0;
+    GLuint framebuffer = 0;
+    int width = 0;
+    int height = 0;
+    GLint format = 0;
+    GLint filter = 0;
+};
+
+// Owns every render target texture. Targets are allocated with headroom and
+// rounded up to size buckets, so a window that grows or shrinks a little keeps
+// its targets and only the drawn sub-rectangle changes. Released targets are
+// kept for a while and handed out again, e.g. when fullscreen is toggled back,
+// and deleted once they have sat unused for kIdleFrames. GL thread only.
+class RenderTargetPool {
+public:
+    static constexpr int kBucketPixels = 256;
+    static constexpr std::uint64_t kIdleFrames = 600;
+
+    explicit RenderTargetPool(GlStateCache& glState);
+    ~RenderTargetPool();
+
+    RenderTargetPool(const RenderTargetPool&) = delete;
+    RenderTargetPool& operator=(const RenderTargetPool&) = delete;
+
+    // Keeps `target` when it is at least width x height, has `format` and is
+    // not far larger than needed; otherwise swaps it for a pooled or new one.
+    // Returns false, leaving `target` empty, when the framebuffer is
+    // incomplete (e.g. a format the driver cannot render to).
+    bool ensure(RenderTarget& target, int width, int height, GLint format, GLint filter);
+    // Returns `target` to the pool and empties it.
+    void release(RenderTarget& target);
+    // Deletes pooled targets idle for kIdleFrames. Call once per frame.
+    void trim();
+    // Deletes every pooled target; targets still held are the caller's to release first.
+    void clear();
+
+private:
+    static constexpr std::size_t kMaxPooled = 6;
+
+    struct Pooled {
+        RenderTarget target;
+        std::uint64_t releasedFrame = 0;
+    };
+
+    static bool suits(const RenderTarget& target, int width, int height, GLint format);
+    bool create(int width, int height, GLint format, RenderTarget& outTarget);
+    void destroy(RenderTarget& target);
+
+    GlStateCache& m_glState;
+    // Fixed size, so resizing never allocates on the CPU side.
+    std::array<Pooled, kMaxPooled> m_pooled{};
+    std::size_t m_pooledCount = 0;
+    std::uint64_t m_frame = 0;
+    std::uint64_t m_liveBytes = 0;
+    GpuAllocation m_memory{MemoryTag::RenderTargets};
+};
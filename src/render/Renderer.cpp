@@ -1,153 +1,165 @@
 #include "render/Renderer.hpp"
 
+#include "core/AssetManager.hpp"
+#include "core/JobSystem.hpp"
+#include "game/Camera.hpp"
 #include "game/Map.hpp"
+#include "game/ParticleSystem.hpp"
 #include "game/Player.hpp"
+#include "game/Townsfolk.hpp"
+#include "render/GlFunctions.hpp"
+#include "render/RenderCommands.hpp"
 
 #include <algorithm>
 #include <cstdint>
 #include <cmath>
 #include <cstdio>
 #include <cstdlib>
-#include <filesystem>
-#include <fstream>
-#include <sstream>
+#include <span>
+#include <string_view>
+#include <utility>
 #include <vector>
-#include <type_traits>
 #include <iostream>
-
-namespace fs = std::filesystem;
+#include <numbers>
 
 namespace {
 
-struct GlFunctions {
-    PFNGLACTIVETEXTUREPROC activeTexture = nullptr;
-    PFNGLATTACHSHADERPROC attachShader = nullptr;
-    PFNGLCOMPILESHADERPROC compileShader = nullptr;
-    PFNGLCREATEPROGRAMPROC createProgram = nullptr;
-    PFNGLCREATESHADERPROC createShader = nullptr;
-    PFNGLDELETEPROGRAMPROC deleteProgram = nullptr;
-    PFNGLDELETESHADERPROC deleteShader = nullptr;
-    PFNGLGETPROGRAMIVPROC getProgramiv = nullptr;
-    PFNGLGETPROGRAMINFOLOGPROC getProgramInfoLog = nullptr;
-    PFNGLGETSHADERIVPROC getShaderiv = nullptr;
-    PFNGLGETSHADERINFOLOGPROC getShaderInfoLog = nullptr;
-    PFNGLGETUNIFORMLOCATIONPROC getUniformLocation = nullptr;
-    PFNGLLINKPROGRAMPROC linkProgram = nullptr;
-    PFNGLSHADERSOURCEPROC shaderSource = nullptr;
-    PFNGLUSEPROGRAMPROC useProgram = nullptr;
-    PFNGLUNIFORM1FPROC uniform1f = nullptr;
-    PFNGLUNIFORM2FPROC uniform2f = nullptr;
-    PFNGLUNIFORM3FPROC uniform3f = nullptr;
-    PFNGLUNIFORM4FPROC uniform4f = nullptr;
-    PFNGLUNIFORM1IPROC uniform1i = nullptr;
-    PFNGLBINDFRAMEBUFFERPROC bindFramebuffer = nullptr;
-    PFNGLDELETEFRAMEBUFFERSPROC deleteFramebuffers = nullptr;
-    PFNGLGENFRAMEBUFFERSPROC genFramebuffers = nullptr;
-    PFNGLCHECKFRAMEBUFFERSTATUSPROC checkFramebufferStatus = nullptr;
-    PFNGLFRAMEBUFFERTEXTURE2DPROC framebufferTexture2D = nullptr;
-};
-
-GlFunctions g_gl;
-
-#define glActiveTexture g_gl.activeTexture
-#define glAttachShader g_gl.attachShader
-#define glCompileShader g_gl.compileShader
-#define glCreateProgram g_gl.createProgram
-#define glCreateShader g_gl.createShader
-#define glDeleteProgram g_gl.deleteProgram
-#define glDeleteShader g_gl.deleteShader
-#define glGetProgramiv g_gl.getProgramiv
-#define glGetProgramInfoLog g_gl.getProgramInfoLog
-#define glGetShaderiv g_gl.getShaderiv
-#define glGetShaderInfoLog g_gl.getShaderInfoLog
-#define glGetUniformLocation g_gl.getUniformLocation
-#define glLinkProgram g_gl.linkProgram
-#define glShaderSource g_gl.shaderSource
-#define glUseProgram g_gl.useProgram
-#define glUniform1f g_gl.uniform1f
-#define glUniform2f g_gl.uniform2f
-#define glUniform3f g_gl.uniform3f
-#define glUniform4f g_gl.uniform4f
-#define glUniform1i g_gl.uniform1i
-#define glBindFramebuffer g_gl.bindFramebuffer
-#define glDeleteFramebuffers g_gl.deleteFramebuffers
-#define glGenFramebuffers g_gl.genFramebuffers
-#define glCheckFramebufferStatus g_gl.checkFramebufferStatus
-#define glFramebufferTexture2D g_gl.framebufferTexture2D
-
-constexpr float kTileW = 64.0F;
-constexpr float kTileH = 32.0F;
 constexpr char kFullscreenVertexShader[] = R"(
 #version 120
 
+varying vec4 vColor;
+varying vec2 vUv;
+
 void main() {
     gl_Position = ftransform();
-    gl_TexCoord[0] = gl_MultiTexCoord0;
+    vColor = gl_Color;
+    vUv = gl_MultiTexCoord0.xy;
 }
 )";
 
-constexpr char kUseGpuLightingEnv[] = "RENDERER_FORCE_CPU_LIGHTING";
+constexpr char kCoreFullscreenVertexShader[] = R"(
+#version 330 core
 
-fs::path resolveResourcePath(const fs::path& relativePath) {
-    auto findFromRoot = [&](const fs::path& root) -> fs::path {
-        std::error_code ec;
-        fs::path cursor = root;
+out vec4 vColor;
+out vec2 vUv;
 
-        while (!cursor.empty()) {
-            const fs::path candidate = cursor / relativePath;
-            if (fs::exists(candidate, ec) && !ec) {
-                return candidate;
-            }
+void main() {
+    // One oversized triangle covering the viewport; no vertex buffer needed.
+    vec2 corner = vec2(float((gl_VertexID << 1) & 2), float(gl_VertexID & 2));
+    vColor = vec4(1.0);
+    vUv = corner;
+    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
 
-            const fs::path parent = cursor.parent_path();
-            if (parent == cursor) {
-                break;
-            }
-            cursor = parent;
-        }
+constexpr char kCoreVolumeVertexShader[] = R"(
+#version 330 core
 
-        return {};
-    };
+// Pixel rectangle (x0, y0, x1, y1), y down.
+uniform vec4 uVolumeRect;
+uniform vec2 uViewport;
+
+out vec4 vColor;
+out vec2 vUv;
+
+void main() {
+    vec2 corner = vec2(float(gl_VertexID & 1), float(gl_VertexID >> 1));
+    vec2 pixel = mix(uVolumeRect.xy, uVolumeRect.zw, corner);
+    vec2 unit = pixel / uViewport;
+    vColor = vec4(1.0);
+    vUv = vec2(unit.x, 1.0 - unit.y);
+    gl_Position = vec4(unit.x * 2.0 - 1.0, 1.0 - unit.y * 2.0, 0.0, 1.0);
+}
+)";
+
+constexpr char kUseGpuLightingEnv[] = "RENDERER_FORCE_CPU_LIGHTING";
+constexpr char kForceCompatibilityEnv[] = "RENDERER_FORCE_GL21";
+constexpr char kMultiPassLightingEnv[] = "RENDERER_MULTIPASS_LIGHTING";
+constexpr char kLightVolumesEnv[] = "RENDERER_LIGHT_VOLUMES";
+constexpr char kFixedResolutionEnv[] = "RENDERER_FIXED_RESOLUTION";
+constexpr char kCaptureDirEnv[] = "RENDERER_CAPTURE_DIR";
+constexpr char kCaptureFormatEnv[] = "RENDERER_CAPTURE_FORMAT";
+constexpr char kCaptureIntervalEnv[] = "RENDERER_CAPTURE_INTERVAL";
+constexpr float kAmbientR = 0.68F;
+constexpr float kAmbientG = 0.74F;
+constexpr float kAmbientB = 0.84F;
+// Work per pool job: occlusion rays, and tiles for the CPU lighting path.
+constexpr std::size_t kRaysPerJob = 1024;
+constexpr std::size_t kTilesPerLightingJob = 4096;
+constexpr std::size_t kParticlesPerJob = 8192;
+// Light volumes recorded per pool job, and the uniforms one volume sets.
+constexpr std::size_t kVolumesPerRecordJob = 4;
+constexpr std::size_t kVolumeUniforms = 10;
+// The 2.1 path draws each particle as a four-vertex quad.
+constexpr std::size_t kParticleQuadVertices = 4;
+
+bool envFlagSet(const char* name) {
+    const char* value = std::getenv(name);
+    return value != nullptr && value[0] != '\0' && value[0] != '0';
+}
+
+// A span of world pixels split at the cache edge: `world` starts the run in
+// world space, `cache` is where it lands in a cache with the given period.
+struct WrappedRun {
+    int world;
+    int cache;
+    int length;
+};
+
+int wrapIndex(int value, int period) {
+    const int wrapped = value % period;
+    return wrapped < 0 ? wrapped + period : wrapped;
+}
 
-    if (const fs::path fromCwd = findFromRoot(fs::current_path()); !fromCwd.empty()) {
-        return fromCwd;
+int splitWrapped(int start, int length, int period, std::array<WrappedRun, 2>& outRuns) {
+    const int cacheStart = wrapIndex(start, period);
+    const int first = std::min(length, period - cacheStart);
+    outRuns[0] = WrappedRun{start, cacheStart, first};
+    if (first == length) {
+        return 1;
     }
+    outRuns[1] = WrappedRun{start + first, 0, length - first};
+    return 2;
+}
 
-    if (const char* basePath = SDL_GetBasePath(); basePath != nullptr) {
-        const fs::path fromBasePath = findFromRoot(fs::path(basePath));
-        SDL_free(const_cast<char*>(basePath));
-        if (!fromBasePath.empty()) {
-            return fromBasePath;
+void drawQuadsImmediate(std::span<const SpriteQuad> quads) {
+    glBegin(GL_QUADS);
+    for (const SpriteQuad& quad : quads) {
+        glColor3f(quad.r, quad.g, quad.b);
+        for (int i = 0; i < 4; ++i) {
+            glVertex2f(quad.x[i], quad.y[i]);
         }
     }
-
-    return relativePath;
+    glEnd();
 }
 
 float pseudoLight(float tileX, float tileY, const Light& light) {
     const float dx = tileX - light.x;
     const float dy = tileY - light.y;
-    const float dist = std::sqrt(dx * dx + dy * dy);
-    const float radius = std::max(0.001F, light.radius);
-    const float normalized = dist / radius;
+    return lightFalloff(std::sqrt(dx * dx + dy * dy), light.radius, light.falloffExponent) * light.intensity;
+}
 
-    float attenuation = 0.0F;
-    if (light.falloffExponent > 0.0F) {
-        attenuation = std::pow(std::clamp(1.0F - normalized, 0.0F, 1.0F), light.falloffExponent);
-    } else {
-        const float k = 1.0F / (radius * radius);
-        attenuation = 1.0F / (1.0F + k * dist * dist);
+// Calls body(begin, end) over [0, count), spread over the pool when there is one.
+template <typename F>
+void forEachChunk(JobSystem* jobs, std::size_t count, std::size_t grain, const F& body) {
+    if (jobs == nullptr) {
+        body(std::size_t{0}, count);
+        return;
     }
-
-    return attenuation * light.intensity;
+    jobs->parallelFor(count, grain, body);
 }
 
 struct OcclusionCache {
     int width = 0;
     int height = 0;
-    std::vector<int8_t> values;
+    std::span<int8_t> values;
 
-    explicit OcclusionCache(int w, int h) : width(w), height(h), values(static_cast<size_t>(w * h), static_cast<int8_t>(-1)) {}
+    void reset(FrameArena& arena, int w, int h) {
+        width = w;
+        height = h;
+        values = arena.allocateArray<int8_t>(static_cast<size_t>(w * h));
+        std::fill(values.begin(), values.end(), static_cast<int8_t>(-1));
+    }
 
     int index(int x, int y) const {
         return y * width + x;
@@ -162,39 +174,6 @@ struct OcclusionCache {
     }
 };
 
-bool hasLineOcclusion(const Map& map, int fromX, int fromY, int toX, int toY) {
-    int x = fromX;
-    int y = fromY;
-
-    const int dx = std::abs(toX - fromX);
-    const int sx = fromX < toX ? 1 : -1;
-    const int dy = -std::abs(toY - fromY);
-    const int sy = fromY < toY ? 1 : -1;
-    int err = dx + dy;
-
-    while (!(x == toX && y == toY)) {
-        const int twiceErr = err * 2;
-        if (twiceErr >= dy) {
-            err += dy;
-            x += sx;
-        }
-        if (twiceErr <= dx) {
-            err += dx;
-            y += sy;
-        }
-
-        if (x == toX && y == toY) {
-            break;
-        }
-
-        if (map.isBlocked(x, y)) {
-            return true;
-        }
-    }
-
-    return false;
-}
-
 float directWithOcclusion(const Map& map, int tileX, int tileY, const Light& light, OcclusionCache& cache) {
     const int cacheState = cache.get(tileX, tileY);
     bool occluded = false;
@@ -203,45 +182,213 @@ float directWithOcclusion(const Map& map, int tileX, int tileY, const Light& lig
     } else {
         const int lightTileX = static_cast<int>(std::round(light.x));
         const int lightTileY = static_cast<int>(std::round(light.y));
-        occluded = hasLineOcclusion(map, lightTileX, lightTileY, tileX, tileY);
+        occluded = !map.hasLineOfSight(lightTileX, lightTileY, tileX, tileY);
         cache.set(tileX, tileY, static_cast<int8_t>(occluded ? 1 : 0));
     }
 
-    constexpr float kOccludedDirectScale = 0.12F;
     const float direct = pseudoLight(static_cast<float>(tileX), static_cast<float>(tileY), light);
     return direct * (occluded ? kOccludedDirectScale : 1.0F);
 }
+
+// Tile rectangle a light can reach. Inverse-square lights never reach zero, so
+// they cover the whole map.
+struct TileBounds {
+    int minX;
+    int minY;
+    int maxX;
+    int maxY;
+};
+
+TileBounds lightTileBounds(const Map& map, const Light& light) {
+    if (light.falloffExponent <= 0.0F) {
+        return {0, 0, map.width() - 1, map.height() - 1};
+    }
+
+    return {
+        std::max(0, static_cast<int>(std::floor(light.x - light.radius))),
+        std::max(0, static_cast<int>(std::floor(light.y - light.radius))),
+        std::min(map.width() - 1, static_cast<int>(std::ceil(light.x + light.radius))),
+        std::min(map.height() - 1, static_cast<int>(std::ceil(light.y + light.radius))),
+    };
+}
 } // namespace
 
 bool Renderer::initialize(SDL_Window* window) {
+    const MemoryTagScope memoryTag(MemoryTag::Render);
     m_window = window;
-    m_context = SDL_GL_CreateContext(window);
-    if (m_context == nullptr) {
-        std::cerr << "SDL_GL_CreateContext failed: " << SDL_GetError() << '\n';
-        return false;
+    // Later changes arrive through resize().
+    SDL_GetWindowSize(m_window, &m_viewWidth, &m_viewHeight);
+
+    // The CPU lighting path draws with the fixed-function pipeline, so it
+    // always gets a 2.1 context.
+    m_forceCpuPath = envFlagSet(kUseGpuLightingEnv);
+    m_lightingMode = LightingMode::Fused;
+    if (envFlagSet(kLightVolumesEnv)) {
+        m_lightingMode = LightingMode::Volumes;
+    } else if (envFlagSet(kMultiPassLightingEnv)) {
+        m_lightingMode = LightingMode::MultiPass;
     }
-
-    const char* forceCpu = std::getenv(kUseGpuLightingEnv);
-    if (!loadGlFunctions()) {
-        std::cerr << "Required OpenGL entry points are unavailable; falling back to CPU lighting path.\n";
-        m_forceCpuPath = true;
-        return true;
+    m_dynamicResolution.setEnabled(!envFlagSet(kFixedResolutionEnv));
+    const bool tryCore = !m_forceCpuPath && !envFlagSet(kForceCompatibilityEnv);
+
+    m_coreProfile = tryCore && createContext(true) && loadGlFunctions(true);
+    if (!m_coreProfile) {
+        if (m_context != nullptr) {
+            SDL_GL_DeleteContext(m_context);
+            m_context = nullptr;
+        }
+        if (!createContext(false)) {
+            std::cerr << "SDL_GL_CreateContext failed: " << SDL_GetError() << '\n';
+            return false;
+        }
+        if (!loadGlFunctions(false)) {
+            std::cerr << "Required OpenGL entry points are unavailable; falling back to CPU lighting path.\n";
+            m_forceCpuPath = true;
+            m_glFunctionsLoaded = false;
+            return true;
+        }
     }
-    m_forceCpuPath = forceCpu != nullptr && forceCpu[0] != '\0' && forceCpu[0] != '0';
+    m_glFunctionsLoaded = true;
 
     if (m_forceCpuPath) {
         std::cerr << "GPU lighting disabled by " << kUseGpuLightingEnv << "; using CPU lighting path.\n";
     }
 
-    if (!m_forceCpuPath && !initializeGpuPipeline()) {
+    startFrameCapture();
+    return true;
+}
+
+void Renderer::startFrameCapture() {
+    const char* directory = std::getenv(kCaptureDirEnv);
+    if (directory == nullptr || directory[0] == '\0') {
+        return;
+    }
+
+    const char* format = std::getenv(kCaptureFormatEnv);
+    const bool ppm = format != nullptr && std::string_view(format) == "ppm";
+    const char* interval = std::getenv(kCaptureIntervalEnv);
+    m_frameCapture.start(
+        directory,
+        ppm ? CaptureFormat::Ppm : CaptureFormat::Png,
+        interval != nullptr ? std::atoi(interval) : 1);
+}
+
+bool Renderer::createContext(bool coreProfile) {
+    if (coreProfile) {
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, SDL_GL_CONTEXT_FORWARD_COMPATIBLE_FLAG);
+    } else {
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 2);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 1);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, 0);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, 0);
+    }
+
+    m_context = SDL_GL_CreateContext(m_window);
+    return m_context != nullptr;
+}
+
+void Renderer::fallBackFromGpuLighting(const char* reason) {
+    if (!m_coreProfile) {
+        std::cerr << reason << "; falling back to CPU lighting path.\n";
+        m_forceCpuPath = true;
+        return;
+    }
+
+    // Nothing can be drawn in a core context without the GPU pipeline, so
+    // replace it with a 2.1 context and retry there.
+    std::cerr << reason << "; falling back to the OpenGL 2.1 renderer.\n";
+    destroyGpuPipeline();
+    m_frameCapture.stop();
+    SDL_GL_DeleteContext(m_context);
+    m_context = nullptr;
+    m_coreProfile = false;
+
+    if (!createContext(false) || !loadGlFunctions(false)) {
+        std::cerr << "OpenGL 2.1 context unavailable: " << SDL_GetError() << '\n';
+        m_forceCpuPath = true;
+        m_glFunctionsLoaded = false;
+        return;
+    }
+    startFrameCapture();
+
+    if (m_sources.light.empty() || !initializeGpuPipeline(m_sources)) {
         std::cerr << "GPU lighting pipeline init failed; falling back to CPU lighting path.\n";
         m_forceCpuPath = true;
     }
+}
+
+bool Renderer::loadShaderSources(const AssetManager& assets, ShaderSources& outSources) {
+    const MemoryTagScope memoryTag(MemoryTag::Shaders);
+    constexpr char albedoPath[] = "assets/shaders/albedo.glsl";
+    constexpr char lightPath[] = "assets/shaders/light.glsl";
+    constexpr char compositePath[] = "assets/shaders/composite.glsl";
 
+    if (!assets.readText(albedoPath, outSources.albedo) ||
+        !assets.readText(lightPath, outSources.light) ||
+        !assets.readText(compositePath, outSources.composite)) {
+        std::cerr << "Failed to load shader sources from:\n"
+                  << "  " << albedoPath << "\n"
+                  << "  " << lightPath << "\n"
+                  << "  " << compositePath << "\n";
+        return false;
+    }
+    return true;
+}
+
+bool Renderer::uploadShaders(const ShaderSources& sources) {
+    if (m_forceCpuPath) {
+        return true;
+    }
+    const MemoryTagScope memoryTag(MemoryTag::Shaders);
+
+    destroyGpuPipeline();
+    m_sources = sources;
+    if (!initializeGpuPipeline(m_sources)) {
+        fallBackFromGpuLighting("GPU lighting pipeline init failed");
+    }
     return true;
 }
 
+void Renderer::renderLoadingScreen(float progress) {
+    const int width = m_viewWidth;
+    const int height = m_viewHeight;
+
+    if (!m_forceCpuPath) {
+        m_glState.invalidate();
+        m_glState.useProgram(0);
+        m_glState.bindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+    glViewport(0, 0, width, height);
+    glClearColor(0.06F, 0.06F, 0.08F, 1.0F);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    // The bar is drawn with scissored clears: shaders may not be loaded yet and
+    // a core context has no fixed-function fallback.
+    const int barWidth = width * 2 / 5;
+    const int barHeight = 12;
+    const int left = (width - barWidth) / 2;
+    const int bottom = height / 2 - barHeight / 2;
+    const int filled = static_cast<int>(static_cast<float>(barWidth) * std::clamp(progress, 0.0F, 1.0F));
+
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(left, bottom, barWidth, barHeight);
+    glClearColor(0.20F, 0.15F, 0.10F, 1.0F);
+    glClear(GL_COLOR_BUFFER_BIT);
+    if (filled > 0) {
+        glScissor(left, bottom, filled, barHeight);
+        glClearColor(0.78F, 0.62F, 0.30F, 1.0F);
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
+    glDisable(GL_SCISSOR_TEST);
+
+    SDL_GL_SwapWindow(m_window);
+}
+
 void Renderer::shutdown() {
+    m_frameCapture.stop();
     destroyGpuPipeline();
 
     if (m_context != nullptr) {
@@ -250,6 +397,11 @@ void Renderer::shutdown() {
     }
 }
 
+void Renderer::resize(int width, int height) {
+    m_viewWidth = width;
+    m_viewHeight = height;
+}
+
 void Renderer::setAmbient(float value) {
     m_ambient = std::clamp(value, 0.0F, 1.0F);
 }
@@ -260,282 +412,849 @@ void Renderer::setGlobalTint(float r, float g, float b) {
     m_globalTintB = std::clamp(b, 0.0F, 2.0F);
 }
 
-void Renderer::render(const Map& map, const Player& player, const Light& playerLight, const Light& lampLight) {
-    int width = 0;
-    int height = 0;
-    SDL_GetWindowSize(m_window, &width, &height);
+void Renderer::setDynamicResolution(bool enabled) {
+    m_dynamicResolution.setEnabled(enabled);
+}
 
-    const float mapPixelWidth = static_cast<float>(map.width() + map.height()) * (kTileW * 0.5F);
-    const float mapPixelHeight = static_cast<float>(map.width() + map.height()) * (kTileH * 0.5F);
-    const float originX = (static_cast<float>(width) - mapPixelWidth) * 0.5F;
-    const float originY = (static_cast<float>(height) - mapPixelHeight) * 0.5F;
+float Renderer::renderScale() const {
+    return m_dynamicResolution.scale();
+}
 
-    if (m_forceCpuPath) {
-        renderCpuLighting(map, player, playerLight, lampLight, originX, originY);
+void Renderer::setLightingMode(LightingMode mode) {
+    // Render targets follow the mode on the next ensureRenderTargets call.
+    m_lightingMode = mode;
+}
+
+void Renderer::setStaticLighting(Lightmap lightmap) {
+    m_lightmap = std::move(lightmap);
+    m_lightmapDirty = true;
+}
+
+void Renderer::setStaticLightScale(float scale) {
+    m_staticLightScale = std::max(0.0F, scale);
+}
+
+void Renderer::setJobSystem(JobSystem* jobs) {
+    m_jobs = jobs;
+}
+
+GlStateStats Renderer::glStateStats() const {
+    return m_glState.stats();
+}
+
+void Renderer::render(
+    const Map& map,
+    const Player& player,
+    const Townsfolk& townsfolk,
+    const Camera& camera,
+    const ParticleSystem& particles,
+    std::span<const Light> lights) {
+    const MemoryTagScope memoryTag(MemoryTag::Render);
+    const std::uint64_t passStart = SDL_GetPerformanceCounter();
+    m_frameArena.reset();
+    // Frame capture and SDL touch GL state between frames.
+    m_glState.invalidate();
+    lights = lights.first(std::min(lights.size(), kMaxLights));
+    m_targetPool.trim();
+
+    float originX = 0.0F;
+    float originY = 0.0F;
+    cameraOrigin(map, camera, originX, originY);
+    refreshStaticLighting(map);
+
+    if (m_forceCpuPath || m_compositeProgram == 0) {
+        renderCpuLighting(map, player, townsfolk, particles, lights, originX, originY);
         return;
     }
 
+    if (m_lightmapDirty) {
+        updateLightmapTexture();
+    }
+
+    // Volumes resolve one variant per light inside renderLightVolumes.
+    const bool volumes = activeLightingMode() == LightingMode::Volumes;
+    LightShaderKey lightKey;
+    const LightProgram* lightProgram = nullptr;
+    if (!volumes) {
+        lightKey = selectLightVariant(map, lights, 0);
+        lightProgram = lightVariant(lightKey);
+        if (lightProgram == nullptr) {
+            fallBackFromGpuLighting("Light shader variant failed");
+            render(map, player, townsfolk, camera, particles, lights);
+            return;
+        }
+    }
+
     if (!ensureRenderTargets()) {
-        renderCpuLighting(map, player, playerLight, lampLight, originX, originY);
+        if (m_coreProfile) {
+            fallBackFromGpuLighting("Render targets unavailable");
+            render(map, player, townsfolk, camera, particles, lights);
+            return;
+        }
+        renderCpuLighting(map, player, townsfolk, particles, lights, originX, originY);
         return;
     }
 
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    glOrtho(0.0, static_cast<double>(m_targetWidth), static_cast<double>(m_targetHeight), 0.0, -1.0, 1.0);
+    // Snap the layout to whole target pixels so tiles kept in the cache line
+    // up exactly with the ones drawn after a scroll.
+    const float scaleX = static_cast<float>(m_targetWidth) / static_cast<float>(m_viewWidth);
+    const float scaleY = static_cast<float>(m_targetHeight) / static_cast<float>(m_viewHeight);
+    originX = std::round(originX * scaleX) / scaleX;
+    originY = std::round(originY * scaleY) / scaleY;
 
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
+    if (!m_coreProfile) {
+        glMatrixMode(GL_PROJECTION);
+        glLoadIdentity();
+        glOrtho(0.0, static_cast<double>(m_viewWidth), static_cast<double>(m_viewHeight), 0.0, -1.0, 1.0);
+
+        glMatrixMode(GL_MODELVIEW);
+        glLoadIdentity();
+    }
 
+    // Geometry is laid out in window pixels; the viewport maps it onto the
+    // (possibly scaled) render targets.
     glDisable(GL_DEPTH_TEST);
 
-    glBindFramebuffer(GL_FRAMEBUFFER, m_albedoFbo);
+    m_gpuTimer.begin();
     glViewport(0, 0, m_targetWidth, m_targetHeight);
-    glClearColor(0.0F, 0.0F, 0.0F, 1.0F);
-    glClear(GL_COLOR_BUFFER_BIT);
-    glUseProgram(m_albedoProgram);
-    renderSceneAlbedo(map, player, originX, originY);
+    renderSceneAlbedo(map, player, townsfolk, particles, originX, originY);
 
-    glBindFramebuffer(GL_FRAMEBUFFER, m_lightFbo);
-    glViewport(0, 0, m_targetWidth, m_targetHeight);
-    glClearColor(0.0F, 0.0F, 0.0F, 1.0F);
-    glClear(GL_COLOR_BUFFER_BIT);
-    glUseProgram(m_lightProgram);
-    glUniform2f(glGetUniformLocation(m_lightProgram, "uResolution"), static_cast<float>(m_targetWidth), static_cast<float>(m_targetHeight));
-    glUniform2f(glGetUniformLocation(m_lightProgram, "uIsoTile"), kTileW, kTileH);
-    glUniform2f(glGetUniformLocation(m_lightProgram, "uIsoOrigin"), originX, originY);
-    glUniform1f(glGetUniformLocation(m_lightProgram, "uAmbient"), m_ambient);
-    glUniform3f(glGetUniformLocation(m_lightProgram, "uAmbientColor"), 0.68F, 0.74F, 0.84F);
-    glUniform4f(glGetUniformLocation(m_lightProgram, "uPlayerLight"), playerLight.x, playerLight.y, playerLight.radius, playerLight.intensity);
-    glUniform4f(glGetUniformLocation(m_lightProgram, "uLampLight"), lampLight.x, lampLight.y, lampLight.radius, lampLight.intensity);
-    glUniform4f(glGetUniformLocation(m_lightProgram, "uPlayerLightColor"), playerLight.r, playerLight.g, playerLight.b, playerLight.falloffExponent);
-    glUniform4f(glGetUniformLocation(m_lightProgram, "uLampLightColor"), lampLight.r, lampLight.g, lampLight.b, lampLight.falloffExponent);
-    drawFullscreenQuad();
+    if (volumes) {
+        if (!renderLightVolumes(map, lights, originX, originY)) {
+            fallBackFromGpuLighting("Light volume variant failed");
+            render(map, player, townsfolk, camera, particles, lights);
+            return;
+        }
+    } else {
+        renderLightPass(map, lights, lightKey, *lightProgram, originX, originY);
+        if (lightKey.fused) {
+            presentFrame(passStart);
+            return;
+        }
+    }
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glViewport(0, 0, m_targetWidth, m_targetHeight);
+    // Composite samples the targets with linear filtering, which also
+    // upscales them when the dynamic resolution scale is below 1.
+    m_glState.bindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, m_viewWidth, m_viewHeight);
     glClearColor(0.06F, 0.06F, 0.08F, 1.0F);
     glClear(GL_COLOR_BUFFER_BIT);
 
-    glUseProgram(m_compositeProgram);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, m_albedoTex);
+    m_glState.useProgram(m_compositeProgram);
+    m_glState.bindTexture(0, m_albedoTarget.texture);
     glUniform1i(glGetUniformLocation(m_compositeProgram, "uAlbedoTex"), 0);
 
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, m_lightTex);
+    m_glState.bindTexture(1, m_lightTarget.texture);
     glUniform1i(glGetUniformLocation(m_compositeProgram, "uLightTex"), 1);
+    setTargetUv(glGetUniformLocation(m_compositeProgram, "uTargetUv"));
     glUniform3f(glGetUniformLocation(m_compositeProgram, "uGlobalTint"), m_globalTintR, m_globalTintG, m_globalTintB);
 
     drawFullscreenQuad();
+    presentFrame(passStart);
+}
+
+void Renderer::presentFrame(std::uint64_t passStart) {
+    m_gpuTimer.end();
+    // The pass time stops before the swap: with vsync on, the swap waits for
+    // the vblank, and counting that would keep the passes from ever showing
+    // the headroom needed to raise the scale again.
+    const std::uint64_t passEnd = SDL_GetPerformanceCounter();
+    double gpuSeconds = 0.0;
+    if (m_gpuTimer.poll(gpuSeconds)) {
+        m_gpuPassSeconds = gpuSeconds;
+    }
 
-    glUseProgram(0);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    glActiveTexture(GL_TEXTURE0);
+    m_glState.useProgram(0);
+    m_frameCapture.captureFrame(m_viewWidth, m_viewHeight);
     SDL_GL_SwapWindow(m_window);
+
+    const std::uint64_t now = SDL_GetPerformanceCounter();
+    const double frequency = static_cast<double>(SDL_GetPerformanceFrequency());
+    if (m_lastPresentCounter != 0) {
+        const double frameSeconds = static_cast<double>(now - m_lastPresentCounter) / frequency;
+        // Whichever of the CPU issuing the passes and the GPU drawing them
+        // took longer; GPU results arrive a few frames late. Without timer
+        // queries only the CPU side is measured: waiting for the GPU here
+        // would stall every frame on the drivers that need the scaling most.
+        const double cpuSeconds = static_cast<double>(passEnd - passStart) / frequency;
+        m_dynamicResolution.addSample(frameSeconds, std::max(cpuSeconds, m_gpuPassSeconds));
+    }
+    m_lastPresentCounter = now;
 }
 
+LightingMode Renderer::activeLightingMode() const {
+    // The fused pass writes straight to the window, so it cannot run at a
+    // reduced scale; below 1 the composite pass does the upscale instead.
+    if (m_lightingMode == LightingMode::Fused && m_dynamicResolution.scale() < 1.0F) {
+        return LightingMode::MultiPass;
+    }
+    return m_lightingMode;
+}
 
-bool Renderer::loadGlFunctions() {
-    auto loadProc = [](auto& proc, const char* name) {
-        proc = reinterpret_cast<std::remove_reference_t<decltype(proc)>>(SDL_GL_GetProcAddress(name));
-        return proc != nullptr;
-    };
+void Renderer::renderLightPass(
+    const Map& map,
+    std::span<const Light> lights,
+    const LightShaderKey& lightKey,
+    const LightProgram& lightProgram,
+    float originX,
+    float originY) {
+    // Fused: the light pass samples albedo and writes the final image, so the
+    // intermediate light buffer is never written or read.
+    const bool fused = lightKey.fused;
+    m_glState.bindFramebuffer(GL_FRAMEBUFFER, fused ? 0 : m_lightTarget.framebuffer);
+    glViewport(0, 0, m_targetWidth, m_targetHeight);
+    if (fused) {
+        glClearColor(0.06F, 0.06F, 0.08F, 1.0F);
+    } else {
+        glClearColor(0.0F, 0.0F, 0.0F, 1.0F);
+    }
+    glClear(GL_COLOR_BUFFER_BIT);
+    // Light shaders work from gl_FragCoord, i.e. in target pixels.
+    const float scaleX = static_cast<float>(m_targetWidth) / static_cast<float>(m_viewWidth);
+    const float scaleY = static_cast<float>(m_targetHeight) / static_cast<float>(m_viewHeight);
+    m_glState.useProgram(lightProgram.program);
+    glUniform2f(lightProgram.resolution, static_cast<float>(m_targetWidth), static_cast<float>(m_targetHeight));
+    glUniform2f(lightProgram.isoTile, kTileW * scaleX, kTileH * scaleY);
+    glUniform2f(lightProgram.isoOrigin, originX * scaleX, originY * scaleY);
+    glUniform1f(lightProgram.ambient, m_ambient);
+    glUniform3f(lightProgram.ambientColor, kAmbientR, kAmbientG, kAmbientB);
+    if (!lights.empty()) {
+        std::array<float, kMaxLights * 4> positions{};
+        std::array<float, kMaxLights * 4> colors{};
+        for (std::size_t i = 0; i < lights.size(); ++i) {
+            const Light& light = lights[i];
+            positions[i * 4 + 0] = light.x;
+            positions[i * 4 + 1] = light.y;
+            positions[i * 4 + 2] = light.radius;
+            positions[i * 4 + 3] = light.intensity;
+            colors[i * 4 + 0] = light.r;
+            colors[i * 4 + 1] = light.g;
+            colors[i * 4 + 2] = light.b;
+            colors[i * 4 + 3] = light.falloffExponent;
+        }
+        glUniform4fv(lightProgram.lights, static_cast<GLsizei>(lights.size()), positions.data());
+        glUniform4fv(lightProgram.lightColors, static_cast<GLsizei>(lights.size()), colors.data());
+    }
+    if (lightKey.occlusion) {
+        updateOcclusionTexture(map, lights);
+        m_glState.bindTexture(0, m_occlusionTex);
+        glUniform1i(lightProgram.occlusionTex, 0);
+        glUniform3f(
+            lightProgram.occlusionSize,
+            static_cast<float>(map.width()),
+            static_cast<float>(map.height()),
+            static_cast<float>(lights.size()));
+    }
+    if (fused) {
+        m_glState.bindTexture(1, m_albedoTarget.texture);
+        glUniform1i(lightProgram.albedoTex, 1);
+        setTargetUv(lightProgram.targetUv);
+        glUniform3f(lightProgram.globalTint, m_globalTintR, m_globalTintG, m_globalTintB);
+    }
+    if (lightKey.baked) {
+        bindLightmap(lightProgram, map);
+    }
+    drawFullscreenQuad();
+}
 
-    return loadProc(g_gl.activeTexture, "glActiveTexture") &&
-        loadProc(g_gl.attachShader, "glAttachShader") &&
-        loadProc(g_gl.compileShader, "glCompileShader") &&
-        loadProc(g_gl.createProgram, "glCreateProgram") &&
-        loadProc(g_gl.createShader, "glCreateShader") &&
-        loadProc(g_gl.deleteProgram, "glDeleteProgram") &&
-        loadProc(g_gl.deleteShader, "glDeleteShader") &&
-        loadProc(g_gl.getProgramiv, "glGetProgramiv") &&
-        loadProc(g_gl.getProgramInfoLog, "glGetProgramInfoLog") &&
-        loadProc(g_gl.getShaderiv, "glGetShaderiv") &&
-        loadProc(g_gl.getShaderInfoLog, "glGetShaderInfoLog") &&
-        loadProc(g_gl.getUniformLocation, "glGetUniformLocation") &&
-        loadProc(g_gl.linkProgram, "glLinkProgram") &&
-        loadProc(g_gl.shaderSource, "glShaderSource") &&
-        loadProc(g_gl.useProgram, "glUseProgram") &&
-        loadProc(g_gl.uniform1f, "glUniform1f") &&
-        loadProc(g_gl.uniform2f, "glUniform2f") &&
-        loadProc(g_gl.uniform3f, "glUniform3f") &&
-        loadProc(g_gl.uniform4f, "glUniform4f") &&
-        loadProc(g_gl.uniform1i, "glUniform1i") &&
-        loadProc(g_gl.bindFramebuffer, "glBindFramebuffer") &&
-        loadProc(g_gl.deleteFramebuffers, "glDeleteFramebuffers") &&
-        loadProc(g_gl.genFramebuffers, "glGenFramebuffers") &&
-        loadProc(g_gl.checkFramebufferStatus, "glCheckFramebufferStatus") &&
-        loadProc(g_gl.framebufferTexture2D, "glFramebufferTexture2D");
-}
-
-bool Renderer::initializeGpuPipeline() {
-    GLuint fullscreenVs = compileShader(GL_VERTEX_SHADER, kFullscreenVertexShader, "fullscreen.vert");
-    if (fullscreenVs == 0) {
-        return false;
+bool Renderer::renderLightVolumes(const Map& map, std::span<const Light> lights, float originX, float originY) {
+    // Resolve every variant before drawing so a failure leaves no half-lit buffer.
+    std::array<LightShaderKey, kMaxLights> keys{};
+    std::array<const LightProgram*, kMaxLights> programs{};
+    bool anyOcclusion = false;
+    for (std::size_t i = 0; i < lights.size(); ++i) {
+        keys[i] = selectLightVariant(map, lights.subspan(i, 1), i);
+        keys[i].fused = false;
+        keys[i].volume = true;
+        keys[i].baked = false;
+        programs[i] = lightVariant(keys[i]);
+        if (programs[i] == nullptr) {
+            return false;
+        }
+        anyOcclusion = anyOcclusion || keys[i].occlusion;
+    }
+    // Static lights are one extra screen-filling volume that reads the lightmap.
+    const LightProgram* bakedProgram = nullptr;
+    if (bakedLightingReady(map)) {
+        const LightShaderKey bakedKey{0, FalloffMode::Mixed, false, false, true, true};
+        bakedProgram = lightVariant(bakedKey);
+        if (bakedProgram == nullptr) {
+            return false;
+        }
+    }
+    if (anyOcclusion) {
+        updateOcclusionTexture(map, lights);
     }
 
-    const fs::path albedoPath = resolveResourcePath("assets/shaders/albedo.glsl");
-    const fs::path lightPath = resolveResourcePath("assets/shaders/light.glsl");
-    const fs::path compositePath = resolveResourcePath("assets/shaders/composite.glsl");
+    // Every volume becomes one command, recorded on the pool when there is
+    // one. Additive blending makes the draw order free, so the executor
+    // replays them grouped by program and binds shared state once.
+    m_volumeCommands.begin(m_frameArena, lights.size() + 1, (lights.size() + 1) * kVolumeUniforms);
+    const float viewWidth = static_cast<float>(m_viewWidth);
+    const float viewHeight = static_cast<float>(m_viewHeight);
+    const float targetWidth = static_cast<float>(m_targetWidth);
+    const float targetHeight = static_cast<float>(m_targetHeight);
+    const float scaleX = targetWidth / viewWidth;
+    const float scaleY = targetHeight / viewHeight;
+    if (bakedProgram != nullptr) {
+        const LightProgram& program = *bakedProgram;
+        RenderCommand command = screenRectCommand(program, 0.0F, 0.0F, viewWidth, viewHeight);
+        command.textures[2] = m_lightmapTex;
+        const std::array<CommandUniform, 8> uniforms{
+            CommandUniform::float2(program.resolution, targetWidth, targetHeight),
+            CommandUniform::float2(program.isoTile, kTileW * scaleX, kTileH * scaleY),
+            CommandUniform::float2(program.isoOrigin, originX * scaleX, originY * scaleY),
+            CommandUniform::int1(program.bakedTex, 2),
+            CommandUniform::float2(program.bakedSize, static_cast<float>(map.width()), static_cast<float>(map.height())),
+            CommandUniform::float1(program.bakedScale, m_staticLightScale * m_lightmapRange),
+            CommandUniform::float4(program.volumeRect, 0.0F, 0.0F, viewWidth, viewHeight),
+            CommandUniform::float2(program.viewport, viewWidth, viewHeight),
+        };
+        m_volumeCommands.record(0, command, uniforms);
+    }
+    forEachChunk(m_jobs, lights.size(), kVolumesPerRecordJob, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            const Light& light = lights[i];
+            const LightProgram& program = *programs[i];
+
+            // A tile-space circle of radius r projects to an ellipse with half
+            // extents r * sqrt(2) * (tileW / 2, tileH / 2). Inverse-square lights
+            // never reach zero and cover the whole target.
+            float x0 = 0.0F;
+            float y0 = 0.0F;
+            float x1 = viewWidth;
+            float y1 = viewHeight;
+            if (light.falloffExponent > 0.0F) {
+                const float centerX = originX + (light.x - light.y) * (kTileW * 0.5F);
+                const float centerY = originY + (light.x + light.y) * (kTileH * 0.5F);
+                const float halfWidth = light.radius * std::numbers::sqrt2_v<float> * (kTileW * 0.5F);
+                const float halfHeight = light.radius * std::numbers::sqrt2_v<float> * (kTileH * 0.5F);
+                x0 = std::max(0.0F, centerX - halfWidth);
+                y0 = std::max(0.0F, centerY - halfHeight);
+                x1 = std::min(viewWidth, centerX + halfWidth);
+                y1 = std::min(viewHeight, centerY + halfHeight);
+                if (x0 >= x1 || y0 >= y1) {
+                    continue;
+                }
+            }
 
-    std::string albedoFragment;
-    std::string lightFragment;
-    std::string compositeFragment;
-    if (!loadShaderSource(albedoPath.string().c_str(), albedoFragment) ||
-        !loadShaderSource(lightPath.string().c_str(), lightFragment) ||
-        !loadShaderSource(compositePath.string().c_str(), compositeFragment)) {
-        std::cerr << "Failed to load shader sources from:\n"
-                  << "  " << albedoPath << "\n"
-                  << "  " << lightPath << "\n"
-                  << "  " << compositePath << "\n";
-        glDeleteShader(fullscreenVs);
+            RenderCommand command = screenRectCommand(program, x0, y0, x1, y1);
+            // Variants without occlusion have no occlusion uniforms; their
+            // locations are -1 and the executor skips them.
+            command.textures[0] = keys[i].occlusion ? m_occlusionTex : 0;
+            const std::array<CommandUniform, kVolumeUniforms> uniforms{
+                CommandUniform::float2(program.resolution, targetWidth, targetHeight),
+                CommandUniform::float2(program.isoTile, kTileW * scaleX, kTileH * scaleY),
+                CommandUniform::float2(program.isoOrigin, originX * scaleX, originY * scaleY),
+                CommandUniform::float4(program.lights, light.x, light.y, light.radius, light.intensity),
+                CommandUniform::float4(program.lightColors, light.r, light.g, light.b, light.falloffExponent),
+                CommandUniform::int1(program.occlusionTex, 0),
+                CommandUniform::float3(
+                    program.occlusionSize,
+                    static_cast<float>(map.width()),
+                    static_cast<float>(map.height()),
+                    static_cast<float>(lights.size())),
+                CommandUniform::float1(program.lightIndex, static_cast<float>(i)),
+                CommandUniform::float4(program.volumeRect, x0, y0, x1, y1),
+                CommandUniform::float2(program.viewport, viewWidth, viewHeight),
+            };
+            m_volumeCommands.record(static_cast<std::uint32_t>(i + 1), command, uniforms);
+        }
+    });
+
+    // Ambient is the clear colour; each light then adds only where it reaches.
+    m_glState.bindFramebuffer(GL_FRAMEBUFFER, m_lightTarget.framebuffer);
+    glViewport(0, 0, m_targetWidth, m_targetHeight);
+    glClearColor(kAmbientR * m_ambient, kAmbientG * m_ambient, kAmbientB * m_ambient, 1.0F);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    m_glState.setBlend(true);
+    m_glState.blendFunc(GL_ONE, GL_ONE);
+    m_volumeCommands.execute(m_glState);
+    m_glState.setBlend(false);
+    return true;
+}
+
+bool Renderer::initializeGpuPipeline(const ShaderSources& sources) {
+    m_fullscreenVs = compileShader(
+        GL_VERTEX_SHADER,
+        m_coreProfile ? kCoreFullscreenVertexShader : kFullscreenVertexShader,
+        "fullscreen.vert");
+    if (m_fullscreenVs == 0) {
         return false;
     }
+    if (m_coreProfile) {
+        m_volumeVs = compileShader(GL_VERTEX_SHADER, kCoreVolumeVertexShader, "volume.vert");
+        if (m_volumeVs == 0) {
+            return false;
+        }
+    }
 
-    GLuint albedoFs = compileShader(GL_FRAGMENT_SHADER, albedoFragment.c_str(), "albedo.frag");
-    GLuint lightFs = compileShader(GL_FRAGMENT_SHADER, lightFragment.c_str(), "light.frag");
-    GLuint compositeFs = compileShader(GL_FRAGMENT_SHADER, compositeFragment.c_str(), "composite.frag");
-    if (albedoFs == 0 || lightFs == 0 || compositeFs == 0) {
-        glDeleteShader(fullscreenVs);
+    const ShaderProfile profile = shaderProfile();
+    const std::string albedoSource = ShaderVariants::compose(profile, {}, sources.albedo);
+    const std::string compositeSource = ShaderVariants::compose(profile, {}, sources.composite);
+    GLuint albedoFs = compileShader(GL_FRAGMENT_SHADER, albedoSource.c_str(), "albedo.frag");
+    GLuint compositeFs = compileShader(GL_FRAGMENT_SHADER, compositeSource.c_str(), "composite.frag");
+    if (albedoFs == 0 || compositeFs == 0) {
         if (albedoFs != 0) {
             glDeleteShader(albedoFs);
         }
-        if (lightFs != 0) {
-            glDeleteShader(lightFs);
-        }
         if (compositeFs != 0) {
             glDeleteShader(compositeFs);
         }
+        destroyGpuPipeline();
         return false;
     }
 
-    m_albedoProgram = linkProgram(fullscreenVs, albedoFs, "albedo");
-    m_lightProgram = linkProgram(fullscreenVs, lightFs, "light");
-    m_compositeProgram = linkProgram(fullscreenVs, compositeFs, "composite");
+    m_albedoProgram = linkProgram(m_fullscreenVs, albedoFs, "albedo");
+    m_compositeProgram = linkProgram(m_fullscreenVs, compositeFs, "composite");
+    const bool geometryReady = !m_coreProfile || initializeCoreGeometry(albedoFs);
 
-    glDeleteShader(fullscreenVs);
     glDeleteShader(albedoFs);
-    glDeleteShader(lightFs);
     glDeleteShader(compositeFs);
 
-    if (m_albedoProgram == 0 || m_lightProgram == 0 || m_compositeProgram == 0) {
+    // Light permutations are compiled on demand; building the most general one
+    // up front surfaces source errors at load time rather than mid-game.
+    const bool volumes = activeLightingMode() == LightingMode::Volumes;
+    const LightShaderKey generalKey{
+        static_cast<std::uint8_t>(volumes ? 1 : kMaxLights),
+        FalloffMode::Mixed,
+        true,
+        activeLightingMode() == LightingMode::Fused,
+        volumes};
+    if (m_albedoProgram == 0 || m_compositeProgram == 0 || !geometryReady || lightVariant(generalKey) == nullptr) {
         destroyGpuPipeline();
         return false;
     }
 
+    m_gpuTimer.create();
     return true;
 }
 
-void Renderer::destroyGpuPipeline() {
-    if (m_albedoTex != 0) {
-        glDeleteTextures(1, &m_albedoTex);
-        m_albedoTex = 0;
+const Renderer::LightProgram* Renderer::lightVariant(const LightShaderKey& key) {
+    const std::uint32_t packedKey = key.packed();
+    if (const auto it = m_lightVariants.find(packedKey); it != m_lightVariants.end()) {
+        return it->second.program != 0 ? &it->second : nullptr;
+    }
+
+    LightProgram variant;
+    const std::string source = ShaderVariants::buildLightSource(shaderProfile(), m_sources.light, key);
+    const GLuint lightFs = compileShader(GL_FRAGMENT_SHADER, source.c_str(), "light.frag");
+    if (lightFs != 0) {
+        const GLuint vertexShader = key.volume && m_coreProfile ? m_volumeVs : m_fullscreenVs;
+        variant.program = linkProgram(vertexShader, lightFs, "light");
+        glDeleteShader(lightFs);
+    }
+
+    if (variant.program != 0) {
+        variant.resolution = glGetUniformLocation(variant.program, "uResolution");
+        variant.isoTile = glGetUniformLocation(variant.program, "uIsoTile");
+        variant.isoOrigin = glGetUniformLocation(variant.program, "uIsoOrigin");
+        variant.ambient = glGetUniformLocation(variant.program, "uAmbient");
+        variant.ambientColor = glGetUniformLocation(variant.program, "uAmbientColor");
+        variant.lights = glGetUniformLocation(variant.program, "uLights");
+        variant.lightColors = glGetUniformLocation(variant.program, "uLightColors");
+        variant.occlusionTex = glGetUniformLocation(variant.program, "uOcclusionTex");
+        variant.occlusionSize = glGetUniformLocation(variant.program, "uOcclusionSize");
+        variant.albedoTex = glGetUniformLocation(variant.program, "uAlbedoTex");
+        variant.globalTint = glGetUniformLocation(variant.program, "uGlobalTint");
+        variant.lightIndex = glGetUniformLocation(variant.program, "uLightIndex");
+        variant.volumeRect = glGetUniformLocation(variant.program, "uVolumeRect");
+        variant.viewport = glGetUniformLocation(variant.program, "uViewport");
+        variant.bakedTex = glGetUniformLocation(variant.program, "uBakedTex");
+        variant.bakedSize = glGetUniformLocation(variant.program, "uBakedSize");
+        variant.bakedScale = glGetUniformLocation(variant.program, "uBakedScale");
+        variant.targetUv = glGetUniformLocation(variant.program, "uTargetUv");
+    }
+
+    // Failed variants are cached too so a broken permutation is not recompiled every frame.
+    const auto inserted = m_lightVariants.emplace(packedKey, variant).first;
+    return inserted->second.program != 0 ? &inserted->second : nullptr;
+}
+
+void Renderer::destroyLightVariants() {
+    for (auto& [key, variant] : m_lightVariants) {
+        if (variant.program != 0) {
+            glDeleteProgram(variant.program);
+        }
     }
-    if (m_lightTex != 0) {
-        glDeleteTextures(1, &m_lightTex);
-        m_lightTex = 0;
+    m_lightVariants.clear();
+}
+
+LightShaderKey Renderer::selectLightVariant(const Map& map, std::span<const Light> lights, std::size_t firstSlot) {
+    LightShaderKey key;
+    key.lightCount = static_cast<std::uint8_t>(lights.size());
+    key.falloff = ShaderVariants::tightestFalloff(lights);
+    // Every light is checked, not just up to the first hit, so each slot's
+    // cache stays current.
+    for (std::size_t i = 0; i < lights.size(); ++i) {
+        key.occlusion = lightReachesBlockedTile(map, lights[i], firstSlot + i) || key.occlusion;
     }
+    key.fused = activeLightingMode() == LightingMode::Fused;
+    key.baked = bakedLightingReady(map);
+    return key;
+}
 
-    if (m_albedoFbo != 0) {
-        glDeleteFramebuffers(1, &m_albedoFbo);
-        m_albedoFbo = 0;
+bool Renderer::lightReachesBlockedTile(const Map& map, const Light& light, std::size_t slot) {
+    const TileBounds bounds = lightTileBounds(map, light);
+    const std::array<int, 4> key{bounds.minX, bounds.minY, bounds.maxX, bounds.maxY};
+    LightReach& cached = m_lightReach[slot];
+    // Same approach as the occlusion bands: keep the answer unless the reach
+    // moved or an edit since it was taken falls inside it.
+    TileRect edited;
+    if (cached.revision != 0 && cached.bounds == key && map.dirtyRegionSince(cached.revision, edited) &&
+        !edited.intersects({bounds.minX, bounds.minY, bounds.maxX - bounds.minX + 1, bounds.maxY - bounds.minY + 1})) {
+        cached.revision = map.revision();
+        return cached.blocked;
     }
-    if (m_lightFbo != 0) {
-        glDeleteFramebuffers(1, &m_lightFbo);
-        m_lightFbo = 0;
+
+    cached.bounds = key;
+    cached.revision = map.revision();
+    cached.blocked = false;
+    for (int y = bounds.minY; y <= bounds.maxY && !cached.blocked; ++y) {
+        for (int x = bounds.minX; x <= bounds.maxX; ++x) {
+            if (map.isBlocked(x, y)) {
+                cached.blocked = true;
+                break;
+            }
+        }
     }
+    return cached.blocked;
+}
 
-    if (m_albedoProgram != 0) {
-        glDeleteProgram(m_albedoProgram);
-        m_albedoProgram = 0;
+bool Renderer::bakedLightingReady(const Map& map) const {
+    return !m_lightmap.empty() && m_lightmap.width == map.width() * Lightmap::kTexelsPerTile &&
+        m_lightmap.height == map.height() * Lightmap::kTexelsPerTile;
+}
+
+void Renderer::updateLightmapTexture() {
+    const MemoryTagScope memoryTag(MemoryTag::Lighting);
+    m_lightmapDirty = false;
+    if (m_lightmap.empty()) {
+        if (m_lightmapTex != 0) {
+            glDeleteTextures(1, &m_lightmapTex);
+            m_lightmapTex = 0;
+            m_lightmapMemory.release();
+            m_glState.invalidate();
+        }
+        return;
     }
-    if (m_lightProgram != 0) {
-        glDeleteProgram(m_lightProgram);
-        m_lightProgram = 0;
+
+    if (m_lightmapTex == 0) {
+        glGenTextures(1, &m_lightmapTex);
     }
-    if (m_compositeProgram != 0) {
-        glDeleteProgram(m_compositeProgram);
-        m_compositeProgram = 0;
+    m_glState.bindTexture(0, m_lightmapTex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    // Half-float keeps the HDR range. 2.1 drivers without float textures get
+    // RGB8 normalised to the brightest texel, rescaled in the shader.
+    while (glGetError() != GL_NO_ERROR) {
     }
+    glTexImage2D(
+        GL_TEXTURE_2D, 0, GL_RGB16F, m_lightmap.width, m_lightmap.height, 0, GL_RGB, GL_FLOAT, m_lightmap.texels.data());
+    m_lightmapRange = 1.0F;
+    m_lightmapFloat = glGetError() == GL_NO_ERROR;
+    if (!m_lightmapFloat) {
+        std::cerr << "Float lightmap texture unsupported; using RGB8.\n";
+        const float brightest = *std::max_element(m_lightmap.texels.begin(), m_lightmap.texels.end());
+        m_lightmapRange = std::max(brightest, 1e-6F);
+        std::vector<std::uint8_t> bytes(m_lightmap.texels.size());
+        for (std::size_t i = 0; i < bytes.size(); ++i) {
+            bytes[i] = static_cast<std::uint8_t>(std::lround(std::clamp(m_lightmap.texels[i] / m_lightmapRange, 0.0F, 1.0F) * 255.0F));
+        }
+        glTexImage2D(
+            GL_TEXTURE_2D, 0, GL_RGB8, m_lightmap.width, m_lightmap.height, 0, GL_RGB, GL_UNSIGNED_BYTE, bytes.data());
+    }
+    const std::size_t texelBytes = m_lightmapFloat ? 3 * sizeof(std::uint16_t) : 3;
+    m_lightmapMemory.set(static_cast<std::uint64_t>(m_lightmap.width) * static_cast<std::uint64_t>(m_lightmap.height) * texelBytes);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 }
 
-bool Renderer::ensureRenderTargets() {
-    int width = 0;
-    int height = 0;
-    SDL_GetWindowSize(m_window, &width, &height);
-    if (width <= 0 || height <= 0) {
-        return false;
+void Renderer::refreshStaticLighting(const Map& map) {
+    if (!bakedLightingReady(map) || m_lightmap.mapRevision == map.revision()) {
+        return;
     }
+    const MemoryTagScope memoryTag(MemoryTag::Lighting);
 
-    if (width == m_targetWidth && height == m_targetHeight && m_albedoTex != 0 && m_lightTex != 0) {
-        return true;
+    TileRect changed;
+    if (!map.dirtyRegionSince(m_lightmap.mapRevision, changed)) {
+        changed = TileRect{0, 0, map.width(), map.height()};
+    }
+    TileRect updated;
+    LightmapBaker::rebake(m_jobs, map, changed, m_lightmap, updated);
+    m_lightmap.mapRevision = map.revision();
+    if (!updated.empty() && m_lightmapTex != 0 && !m_lightmapDirty) {
+        uploadLightmapTiles(updated);
     }
+}
 
-    if (m_albedoTex != 0) {
-        glDeleteTextures(1, &m_albedoTex);
-        m_albedoTex = 0;
+void Renderer::uploadLightmapTiles(const TileRect& tiles) {
+    const int x = tiles.x * Lightmap::kTexelsPerTile;
+    const int y = tiles.y * Lightmap::kTexelsPerTile;
+    const int width = tiles.width * Lightmap::kTexelsPerTile;
+    const int height = tiles.height * Lightmap::kTexelsPerTile;
+    const std::size_t first = (static_cast<std::size_t>(y) * static_cast<std::size_t>(m_lightmap.width) + static_cast<std::size_t>(x)) * 3;
+
+    m_glState.bindTexture(0, m_lightmapTex);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (m_lightmapFloat) {
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, m_lightmap.width);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, GL_RGB, GL_FLOAT, m_lightmap.texels.data() + first);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    } else {
+        // Keeps the range of the full upload; brighter new texels clip.
+        const std::span<std::uint8_t> bytes =
+            m_frameArena.allocateArray<std::uint8_t>(static_cast<std::size_t>(width) * static_cast<std::size_t>(height) * 3);
+        for (int row = 0; row < height; ++row) {
+            const float* source = m_lightmap.texels.data() + first + static_cast<std::size_t>(row) * static_cast<std::size_t>(m_lightmap.width) * 3;
+            for (int i = 0; i < width * 3; ++i) {
+                bytes[static_cast<std::size_t>(row * width * 3 + i)] =
+                    static_cast<std::uint8_t>(std::lround(std::clamp(source[i] / m_lightmapRange, 0.0F, 1.0F) * 255.0F));
+            }
+        }
+        glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, GL_RGB, GL_UNSIGNED_BYTE, bytes.data());
     }
-    if (m_lightTex != 0) {
-        glDeleteTextures(1, &m_lightTex);
-        m_lightTex = 0;
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+void Renderer::bindLightmap(const LightProgram& program, const Map& map) {
+    m_glState.bindTexture(2, m_lightmapTex);
+    glUniform1i(program.bakedTex, 2);
+    glUniform2f(program.bakedSize, static_cast<float>(map.width()), static_cast<float>(map.height()));
+    glUniform1f(program.bakedScale, m_staticLightScale * m_lightmapRange);
+}
+
+void Renderer::updateOcclusionTexture(const Map& map, std::span<const Light> lights) {
+    const int mapWidth = map.width();
+    const int mapHeight = map.height();
+    const int textureHeight = mapHeight * static_cast<int>(lights.size());
+    if (mapWidth <= 0 || textureHeight <= 0) {
+        return;
     }
-    if (m_albedoFbo != 0) {
-        glDeleteFramebuffers(1, &m_albedoFbo);
-        m_albedoFbo = 0;
+
+    // A band only changes when its light crosses into another tile, its reach
+    // changes, or a map edit lands inside its reach; other bands keep their
+    // texels and skip both the ray casts and the upload.
+    std::array<int, kMaxLights * 3 + 3> state{};
+    state[0] = mapWidth;
+    state[1] = mapHeight;
+    state[2] = static_cast<int>(lights.size());
+    for (std::size_t i = 0; i < lights.size(); ++i) {
+        state[3 + i * 3 + 0] = static_cast<int>(std::round(lights[i].x));
+        state[3 + i * 3 + 1] = static_cast<int>(std::round(lights[i].y));
+        state[3 + i * 3 + 2] = lights[i].falloffExponent <= 0.0F ? -1 : static_cast<int>(std::ceil(lights[i].radius));
     }
-    if (m_lightFbo != 0) {
-        glDeleteFramebuffers(1, &m_lightFbo);
-        m_lightFbo = 0;
+    const bool reallocate = m_occlusionTex == 0 || mapWidth != m_occlusionWidth || textureHeight != m_occlusionHeight ||
+        state[0] != m_occlusionState[0] || state[1] != m_occlusionState[1] || state[2] != m_occlusionState[2];
+    TileRect edited;
+    const bool editsKnown = !reallocate && map.dirtyRegionSince(m_occlusionRevision, edited);
+    if (editsKnown && edited.empty() && state == m_occlusionState) {
+        return;
     }
+    m_occlusionRevision = map.revision();
+    const std::size_t bandSize = static_cast<std::size_t>(mapWidth) * static_cast<std::size_t>(mapHeight);
+    m_occlusionTexels.resize(bandSize * lights.size());
 
-    m_targetWidth = width;
-    m_targetHeight = height;
+    if (m_occlusionTex == 0) {
+        glGenTextures(1, &m_occlusionTex);
+    }
+    m_glState.bindTexture(0, m_occlusionTex);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    // Single-channel either way; core contexts dropped GL_LUMINANCE.
+    const GLenum format = m_coreProfile ? GL_RED : GL_LUMINANCE;
+    const GLint internalFormat = m_coreProfile ? GL_R8 : GL_LUMINANCE;
+
+    for (std::size_t i = 0; i < lights.size(); ++i) {
+        const Light& light = lights[i];
+        const TileBounds bounds = lightTileBounds(map, light);
+        const TileRect reach{bounds.minX, bounds.minY, bounds.maxX - bounds.minX + 1, bounds.maxY - bounds.minY + 1};
+        const bool moved = !std::equal(&state[3 + i * 3], &state[3 + i * 3 + 3], &m_occlusionState[3 + i * 3]);
+        if (editsKnown && !moved && !reach.intersects(edited)) {
+            continue;
+        }
 
-    glGenTextures(1, &m_albedoTex);
-    glBindTexture(GL_TEXTURE_2D, m_albedoTex);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_targetWidth, m_targetHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        std::uint8_t* band = m_occlusionTexels.data() + i * bandSize;
+        std::fill(band, band + bandSize, static_cast<std::uint8_t>(255));
+        if (!reach.empty()) {
+            // One centre-to-centre ray per tile in reach, cast as a batch.
+            const int lightTileX = static_cast<int>(std::round(light.x));
+            const int lightTileY = static_cast<int>(std::round(light.y));
+            const std::size_t rayCount = static_cast<std::size_t>(reach.width) * static_cast<std::size_t>(reach.height);
+            const std::span<Ray> rays = m_frameArena.allocateArray<Ray>(rayCount);
+            const std::span<RayHit> hits = m_frameArena.allocateArray<RayHit>(rayCount);
+            const float fromX = static_cast<float>(lightTileX) + 0.5F;
+            const float fromY = static_cast<float>(lightTileY) + 0.5F;
+            std::size_t index = 0;
+            for (int y = bounds.minY; y <= bounds.maxY; ++y) {
+                for (int x = bounds.minX; x <= bounds.maxX; ++x) {
+                    rays[index++] = Ray{fromX, fromY, static_cast<float>(x) + 0.5F, static_cast<float>(y) + 0.5F};
+                }
+            }
+            forEachChunk(m_jobs, rayCount, kRaysPerJob, [&map, rays, hits](std::size_t begin, std::size_t end) {
+                map.raycastBatch(rays.subspan(begin, end - begin), hits.subspan(begin, end - begin));
+            });
+
+            index = 0;
+            for (int y = bounds.minY; y <= bounds.maxY; ++y) {
+                for (int x = bounds.minX; x <= bounds.maxX; ++x) {
+                    // The lit tile itself never occludes, so a wall face stays lit.
+                    const RayHit& hit = hits[index++];
+                    if (hit.hit && (hit.cellX != x || hit.cellY != y)) {
+                        band[y * mapWidth + x] = 0;
+                    }
+                }
+            }
+        }
+        if (!reallocate) {
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, static_cast<GLint>(i) * mapHeight, mapWidth, mapHeight, format, GL_UNSIGNED_BYTE, band);
+        }
+    }
 
-    glGenTextures(1, &m_lightTex);
-    glBindTexture(GL_TEXTURE_2D, m_lightTex);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_targetWidth, m_targetHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    m_occlusionState = state;
+
+    if (reallocate) {
+        m_occlusionWidth = mapWidth;
+        m_occlusionHeight = textureHeight;
+        glTexImage2D(
+            GL_TEXTURE_2D, 0, internalFormat, mapWidth, textureHeight, 0, format, GL_UNSIGNED_BYTE, m_occlusionTexels.data());
+        m_occlusionMemory.set(static_cast<std::uint64_t>(mapWidth) * static_cast<std::uint64_t>(textureHeight));
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
 
-    glGenFramebuffers(1, &m_albedoFbo);
-    glBindFramebuffer(GL_FRAMEBUFFER, m_albedoFbo);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_albedoTex, 0);
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-        return false;
+void Renderer::destroyGpuPipeline() {
+    // Deleted names may come back from the next glGen* call while the cache
+    // still thinks they are bound.
+    m_glState.invalidate();
+    m_gpuTimer.destroy();
+    m_gpuPassSeconds = 0.0;
+    destroyLightVariants();
+    destroyCoreGeometry();
+
+    if (m_particleVbo != 0) {
+        glDeleteBuffers(1, &m_particleVbo);
+        m_particleVbo = 0;
     }
+    m_particleMemory.release();
 
-    glGenFramebuffers(1, &m_lightFbo);
-    glBindFramebuffer(GL_FRAMEBUFFER, m_lightFbo);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_lightTex, 0);
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-        return false;
+    if (m_fullscreenVs != 0) {
+        glDeleteShader(m_fullscreenVs);
+        m_fullscreenVs = 0;
+    }
+    if (m_volumeVs != 0) {
+        glDeleteShader(m_volumeVs);
+        m_volumeVs = 0;
+    }
+    if (m_occlusionTex != 0) {
+        glDeleteTextures(1, &m_occlusionTex);
+        m_occlusionTex = 0;
+        m_occlusionWidth = 0;
+        m_occlusionHeight = 0;
+    }
+    if (m_lightmapTex != 0) {
+        glDeleteTextures(1, &m_lightmapTex);
+        m_lightmapTex = 0;
     }
+    m_occlusionMemory.release();
+    m_lightmapMemory.release();
+    // Re-uploaded by the next GPU frame, possibly into a new context.
+    m_lightmapDirty = !m_lightmap.empty();
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    return true;
+    destroyRenderTargets();
+
+    if (m_albedoProgram != 0) {
+        glDeleteProgram(m_albedoProgram);
+        m_albedoProgram = 0;
+    }
+    if (m_compositeProgram != 0) {
+        glDeleteProgram(m_compositeProgram);
+        m_compositeProgram = 0;
+    }
 }
 
-bool Renderer::loadShaderSource(const char* path, std::string& outSource) const {
-    std::ifstream file(path);
-    if (!file.is_open()) {
-        std::cerr << "Unable to open shader source: " << path << '\n';
+void Renderer::destroyRenderTargets() {
+    // Called when the pipeline goes, possibly with its context, so nothing is
+    // kept for later.
+    m_targetPool.release(m_albedoTarget);
+    m_targetPool.release(m_tileCacheTarget);
+    m_targetPool.release(m_lightTarget);
+    m_targetPool.clear();
+    m_lightFormat = GL_RGBA16F;
+
+    // The cached tiles went with their texture.
+    m_tileCacheRevision = 0;
+    m_targetWidth = 0;
+    m_targetHeight = 0;
+    m_glState.invalidate();
+}
+
+bool Renderer::ensureRenderTargets() {
+    if (m_viewWidth <= 0 || m_viewHeight <= 0) {
+        return false;
+    }
+    const float scale = m_dynamicResolution.scale();
+    const int width = std::max(1, static_cast<int>(std::lround(static_cast<float>(m_viewWidth) * scale)));
+    const int height = std::max(1, static_cast<int>(std::lround(static_cast<float>(m_viewHeight) * scale)));
+    // Targets are sized for the window rather than the scaled size, so
+    // dynamic resolution only moves the edge of the drawn sub-rectangle.
+    const int capacityWidth = std::max(width, m_viewWidth);
+    const int capacityHeight = std::max(height, m_viewHeight);
+
+    const GLuint tileCacheTexture = m_tileCacheTarget.texture;
+    if (!m_targetPool.ensure(m_albedoTarget, capacityWidth, capacityHeight, GL_RGBA8, GL_LINEAR)) {
+        return false;
+    }
+    // Only read back through glBlitFramebuffer, so it needs no filtering.
+    if (!m_targetPool.ensure(m_tileCacheTarget, capacityWidth, capacityHeight, GL_RGBA8, GL_NEAREST)) {
         return false;
     }
 
-    std::stringstream stream;
-    stream << file.rdbuf();
-    outSource = stream.str();
+    // Light is accumulated unclamped and tone mapped in the composite. Drivers
+    // without renderable half-float get RGBA8, which clips light above 1.
+    if (activeLightingMode() != LightingMode::Fused) {
+        while (!m_targetPool.ensure(m_lightTarget, capacityWidth, capacityHeight, m_lightFormat, GL_LINEAR)) {
+            if (m_lightFormat != GL_RGBA16F) {
+                return false;
+            }
+            std::cerr << "Half-float light buffer unsupported; using RGBA8.\n";
+            m_lightFormat = GL_RGBA8;
+        }
+    } else {
+        m_targetPool.release(m_lightTarget);
+    }
+
+    // The cache wraps at the drawn size, so a new size or texture starts it over.
+    if (width != m_targetWidth || height != m_targetHeight || m_tileCacheTarget.texture != tileCacheTexture) {
+        m_tileCacheRevision = 0;
+        m_targetWidth = width;
+        m_targetHeight = height;
+    }
     return true;
 }
 
+void Renderer::setTargetUv(GLint location) const {
+    // Screen UVs cover the drawn sub-rectangle; sampling stops at its last
+    // texel centre so linear filtering never reads past it.
+    const auto capacityWidth = static_cast<float>(m_albedoTarget.width);
+    const auto capacityHeight = static_cast<float>(m_albedoTarget.height);
+    const auto width = static_cast<float>(m_targetWidth);
+    const auto height = static_cast<float>(m_targetHeight);
+    glUniform4f(
+        location,
+        width / capacityWidth,
+        height / capacityHeight,
+        (width - 0.5F) / capacityWidth,
+        (height - 0.5F) / capacityHeight);
+}
+
 GLuint Renderer::compileShader(GLenum shaderType, const char* source, const char* label) const {
     const GLuint shader = glCreateShader(shaderType);
     glShaderSource(shader, 1, &source, nullptr);
@@ -546,9 +1265,9 @@ GLuint Renderer::compileShader(GLenum shaderType, const char* source, const char
     if (status == GL_FALSE) {
         GLint logLength = 0;
         glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLength);
-        std::vector<char> log(static_cast<size_t>(std::max(logLength, 1)));
-        glGetShaderInfoLog(shader, logLength, nullptr, log.data());
-        std::fprintf(stderr, "Failed to compile shader %s: %s\n", label, log.data());
+        m_infoLogScratch.assign(static_cast<size_t>(std::max(logLength, 1)), '\0');
+        glGetShaderInfoLog(shader, logLength, nullptr, m_infoLogScratch.data());
+        std::fprintf(stderr, "Failed to compile shader %s: %s\n", label, m_infoLogScratch.data());
         glDeleteShader(shader);
         return 0;
     }
@@ -567,9 +1286,9 @@ GLuint Renderer::linkProgram(GLuint vertexShader, GLuint fragmentShader, const c
     if (status == GL_FALSE) {
         GLint logLength = 0;
         glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
-        std::vector<char> log(static_cast<size_t>(std::max(logLength, 1)));
-        glGetProgramInfoLog(program, logLength, nullptr, log.data());
-        std::fprintf(stderr, "Failed to link %s program: %s\n", label, log.data());
+        m_infoLogScratch.assign(static_cast<size_t>(std::max(logLength, 1)), '\0');
+        glGetProgramInfoLog(program, logLength, nullptr, m_infoLogScratch.data());
+        std::fprintf(stderr, "Failed to link %s program: %s\n", label, m_infoLogScratch.data());
         glDeleteProgram(program);
         return 0;
     }
@@ -580,56 +1299,81 @@ GLuint Renderer::linkProgram(GLuint vertexShader, GLuint fragmentShader, const c
 void Renderer::renderCpuLighting(
     const Map& map,
     const Player& player,
-    const Light& playerLight,
-    const Light& lampLight,
+    const Townsfolk& townsfolk,
+    const ParticleSystem& particles,
+    std::span<const Light> lights,
     float originX,
-    float originY) const {
+    float originY) {
+    glViewport(0, 0, m_viewWidth, m_viewHeight);
     glClearColor(0.06F, 0.06F, 0.08F, 1.0F);
     glClear(GL_COLOR_BUFFER_BIT);
 
     glMatrixMode(GL_PROJECTION);
     glLoadIdentity();
-
-    int width = 0;
-    int height = 0;
-    SDL_GetWindowSize(m_window, &width, &height);
-    glOrtho(0.0, static_cast<double>(width), static_cast<double>(height), 0.0, -1.0, 1.0);
+    glOrtho(0.0, static_cast<double>(m_viewWidth), static_cast<double>(m_viewHeight), 0.0, -1.0, 1.0);
 
     glMatrixMode(GL_MODELVIEW);
     glLoadIdentity();
 
-    OcclusionCache playerOcclusion(map.width(), map.height());
-    OcclusionCache lampOcclusion(map.width(), map.height());
+    std::array<OcclusionCache, kMaxLights> occlusion{};
+    for (std::size_t i = 0; i < lights.size(); ++i) {
+        occlusion[i].reset(m_frameArena, map.width(), map.height());
+    }
+    const bool baked = bakedLightingReady(map);
+
+    // Tile colours are lit in parallel by rows; each tile touches only its own
+    // occlusion cache entries. The immediate-mode submission below stays here.
+    const std::size_t mapWidth = static_cast<std::size_t>(map.width());
+    const std::span<float> colors = m_frameArena.allocateArray<float>(mapWidth * static_cast<std::size_t>(map.height()) * 3);
+    const std::size_t rowsPerJob = std::max<std::size_t>(1, kTilesPerLightingJob / std::max<std::size_t>(mapWidth, 1));
+    forEachChunk(m_jobs, static_cast<std::size_t>(map.height()), rowsPerJob, [&](std::size_t firstRow, std::size_t endRow) {
+        for (int y = static_cast<int>(firstRow); y < static_cast<int>(endRow); ++y) {
+            for (int x = 0; x < map.width(); ++x) {
+                const float ambient = m_ambient;
+
+                float lightR = 0.68F * ambient;
+                float lightG = 0.74F * ambient;
+                float lightB = 0.84F * ambient;
+                for (std::size_t i = 0; i < lights.size(); ++i) {
+                    const float contribution = directWithOcclusion(map, x, y, lights[i], occlusion[i]);
+                    lightR += lights[i].r * contribution;
+                    lightG += lights[i].g * contribution;
+                    lightB += lights[i].b * contribution;
+                }
+                if (baked) {
+                    float bakedR = 0.0F;
+                    float bakedG = 0.0F;
+                    float bakedB = 0.0F;
+                    m_lightmap.sample(static_cast<float>(x) + 0.5F, static_cast<float>(y) + 0.5F, bakedR, bakedG, bakedB);
+                    lightR += bakedR * m_staticLightScale;
+                    lightG += bakedG * m_staticLightScale;
+                    lightB += bakedB * m_staticLightScale;
+                }
+
+                lightR = lightR / (1.0F + lightR);
+                lightG = lightG / (1.0F + lightG);
+                lightB = lightB / (1.0F + lightB);
+
+                lightR = std::clamp(lightR * m_globalTintR, 0.0F, 1.0F);
+                lightG = std::clamp(lightG * m_globalTintG, 0.0F, 1.0F);
+                lightB = std::clamp(lightB * m_globalTintB, 0.0F, 1.0F);
+
+                const float* albedo = &kTilePalette[static_cast<std::size_t>(tileId(map, x, y)) * 3];
+                float* color = &colors[(static_cast<std::size_t>(y) * mapWidth + static_cast<std::size_t>(x)) * 3];
+                color[0] = albedo[0] * lightR;
+                color[1] = albedo[1] * lightG;
+                color[2] = albedo[2] * lightB;
+            }
+        }
+    });
 
     glBegin(GL_QUADS);
     for (int y = 0; y < map.height(); ++y) {
         for (int x = 0; x < map.width(); ++x) {
-            const bool blocked = map.isBlocked(x, y);
             const float sx = originX + (x - y) * (kTileW * 0.5F);
             const float sy = originY + (x + y) * (kTileH * 0.5F);
 
-            const float playerContribution = directWithOcclusion(map, x, y, playerLight, playerOcclusion);
-            const float lampContribution = directWithOcclusion(map, x, y, lampLight, lampOcclusion);
-            const float ambient = m_ambient;
-
-            float lightR = 0.68F * ambient + playerLight.r * playerContribution + lampLight.r * lampContribution;
-            float lightG = 0.74F * ambient + playerLight.g * playerContribution + lampLight.g * lampContribution;
-            float lightB = 0.84F * ambient + playerLight.b * playerContribution + lampLight.b * lampContribution;
-
-            lightR = lightR / (1.0F + lightR);
-            lightG = lightG / (1.0F + lightG);
-            lightB = lightB / (1.0F + lightB);
-
-            lightR = std::clamp(lightR * m_globalTintR, 0.0F, 1.0F);
-            lightG = std::clamp(lightG * m_globalTintG, 0.0F, 1.0F);
-            lightB = std::clamp(lightB * m_globalTintB, 0.0F, 1.0F);
-
-            if (blocked) {
-                glColor3f(0.42F * lightR, 0.30F * lightG, 0.20F * lightB);
-            } else {
-                glColor3f(0.67F * lightR, 0.59F * lightG, 0.34F * lightB);
-            }
-
+            glColor3fv(&colors[(static_cast<std::size_t>(y) * mapWidth + static_cast<std::size_t>(x)) * 3]);
             glVertex2f(sx, sy + kTileH * 0.5F);
             glVertex2f(sx + kTileW * 0.5F, sy);
             glVertex2f(sx + kTileW, sy + kTileH * 0.5F);
@@ -638,88 +1382,471 @@ void Renderer::renderCpuLighting(
     }
     glEnd();
 
-    const float playerSx = originX + (player.x() - player.y()) * (kTileW * 0.5F) + kTileW * 0.5F;
-    const float playerSyBase = originY + (player.x() + player.y()) * (kTileH * 0.5F) + kTileH * 0.5F;
+    drawQuadsImmediate(actorSprites(player, townsfolk, originX, originY));
+    // Particles are not lit per tile here; the ambient level stands in.
+    drawParticles(particles, originX, originY, std::clamp(m_ambient * 2.5F, 0.3F, 1.0F));
+
+    m_frameCapture.captureFrame(m_viewWidth, m_viewHeight);
+    SDL_GL_SwapWindow(m_window);
+}
 
-    const float bob = std::sin(player.walkPhase() * 2.0F) * 2.5F * player.moveBlend();
-    const float sway = std::sin(player.walkPhase()) * 1.8F * player.moveBlend();
-    const float playerSy = playerSyBase - bob;
+std::array<SpriteQuad, 2> Renderer::actorSpriteQuads(
+    float x,
+    float y,
+    float walkPhase,
+    float moveBlend,
+    const std::array<float, 3>& color,
+    float originX,
+    float originY) {
+    const float actorSx = originX + (x - y) * (kTileW * 0.5F) + kTileW * 0.5F;
+    const float actorSyBase = originY + (x + y) * (kTileH * 0.5F) + kTileH * 0.5F;
+
+    const float bob = std::sin(walkPhase * 2.0F) * 2.5F * moveBlend;
+    const float sway = std::sin(walkPhase) * 1.8F * moveBlend;
+    const float actorSy = actorSyBase - bob;
+
+    const SpriteQuad shadow{
+        {actorSx - 9.0F, actorSx + 9.0F, actorSx + 9.0F, actorSx - 9.0F},
+        {actorSyBase + 2.0F, actorSyBase + 2.0F, actorSyBase + 6.0F, actorSyBase + 6.0F},
+        0.10F,
+        0.10F,
+        0.12F};
+    const SpriteQuad body{
+        {actorSx - 8.0F + sway, actorSx + 8.0F + sway, actorSx + 8.0F - sway, actorSx - 8.0F - sway},
+        {actorSy - 20.0F, actorSy - 20.0F, actorSy, actorSy},
+        color[0],
+        color[1],
+        color[2]};
+    return {shadow, body};
+}
 
-    glColor3f(0.10F, 0.10F, 0.12F);
-    glBegin(GL_QUADS);
-    glVertex2f(playerSx - 9.0F, playerSyBase + 2.0F);
-    glVertex2f(playerSx + 9.0F, playerSyBase + 2.0F);
-    glVertex2f(playerSx + 9.0F, playerSyBase + 6.0F);
-    glVertex2f(playerSx - 9.0F, playerSyBase + 6.0F);
-    glEnd();
+std::span<const SpriteQuad> Renderer::actorSprites(
+    const Player& player,
+    const Townsfolk& townsfolk,
+    float originX,
+    float originY) {
+    struct Actor {
+        float depth;
+        std::uint32_t order;
+        std::array<SpriteQuad, 2> quads;
+    };
+    static_assert(kOutfitColors.size() == Townsfolk::kOutfitCount);
+    const std::span<Actor> actors = m_frameArena.allocateArray<Actor>(townsfolk.size() + 1);
+    std::size_t count = 0;
+    actors[count++] = Actor{
+        player.x() + player.y(),
+        0,
+        actorSpriteQuads(player.x(), player.y(), player.walkPhase(), player.moveBlend(), kPlayerColor, originX, originY)};
+    for (std::size_t i = 0; i < townsfolk.size(); ++i) {
+        const TownsfolkPose pose = townsfolk.pose(i);
+        const std::array<SpriteQuad, 2> quads =
+            actorSpriteQuads(pose.x, pose.y, pose.walkPhase, pose.moveBlend, kOutfitColors[pose.outfit], originX, originY);
+        // The shadow is the widest part and the body the tallest.
+        const SpriteQuad& shadow = quads[0];
+        const SpriteQuad& body = quads[1];
+        if (shadow.x[1] < 0.0F || shadow.x[0] > static_cast<float>(m_viewWidth) || shadow.y[2] < 0.0F ||
+            body.y[0] > static_cast<float>(m_viewHeight)) {
+            continue;
+        }
+        actors[count++] = Actor{pose.x + pose.y, static_cast<std::uint32_t>(count), quads};
+    }
 
-    glColor3f(0.2F, 0.4F, 0.85F);
-    glBegin(GL_QUADS);
-    glVertex2f(playerSx - 8.0F + sway, playerSy - 20.0F);
-    glVertex2f(playerSx + 8.0F + sway, playerSy - 20.0F);
-    glVertex2f(playerSx + 8.0F - sway, playerSy);
-    glVertex2f(playerSx - 8.0F - sway, playerSy);
-    glEnd();
+    // Nearer actors (larger x + y) are lower on screen and drawn last; ties
+    // keep the gathering order so the frame is the same every time.
+    const std::span<Actor> visible = actors.first(count);
+    std::sort(visible.begin(), visible.end(), [](const Actor& a, const Actor& b) {
+        return a.depth < b.depth || (a.depth == b.depth && a.order < b.order);
+    });
+    const std::span<SpriteQuad> quads = m_frameArena.allocateArray<SpriteQuad>(count * 2);
+    for (std::size_t i = 0; i < count; ++i) {
+        quads[i] = visible[i].quads[0];
+        quads[count + i] = visible[i].quads[1];
+    }
+    return quads;
+}
 
-    SDL_GL_SwapWindow(m_window);
+void Renderer::renderSceneAlbedo(
+    const Map& map,
+    const Player& player,
+    const Townsfolk& townsfolk,
+    const ParticleSystem& particles,
+    float originX,
+    float originY) {
+    const float scaleX = static_cast<float>(m_targetWidth) / static_cast<float>(m_viewWidth);
+    const float scaleY = static_cast<float>(m_targetHeight) / static_cast<float>(m_viewHeight);
+    const int viewLeft = static_cast<int>(std::lround(-originX * scaleX));
+    const int viewTop = static_cast<int>(std::lround(-originY * scaleY));
+    updateTileCache(map, viewLeft, viewTop);
+    blitTileCache(viewLeft, viewTop);
+
+    // Actors are the only per-frame albedo work.
+    m_glState.bindFramebuffer(GL_FRAMEBUFFER, m_albedoTarget.framebuffer);
+    glViewport(0, 0, m_targetWidth, m_targetHeight);
+    const std::span<const SpriteQuad> sprites = actorSprites(player, townsfolk, originX, originY);
+    if (m_coreProfile) {
+        drawSpritesCore(sprites);
+    } else {
+        m_glState.useProgram(m_albedoProgram);
+        drawQuadsImmediate(sprites);
+    }
+    drawParticles(particles, originX, originY, 1.0F);
 }
 
-void Renderer::renderSceneAlbedo(const Map& map, const Player& player, float originX, float originY) const {
-    glBegin(GL_QUADS);
-    for (int y = 0; y < map.height(); ++y) {
-        for (int x = 0; x < map.width(); ++x) {
-            const bool blocked = map.isBlocked(x, y);
-            const float sx = originX + (x - y) * (kTileW * 0.5F);
-            const float sy = originY + (x + y) * (kTileH * 0.5F);
+void Renderer::writeParticleSprites(
+    const ParticleSystem& particles,
+    float originX,
+    float originY,
+    float lit,
+    std::span<ParticleSprite> outSprites) const {
+    const auto toByte = [](float value) {
+        return static_cast<std::uint8_t>(std::clamp(value, 0.0F, 1.0F) * 255.0F + 0.5F);
+    };
 
-            if (blocked) {
-                glColor3f(0.42F, 0.30F, 0.20F);
-            } else {
-                glColor3f(0.67F, 0.59F, 0.34F);
+    std::size_t base = 0;
+    for (std::size_t kind = 0; kind < kParticleKindCount; ++kind) {
+        const ParticlePool& pool = particles.pool(static_cast<ParticleKind>(kind));
+        const ParticleLook& look = ParticleSystem::look(static_cast<ParticleKind>(kind));
+        const float scale = look.emissive ? 1.0F : lit;
+        const std::span<ParticleSprite> sprites = outSprites.subspan(base, pool.size());
+        forEachChunk(m_jobs, pool.size(), kParticlesPerJob, [&](std::size_t begin, std::size_t end) {
+            const float* x = pool.x();
+            const float* y = pool.y();
+            const float* z = pool.z();
+            const float* age = pool.age();
+            for (std::size_t i = begin; i < end; ++i) {
+                // Same anchor as the player sprite; height lifts it up the screen.
+                const float t = age[i];
+                ParticleSprite& sprite = sprites[i];
+                sprite.x = originX + (x[i] - y[i]) * (kTileW * 0.5F) + kTileW * 0.5F;
+                sprite.y = originY + (x[i] + y[i]) * (kTileH * 0.5F) + kTileH * 0.5F - z[i] * kTileH;
+                sprite.size = look.startSize + (look.endSize - look.startSize) * t;
+                for (std::size_t c = 0; c < 3; ++c) {
+                    sprite.color[c] = toByte((look.startColor[c] + (look.endColor[c] - look.startColor[c]) * t) * scale);
+                }
+                sprite.color[3] = toByte(look.startColor[3] + (look.endColor[3] - look.startColor[3]) * t);
             }
+        });
+        base += pool.size();
+    }
+}
 
-            glVertex2f(sx, sy + kTileH * 0.5F);
-            glVertex2f(sx + kTileW * 0.5F, sy);
-            glVertex2f(sx + kTileW, sy + kTileH * 0.5F);
-            glVertex2f(sx + kTileW * 0.5F, sy + kTileH);
+void Renderer::drawParticles(const ParticleSystem& particles, float originX, float originY, float lit) {
+    const std::size_t count = particles.size();
+    if (count == 0 || !m_glFunctionsLoaded) {
+        return;
+    }
+
+    m_glState.setBlend(true);
+    m_glState.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    if (m_coreProfile) {
+        drawParticlesCore(particles, originX, originY);
+        m_glState.setBlend(false);
+        return;
+    }
+
+    // Orphaning the buffer lets the driver hand back fresh storage instead of
+    // waiting for last frame's draw; the quads are written straight into it.
+    if (m_particleVbo == 0) {
+        glGenBuffers(1, &m_particleVbo);
+    }
+    struct QuadVertex {
+        float x;
+        float y;
+        std::array<std::uint8_t, 4> color;
+    };
+    const std::size_t vertexCount = count * kParticleQuadVertices;
+    glBindBuffer(GL_ARRAY_BUFFER, m_particleVbo);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(vertexCount * sizeof(QuadVertex)), nullptr, GL_STREAM_DRAW);
+    m_particleMemory.set(vertexCount * sizeof(QuadVertex));
+    auto* vertices = static_cast<QuadVertex*>(glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY));
+    if (vertices == nullptr) {
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        m_glState.setBlend(false);
+        return;
+    }
+
+    const std::span<ParticleSprite> sprites = m_frameArena.allocateArray<ParticleSprite>(count);
+    writeParticleSprites(particles, originX, originY, lit, sprites);
+    forEachChunk(m_jobs, count, kParticlesPerJob, [sprites, vertices](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            const ParticleSprite& sprite = sprites[i];
+            const float half = sprite.size * 0.5F;
+            QuadVertex* quad = vertices + i * kParticleQuadVertices;
+            quad[0] = QuadVertex{sprite.x - half, sprite.y - half, sprite.color};
+            quad[1] = QuadVertex{sprite.x + half, sprite.y - half, sprite.color};
+            quad[2] = QuadVertex{sprite.x + half, sprite.y + half, sprite.color};
+            quad[3] = QuadVertex{sprite.x - half, sprite.y + half, sprite.color};
         }
+    });
+    const bool intact = glUnmapBuffer(GL_ARRAY_BUFFER) == GL_TRUE;
+
+    if (intact) {
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glEnableClientState(GL_COLOR_ARRAY);
+        glVertexPointer(2, GL_FLOAT, sizeof(QuadVertex), nullptr);
+        glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(QuadVertex), reinterpret_cast<const void*>(offsetof(QuadVertex, color)));
+        glDrawArrays(GL_QUADS, 0, static_cast<GLsizei>(vertexCount));
+        glDisableClientState(GL_COLOR_ARRAY);
+        glDisableClientState(GL_VERTEX_ARRAY);
     }
-    glEnd();
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    m_glState.setBlend(false);
+}
 
-    const float playerSx = originX + (player.x() - player.y()) * (kTileW * 0.5F) + kTileW * 0.5F;
-    const float playerSyBase = originY + (player.x() + player.y()) * (kTileH * 0.5F) + kTileH * 0.5F;
+void Renderer::updateTileCache(const Map& map, int viewLeft, int viewTop) {
+    const int width = m_targetWidth;
+    const int height = m_targetHeight;
+    const int dx = viewLeft - m_tileCacheLeft;
+    const int dy = viewTop - m_tileCacheTop;
+
+    // Edits since the last frame only redraw the tiles they touched.
+    TileRect edited;
+    const bool editsKnown = m_tileCacheRevision != 0 && map.dirtyRegionSince(m_tileCacheRevision, edited);
+    if (!editsKnown || std::abs(dx) >= width || std::abs(dy) >= height) {
+        drawTileCacheRegion(map, viewLeft, viewTop, width, height);
+    } else {
+        // Columns and rows that scrolled into view; their cache texels are the
+        // ones that just scrolled out. The corner is drawn twice, which is cheap.
+        if (dx != 0) {
+            const int left = dx > 0 ? m_tileCacheLeft + width : viewLeft;
+            drawTileCacheRegion(map, left, viewTop, std::abs(dx), height);
+        }
+        if (dy != 0) {
+            const int top = dy > 0 ? m_tileCacheTop + height : viewTop;
+            drawTileCacheRegion(map, viewLeft, top, width, std::abs(dy));
+        }
+        if (!edited.empty()) {
+            redrawTileCacheTiles(map, edited, viewLeft, viewTop);
+        }
+    }
 
-    const float bob = std::sin(player.walkPhase() * 2.0F) * 2.5F * player.moveBlend();
-    const float sway = std::sin(player.walkPhase()) * 1.8F * player.moveBlend();
-    const float playerSy = playerSyBase - bob;
+    m_tileCacheRevision = map.revision();
+    m_tileCacheLeft = viewLeft;
+    m_tileCacheTop = viewTop;
+}
 
-    glColor3f(0.10F, 0.10F, 0.12F);
-    glBegin(GL_QUADS);
-    glVertex2f(playerSx - 9.0F, playerSyBase + 2.0F);
-    glVertex2f(playerSx + 9.0F, playerSyBase + 2.0F);
-    glVertex2f(playerSx + 9.0F, playerSyBase + 6.0F);
-    glVertex2f(playerSx - 9.0F, playerSyBase + 6.0F);
-    glEnd();
+void Renderer::redrawTileCacheTiles(const Map& map, const TileRect& tiles, int viewLeft, int viewTop) {
+    // Screen bounds of the tiles' diamonds in world target pixels, padded a
+    // pixel for rounding. Neighbours overlapping them are redrawn with them.
+    const float scaleX = static_cast<float>(m_targetWidth) / static_cast<float>(m_viewWidth);
+    const float scaleY = static_cast<float>(m_targetHeight) / static_cast<float>(m_viewHeight);
+    const int lastX = tiles.x + tiles.width - 1;
+    const int lastY = tiles.y + tiles.height - 1;
+    const float minSx = static_cast<float>(tiles.x - lastY) * (kTileW * 0.5F);
+    const float maxSx = static_cast<float>(lastX - tiles.y) * (kTileW * 0.5F) + kTileW;
+    const float minSy = static_cast<float>(tiles.x + tiles.y) * (kTileH * 0.5F);
+    const float maxSy = static_cast<float>(lastX + lastY) * (kTileH * 0.5F) + kTileH;
+    const int left = std::max(viewLeft, static_cast<int>(std::floor(minSx * scaleX)) - 1);
+    const int top = std::max(viewTop, static_cast<int>(std::floor(minSy * scaleY)) - 1);
+    const int right = std::min(viewLeft + m_targetWidth, static_cast<int>(std::ceil(maxSx * scaleX)) + 1);
+    const int bottom = std::min(viewTop + m_targetHeight, static_cast<int>(std::ceil(maxSy * scaleY)) + 1);
+    if (left < right && top < bottom) {
+        drawTileCacheRegion(map, left, top, right - left, bottom - top);
+    }
+}
+
+void Renderer::drawTileCacheRegion(const Map& map, int left, int top, int width, int height) {
+    const float scaleX = static_cast<float>(m_targetWidth) / static_cast<float>(m_viewWidth);
+    const float scaleY = static_cast<float>(m_targetHeight) / static_cast<float>(m_viewHeight);
+
+    m_glState.bindFramebuffer(GL_FRAMEBUFFER, m_tileCacheTarget.framebuffer);
+    glViewport(0, 0, m_targetWidth, m_targetHeight);
+    glEnable(GL_SCISSOR_TEST);
+    glClearColor(0.0F, 0.0F, 0.0F, 1.0F);
+
+    std::array<WrappedRun, 2> columns{};
+    std::array<WrappedRun, 2> rows{};
+    const int columnCount = splitWrapped(left, width, m_targetWidth, columns);
+    const int rowCount = splitWrapped(top, height, m_targetHeight, rows);
+    for (int row = 0; row < rowCount; ++row) {
+        for (int column = 0; column < columnCount; ++column) {
+            const WrappedRun& x = columns[column];
+            const WrappedRun& y = rows[row];
+            glScissor(x.cache, m_targetHeight - (y.cache + y.length), x.length, y.length);
+            glClear(GL_COLOR_BUFFER_BIT);
+
+            // Place the world so this run lands on its cache texels.
+            const float originX = -static_cast<float>(x.world - x.cache) / scaleX;
+            const float originY = -static_cast<float>(y.world - y.cache) / scaleY;
+            const std::span<const TileInstance> tiles = collectTiles(
+                map,
+                static_cast<float>(x.world) / scaleX,
+                static_cast<float>(y.world) / scaleY,
+                static_cast<float>(x.world + x.length) / scaleX,
+                static_cast<float>(y.world + y.length) / scaleY);
+            drawTiles(tiles, originX, originY);
+        }
+    }
+    glDisable(GL_SCISSOR_TEST);
+}
 
-    glColor3f(0.2F, 0.4F, 0.85F);
+void Renderer::blitTileCache(int viewLeft, int viewTop) {
+    m_glState.bindFramebuffer(GL_READ_FRAMEBUFFER, m_tileCacheTarget.framebuffer);
+    m_glState.bindFramebuffer(GL_DRAW_FRAMEBUFFER, m_albedoTarget.framebuffer);
+
+    std::array<WrappedRun, 2> columns{};
+    std::array<WrappedRun, 2> rows{};
+    const int columnCount = splitWrapped(viewLeft, m_targetWidth, m_targetWidth, columns);
+    const int rowCount = splitWrapped(viewTop, m_targetHeight, m_targetHeight, rows);
+    for (int row = 0; row < rowCount; ++row) {
+        for (int column = 0; column < columnCount; ++column) {
+            const WrappedRun& x = columns[column];
+            const WrappedRun& y = rows[row];
+            const int sourceBottom = m_targetHeight - (y.cache + y.length);
+            const int destinationLeft = x.world - viewLeft;
+            const int destinationBottom = m_targetHeight - (y.world - viewTop + y.length);
+            glBlitFramebuffer(
+                x.cache,
+                sourceBottom,
+                x.cache + x.length,
+                sourceBottom + y.length,
+                destinationLeft,
+                destinationBottom,
+                destinationLeft + x.length,
+                destinationBottom + y.length,
+                GL_COLOR_BUFFER_BIT,
+                GL_NEAREST);
+        }
+    }
+}
+
+std::span<Renderer::TileInstance> Renderer::collectTiles(
+    const Map& map,
+    float left,
+    float top,
+    float right,
+    float bottom) {
+    // World pixel (wx, wy) lies in tile ((u + v) / 2, (v - u) / 2) with
+    // u = wx / (tileW / 2) and v = wy / (tileH / 2). The rectangle's corners
+    // bound the tile range; the per-tile test below trims it to the diamond
+    // bounding boxes that actually overlap.
+    const float halfW = kTileW * 0.5F;
+    const float halfH = kTileH * 0.5F;
+    const float uMin = left / halfW;
+    const float uMax = right / halfW;
+    const float vMin = top / halfH;
+    const float vMax = bottom / halfH;
+    const int minX = std::max(0, static_cast<int>(std::floor((uMin + vMin) * 0.5F)) - 1);
+    const int maxX = std::min(map.width() - 1, static_cast<int>(std::ceil((uMax + vMax) * 0.5F)));
+    const int minY = std::max(0, static_cast<int>(std::floor((vMin - uMax) * 0.5F)) - 1);
+    const int maxY = std::min(map.height() - 1, static_cast<int>(std::ceil((vMax - uMin) * 0.5F)));
+    if (minX > maxX || minY > maxY) {
+        return {};
+    }
+
+    const std::size_t capacity =
+        static_cast<std::size_t>(maxX - minX + 1) * static_cast<std::size_t>(maxY - minY + 1);
+    const std::span<TileInstance> tiles = m_frameArena.allocateArray<TileInstance>(capacity);
+    std::size_t count = 0;
+    for (int y = minY; y <= maxY; ++y) {
+        for (int x = minX; x <= maxX; ++x) {
+            const float sx = static_cast<float>(x - y) * halfW;
+            const float sy = static_cast<float>(x + y) * halfH;
+            if (sx >= right || sx + kTileW <= left || sy >= bottom || sy + kTileH <= top) {
+                continue;
+            }
+            tiles[count++] = TileInstance{
+                static_cast<std::int16_t>(x),
+                static_cast<std::int16_t>(y),
+                tileId(map, x, y),
+                0};
+        }
+    }
+    return tiles.first(count);
+}
+
+std::int16_t Renderer::tileId(const Map& map, int x, int y) {
+    switch (map.tileAt(x, y)) {
+    case Map::kClosedDoorTile:
+        return kClosedDoorTileId;
+    case Map::kOpenDoorTile:
+        return kOpenDoorTileId;
+    default:
+        return map.isBlocked(x, y) ? kWallTileId : kFloorTileId;
+    }
+}
+
+void Renderer::drawTiles(std::span<const TileInstance> tiles, float originX, float originY) {
+    if (m_coreProfile) {
+        drawTilesInstanced(tiles, originX, originY);
+        return;
+    }
+
+    // The 2.1 projection is y-down in window pixels; the viewport scales it.
+    m_glState.useProgram(m_albedoProgram);
     glBegin(GL_QUADS);
-    glVertex2f(playerSx - 8.0F + sway, playerSy - 20.0F);
-    glVertex2f(playerSx + 8.0F + sway, playerSy - 20.0F);
-    glVertex2f(playerSx + 8.0F - sway, playerSy);
-    glVertex2f(playerSx - 8.0F - sway, playerSy);
+    for (const TileInstance& tile : tiles) {
+        const float sx = originX + static_cast<float>(tile.x - tile.y) * (kTileW * 0.5F);
+        const float sy = originY + static_cast<float>(tile.x + tile.y) * (kTileH * 0.5F);
+        const float* color = &kTilePalette[static_cast<std::size_t>(tile.id) * 3];
+        glColor3f(color[0], color[1], color[2]);
+        glVertex2f(sx, sy + kTileH * 0.5F);
+        glVertex2f(sx + kTileW * 0.5F, sy);
+        glVertex2f(sx + kTileW, sy + kTileH * 0.5F);
+        glVertex2f(sx + kTileW * 0.5F, sy + kTileH);
+    }
     glEnd();
 }
 
-void Renderer::drawFullscreenQuad() const {
+void Renderer::cameraOrigin(const Map& map, const Camera& camera, float& outOriginX, float& outOriginY) const {
+    // World pixels are relative to the layout origin: tile (x, y) covers
+    // [(x - y) * tileW / 2, + tileW] x [(x + y) * tileH / 2, + tileH].
+    const float halfW = kTileW * 0.5F;
+    const float halfH = kTileH * 0.5F;
+    const float focusX = (camera.x() - camera.y()) * halfW + halfW;
+    const float focusY = (camera.x() + camera.y()) * halfH + halfH;
+    const float mapLeft = -static_cast<float>(map.height() - 1) * halfW;
+    const float mapRight = static_cast<float>(map.width() - 1) * halfW + kTileW;
+    const float mapBottom = static_cast<float>(map.width() + map.height() - 2) * halfH + kTileH;
+
+    // Centre on the camera, but keep the view over the map; a map narrower
+    // than the window is centred on that axis instead.
+    const auto axisOrigin = [](float view, float focus, float mapMin, float mapMax) {
+        if (mapMax - mapMin <= view) {
+            return (view - (mapMin + mapMax)) * 0.5F;
+        }
+        const float viewMin = std::clamp(focus - view * 0.5F, mapMin, mapMax - view);
+        return -viewMin;
+    };
+    outOriginX = axisOrigin(static_cast<float>(m_viewWidth), focusX, mapLeft, mapRight);
+    outOriginY = axisOrigin(static_cast<float>(m_viewHeight), focusY, 0.0F, mapBottom);
+}
+
+RenderCommand Renderer::screenRectCommand(const LightProgram& program, float x0, float y0, float x1, float y1) const {
+    RenderCommand command;
+    command.program = program.program;
+    if (m_coreProfile) {
+        // The volume vertex shader places the strip from uVolumeRect.
+        command.draw = CommandDraw::Arrays;
+        command.mode = GL_TRIANGLE_STRIP;
+        command.vertexArray = m_emptyVao;
+        command.count = 4;
+    } else {
+        // The 2.1 path keeps the y-down ortho projection set up in render().
+        command.draw = CommandDraw::ScreenQuad;
+        command.rect = {x0, y0, x1, y1};
+    }
+    return command;
+}
+
+void Renderer::drawFullscreenQuad() {
+    if (m_coreProfile) {
+        m_glState.bindVertexArray(m_emptyVao);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        return;
+    }
+
     glColor3f(1.0F, 1.0F, 1.0F);
+    // The projection is y-down, so the top edge of the screen maps to t = 1 of
+    // the render targets.
     glBegin(GL_QUADS);
-    glTexCoord2f(0.0F, 0.0F);
+    glTexCoord2f(0.0F, 1.0F);
     glVertex2f(0.0F, 0.0F);
-    glTexCoord2f(1.0F, 0.0F);
-    glVertex2f(static_cast<float>(m_targetWidth), 0.0F);
     glTexCoord2f(1.0F, 1.0F);
-    glVertex2f(static_cast<float>(m_targetWidth), static_cast<float>(m_targetHeight));
-    glTexCoord2f(0.0F, 1.0F);
-    glVertex2f(0.0F, static_cast<float>(m_targetHeight));
+    glVertex2f(static_cast<float>(m_viewWidth), 0.0F);
+    glTexCoord2f(1.0F, 0.0F);
+    glVertex2f(static_cast<float>(m_viewWidth), static_cast<float>(m_viewHeight));
+    glTexCoord2f(0.0F, 0.0F);
+    glVertex2f(0.0F, static_cast<float>(m_viewHeight));
     glEnd();
 }
@@ -5,67 +5,378 @@
 #include <SDL2/SDL_opengl.h>
 #include <SDL2/SDL_opengl_glext.h>
 
+#include "core/FrameArena.hpp"
+#include "core/MemoryAccounting.hpp"
+#include "render/DynamicResolution.hpp"
+#include "render/FrameCapture.hpp"
+#include "render/GpuTimer.hpp"
+#include "render/Light.hpp"
+#include "render/Lightmap.hpp"
+#include "render/RenderCommands.hpp"
+#include "render/RenderTargetPool.hpp"
+#include "render/ShaderVariants.hpp"
+
+#include <array>
+#include <cstdint>
+#include <span>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
+class AssetManager;
+class JobSystem;
+class Camera;
 class Map;
+class ParticleSystem;
 class Player;
+class Townsfolk;
+struct TileRect;
+
+// Fragment shader sources read off the GL thread and compiled by Renderer::uploadShaders.
+struct ShaderSources {
+    std::string albedo;
+    std::string light;
+    std::string composite;
+};
 
-struct Light {
-    float x;
-    float y;
-    float radius;
-    float intensity;
+// A flat-coloured screen-space quad (actor sprite, shadow).
+struct SpriteQuad {
+    std::array<float, 4> x;
+    std::array<float, 4> y;
     float r;
     float g;
     float b;
-    float falloffExponent;
 };
 
+// Fused evaluates the lights inside the composite pass and needs no light
+// buffer; MultiPass keeps the separate light target for effects that read it.
+// Volumes draws each light over its screen bounds into a half-float light
+// buffer with additive blending, so fill cost follows the lit area.
+enum class LightingMode : std::uint8_t {
+    Fused,
+    MultiPass,
+    Volumes,
+};
+
+// Renders through a GL 3.3 core context (VAOs, instanced tiles) when one can be
+// created, and through the GL 2.1 fixed-function path otherwise. The CPU
+// lighting path needs the 2.1 context, so the renderer drops back to it when
+// the core pipeline cannot be built.
 class Renderer {
 public:
     bool initialize(SDL_Window* window);
     void shutdown();
+
+    // Safe to call from a loader thread; does not touch GL.
+    static bool loadShaderSources(const AssetManager& assets, ShaderSources& outSources);
+    bool uploadShaders(const ShaderSources& sources);
+    void renderLoadingScreen(float progress);
+    // New window size, from SDL_WINDOWEVENT_SIZE_CHANGED. The window is not
+    // queried per frame.
+    void resize(int width, int height);
+
     void setAmbient(float value);
     void setGlobalTint(float r, float g, float b);
-    void render(const Map& map, const Player& player, const Light& playerLight, const Light& lampLight);
+    void setLightingMode(LightingMode mode);
+    // Scales the internal render targets to hold 60 fps; the composite pass
+    // upscales to the window. On by default, off with RENDERER_FIXED_RESOLUTION.
+    void setDynamicResolution(bool enabled);
+    float renderScale() const;
+    // Baked light of the static lights, added under the dynamic ones. It is
+    // used while its size matches the rendered map.
+    void setStaticLighting(Lightmap lightmap);
+    // Multiplies the baked light, e.g. for a flickering lamp.
+    void setStaticLightScale(float scale);
+    // Spreads the CPU side of lighting (occlusion ray casts, the CPU lighting
+    // path) over the pool. GL calls stay on the calling thread. May be null.
+    void setJobSystem(JobSystem* jobs);
+    // Binds requested of the GL state cache so far, and how many it dropped.
+    GlStateStats glStateStats() const;
+    void render(
+        const Map& map,
+        const Player& player,
+        const Townsfolk& townsfolk,
+        const Camera& camera,
+        const ParticleSystem& particles,
+        std::span<const Light> lights);
 
 private:
-    bool loadGlFunctions();
-    bool initializeGpuPipeline();
+    static constexpr float kTileW = 64.0F;
+    static constexpr float kTileH = 32.0F;
+
+    // Albedo per tile id: floor, wall, closed door, open door.
+    static constexpr std::int16_t kFloorTileId = 0;
+    static constexpr std::int16_t kWallTileId = 1;
+    static constexpr std::int16_t kClosedDoorTileId = 2;
+    static constexpr std::int16_t kOpenDoorTileId = 3;
+    static constexpr std::array<float, 12> kTilePalette{
+        0.67F, 0.59F, 0.34F,
+        0.42F, 0.30F, 0.20F,
+        0.50F, 0.31F, 0.15F,
+        0.58F, 0.48F, 0.30F,
+    };
+    static constexpr std::array<float, 3> kPlayerColor{0.2F, 0.4F, 0.85F};
+    // Townsfolk outfits: faded red, green, ochre and grey.
+    static constexpr std::array<std::array<float, 3>, 4> kOutfitColors{{
+        {0.62F, 0.24F, 0.20F},
+        {0.30F, 0.46F, 0.28F},
+        {0.70F, 0.56F, 0.26F},
+        {0.45F, 0.44F, 0.42F},
+    }};
+
+    // One tile to draw; also the GL 3.3 per-instance vertex layout.
+    struct TileInstance {
+        std::int16_t x;
+        std::int16_t y;
+        std::int16_t id;
+        std::int16_t pad;
+    };
+
+    // One particle as a screen-space square; also the GL 3.3 per-instance
+    // vertex layout.
+    struct ParticleSprite {
+        float x;
+        float y;
+        float size;
+        std::array<std::uint8_t, 4> color;
+    };
+
+    // A compiled light-pass permutation with its uniform locations resolved once.
+    struct LightProgram {
+        GLuint program = 0;
+        GLint resolution = -1;
+        GLint isoTile = -1;
+        GLint isoOrigin = -1;
+        GLint ambient = -1;
+        GLint ambientColor = -1;
+        GLint lights = -1;
+        GLint lightColors = -1;
+        GLint occlusionTex = -1;
+        GLint occlusionSize = -1;
+        GLint albedoTex = -1;
+        GLint globalTint = -1;
+        GLint lightIndex = -1;
+        GLint volumeRect = -1;
+        GLint viewport = -1;
+        GLint bakedTex = -1;
+        GLint bakedSize = -1;
+        GLint bakedScale = -1;
+        GLint targetUv = -1;
+    };
+
+    bool createContext(bool coreProfile);
+    void fallBackFromGpuLighting(const char* reason);
+    bool initializeGpuPipeline(const ShaderSources& sources);
     void destroyGpuPipeline();
     bool ensureRenderTargets();
+    void destroyRenderTargets();
+    // Sets a uTargetUv uniform for passes that sample the render targets.
+    void setTargetUv(GLint location) const;
+    LightingMode activeLightingMode() const;
+    void presentFrame(std::uint64_t passStart);
+    void startFrameCapture();
 
-    bool loadShaderSource(const char* path, std::string& outSource) const;
     GLuint compileShader(GLenum shaderType, const char* source, const char* label) const;
     GLuint linkProgram(GLuint vertexShader, GLuint fragmentShader, const char* label) const;
+    ShaderProfile shaderProfile() const;
+
+    const LightProgram* lightVariant(const LightShaderKey& key);
+    void destroyLightVariants();
+    // `lights` fill the reach cache slots from firstSlot on.
+    LightShaderKey selectLightVariant(const Map& map, std::span<const Light> lights, std::size_t firstSlot);
+    bool lightReachesBlockedTile(const Map& map, const Light& light, std::size_t slot);
+    void renderLightPass(
+        const Map& map,
+        std::span<const Light> lights,
+        const LightShaderKey& lightKey,
+        const LightProgram& lightProgram,
+        float originX,
+        float originY);
+    bool renderLightVolumes(const Map& map, std::span<const Light> lights, float originX, float originY);
+    // A light volume command over the pixel rectangle; the caller adds the
+    // textures and uniforms.
+    RenderCommand screenRectCommand(const LightProgram& program, float x0, float y0, float x1, float y1) const;
+    void updateOcclusionTexture(const Map& map, std::span<const Light> lights);
+    bool bakedLightingReady(const Map& map) const;
+    void refreshStaticLighting(const Map& map);
+    void updateLightmapTexture();
+    void uploadLightmapTiles(const TileRect& tiles);
+    void bindLightmap(const LightProgram& program, const Map& map);
+
+    // GL 3.3 core geometry (RendererCore.cpp).
+    bool initializeCoreGeometry(GLuint albedoFs);
+    void destroyCoreGeometry();
+    void drawTilesInstanced(std::span<const TileInstance> tiles, float originX, float originY);
+    void drawSpritesCore(std::span<const SpriteQuad> quads);
+    void drawParticlesCore(const ParticleSystem& particles, float originX, float originY);
 
     void renderCpuLighting(
         const Map& map,
         const Player& player,
-        const Light& playerLight,
-        const Light& lampLight,
+        const Townsfolk& townsfolk,
+        const ParticleSystem& particles,
+        std::span<const Light> lights,
+        float originX,
+        float originY);
+    void cameraOrigin(const Map& map, const Camera& camera, float& outOriginX, float& outOriginY) const;
+    // Shadow and body of one actor at tile position (x, y).
+    static std::array<SpriteQuad, 2> actorSpriteQuads(
+        float x,
+        float y,
+        float walkPhase,
+        float moveBlend,
+        const std::array<float, 3>& color,
+        float originX,
+        float originY);
+    // Sprites of the player and every townsperson on screen, from the frame
+    // arena: all shadows first, then the bodies back to front.
+    std::span<const SpriteQuad> actorSprites(const Player& player, const Townsfolk& townsfolk, float originX, float originY);
+    void renderSceneAlbedo(
+        const Map& map,
+        const Player& player,
+        const Townsfolk& townsfolk,
+        const ParticleSystem& particles,
+        float originX,
+        float originY);
+    // Fills outSprites with every live particle, in parallel; `lit` scales
+    // the colour of particles that are not emissive.
+    void writeParticleSprites(
+        const ParticleSystem& particles,
         float originX,
-        float originY) const;
-    void renderSceneAlbedo(const Map& map, const Player& player, float originX, float originY) const;
-    void drawFullscreenQuad() const;
+        float originY,
+        float lit,
+        std::span<ParticleSprite> outSprites) const;
+    // Streams the particles through one vertex buffer, alpha blended over
+    // whatever is bound.
+    void drawParticles(const ParticleSystem& particles, float originX, float originY, float lit);
+    void updateTileCache(const Map& map, int viewLeft, int viewTop);
+    void redrawTileCacheTiles(const Map& map, const TileRect& tiles, int viewLeft, int viewTop);
+    void drawTileCacheRegion(const Map& map, int left, int top, int width, int height);
+    void blitTileCache(int viewLeft, int viewTop);
+    std::span<TileInstance> collectTiles(const Map& map, float left, float top, float right, float bottom);
+    static std::int16_t tileId(const Map& map, int x, int y);
+    void drawTiles(std::span<const TileInstance> tiles, float originX, float originY);
+    void drawFullscreenQuad();
 
     SDL_Window* m_window = nullptr;
+    JobSystem* m_jobs = nullptr;
     SDL_GLContext m_context = nullptr;
     float m_ambient = 0.35F;
     float m_globalTintR = 1.0F;
     float m_globalTintG = 1.0F;
     float m_globalTintB = 1.0F;
     bool m_forceCpuPath = false;
+    // Buffer objects and shaders; false when the GL entry points failed to load.
+    bool m_glFunctionsLoaded = false;
+    bool m_coreProfile = false;
+    LightingMode m_lightingMode = LightingMode::Fused;
 
+    // Window size (scene layout) and the scaled size drawn into the render
+    // targets, which may be larger (see RenderTargetPool).
+    int m_viewWidth = 0;
+    int m_viewHeight = 0;
     int m_targetWidth = 0;
     int m_targetHeight = 0;
+    DynamicResolution m_dynamicResolution;
+    std::uint64_t m_lastPresentCounter = 0;
+    // Passes timed on the GPU; the last result read back, in seconds.
+    GpuTimer m_gpuTimer;
+    double m_gpuPassSeconds = 0.0;
+    FrameCapture m_frameCapture;
 
+    GLuint m_fullscreenVs = 0;
+    GLuint m_volumeVs = 0;
     GLuint m_albedoProgram = 0;
-    GLuint m_lightProgram = 0;
     GLuint m_compositeProgram = 0;
 
-    GLuint m_albedoFbo = 0;
-    GLuint m_albedoTex = 0;
-    GLuint m_lightFbo = 0;
-    GLuint m_lightTex = 0;
+    ShaderSources m_sources;
+    std::unordered_map<std::uint32_t, LightProgram> m_lightVariants;
+
+    // One band of map height per light. Bands are recast only when their
+    // light moves or a map edit falls inside its reach.
+    GLuint m_occlusionTex = 0;
+    int m_occlusionWidth = 0;
+    int m_occlusionHeight = 0;
+    std::array<int, kMaxLights * 3 + 3> m_occlusionState{};
+    std::uint64_t m_occlusionRevision = 0;
+    std::vector<std::uint8_t> m_occlusionTexels;
+
+    // Whether each light's reach held a blocked tile, by light slot. A slot
+    // is rescanned only when its reach changes or an edit lands inside it.
+    struct LightReach {
+        std::array<int, 4> bounds{};
+        std::uint64_t revision = 0;
+        bool blocked = false;
+    };
+    std::array<LightReach, kMaxLights> m_lightReach{};
+
+    Lightmap m_lightmap;
+    float m_staticLightScale = 1.0F;
+    GLuint m_lightmapTex = 0;
+    bool m_lightmapDirty = false;
+    bool m_lightmapFloat = false;
+    // Texel values are divided by this when the texture falls back to RGB8.
+    float m_lightmapRange = 1.0F;
+
+    RenderTarget m_albedoTarget;
+
+    // Toroidal cache of the tile layer at target size. Cache texel (x, y) holds
+    // world target pixel (x + i * width, y + j * height) for the view rectangle
+    // starting at m_tileCacheLeft/Top, so scrolling only redraws the exposed
+    // strips. Coordinates are top-down; rebuilt when the map revision changes
+    // and whenever the target size changes.
+    RenderTarget m_tileCacheTarget;
+    std::uint64_t m_tileCacheRevision = 0;
+    int m_tileCacheLeft = 0;
+    int m_tileCacheTop = 0;
+    // MultiPass and Volumes only; linear HDR light. The format drops to RGBA8
+    // until the pipeline is rebuilt once half-float turns out not to be
+    // renderable.
+    RenderTarget m_lightTarget;
+    GLint m_lightFormat = GL_RGBA16F;
+
+    // GL 3.3 core only: an empty VAO for attribute-less fullscreen triangles,
+    // a streaming per-tile instance buffer, and a small one for sprites.
+    GLuint m_emptyVao = 0;
+    GLuint m_tileProgram = 0;
+    GLint m_tileViewportLoc = -1;
+    GLint m_tileOriginLoc = -1;
+    GLint m_tileSizeLoc = -1;
+    GLint m_tilePaletteLoc = -1;
+    GLuint m_tileVao = 0;
+    GLuint m_tileCornerVbo = 0;
+    GLuint m_tileInstanceVbo = 0;
+    GLuint m_spriteProgram = 0;
+    GLint m_spriteViewportLoc = -1;
+    GLuint m_spriteVao = 0;
+    GLuint m_spriteVbo = 0;
+    GLuint m_particleProgram = 0;
+    GLint m_particleViewportLoc = -1;
+    GLuint m_particleVao = 0;
+    GLuint m_particleCornerVbo = 0;
+
+    // Particle vertices, refilled every frame: instances in the core profile,
+    // expanded quads in 2.1.
+    GLuint m_particleVbo = 0;
+
+    // Every program, texture, vertex array, framebuffer and blend change of a
+    // frame goes through the cache. Light volumes are recorded as commands,
+    // possibly on the pool, and replayed through it.
+    GlStateCache m_glState;
+    RenderCommandBuffer m_volumeCommands;
+    // Accounts the render targets' GPU memory itself.
+    RenderTargetPool m_targetPool{m_glState};
+
+    // Estimated GPU memory: the baked and occlusion textures, and the
+    // streaming vertex buffers.
+    GpuAllocation m_lightmapMemory{MemoryTag::Lighting};
+    GpuAllocation m_occlusionMemory{MemoryTag::Lighting};
+    GpuAllocation m_tileInstanceMemory{MemoryTag::Geometry};
+    GpuAllocation m_spriteMemory{MemoryTag::Geometry};
+    GpuAllocation m_particleMemory{MemoryTag::Geometry};
+
+    // Per-frame scratch (reset at the top of render) and a persistent buffer for
+    // shader info logs, so steady-state frames do not allocate.
+    FrameArena m_frameArena;
+    mutable std::vector<char> m_infoLogScratch;
 };
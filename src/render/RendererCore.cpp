@@ -0,0 +1,305 @@
+#include "render/Renderer.hpp"
+
+#include "game/ParticleSystem.hpp"
+#include "render/GlFunctions.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace {
+
+constexpr char kTileVertexShader[] = R"(
+#version 330 core
+
+layout(location = 0) in vec2 aCorner;
+layout(location = 1) in ivec4 aTile;
+
+uniform vec2 uViewport;
+uniform vec2 uOrigin;
+uniform vec2 uTileSize;
+uniform vec3 uTilePalette[4];
+
+out vec4 vColor;
+
+void main() {
+    vec2 tile = vec2(aTile.xy);
+    vec2 pixel = uOrigin + vec2(tile.x - tile.y, tile.x + tile.y) * (uTileSize * 0.5) + aCorner;
+    vColor = vec4(uTilePalette[aTile.z & 3], 1.0);
+    gl_Position = vec4(pixel.x / uViewport.x * 2.0 - 1.0, 1.0 - pixel.y / uViewport.y * 2.0, 0.0, 1.0);
+}
+)";
+
+constexpr char kSpriteVertexShader[] = R"(
+#version 330 core
+
+layout(location = 0) in vec2 aPosition;
+layout(location = 1) in vec3 aColor;
+
+uniform vec2 uViewport;
+
+out vec4 vColor;
+
+void main() {
+    vColor = vec4(aColor, 1.0);
+    gl_Position = vec4(aPosition.x / uViewport.x * 2.0 - 1.0, 1.0 - aPosition.y / uViewport.y * 2.0, 0.0, 1.0);
+}
+)";
+
+constexpr char kParticleVertexShader[] = R"(
+#version 330 core
+
+layout(location = 0) in vec2 aCorner;
+layout(location = 1) in vec3 aSprite;
+layout(location = 2) in vec4 aColor;
+
+uniform vec2 uViewport;
+
+out vec4 vColor;
+
+void main() {
+    // aSprite is the centre in window pixels and the edge length.
+    vec2 pixel = aSprite.xy + aCorner * aSprite.z;
+    vColor = aColor;
+    gl_Position = vec4(pixel.x / uViewport.x * 2.0 - 1.0, 1.0 - pixel.y / uViewport.y * 2.0, 0.0, 1.0);
+}
+)";
+
+struct SpriteVertex {
+    float x;
+    float y;
+    float r;
+    float g;
+    float b;
+};
+
+// Two triangles per quad.
+constexpr std::size_t kSpriteVerticesPerQuad = 6;
+
+} // namespace
+
+ShaderProfile Renderer::shaderProfile() const {
+    return m_coreProfile ? ShaderProfile::Core330 : ShaderProfile::Compatibility120;
+}
+
+bool Renderer::initializeCoreGeometry(GLuint albedoFs) {
+    glGenVertexArrays(1, &m_emptyVao);
+
+    const GLuint tileVs = compileShader(GL_VERTEX_SHADER, kTileVertexShader, "tile.vert");
+    const GLuint spriteVs = compileShader(GL_VERTEX_SHADER, kSpriteVertexShader, "sprite.vert");
+    const GLuint particleVs = compileShader(GL_VERTEX_SHADER, kParticleVertexShader, "particle.vert");
+    if (tileVs != 0) {
+        m_tileProgram = linkProgram(tileVs, albedoFs, "tile");
+        glDeleteShader(tileVs);
+    }
+    if (spriteVs != 0) {
+        m_spriteProgram = linkProgram(spriteVs, albedoFs, "sprite");
+        glDeleteShader(spriteVs);
+    }
+    if (particleVs != 0) {
+        m_particleProgram = linkProgram(particleVs, albedoFs, "particle");
+        glDeleteShader(particleVs);
+    }
+    if (m_tileProgram == 0 || m_spriteProgram == 0 || m_particleProgram == 0) {
+        return false;
+    }
+
+    m_tileViewportLoc = glGetUniformLocation(m_tileProgram, "uViewport");
+    m_tileOriginLoc = glGetUniformLocation(m_tileProgram, "uOrigin");
+    m_tileSizeLoc = glGetUniformLocation(m_tileProgram, "uTileSize");
+    m_tilePaletteLoc = glGetUniformLocation(m_tileProgram, "uTilePalette");
+    m_spriteViewportLoc = glGetUniformLocation(m_spriteProgram, "uViewport");
+    m_particleViewportLoc = glGetUniformLocation(m_particleProgram, "uViewport");
+
+    // Every tile shares the same diamond; only the per-instance tile record
+    // changes, so a full map is one draw call.
+    const std::array<float, 8> corners{
+        0.0F, kTileH * 0.5F,
+        kTileW * 0.5F, 0.0F,
+        kTileW * 0.5F, kTileH,
+        kTileW, kTileH * 0.5F,
+    };
+
+    glGenVertexArrays(1, &m_tileVao);
+    m_glState.bindVertexArray(m_tileVao);
+    glGenBuffers(1, &m_tileCornerVbo);
+    glBindBuffer(GL_ARRAY_BUFFER, m_tileCornerVbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners.data(), GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), nullptr);
+
+    glGenBuffers(1, &m_tileInstanceVbo);
+    glBindBuffer(GL_ARRAY_BUFFER, m_tileInstanceVbo);
+    glEnableVertexAttribArray(1);
+    glVertexAttribIPointer(1, 4, GL_SHORT, sizeof(TileInstance), nullptr);
+    glVertexAttribDivisor(1, 1);
+
+    glGenVertexArrays(1, &m_spriteVao);
+    m_glState.bindVertexArray(m_spriteVao);
+    // Sized by each draw; see drawSpritesCore.
+    glGenBuffers(1, &m_spriteVbo);
+    glBindBuffer(GL_ARRAY_BUFFER, m_spriteVbo);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(SpriteVertex), nullptr);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(
+        1,
+        3,
+        GL_FLOAT,
+        GL_FALSE,
+        sizeof(SpriteVertex),
+        reinterpret_cast<const void*>(offsetof(SpriteVertex, r)));
+
+    // Particles are instanced squares; the instance buffer is refilled, and
+    // orphaned, every frame.
+    const std::array<float, 8> particleCorners{
+        -0.5F, -0.5F,
+        0.5F, -0.5F,
+        -0.5F, 0.5F,
+        0.5F, 0.5F,
+    };
+    glGenVertexArrays(1, &m_particleVao);
+    m_glState.bindVertexArray(m_particleVao);
+    glGenBuffers(1, &m_particleCornerVbo);
+    glBindBuffer(GL_ARRAY_BUFFER, m_particleCornerVbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(particleCorners), particleCorners.data(), GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), nullptr);
+
+    glGenBuffers(1, &m_particleVbo);
+    glBindBuffer(GL_ARRAY_BUFFER, m_particleVbo);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(ParticleSprite), nullptr);
+    glVertexAttribDivisor(1, 1);
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(
+        2,
+        4,
+        GL_UNSIGNED_BYTE,
+        GL_TRUE,
+        sizeof(ParticleSprite),
+        reinterpret_cast<const void*>(offsetof(ParticleSprite, color)));
+    glVertexAttribDivisor(2, 1);
+
+    m_glState.bindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return true;
+}
+
+void Renderer::destroyCoreGeometry() {
+    if (m_tileProgram != 0) {
+        glDeleteProgram(m_tileProgram);
+        m_tileProgram = 0;
+    }
+    if (m_spriteProgram != 0) {
+        glDeleteProgram(m_spriteProgram);
+        m_spriteProgram = 0;
+    }
+    if (m_particleProgram != 0) {
+        glDeleteProgram(m_particleProgram);
+        m_particleProgram = 0;
+    }
+
+    const std::array<GLuint, 4> buffers{m_tileCornerVbo, m_tileInstanceVbo, m_spriteVbo, m_particleCornerVbo};
+    for (GLuint buffer : buffers) {
+        if (buffer != 0) {
+            glDeleteBuffers(1, &buffer);
+        }
+    }
+    m_tileCornerVbo = 0;
+    m_tileInstanceVbo = 0;
+    m_spriteVbo = 0;
+    m_particleCornerVbo = 0;
+    m_tileInstanceMemory.release();
+    m_spriteMemory.release();
+
+    const std::array<GLuint, 4> arrays{m_emptyVao, m_tileVao, m_spriteVao, m_particleVao};
+    for (GLuint array : arrays) {
+        if (array != 0) {
+            glDeleteVertexArrays(1, &array);
+        }
+    }
+    m_emptyVao = 0;
+    m_tileVao = 0;
+    m_spriteVao = 0;
+    m_particleVao = 0;
+}
+
+void Renderer::drawTilesInstanced(std::span<const TileInstance> tiles, float originX, float originY) {
+    if (tiles.empty()) {
+        return;
+    }
+
+    // Only the tiles of the strip being drawn are uploaded; orphaning the
+    // buffer keeps the upload from waiting on the previous draw.
+    glBindBuffer(GL_ARRAY_BUFFER, m_tileInstanceVbo);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(tiles.size_bytes()), nullptr, GL_STREAM_DRAW);
+    m_tileInstanceMemory.set(tiles.size_bytes());
+    glBufferSubData(GL_ARRAY_BUFFER, 0, static_cast<GLsizeiptr>(tiles.size_bytes()), tiles.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    m_glState.useProgram(m_tileProgram);
+    glUniform2f(m_tileViewportLoc, static_cast<float>(m_viewWidth), static_cast<float>(m_viewHeight));
+    glUniform2f(m_tileOriginLoc, originX, originY);
+    glUniform2f(m_tileSizeLoc, kTileW, kTileH);
+    glUniform3fv(m_tilePaletteLoc, 4, kTilePalette.data());
+
+    m_glState.bindVertexArray(m_tileVao);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(tiles.size()));
+}
+
+void Renderer::drawSpritesCore(std::span<const SpriteQuad> quads) {
+    if (quads.empty()) {
+        return;
+    }
+
+    const std::span<SpriteVertex> vertices =
+        m_frameArena.allocateArray<SpriteVertex>(quads.size() * kSpriteVerticesPerQuad);
+    constexpr std::array<int, kSpriteVerticesPerQuad> kCornerOrder{0, 1, 2, 0, 2, 3};
+    std::size_t index = 0;
+    for (const SpriteQuad& quad : quads) {
+        for (int corner : kCornerOrder) {
+            vertices[index++] = SpriteVertex{quad.x[corner], quad.y[corner], quad.r, quad.g, quad.b};
+        }
+    }
+
+    m_glState.useProgram(m_spriteProgram);
+    glUniform2f(m_spriteViewportLoc, static_cast<float>(m_viewWidth), static_cast<float>(m_viewHeight));
+
+    // A fresh store every draw: the actor count changes from frame to frame,
+    // and the driver need not wait for last frame's draw to finish reading.
+    glBindBuffer(GL_ARRAY_BUFFER, m_spriteVbo);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(vertices.size_bytes()), vertices.data(), GL_STREAM_DRAW);
+    m_spriteMemory.set(vertices.size_bytes());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    m_glState.bindVertexArray(m_spriteVao);
+    glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(vertices.size()));
+}
+
+void Renderer::drawParticlesCore(const ParticleSystem& particles, float originX, float originY) {
+    const std::size_t count = particles.size();
+    const auto bytes = static_cast<GLsizeiptr>(count * sizeof(ParticleSprite));
+    glBindBuffer(GL_ARRAY_BUFFER, m_particleVbo);
+    glBufferData(GL_ARRAY_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+    m_particleMemory.set(static_cast<std::uint64_t>(bytes));
+    auto* sprites = static_cast<ParticleSprite*>(glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY));
+    if (sprites == nullptr) {
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        return;
+    }
+    // The lighting pass lights them, so every kind goes in at full colour.
+    writeParticleSprites(particles, originX, originY, 1.0F, std::span<ParticleSprite>(sprites, count));
+    const bool intact = glUnmapBuffer(GL_ARRAY_BUFFER) == GL_TRUE;
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    if (!intact) {
+        return;
+    }
+
+    m_glState.useProgram(m_particleProgram);
+    glUniform2f(m_particleViewportLoc, static_cast<float>(m_viewWidth), static_cast<float>(m_viewHeight));
+    m_glState.bindVertexArray(m_particleVao);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(count));
+}
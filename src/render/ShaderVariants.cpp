@@ -0,0 +1,77 @@
+#include "render/ShaderVariants.hpp"
+
+#include <cmath>
+
+namespace {
+FalloffMode falloffFor(float exponent) {
+    if (exponent <= 0.0F) {
+        return FalloffMode::InverseSquare;
+    }
+    if (std::fabs(exponent - 1.0F) < 1e-4F) {
+        return FalloffMode::Linear;
+    }
+    if (std::fabs(exponent - 2.0F) < 1e-4F) {
+        return FalloffMode::Quadratic;
+    }
+    return FalloffMode::Power;
+}
+}
+
+FalloffMode ShaderVariants::tightestFalloff(std::span<const Light> lights) {
+    if (lights.empty()) {
+        return FalloffMode::InverseSquare;
+    }
+
+    const FalloffMode first = falloffFor(lights.front().falloffExponent);
+    bool uniform = true;
+    bool anyInverseSquare = false;
+    bool anyPositive = false;
+    for (const Light& light : lights) {
+        const FalloffMode lightMode = falloffFor(light.falloffExponent);
+        uniform = uniform && lightMode == first;
+        anyInverseSquare = anyInverseSquare || lightMode == FalloffMode::InverseSquare;
+        anyPositive = anyPositive || lightMode != FalloffMode::InverseSquare;
+    }
+    if (uniform) {
+        return first;
+    }
+
+    // Linear and quadratic are special cases of the generic power curve;
+    // only a mix with inverse-square needs the per-pixel branch.
+    return anyInverseSquare && anyPositive ? FalloffMode::Mixed : FalloffMode::Power;
+}
+
+std::string ShaderVariants::compose(ShaderProfile profile, std::string_view defines, std::string_view body) {
+    constexpr std::string_view kCompatibilityPreamble =
+        "#version 120\n"
+        "#define VARYING varying\n"
+        "#define TEXTURE_2D texture2D\n"
+        "#define FRAG_COLOR gl_FragColor\n";
+    constexpr std::string_view kCorePreamble =
+        "#version 330 core\n"
+        "#define VARYING in\n"
+        "#define TEXTURE_2D texture\n"
+        "out vec4 fragColor;\n"
+        "#define FRAG_COLOR fragColor\n";
+
+    const std::string_view preamble = profile == ShaderProfile::Core330 ? kCorePreamble : kCompatibilityPreamble;
+
+    std::string result;
+    result.reserve(preamble.size() + defines.size() + body.size() + 16);
+    result.append(preamble);
+    result.append(defines);
+    result.append("#line 1\n");
+    result.append(body);
+    return result;
+}
+
+std::string ShaderVariants::buildLightSource(ShaderProfile profile, std::string_view body, const LightShaderKey& key) {
+    std::string defines;
+    defines += "#define LIGHT_COUNT " + std::to_string(key.lightCount) + "\n";
+    defines += "#define FALLOFF_MODE " + std::to_string(static_cast<int>(key.falloff)) + "\n";
+    defines += "#define OCCLUSION " + std::string(key.occlusion ? "1" : "0") + "\n";
+    defines += "#define FUSED " + std::string(key.fused ? "1" : "0") + "\n";
+    defines += "#define VOLUME " + std::string(key.volume ? "1" : "0") + "\n";
+    defines += "#define BAKED " + std::string(key.baked ? "1" : "0") + "\n";
+    return compose(profile, defines, body);
+}
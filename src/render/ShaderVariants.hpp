@@ -0,0 +1,56 @@
+#pragma once
+
+#include "render/Light.hpp"
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+
+// GLSL dialect of the active context. Fragment shaders are written against the
+// VARYING / TEXTURE_2D / FRAG_COLOR macros and get the matching preamble.
+enum class ShaderProfile : std::uint8_t {
+    Compatibility120,
+    Core330,
+};
+
+// Attenuation curve shared by every light in a lighting pass. The specialised
+// modes drop the per-pixel branch and replace pow() with multiplies.
+enum class FalloffMode : std::uint8_t {
+    InverseSquare = 0,
+    Linear = 1,
+    Quadratic = 2,
+    Power = 3,
+    Mixed = 4,
+};
+
+struct LightShaderKey {
+    std::uint8_t lightCount = 0;
+    FalloffMode falloff = FalloffMode::Mixed;
+    bool occlusion = false;
+    // Light and composite in one pass, writing the final colour.
+    bool fused = false;
+    // One light per draw, additively blended over its screen bounds.
+    bool volume = false;
+    // Adds the baked static lightmap.
+    bool baked = false;
+
+    std::uint32_t packed() const {
+        return static_cast<std::uint32_t>(lightCount) |
+            (static_cast<std::uint32_t>(falloff) << 4U) |
+            (static_cast<std::uint32_t>(occlusion ? 1U : 0U) << 7U) |
+            (static_cast<std::uint32_t>(fused ? 1U : 0U) << 8U) |
+            (static_cast<std::uint32_t>(volume ? 1U : 0U) << 9U) |
+            (static_cast<std::uint32_t>(baked ? 1U : 0U) << 10U);
+    }
+};
+
+class ShaderVariants {
+public:
+    // Narrowest falloff mode that evaluates every light exactly.
+    static FalloffMode tightestFalloff(std::span<const Light> lights);
+
+    // Profile preamble, then defines, then the shader body.
+    static std::string compose(ShaderProfile profile, std::string_view defines, std::string_view body);
+    static std::string buildLightSource(ShaderProfile profile, std::string_view body, const LightShaderKey& key);
+};
@@ -0,0 +1,139 @@
+// Packs loose asset files into the archive format described in core/AssetArchive.hpp.
+//
+// Usage: asset_packer <output.pak> <source root> <relative path>...
+
+#include "core/AssetArchive.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct PackedFile {
+    std::string name;
+    std::vector<char> data;
+};
+
+std::uint64_t alignUp(std::uint64_t value, std::uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+std::uint32_t bucketCountFor(std::size_t entryCount) {
+    std::uint32_t count = 1;
+    while (count < entryCount * 2) {
+        count <<= 1U;
+    }
+    return count;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "Usage: asset_packer <output.pak> <source root> <relative path>...\n";
+        return 1;
+    }
+
+    const fs::path outputPath = argv[1];
+    const fs::path sourceRoot = argv[2];
+
+    std::vector<PackedFile> files;
+    for (int i = 3; i < argc; ++i) {
+        PackedFile file;
+        file.name = fs::path(argv[i]).generic_string();
+
+        std::ifstream input(sourceRoot / file.name, std::ios::binary);
+        if (!input.is_open()) {
+            std::cerr << "asset_packer: unable to open " << (sourceRoot / file.name) << '\n';
+            return 1;
+        }
+        file.data.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+        files.push_back(std::move(file));
+    }
+
+    // Sorted input keeps the archive byte-identical across configure runs.
+    std::sort(files.begin(), files.end(), [](const PackedFile& a, const PackedFile& b) { return a.name < b.name; });
+
+    AssetArchiveHeader header{};
+    std::memcpy(header.magic, kAssetArchiveMagic, sizeof(header.magic));
+    header.version = kAssetArchiveVersion;
+    header.entryCount = static_cast<std::uint32_t>(files.size());
+    header.bucketCount = bucketCountFor(files.size());
+    header.entriesOffset = sizeof(AssetArchiveHeader);
+    header.bucketsOffset = header.entriesOffset + sizeof(AssetArchiveEntry) * files.size();
+    header.namesOffset = header.bucketsOffset + sizeof(std::uint32_t) * header.bucketCount;
+
+    std::vector<AssetArchiveEntry> entries(files.size());
+    std::vector<std::uint32_t> buckets(header.bucketCount, kAssetArchiveEmptyBucket);
+    std::string names;
+
+    for (std::size_t i = 0; i < files.size(); ++i) {
+        AssetArchiveEntry& entry = entries[i];
+        entry.nameHash = assetPathHash(files[i].name);
+        entry.nameOffset = static_cast<std::uint32_t>(names.size());
+        entry.nameLength = static_cast<std::uint32_t>(files[i].name.size());
+        entry.dataSize = files[i].data.size();
+        names += files[i].name;
+
+        std::uint32_t& bucket = buckets[entry.nameHash & (header.bucketCount - 1)];
+        entry.nextInBucket = bucket;
+        bucket = static_cast<std::uint32_t>(i);
+    }
+
+    header.dataOffset = alignUp(header.namesOffset + names.size(), kAssetArchiveDataAlignment);
+    std::uint64_t cursor = header.dataOffset;
+    for (std::size_t i = 0; i < files.size(); ++i) {
+        entries[i].dataOffset = cursor;
+        cursor = alignUp(cursor + files[i].data.size(), kAssetArchiveDataAlignment);
+    }
+
+    const fs::path tempPath = fs::path(outputPath).concat(".tmp");
+    {
+        std::ofstream output(tempPath, std::ios::binary | std::ios::trunc);
+        if (!output.is_open()) {
+            std::cerr << "asset_packer: unable to write " << tempPath << '\n';
+            return 1;
+        }
+
+        auto padTo = [&output](std::uint64_t offset) {
+            const auto position = static_cast<std::uint64_t>(output.tellp());
+            for (std::uint64_t i = position; i < offset; ++i) {
+                output.put('\0');
+            }
+        };
+
+        output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        output.write(reinterpret_cast<const char*>(entries.data()), static_cast<std::streamsize>(sizeof(AssetArchiveEntry) * entries.size()));
+        output.write(reinterpret_cast<const char*>(buckets.data()), static_cast<std::streamsize>(sizeof(std::uint32_t) * buckets.size()));
+        output.write(names.data(), static_cast<std::streamsize>(names.size()));
+        for (std::size_t i = 0; i < files.size(); ++i) {
+            padTo(entries[i].dataOffset);
+            output.write(files[i].data.data(), static_cast<std::streamsize>(files[i].data.size()));
+        }
+        padTo(cursor);
+
+        if (!output.good()) {
+            std::cerr << "asset_packer: write failed for " << tempPath << '\n';
+            return 1;
+        }
+    }
+
+    std::error_code ec;
+    fs::rename(tempPath, outputPath, ec);
+    if (ec) {
+        std::cerr << "asset_packer: unable to move archive into place: " << ec.message() << '\n';
+        return 1;
+    }
+
+    std::cout << "asset_packer: packed " << files.size() << " assets into " << outputPath << '\n';
+    return 0;
+}
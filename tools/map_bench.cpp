@@ -0,0 +1,670 @@
+// Times map-size dependent costs on generated maps of growing size and fits how
+// each one scales with the tile count.
+//
+// Usage: map_bench [--sizes 64,256,...] [--style town|canyon] [--seed N] [--density F]
+//                  [--frames N] [--no-render] [--particles N] [--actors N] [--lod-tiers T]
+//
+// Raycasts are also checked against a plain cell-by-cell DDA, on the timed
+// rays and on centre-to-centre rays that pass through exact cell corners.
+//
+// The render rows use whatever path the renderer picks; select one with the
+// usual RENDERER_* variables (e.g. RENDERER_FORCE_CPU_LIGHTING=1). With
+// --particles, that many particles are kept alive around the view, stepped and
+// drawn every rendered frame. With --actors, that many townsfolk are spread
+// over the map and stepped under the simulation LOD tiers (--lod-tiers, in
+// the SIM_LOD_TIERS format) and at full rate for comparison; the rendered
+// frames then draw the ones on screen. The run also checks that no actor
+// waits longer than its tier's period while it stays in that tier.
+
+#include "core/AssetManager.hpp"
+#include "game/Camera.hpp"
+#include "game/Map.hpp"
+#include "game/MapGenerator.hpp"
+#include "game/ParticleSystem.hpp"
+#include "game/Player.hpp"
+#include "game/SimulationLod.hpp"
+#include "game/Townsfolk.hpp"
+#include "render/Light.hpp"
+#include "render/Renderer.hpp"
+
+#include <SDL2/SDL.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+constexpr char kUsage[] =
+    "Usage: map_bench [--sizes 64,256,...] [--style town|canyon] [--seed N] [--density F] [--frames N] [--no-render]\n"
+    "                 [--particles N] [--actors N] [--lod-tiers T]\n";
+
+constexpr std::array<int, 5> kDefaultSizes{64, 256, 1024, 4096, 8192};
+constexpr int kCollisionQueries = 200000;
+constexpr int kSightQueries = 200000;
+constexpr int kRayQueries = 100000;
+// Light-sized line-of-sight checks, and rays long enough to cross rooms.
+constexpr float kSightRange = 8.0F;
+constexpr float kRayRange = 48.0F;
+constexpr float kPlayerRadius = 0.3F;
+constexpr int kBenchWindowWidth = 1280;
+constexpr int kBenchWindowHeight = 720;
+// Tiles the camera pans per rendered frame, so scroll caches do real work.
+constexpr float kCameraPanPerFrame = 0.35F;
+// Particles are spawned in clusters this many at a time, within this many
+// tiles of the view centre, and stepped at the game's fixed rate.
+constexpr std::size_t kParticleCluster = 256;
+constexpr float kParticleSpread = 10.0F;
+constexpr float kParticleStepSeconds = 1.0F / 60.0F;
+// Townsfolk steps per measurement; a multiple of every default tier period.
+constexpr int kActorSteps = 240;
+// The LOD cadence check circles the focus around the map centre this many
+// steps, at this many tiles per step, with the actors held still.
+constexpr int kLodCheckSteps = 2400;
+constexpr float kLodCheckFocusSpeed = 0.1F;
+
+enum Metric : std::size_t {
+    kGenerate,
+    kLoad,
+    kCollision,
+    kSight,
+    kRaycast,
+    kRaycastMismatches,
+    kFirstFrame,
+    kFrame,
+    kParticleStep,
+    kBinds,
+    kBindsSkipped,
+    kActorStep,
+    kActorStepFull,
+    kActorUpdates,
+    kActorWorstGap,
+    kMetricCount,
+};
+
+struct MetricInfo {
+    const char* name;
+    const char* unit;
+};
+
+constexpr std::array<MetricInfo, kMetricCount> kMetrics{{
+    {"generate", "ms"},
+    {"load", "ms"},
+    {"sweepCircle", "ns/op"},
+    {"hasLineOfSight", "ns/op"},
+    {"raycastBatch", "ns/op"},
+    {"raycast vs DDA", "diffs"},
+    {"first frame", "ms"},
+    {"frame", "ms"},
+    {"particle step", "ms"},
+    {"state binds", "/frame"},
+    {"binds skipped", "/frame"},
+    {"actor step", "ms"},
+    {"full-rate step", "ms"},
+    {"actor updates", "/step"},
+    {"worst LOD gap", "periods"},
+}};
+
+struct SizeResult {
+    int size = 0;
+    float blockedFraction = 0.0F;
+    std::array<double, kMetricCount> values{};
+    std::array<bool, kMetricCount> measured{};
+};
+
+using Clock = std::chrono::steady_clock;
+
+double elapsedMs(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Small deterministic generator for query inputs.
+class QueryRng {
+public:
+    explicit QueryRng(std::uint64_t seed)
+        : m_state(seed * 2 + 1) {
+    }
+
+    float uniform() {
+        m_state ^= m_state << 13U;
+        m_state ^= m_state >> 7U;
+        m_state ^= m_state << 17U;
+        return static_cast<float>(m_state >> 40U) * (1.0F / 16777216.0F);
+    }
+
+private:
+    std::uint64_t m_state;
+};
+
+// Centre of a random open tile; falls back to any tile on a full map.
+void randomOpenTile(const Map& map, QueryRng& rng, float& outX, float& outY) {
+    for (int attempt = 0; attempt < 64; ++attempt) {
+        const int x = static_cast<int>(rng.uniform() * static_cast<float>(map.width()));
+        const int y = static_cast<int>(rng.uniform() * static_cast<float>(map.height()));
+        if (!map.isBlocked(x, y) || attempt == 63) {
+            outX = static_cast<float>(x) + 0.5F;
+            outY = static_cast<float>(y) + 0.5F;
+            return;
+        }
+    }
+}
+
+std::vector<Ray> randomRays(const Map& map, QueryRng& rng, int count, float range) {
+    std::vector<Ray> rays(static_cast<std::size_t>(count));
+    for (Ray& ray : rays) {
+        randomOpenTile(map, rng, ray.fromX, ray.fromY);
+        const float angle = rng.uniform() * 6.2831853F;
+        const float length = rng.uniform() * range;
+        ray.toX = std::clamp(ray.fromX + std::cos(angle) * length, 0.0F, static_cast<float>(map.width()) - 0.01F);
+        ray.toY = std::clamp(ray.fromY + std::sin(angle) * length, 0.0F, static_cast<float>(map.height()) - 0.01F);
+    }
+    return rays;
+}
+
+// Plain cell-by-cell DDA, the reference Map::raycast must match exactly: same
+// hit cell, same t and the same normal, diagonal on exact corners.
+RayHit referenceRaycast(const Map& map, const Ray& ray) {
+    const float dx = ray.toX - ray.fromX;
+    const float dy = ray.toY - ray.fromY;
+    const int stepX = dx > 0.0F ? 1 : (dx < 0.0F ? -1 : 0);
+    const int stepY = dy > 0.0F ? 1 : (dy < 0.0F ? -1 : 0);
+    const auto boundaryT = [](float origin, float delta, int step, int cell) {
+        if (step == 0) {
+            return std::numeric_limits<float>::infinity();
+        }
+        return (static_cast<float>(step > 0 ? cell + 1 : cell) - origin) / delta;
+    };
+    int cellX = static_cast<int>(std::floor(ray.fromX));
+    int cellY = static_cast<int>(std::floor(ray.fromY));
+    for (;;) {
+        const float nextX = boundaryT(ray.fromX, dx, stepX, cellX);
+        const float nextY = boundaryT(ray.fromY, dy, stepY, cellY);
+        const float t = std::min(nextX, nextY);
+        if (t > 1.0F) {
+            return RayHit{false, 0, 0, 1.0F, 0.0F, 0.0F};
+        }
+        const bool crossedX = nextX <= nextY;
+        const bool crossedY = nextY <= nextX;
+        cellX += crossedX ? stepX : 0;
+        cellY += crossedY ? stepY : 0;
+        if (map.isBlocked(cellX, cellY)) {
+            return RayHit{
+                true,
+                cellX,
+                cellY,
+                t,
+                crossedX ? static_cast<float>(-stepX) : 0.0F,
+                crossedY ? static_cast<float>(-stepY) : 0.0F};
+        }
+    }
+}
+
+// Rays whose hit differs from the reference DDA in any field.
+int raycastMismatches(const Map& map, std::span<const Ray> rays, std::span<const RayHit> hits) {
+    int mismatches = 0;
+    for (std::size_t i = 0; i < rays.size(); ++i) {
+        const RayHit expected = referenceRaycast(map, rays[i]);
+        const RayHit& hit = hits[i];
+        if (hit.hit != expected.hit ||
+            (expected.hit &&
+             (hit.cellX != expected.cellX || hit.cellY != expected.cellY || hit.t != expected.t ||
+              hit.normalX != expected.normalX || hit.normalY != expected.normalY))) {
+            ++mismatches;
+        }
+    }
+    return mismatches;
+}
+
+void measureQueries(const Map& map, std::uint64_t seed, SizeResult& result) {
+    QueryRng rng(seed);
+
+    const std::vector<Ray> moves = randomRays(map, rng, kCollisionQueries, 0.5F);
+    float checksum = 0.0F;
+    Clock::time_point start = Clock::now();
+    for (const Ray& move : moves) {
+        const SweepResult swept = map.sweepCircle(move.fromX, move.fromY, kPlayerRadius, move.toX - move.fromX, move.toY - move.fromY);
+        checksum += swept.x;
+    }
+    result.values[kCollision] = elapsedMs(start) * 1.0e6 / kCollisionQueries;
+
+    const std::vector<Ray> sights = randomRays(map, rng, kSightQueries, kSightRange);
+    int visible = 0;
+    start = Clock::now();
+    for (const Ray& sight : sights) {
+        visible += map.hasLineOfSight(
+                       static_cast<int>(sight.fromX),
+                       static_cast<int>(sight.fromY),
+                       static_cast<int>(sight.toX),
+                       static_cast<int>(sight.toY))
+            ? 1
+            : 0;
+    }
+    result.values[kSight] = elapsedMs(start) * 1.0e6 / kSightQueries;
+
+    const std::vector<Ray> rays = randomRays(map, rng, kRayQueries, kRayRange);
+    std::vector<RayHit> hits(rays.size());
+    start = Clock::now();
+    map.raycastBatch(rays, hits);
+    result.values[kRaycast] = elapsedMs(start) * 1.0e6 / kRayQueries;
+
+    result.measured[kCollision] = true;
+    result.measured[kSight] = true;
+    result.measured[kRaycast] = true;
+
+    // The timed rays, plus centre-to-centre ones, which often pass exactly
+    // through cell corners.
+    std::vector<Ray> centred = sights;
+    for (Ray& ray : centred) {
+        ray.toX = std::floor(ray.toX) + 0.5F;
+        ray.toY = std::floor(ray.toY) + 0.5F;
+    }
+    std::vector<RayHit> centredHits(centred.size());
+    map.raycastBatch(centred, centredHits);
+    result.values[kRaycastMismatches] =
+        raycastMismatches(map, rays, hits) + raycastMismatches(map, centred, centredHits);
+    result.measured[kRaycastMismatches] = true;
+    if (result.values[kRaycastMismatches] > 0.0) {
+        std::cerr << "map_bench: raycast differs from a cell-by-cell DDA on " << result.values[kRaycastMismatches]
+                  << " rays.\n";
+    }
+    // Keeps the loops from being optimised away.
+    if (checksum < 0.0F || visible < 0 || hits.empty()) {
+        std::cerr << '\n';
+    }
+}
+
+// Tops each kind up to an equal share of `count`, in clusters around (x, y).
+void topUpParticles(ParticleSystem& particles, std::size_t count, float x, float y, QueryRng& rng) {
+    const std::size_t share = count / kParticleKindCount;
+    for (std::size_t kind = 0; kind < kParticleKindCount; ++kind) {
+        const auto particleKind = static_cast<ParticleKind>(kind);
+        while (particles.pool(particleKind).size() < share) {
+            const std::size_t missing = share - particles.pool(particleKind).size();
+            const float clusterX = x + (rng.uniform() * 2.0F - 1.0F) * kParticleSpread;
+            const float clusterY = y + (rng.uniform() * 2.0F - 1.0F) * kParticleSpread;
+            if (particles.emit(particleKind, clusterX, clusterY, 0.5F, std::min(missing, kParticleCluster)) == 0) {
+                break;
+            }
+        }
+    }
+}
+
+// Steps `townsfolk` (already spawned) kActorSteps times around (x, y).
+// Returns the mean milliseconds per step and the mean townsfolk updated.
+double stepTownsfolk(Townsfolk& townsfolk, const Map& map, float x, float y, double& outUpdates) {
+    std::size_t updates = 0;
+    const Clock::time_point start = Clock::now();
+    for (int step = 0; step < kActorSteps; ++step) {
+        townsfolk.update(map, x, y, kParticleStepSeconds);
+        updates += townsfolk.updatesLastStep();
+    }
+    outUpdates = static_cast<double>(updates) / kActorSteps;
+    return elapsedMs(start) / kActorSteps;
+}
+
+// Longest wait between two updates of an actor that stayed in one LOD tier,
+// in units of that tier's period; anything above 1 means an actor missed its
+// rate. The focus circles the map centre so actors keep changing tier.
+double worstLodGap(const Map& map, const SimulationLodSettings& settings, const Townsfolk& townsfolk) {
+    std::vector<float> xs(townsfolk.size());
+    std::vector<float> ys(townsfolk.size());
+    for (std::size_t i = 0; i < townsfolk.size(); ++i) {
+        const TownsfolkPose pose = townsfolk.pose(i);
+        xs[i] = pose.x;
+        ys[i] = pose.y;
+    }
+
+    SimulationLod lod;
+    lod.configure(settings);
+    // Tier each actor had at its last update, and whether it has been in
+    // another tier since; tierCount() + 1 marks "not updated yet".
+    const std::size_t notYet = settings.tierCount + 1;
+    std::vector<std::size_t> lastTier(xs.size(), notYet);
+    std::vector<std::uint64_t> lastStep(xs.size(), 0);
+    std::vector<bool> moved(xs.size(), false);
+
+    const float centreX = static_cast<float>(map.width()) * 0.5F;
+    const float centreY = static_cast<float>(map.height()) * 0.5F;
+    const float orbit = static_cast<float>(std::min(map.width(), map.height())) * 0.25F;
+    double worst = 0.0;
+    for (std::uint64_t step = 1; step <= kLodCheckSteps; ++step) {
+        const float angle = static_cast<float>(step) * kLodCheckFocusSpeed / std::max(orbit, 1.0F);
+        const float focusX = centreX + std::cos(angle) * orbit;
+        const float focusY = centreY + std::sin(angle) * orbit;
+        // Mirrors the reclassifications forEachDue makes.
+        if (step == 1 || step % SimulationLod::kReclassifySteps == 0) {
+            for (std::size_t i = 0; i < xs.size(); ++i) {
+                if (lastTier[i] != notYet && lod.classify(xs[i], ys[i], focusX, focusY) != lastTier[i]) {
+                    moved[i] = true;
+                }
+            }
+        }
+        lod.forEachDue(step, focusX, focusY, xs, ys, [&](std::uint32_t index, std::size_t tier) {
+            if (lastTier[index] == tier && !moved[index]) {
+                const std::uint32_t period =
+                    tier < settings.tierCount ? settings.tiers[tier].period : settings.coarsePeriod;
+                worst = std::max(worst, static_cast<double>(step - lastStep[index]) / period);
+            }
+            lastTier[index] = tier;
+            lastStep[index] = step;
+            moved[index] = false;
+        });
+    }
+    return worst;
+}
+
+// Times the same town under the LOD tiers and at full rate. Leaves the LOD
+// run's townsfolk in `townsfolk` for the rendered frames.
+void measureActors(
+    const Map& map,
+    std::uint64_t seed,
+    std::size_t actorCount,
+    const SimulationLodSettings& lod,
+    Townsfolk& townsfolk,
+    SizeResult& result) {
+    float x = 0.0F;
+    float y = 0.0F;
+    // Focused where measureRendering puts the camera.
+    QueryRng rng(7);
+    randomOpenTile(map, rng, x, y);
+
+    const auto townSeed = static_cast<std::uint32_t>(seed);
+    Townsfolk fullRate;
+    fullRate.configure(SimulationLodSettings::fullRate());
+    fullRate.spawn(map, actorCount, townSeed);
+    double ignored = 0.0;
+    result.values[kActorStepFull] = stepTownsfolk(fullRate, map, x, y, ignored);
+
+    townsfolk.configure(lod);
+    townsfolk.spawn(map, actorCount, townSeed);
+    result.values[kActorStep] = stepTownsfolk(townsfolk, map, x, y, result.values[kActorUpdates]);
+
+    result.measured[kActorStep] = true;
+    result.measured[kActorStepFull] = true;
+    result.measured[kActorUpdates] = true;
+
+    result.values[kActorWorstGap] = worstLodGap(map, lod, townsfolk);
+    result.measured[kActorWorstGap] = true;
+    if (result.values[kActorWorstGap] > 1.0) {
+        std::cerr << "map_bench: an actor waited " << result.values[kActorWorstGap]
+                  << " periods for an update without changing LOD tier.\n";
+    }
+}
+
+void measureRendering(
+    Renderer& renderer,
+    const Map& map,
+    int frames,
+    std::size_t particleCount,
+    const Townsfolk& townsfolk,
+    SizeResult& result) {
+    Player player;
+    float x = 0.0F;
+    float y = 0.0F;
+    QueryRng rng(7);
+    randomOpenTile(map, rng, x, y);
+    player.setPosition(x, y);
+    Camera camera;
+    camera.snapTo(x, y);
+
+    const std::array<Light, 4> lights{
+        Light{x, y, 4.2F, 0.88F, 1.00F, 0.78F, 0.52F, 2.3F},
+        Light{x + 3.0F, y - 2.0F, 3.8F, 0.66F, 1.00F, 0.70F, 0.42F, 1.8F},
+        Light{x - 4.0F, y + 1.0F, 3.5F, 0.60F, 0.55F, 0.70F, 1.00F, 2.0F},
+        Light{x + 1.0F, y + 4.0F, 3.0F, 0.50F, 1.00F, 0.50F, 0.30F, 2.0F},
+    };
+
+    ParticleSystem particles;
+    topUpParticles(particles, particleCount, x, y, rng);
+
+    Clock::time_point start = Clock::now();
+    renderer.render(map, player, townsfolk, camera, particles, lights);
+    result.values[kFirstFrame] = elapsedMs(start);
+
+    double stepMs = 0.0;
+    const GlStateStats statesBefore = renderer.glStateStats();
+    start = Clock::now();
+    for (int frame = 0; frame < frames; ++frame) {
+        // Pan along a diagonal and back so the view keeps scrolling.
+        const float offset = kCameraPanPerFrame * static_cast<float>(frame % 64 < 32 ? frame % 32 : 32 - frame % 32);
+        camera.snapTo(x + offset, y + offset * 0.5F);
+        if (particleCount > 0) {
+            topUpParticles(particles, particleCount, x, y, rng);
+            const Clock::time_point stepStart = Clock::now();
+            particles.update(map, kParticleStepSeconds);
+            stepMs += elapsedMs(stepStart);
+        }
+        renderer.render(map, player, townsfolk, camera, particles, lights);
+    }
+    result.values[kFrame] = elapsedMs(start) / std::max(frames, 1);
+    result.values[kParticleStep] = stepMs / std::max(frames, 1);
+    const GlStateStats statesAfter = renderer.glStateStats();
+    result.values[kBinds] = static_cast<double>(statesAfter.requested - statesBefore.requested) / std::max(frames, 1);
+    result.values[kBindsSkipped] = static_cast<double>(statesAfter.skipped - statesBefore.skipped) / std::max(frames, 1);
+    result.measured[kFirstFrame] = true;
+    result.measured[kFrame] = true;
+    result.measured[kParticleStep] = particleCount > 0;
+    result.measured[kBinds] = true;
+    result.measured[kBindsSkipped] = true;
+}
+
+// Least-squares slope of log(value) against log(tiles): 0 is flat, 1 linear.
+bool growthExponent(const std::vector<SizeResult>& results, std::size_t metric, double& outExponent) {
+    double sumX = 0.0;
+    double sumY = 0.0;
+    double sumXX = 0.0;
+    double sumXY = 0.0;
+    int count = 0;
+    for (const SizeResult& result : results) {
+        if (!result.measured[metric] || result.values[metric] <= 0.0) {
+            continue;
+        }
+        const double logTiles = std::log(static_cast<double>(result.size) * result.size);
+        const double logValue = std::log(result.values[metric]);
+        sumX += logTiles;
+        sumY += logValue;
+        sumXX += logTiles * logTiles;
+        sumXY += logTiles * logValue;
+        ++count;
+    }
+    const double denominator = count * sumXX - sumX * sumX;
+    if (count < 2 || denominator <= 0.0) {
+        return false;
+    }
+    outExponent = (count * sumXY - sumX * sumY) / denominator;
+    return true;
+}
+
+bool parseSizes(std::string_view list, std::vector<int>& outSizes) {
+    outSizes.clear();
+    while (!list.empty()) {
+        const std::size_t comma = list.find(',');
+        const int size = std::atoi(std::string(list.substr(0, comma)).c_str());
+        if (size < MapGenerator::kMinSize || size > MapGenerator::kMaxSize) {
+            return false;
+        }
+        outSizes.push_back(size);
+        list = comma == std::string_view::npos ? std::string_view{} : list.substr(comma + 1);
+    }
+    return !outSizes.empty();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::vector<int> sizes(kDefaultSizes.begin(), kDefaultSizes.end());
+    MapGenSettings settings;
+    bool densitySet = false;
+    bool render = true;
+    int frames = 60;
+    std::size_t particleCount = 0;
+    std::size_t actorCount = 0;
+    SimulationLodSettings lod;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--sizes" && hasValue) {
+            if (!parseSizes(argv[++i], sizes)) {
+                std::cerr << "map_bench: sizes must be " << MapGenerator::kMinSize << ".." << MapGenerator::kMaxSize << '\n';
+                return 1;
+            }
+        } else if (arg == "--style" && hasValue) {
+            const std::string_view style = argv[++i];
+            if (style != "town" && style != "canyon") {
+                std::cerr << "map_bench: unknown style " << style << '\n';
+                return 1;
+            }
+            settings.style = style == "town" ? MapStyle::Town : MapStyle::Canyon;
+        } else if (arg == "--seed" && hasValue) {
+            settings.seed = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--density" && hasValue) {
+            settings.wallDensity = static_cast<float>(std::atof(argv[++i]));
+            densitySet = true;
+        } else if (arg == "--frames" && hasValue) {
+            frames = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--particles" && hasValue) {
+            particleCount = static_cast<std::size_t>(std::max(0, std::atoi(argv[++i])));
+        } else if (arg == "--actors" && hasValue) {
+            actorCount = static_cast<std::size_t>(std::max(0, std::atoi(argv[++i])));
+        } else if (arg == "--lod-tiers" && hasValue) {
+            if (!SimulationLodSettings::parse(argv[++i], lod)) {
+                std::cerr << "map_bench: LOD tiers must look like 16:1,40:4,96:16,*:120\n";
+                return 1;
+            }
+        } else if (arg == "--no-render") {
+            render = false;
+        } else {
+            std::cerr << kUsage;
+            return 1;
+        }
+    }
+    if (!densitySet) {
+        settings.wallDensity = MapGenerator::defaultDensity(settings.style);
+    }
+
+    SDL_Window* window = nullptr;
+    AssetManager assets;
+    Renderer renderer;
+    if (render) {
+        ShaderSources sources;
+        if (SDL_Init(SDL_INIT_VIDEO) != 0) {
+            std::cerr << "SDL_Init failed: " << SDL_GetError() << '\n';
+            return 1;
+        }
+        window = SDL_CreateWindow(
+            "map_bench",
+            SDL_WINDOWPOS_CENTERED,
+            SDL_WINDOWPOS_CENTERED,
+            kBenchWindowWidth,
+            kBenchWindowHeight,
+            SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN);
+        if (window == nullptr || !assets.initialize() || !renderer.initialize(window) ||
+            !Renderer::loadShaderSources(assets, sources) || !renderer.uploadShaders(sources)) {
+            std::cerr << "map_bench: renderer setup failed; rerun with --no-render.\n";
+            return 1;
+        }
+        // A fixed resolution keeps frame times comparable across sizes.
+        renderer.setDynamicResolution(false);
+
+        // One frame on a small map first, so shader variants and render
+        // targets are not billed to the first measured size.
+        MapGenSettings warmup = settings;
+        warmup.width = MapGenerator::kMinSize;
+        warmup.height = MapGenerator::kMinSize;
+        std::string text;
+        Map map;
+        if (MapGenerator::generate(warmup, text) && map.loadFromAscii(text)) {
+            SizeResult ignored;
+            measureRendering(renderer, map, 1, particleCount, Townsfolk(), ignored);
+        }
+    }
+
+    std::vector<SizeResult> results;
+    for (const int size : sizes) {
+        SizeResult result;
+        result.size = size;
+        settings.width = size;
+        settings.height = size;
+
+        std::string text;
+        Clock::time_point start = Clock::now();
+        if (!MapGenerator::generate(settings, text)) {
+            std::cerr << "map_bench: invalid generator settings.\n";
+            return 1;
+        }
+        result.values[kGenerate] = elapsedMs(start);
+
+        Map map;
+        start = Clock::now();
+        map.loadFromAscii(text);
+        result.values[kLoad] = elapsedMs(start);
+        result.measured[kGenerate] = true;
+        result.measured[kLoad] = true;
+        text = std::string();
+
+        std::size_t blocked = 0;
+        for (int y = 0; y < map.height(); ++y) {
+            for (int x = 0; x < map.width(); ++x) {
+                blocked += map.isBlocked(x, y) ? 1 : 0;
+            }
+        }
+        result.blockedFraction = static_cast<float>(blocked) / (static_cast<float>(size) * static_cast<float>(size));
+
+        measureQueries(map, settings.seed, result);
+        Townsfolk townsfolk;
+        if (actorCount > 0) {
+            measureActors(map, settings.seed, actorCount, lod, townsfolk, result);
+        }
+        if (render) {
+            measureRendering(renderer, map, frames, particleCount, townsfolk, result);
+        }
+        std::cerr << "map_bench: " << size << 'x' << size << " done.\n";
+        results.push_back(result);
+    }
+
+    if (render) {
+        renderer.shutdown();
+        SDL_DestroyWindow(window);
+        SDL_Quit();
+    }
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << std::setw(22) << "size";
+    for (const SizeResult& result : results) {
+        std::cout << std::setw(12) << (std::to_string(result.size) + "^2");
+    }
+    std::cout << std::setw(9) << "growth" << '\n';
+    std::cout << std::setw(22) << "blocked";
+    for (const SizeResult& result : results) {
+        std::cout << std::setw(12) << result.blockedFraction;
+    }
+    std::cout << '\n';
+
+    for (std::size_t metric = 0; metric < kMetricCount; ++metric) {
+        if (!results.front().measured[metric]) {
+            continue;
+        }
+        std::cout << std::setw(22) << (std::string(kMetrics[metric].name) + " " + kMetrics[metric].unit);
+        for (const SizeResult& result : results) {
+            std::cout << std::setw(12) << result.values[metric];
+        }
+        double exponent = 0.0;
+        if (growthExponent(results, metric, exponent)) {
+            std::cout << std::setw(9) << std::setprecision(2) << exponent << std::setprecision(3);
+        }
+        std::cout << '\n';
+    }
+    std::cout << "growth: fitted k in time ~ tiles^k (0 = independent of map size, 1 = linear).\n";
+    return 0;
+}
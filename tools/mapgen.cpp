@@ -0,0 +1,72 @@
+// Writes a seeded stress map (see game/MapGenerator.hpp) for scaling tests.
+//
+// Usage: mapgen <output.map> <width> [height] [--style town|canyon] [--seed N] [--density F]
+
+#include "game/MapGenerator.hpp"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+namespace {
+
+constexpr char kUsage[] = "Usage: mapgen <output.map> <width> [height] [--style town|canyon] [--seed N] [--density F]\n";
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << kUsage;
+        return 1;
+    }
+
+    const std::string outputPath = argv[1];
+    MapGenSettings settings;
+    settings.width = std::atoi(argv[2]);
+    settings.height = settings.width;
+    bool densitySet = false;
+
+    for (int i = 3; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--style" && hasValue) {
+            const std::string_view style = argv[++i];
+            if (style != "town" && style != "canyon") {
+                std::cerr << "mapgen: unknown style " << style << '\n';
+                return 1;
+            }
+            settings.style = style == "town" ? MapStyle::Town : MapStyle::Canyon;
+        } else if (arg == "--seed" && hasValue) {
+            settings.seed = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--density" && hasValue) {
+            settings.wallDensity = static_cast<float>(std::atof(argv[++i]));
+            densitySet = true;
+        } else if (i == 3 && !arg.starts_with("--")) {
+            settings.height = std::atoi(argv[i]);
+        } else {
+            std::cerr << kUsage;
+            return 1;
+        }
+    }
+    if (!densitySet) {
+        settings.wallDensity = MapGenerator::defaultDensity(settings.style);
+    }
+
+    std::string text;
+    if (!MapGenerator::generate(settings, text)) {
+        std::cerr << "mapgen: sides must be " << MapGenerator::kMinSize << ".." << MapGenerator::kMaxSize
+                  << " and density 0..0.9\n";
+        return 1;
+    }
+
+    std::ofstream output(outputPath, std::ios::binary | std::ios::trunc);
+    output << text;
+    if (!output) {
+        std::cerr << "mapgen: unable to write " << outputPath << '\n';
+        return 1;
+    }
+    std::cout << "Wrote " << settings.width << 'x' << settings.height << " map to " << outputPath << '\n';
+    return 0;
+}